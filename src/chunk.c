@@ -9,20 +9,51 @@
 
 #include "rmutil/alloc.h"
 
+#include <math.h>
+
 Chunk_t *Uncompressed_NewChunk(size_t size) {
     Chunk *newChunk = (Chunk *)malloc(sizeof(Chunk));
     newChunk->num_samples = 0;
     newChunk->size = size;
+    newChunk->refs = 0;
     newChunk->samples = (Sample *)malloc(size);
 
     return newChunk;
 }
 
 void Uncompressed_FreeChunk(Chunk_t *chunk) {
-    free(((Chunk *)chunk)->samples);
+    Chunk *uncompChunk = chunk;
+    // a pinned chunk outlives its owner until the last reader releases it
+    uint32_t refs = __atomic_load_n(&uncompChunk->refs, __ATOMIC_ACQUIRE);
+    while (refs > 0) {
+        if (__atomic_compare_exchange_n(
+                &uncompChunk->refs, &refs, refs - 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return;
+        }
+    }
+    free(uncompChunk->samples);
     free(chunk);
 }
 
+Chunk_t *Uncompressed_CloneChunk(Chunk_t *chunk) {
+    Chunk *oldChunk = chunk;
+    Chunk *newChunk = malloc(sizeof(Chunk));
+    memcpy(newChunk, oldChunk, sizeof(Chunk));
+    newChunk->samples = malloc(newChunk->size);
+    memcpy(newChunk->samples, oldChunk->samples, oldChunk->size);
+    newChunk->refs = 0;
+    return newChunk;
+}
+
+Chunk_t *Uncompressed_RetainChunk(Chunk_t *chunk) {
+    __atomic_add_fetch(&((Chunk *)chunk)->refs, 1, __ATOMIC_RELAXED);
+    return chunk;
+}
+
+bool Uncompressed_IsChunkShared(Chunk_t *chunk) {
+    return __atomic_load_n(&((Chunk *)chunk)->refs, __ATOMIC_ACQUIRE) > 0;
+}
+
 /**
  * TODO: describe me
  * @param chunk
@@ -48,6 +79,12 @@ Chunk_t *Uncompressed_SplitChunk(Chunk_t *chunk) {
     return newChunk;
 }
 
+void Uncompressed_ResizeChunk(Chunk_t *chunk, size_t size) {
+    Chunk *uncompChunk = chunk;
+    uncompChunk->samples = realloc(uncompChunk->samples, size);
+    uncompChunk->size = size;
+}
+
 static int IsChunkFull(Chunk *chunk) {
     return chunk->num_samples == chunk->size / SAMPLE_SIZE;
 }
@@ -74,6 +111,26 @@ timestamp_t Uncompressed_GetFirstTimestamp(Chunk_t *chunk) {
     return ChunkGetSample(chunk, 0)->timestamp;
 }
 
+bool Uncompressed_GetValueRange(Chunk_t *chunk, double *min, double *max) {
+    Chunk *regChunk = chunk;
+    if (regChunk->num_samples == 0) {
+        return false;
+    }
+    *min = regChunk->minValue;
+    *max = regChunk->maxValue;
+    return true;
+}
+
+// Widens the value bounds of a chunk holding `value`, the chunk may be empty
+static void updateValueRange(Chunk *chunk, double value) {
+    if (chunk->num_samples == 0) {
+        chunk->minValue = chunk->maxValue = value;
+    } else {
+        chunk->minValue = fmin(chunk->minValue, value);
+        chunk->maxValue = fmax(chunk->maxValue, value);
+    }
+}
+
 ChunkResult Uncompressed_AddSample(Chunk_t *chunk, Sample *sample) {
     Chunk *regChunk = (Chunk *)chunk;
     if (IsChunkFull(regChunk)) {
@@ -85,6 +142,7 @@ ChunkResult Uncompressed_AddSample(Chunk_t *chunk, Sample *sample) {
         regChunk->base_timestamp = sample->timestamp;
     }
 
+    updateValueRange(regChunk, sample->value);
     regChunk->samples[regChunk->num_samples] = *sample;
     regChunk->num_samples++;
 
@@ -137,6 +195,7 @@ ChunkResult Uncompressed_UpsertSample(UpsertCtx *uCtx, int *size, DuplicatePolic
         if (cr != CR_OK) {
             return CR_ERR;
         }
+        updateValueRange(regChunk, uCtx->sample.value);
         regChunk->samples[i].value = uCtx->sample.value;
         return CR_OK;
     }
@@ -145,15 +204,43 @@ ChunkResult Uncompressed_UpsertSample(UpsertCtx *uCtx, int *size, DuplicatePolic
         regChunk->base_timestamp = ts;
     }
 
+    updateValueRange(regChunk, uCtx->sample.value);
     upsertChunk(regChunk, i, &uCtx->sample);
     *size = 1;
     return CR_OK;
 }
 
-ChunkIter_t *Uncompressed_NewChunkIterator(Chunk_t *chunk,
-                                           int options,
-                                           ChunkIterFuncs *retChunkIterClass) {
-    ChunkIterator *iter = (ChunkIterator *)calloc(1, sizeof(ChunkIterator));
+size_t Uncompressed_DelRange(Chunk_t *chunk, timestamp_t startTs, timestamp_t endTs) {
+    Chunk *regChunk = (Chunk *)chunk;
+    size_t first = 0;
+    while (first < regChunk->num_samples && regChunk->samples[first].timestamp < startTs) {
+        first++;
+    }
+    size_t last = first;
+    while (last < regChunk->num_samples && regChunk->samples[last].timestamp <= endTs) {
+        last++;
+    }
+    size_t deleted = last - first;
+    if (deleted == 0) {
+        return 0;
+    }
+    memmove(&regChunk->samples[first],
+            &regChunk->samples[last],
+            (regChunk->num_samples - last) * sizeof(Sample));
+    regChunk->num_samples -= deleted;
+    if (regChunk->num_samples > 0) {
+        regChunk->base_timestamp = regChunk->samples[0].timestamp;
+    }
+    return deleted;
+}
+
+void Uncompressed_InitChunkIterator(Chunk_t *chunk,
+                                    int options,
+                                    ChunkIterFuncs *retChunkIterClass,
+                                    ChunkIter_t *iterator,
+                                    ChunkIterScratch *scratch) {
+    ChunkIterator *iter = iterator;
+    memset(iter, 0, sizeof(*iter));
     iter->chunk = chunk;
     iter->options = options;
     if (options & CHUNK_ITER_OP_REVERSE) { // iterate from last to first
@@ -165,7 +252,13 @@ ChunkIter_t *Uncompressed_NewChunkIterator(Chunk_t *chunk,
     if (retChunkIterClass != NULL) {
         *retChunkIterClass = *GetChunkIteratorClass(CHUNK_REGULAR);
     }
+}
 
+ChunkIter_t *Uncompressed_NewChunkIterator(Chunk_t *chunk,
+                                           int options,
+                                           ChunkIterFuncs *retChunkIterClass) {
+    ChunkIterator *iter = (ChunkIterator *)malloc(sizeof(ChunkIterator));
+    Uncompressed_InitChunkIterator(chunk, options, retChunkIterClass, iter, NULL);
     return (ChunkIter_t *)iter;
 }
 
@@ -206,6 +299,10 @@ size_t Uncompressed_GetChunkSize(Chunk_t *chunk, bool includeStruct) {
     return size;
 }
 
+size_t Uncompressed_GetChunkDataSize(Chunk_t *chunk) {
+    return ((Chunk *)chunk)->num_samples * SAMPLE_SIZE;
+}
+
 typedef void (*SaveUnsignedFunc)(void *, uint64_t);
 typedef void (*SaveStringBufferFunc)(void *, const char *str, size_t len);
 typedef uint64_t (*ReadUnsignedFunc)(void *);
@@ -230,11 +327,18 @@ static void Uncompressed_Deserialize(Chunk_t **chunk,
                                      ReadStringBufferFunc readStringBuffer) {
     Chunk *uncompchunk = (Chunk *)malloc(sizeof(*uncompchunk));
 
+    uncompchunk->refs = 0;
     uncompchunk->base_timestamp = readUnsigned(ctx);
     uncompchunk->num_samples = readUnsigned(ctx);
     uncompchunk->size = readUnsigned(ctx);
     size_t string_buffer_size;
     uncompchunk->samples = (Sample *)readStringBuffer(ctx, &string_buffer_size);
+    // the value bounds are not serialized, they are recomputed from the samples
+    for (unsigned int i = 0; i < uncompchunk->num_samples; i++) {
+        double value = uncompchunk->samples[i].value;
+        uncompchunk->minValue = i == 0 ? value : fmin(uncompchunk->minValue, value);
+        uncompchunk->maxValue = i == 0 ? value : fmax(uncompchunk->maxValue, value);
+    }
     *chunk = (Chunk_t *)uncompchunk;
 }
 
@@ -255,3 +359,9 @@ void Uncompressed_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io) {
 void Uncompressed_GearsSerialize(Chunk_t *chunk, Gears_BufferWriter *bw) {}
 
 void Uncompressed_GearsDeserialize(Chunk_t *chunk, Gears_BufferReader *br) {}
+
+Chunk_t *Uncompressed_DefragChunk(RedisModuleDefragCtx *ctx, Chunk_t *chunk) {
+    Chunk *uncompChunk = DefragPtr(ctx, chunk);
+    uncompChunk->samples = DefragPtr(ctx, uncompChunk->samples);
+    return uncompChunk;
+}
@@ -17,6 +17,10 @@ typedef struct Chunk
     Sample *samples;
     unsigned int num_samples;
     size_t size;
+    uint32_t refs; // readers pinning the chunk besides its owner, see RetainChunk
+    // bounds of the values, see ChunkFuncs.GetValueRange
+    double minValue;
+    double maxValue;
 } Chunk;
 
 typedef struct ChunkIterator
@@ -30,6 +34,9 @@ typedef struct ChunkIterator
 
 Chunk_t *Uncompressed_NewChunk(size_t sampleCount);
 void Uncompressed_FreeChunk(Chunk_t *chunk);
+Chunk_t *Uncompressed_CloneChunk(Chunk_t *chunk);
+Chunk_t *Uncompressed_RetainChunk(Chunk_t *chunk);
+bool Uncompressed_IsChunkShared(Chunk_t *chunk);
 
 /**
  * TODO: describe me
@@ -37,7 +44,9 @@ void Uncompressed_FreeChunk(Chunk_t *chunk);
  * @return
  */
 Chunk_t *Uncompressed_SplitChunk(Chunk_t *chunk);
+void Uncompressed_ResizeChunk(Chunk_t *chunk, size_t size);
 size_t Uncompressed_GetChunkSize(Chunk_t *chunk, bool includeStruct);
+size_t Uncompressed_GetChunkDataSize(Chunk_t *chunk);
 
 /**
  * TODO: describe me
@@ -55,14 +64,21 @@ ChunkResult Uncompressed_AddSample(Chunk_t *chunk, Sample *sample);
  * @return
  */
 ChunkResult Uncompressed_UpsertSample(UpsertCtx *uCtx, int *size, DuplicatePolicy duplicatePolicy);
+size_t Uncompressed_DelRange(Chunk_t *chunk, timestamp_t startTs, timestamp_t endTs);
 
 u_int64_t Uncompressed_NumOfSample(Chunk_t *chunk);
 timestamp_t Uncompressed_GetLastTimestamp(Chunk_t *chunk);
 timestamp_t Uncompressed_GetFirstTimestamp(Chunk_t *chunk);
+bool Uncompressed_GetValueRange(Chunk_t *chunk, double *min, double *max);
 
 ChunkIter_t *Uncompressed_NewChunkIterator(Chunk_t *chunk,
                                            int options,
                                            ChunkIterFuncs *retChunkIterClass);
+void Uncompressed_InitChunkIterator(Chunk_t *chunk,
+                                    int options,
+                                    ChunkIterFuncs *retChunkIterClass,
+                                    ChunkIter_t *iter,
+                                    ChunkIterScratch *scratch);
 ChunkResult Uncompressed_ChunkIteratorGetNext(ChunkIter_t *iterator, Sample *sample);
 ChunkResult Uncompressed_ChunkIteratorGetPrev(ChunkIter_t *iterator, Sample *sample);
 void Uncompressed_FreeChunkIterator(ChunkIter_t *iter);
@@ -75,4 +91,7 @@ void Uncompressed_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io);
 void Uncompressed_GearsSerialize(Chunk_t *chunk, Gears_BufferWriter *bw);
 void Uncompressed_GearsDeserialize(Chunk_t *chunk, Gears_BufferReader *br);
 
+// Defrag
+Chunk_t *Uncompressed_DefragChunk(struct RedisModuleDefragCtx *ctx, Chunk_t *chunk);
+
 #endif
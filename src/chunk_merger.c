@@ -0,0 +1,189 @@
+/*
+ * Copyright 2018-2020 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "chunk_merger.h"
+
+#include "endianconv.h"
+#include "gorilla.h"
+#include "module.h"
+#include "tsdb.h"
+
+#include "rmutil/alloc.h"
+
+static struct
+{
+    long long interval;
+    int db;
+    RedisModuleScanCursor *cursor;
+    bool dbScanned;
+    // series keys returned by the last scan step, merged before scanning further
+    RedisModuleString **keys;
+    size_t keysCount;
+    size_t keysCap;
+    size_t next;
+    // resume point inside keys[next]
+    size_t field;
+    timestamp_t from;
+} merger;
+
+static bool isMergeable(Series *series, Chunk_t *chunk) {
+    if (chunk == series->lastChunk) {
+        return false;
+    }
+    // cold chunks stay where they are, merging would bring them back to RAM
+    return (series->options & SERIES_OPT_UNCOMPRESSED) || !((CompressedChunk *)chunk)->cold;
+}
+
+// Returns NULL if the samples of both chunks do not fit in a single chunk
+static Chunk_t *mergeChunks(Series *series, Chunk_t *first, Chunk_t *second) {
+    ChunkFuncs *funcs = series->funcs;
+    Chunk_t *merged = funcs->NewChunk(series->chunkSizeBytes);
+    Chunk_t *parts[] = { first, second };
+    for (size_t i = 0; i < 2; i++) {
+        ChunkIterFuncs iterFuncs;
+        ChunkIter_t *iter = funcs->NewChunkIterator(parts[i], CHUNK_ITER_OP_NONE, &iterFuncs);
+        Sample sample;
+        while (iterFuncs.GetNext(iter, &sample) == CR_OK) {
+            if (funcs->AddSample(merged, &sample) != CR_OK) {
+                iterFuncs.Free(iter);
+                funcs->FreeChunk(merged);
+                return NULL;
+            }
+        }
+        iterFuncs.Free(iter);
+    }
+    return merged;
+}
+
+bool SeriesMergeChunks(Series *series, timestamp_t *from, size_t *budget) {
+    ChunkFuncs *funcs = series->funcs;
+    timestamp_t rax_key;
+    seriesEncodeTimestamp(&rax_key, *from);
+    RedisModuleDictIter *iter =
+        RedisModule_DictIteratorStartC(series->chunks, ">=", &rax_key, sizeof(rax_key));
+
+    bool done = true;
+    Chunk_t *prev = NULL, *chunk;
+    timestamp_t prevKey = 0;
+    void *key;
+    while ((key = RedisModule_DictNextC(iter, NULL, (void *)&chunk))) {
+        timestamp_t chunkKey;
+        memcpy(&chunkKey, key, sizeof(chunkKey));
+        chunkKey = ntohu64(chunkKey);
+        if (*budget == 0) {
+            *from = chunkKey;
+            done = false;
+            break;
+        }
+        (*budget)--;
+        if (!isMergeable(series, chunk)) {
+            prev = NULL;
+            continue;
+        }
+        if (prev != NULL && funcs->GetChunkDataSize(prev) + funcs->GetChunkDataSize(chunk) <=
+                                (size_t)series->chunkSizeBytes) {
+            Chunk_t *merged = mergeChunks(series, prev, chunk);
+            if (merged != NULL) {
+                // the merged chunk takes over the key of the first one
+                dictOperator(series->chunks, merged, prevKey, DICT_OP_REPLACE);
+                dictOperator(series->chunks, NULL, chunkKey, DICT_OP_DEL);
+                seriesEncodeTimestamp(&rax_key, chunkKey);
+                RedisModule_DictIteratorReseekC(iter, ">", &rax_key, sizeof(rax_key));
+                SeriesAccountChunk(series, prev, -1);
+                SeriesAccountChunk(series, chunk, -1);
+                SeriesAccountChunk(series, merged, 1);
+                funcs->FreeChunk(prev);
+                funcs->FreeChunk(chunk);
+                prev = merged;
+                continue;
+            }
+        }
+        prev = chunk;
+        prevKey = chunkKey;
+    }
+    RedisModule_DictIteratorStop(iter);
+    return done;
+}
+
+static void collectSeriesKey(RedisModuleCtx *ctx,
+                             RedisModuleString *keyname,
+                             RedisModuleKey *key,
+                             void *privdata) {
+    if (key == NULL || RedisModule_ModuleTypeGetType(key) != SeriesType) {
+        return;
+    }
+    if (merger.keysCount == merger.keysCap) {
+        merger.keysCap = merger.keysCap ? merger.keysCap * 2 : 16;
+        merger.keys = realloc(merger.keys, merger.keysCap * sizeof(*merger.keys));
+    }
+    merger.keys[merger.keysCount++] = RedisModule_CreateStringFromString(NULL, keyname);
+}
+
+// Returns false when the key still has work left and the budget ran out. Only the chunks of the
+// series and its fields are merged: embedded levels are skipped, they are written once per closed
+// bucket and rarely fragment, and so are cold chunks (see isMergeable).
+static bool mergeKey(RedisModuleCtx *ctx, RedisModuleString *keyName, size_t *budget) {
+    Series *series;
+    RedisModuleKey *key;
+    // the key may have been deleted since it was scanned
+    if (!SilentGetSeries(ctx, keyName, &key, &series, REDISMODULE_READ | REDISMODULE_WRITE)) {
+        return true;
+    }
+    size_t fieldsCount = series->fieldsCount > 0 ? series->fieldsCount : 1;
+    for (; merger.field < fieldsCount; merger.field++) {
+        if (!SeriesMergeChunks(SeriesGetField(series, merger.field), &merger.from, budget)) {
+            RedisModule_CloseKey(key);
+            return false;
+        }
+        merger.from = 0;
+    }
+    RedisModule_CloseKey(key);
+    return true;
+}
+
+static void mergeTick(RedisModuleCtx *ctx, void *data) {
+    size_t budget = CHUNK_MERGE_BUDGET;
+    if (RedisModule_SelectDb(ctx, merger.db) != REDISMODULE_OK) {
+        merger.db = 0;
+        RedisModule_SelectDb(ctx, merger.db);
+    }
+    while (budget > 0) {
+        if (merger.next == merger.keysCount) {
+            merger.next = merger.keysCount = 0;
+            if (merger.dbScanned) {
+                // continue with the next db on the next tick
+                merger.dbScanned = false;
+                merger.db++;
+                break;
+            }
+            // a scan step counts as a visit so an empty keyspace does not spin
+            budget--;
+            if (merger.cursor == NULL) {
+                merger.cursor = RedisModule_ScanCursorCreate();
+            }
+            if (!RedisModule_Scan(ctx, merger.cursor, collectSeriesKey, NULL)) {
+                RedisModule_ScanCursorDestroy(merger.cursor);
+                merger.cursor = NULL;
+                merger.dbScanned = true;
+            }
+            continue;
+        }
+        if (!mergeKey(ctx, merger.keys[merger.next], &budget)) {
+            break;
+        }
+        RedisModule_FreeString(NULL, merger.keys[merger.next]);
+        merger.next++;
+        merger.field = 0;
+        merger.from = 0;
+    }
+    RedisModule_CreateTimer(ctx, merger.interval, mergeTick, NULL);
+}
+
+void ChunkMerger_Start(RedisModuleCtx *ctx, long long interval) {
+    merger.interval = interval;
+    if (interval > 0) {
+        RedisModule_CreateTimer(ctx, interval, mergeTick, NULL);
+    }
+}
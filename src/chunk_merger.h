@@ -0,0 +1,29 @@
+/*
+ * Copyright 2018-2020 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#ifndef CHUNK_MERGER_H
+#define CHUNK_MERGER_H
+
+#include "consts.h"
+#include "redismodule.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct Series;
+
+// Out-of-order upserts split chunks in half and backfills leave partially filled chunks behind.
+// A timer walks the keyspace in bounded slices and merges adjacent sealed chunks whose samples fit
+// in a single chunk of the series' chunk size.
+
+// Merges the undersized chunks of a series, starting at the chunk keyed `*from`. Every visited
+// chunk consumes one unit of `*budget`; when it runs out `*from` is set to the chunk to resume
+// from and false is returned.
+bool SeriesMergeChunks(struct Series *series, timestamp_t *from, size_t *budget);
+
+// Schedules the merge timer, an interval of 0 disables it
+void ChunkMerger_Start(RedisModuleCtx *ctx, long long interval);
+
+#endif
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2018-2020 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "cold_tier.h"
+
+#include "gorilla.h"
+#include "tsdb.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "rmutil/alloc.h"
+
+#define COLD_TIER_ALIGN sizeof(binary_t)
+
+typedef struct ColdSegment
+{
+    char *base;
+    size_t used;
+    size_t live;
+} ColdSegment;
+
+static struct
+{
+    char *path;
+    long long age;
+    ColdSegment *segments;
+    size_t segmentsCount;
+    size_t nextId;
+    // chunks of lazily freed series are released from the lazyfree thread
+    pthread_mutex_t lock;
+} coldTier = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+bool ColdTier_Enabled() {
+    return coldTier.path != NULL;
+}
+
+int ColdTier_Init(const char *path, long long age) {
+    if (access(path, W_OK) != 0) {
+        return TSDB_ERROR;
+    }
+    coldTier.path = strdup(path);
+    coldTier.age = age;
+    return TSDB_OK;
+}
+
+// The file is unlinked as soon as it is mapped: the mapping keeps the space alive and nothing is
+// left behind on restart, since RDB files carry the cold data themselves.
+static ColdSegment *openSegment() {
+    char filename[PATH_MAX];
+    snprintf(filename,
+             sizeof(filename),
+             "%s/timeseries-%d-%zu.seg",
+             coldTier.path,
+             (int)getpid(),
+             coldTier.nextId++);
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1) {
+        return NULL;
+    }
+    char *base = MAP_FAILED;
+    if (ftruncate(fd, COLD_TIER_SEGMENT_SIZE) == 0) {
+        base = mmap(NULL, COLD_TIER_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    unlink(filename);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    coldTier.segments =
+        realloc(coldTier.segments, sizeof(ColdSegment) * (coldTier.segmentsCount + 1));
+    ColdSegment *segment = &coldTier.segments[coldTier.segmentsCount++];
+    *segment = (ColdSegment){ .base = base, .used = 0, .live = 0 };
+    return segment;
+}
+
+void *ColdTier_Store(const void *data, size_t size) {
+    size_t allocSize = (size + COLD_TIER_ALIGN - 1) & ~(COLD_TIER_ALIGN - 1);
+    if (!ColdTier_Enabled() || allocSize > COLD_TIER_SEGMENT_SIZE) {
+        return NULL;
+    }
+    pthread_mutex_lock(&coldTier.lock);
+    ColdSegment *segment = NULL;
+    if (coldTier.segmentsCount > 0) {
+        segment = &coldTier.segments[coldTier.segmentsCount - 1];
+    }
+    if (segment == NULL || segment->used + allocSize > COLD_TIER_SEGMENT_SIZE) {
+        if ((segment = openSegment()) == NULL) {
+            pthread_mutex_unlock(&coldTier.lock);
+            return NULL;
+        }
+    }
+    char *dest = segment->base + segment->used;
+    memcpy(dest, data, size);
+    segment->used += allocSize;
+    segment->live += allocSize;
+    pthread_mutex_unlock(&coldTier.lock);
+    return dest;
+}
+
+void ColdTier_Release(void *data, size_t size) {
+    size_t allocSize = (size + COLD_TIER_ALIGN - 1) & ~(COLD_TIER_ALIGN - 1);
+    pthread_mutex_lock(&coldTier.lock);
+    for (size_t i = 0; i < coldTier.segmentsCount; i++) {
+        ColdSegment *segment = &coldTier.segments[i];
+        if ((char *)data < segment->base ||
+            (char *)data >= segment->base + COLD_TIER_SEGMENT_SIZE) {
+            continue;
+        }
+        segment->live -= allocSize;
+        // the segment being appended to is kept even when empty
+        if (segment->live == 0 && i != coldTier.segmentsCount - 1) {
+            munmap(segment->base, COLD_TIER_SEGMENT_SIZE);
+            // keep the order, the last segment is the one being appended to
+            memmove(&coldTier.segments[i],
+                    &coldTier.segments[i + 1],
+                    (coldTier.segmentsCount - i - 1) * sizeof(ColdSegment));
+            coldTier.segmentsCount--;
+        }
+        break;
+    }
+    pthread_mutex_unlock(&coldTier.lock);
+}
+
+void ColdTier_WillNeed(const void *data, size_t size) {
+    long pageSize = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)data & ~(uintptr_t)(pageSize - 1);
+    madvise((void *)start, (uintptr_t)data + size - start, MADV_WILLNEED);
+}
+
+void SeriesDemoteChunks(Series *series) {
+    if (!ColdTier_Enabled() || series->isTemporary ||
+        (series->options & SERIES_OPT_UNCOMPRESSED) ||
+        series->lastTimestamp <= (timestamp_t)coldTier.age) {
+        return;
+    }
+    const timestamp_t threshold = series->lastTimestamp - coldTier.age;
+
+    // Walk back from the newest sealed chunk. Chunks age in order, so everything before the
+    // first cold chunk is already cold.
+    timestamp_t rax_key;
+    seriesEncodeTimestamp(&rax_key, series->funcs->GetFirstTimestamp(series->lastChunk));
+    RedisModuleDictIter *iter =
+        RedisModule_DictIteratorStartC(series->chunks, "<", &rax_key, sizeof(rax_key));
+    CompressedChunk *chunk;
+    while (RedisModule_DictPrevC(iter, NULL, (void **)&chunk) != NULL) {
+        if (chunk->cold) {
+            break;
+        }
+        // a pinned chunk keeps its data where its readers found it
+        if (chunk->prevTimestamp >= threshold || series->funcs->IsChunkShared(chunk)) {
+            continue;
+        }
+        void *data = ColdTier_Store(chunk->data, chunk->size);
+        if (data == NULL) {
+            break;
+        }
+        SeriesAccountChunk(series, chunk, -1);
+        free(chunk->data);
+        chunk->data = data;
+        chunk->cold = true;
+        SeriesAccountChunk(series, chunk, 1);
+    }
+    RedisModule_DictIteratorStop(iter);
+}
+
+void SeriesPromoteChunk(Series *series, void *chunk) {
+    CompressedChunk *cmpChunk = chunk;
+    if ((series->options & SERIES_OPT_UNCOMPRESSED) || !cmpChunk->cold) {
+        return;
+    }
+    SeriesAccountChunk(series, cmpChunk, -1);
+    void *data = malloc(cmpChunk->size);
+    memcpy(data, cmpChunk->data, cmpChunk->size);
+    ColdTier_Release(cmpChunk->data, cmpChunk->size);
+    cmpChunk->data = data;
+    cmpChunk->cold = false;
+    SeriesAccountChunk(series, cmpChunk, 1);
+}
+
+static void addColdResidency(Series *series, size_t *chunks, size_t *bytes) {
+    if (series->options & SERIES_OPT_UNCOMPRESSED) {
+        return;
+    }
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
+    CompressedChunk *chunk;
+    while (RedisModule_DictNextC(iter, NULL, (void **)&chunk) != NULL) {
+        if (chunk->cold) {
+            (*chunks)++;
+            *bytes += chunk->size;
+        }
+    }
+    RedisModule_DictIteratorStop(iter);
+}
+
+void SeriesColdResidency(Series *series, size_t *chunks, size_t *bytes) {
+    *chunks = 0;
+    *bytes = 0;
+    size_t fieldsCount = series->fieldsCount > 0 ? series->fieldsCount : 1;
+    for (size_t i = 0; i < fieldsCount; i++) {
+        addColdResidency(SeriesGetField(series, i), chunks, bytes);
+    }
+}
+
+ColdTierStats ColdTier_GetStats() {
+    pthread_mutex_lock(&coldTier.lock);
+    ColdTierStats stats = { .segments = coldTier.segmentsCount };
+    for (size_t i = 0; i < coldTier.segmentsCount; i++) {
+        stats.mappedBytes += COLD_TIER_SEGMENT_SIZE;
+        stats.liveBytes += coldTier.segments[i].live;
+    }
+    pthread_mutex_unlock(&coldTier.lock);
+    return stats;
+}
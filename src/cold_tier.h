@@ -0,0 +1,46 @@
+/*
+ * Copyright 2018-2020 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#ifndef COLD_TIER_H
+#define COLD_TIER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct Series;
+
+// Sealed compressed chunks older than the configured age are moved out of the heap into
+// append-only segment files mapped in memory. A cold chunk keeps its CompressedChunk struct in
+// the chunk dictionary; only its data buffer points into a segment, so readers are unaffected.
+// Writers replace the buffer (upsert, split) which brings the chunk back to RAM.
+
+#define COLD_TIER_SEGMENT_SIZE (64 * 1024 * 1024)
+
+typedef struct ColdTierStats
+{
+    size_t segments;
+    size_t mappedBytes; // size of all segments
+    size_t liveBytes;   // bytes still referenced by chunks
+} ColdTierStats;
+
+bool ColdTier_Enabled();
+int ColdTier_Init(const char *path, long long age);
+
+// Copies a chunk buffer into the current segment. Returns NULL if the tier is full or disabled.
+void *ColdTier_Store(const void *data, size_t size);
+// Drops a reference to a buffer previously returned by ColdTier_Store
+void ColdTier_Release(void *data, size_t size);
+// Readahead hint before a cold buffer is decoded
+void ColdTier_WillNeed(const void *data, size_t size);
+
+// Moves the sealed chunks of the series that crossed the age threshold to the cold tier
+void SeriesDemoteChunks(struct Series *series);
+// Brings a cold chunk back to the heap before it is appended to again
+void SeriesPromoteChunk(struct Series *series, void *chunk);
+void SeriesColdResidency(struct Series *series, size_t *chunks, size_t *bytes);
+
+ColdTierStats ColdTier_GetStats();
+
+#endif
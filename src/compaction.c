@@ -5,6 +5,8 @@
  */
 #include "compaction.h"
 
+#include "quantile_sketch.h"
+
 #include <ctype.h>
 #include <math.h> // sqrt
 #include <string.h>
@@ -36,6 +38,58 @@ typedef struct StdContext
     u_int64_t cnt;
 } StdContext;
 
+typedef struct CounterContext
+{
+    double increase; // sum of the increases between consecutive samples
+    u_int64_t pairs; // number of increases summed
+    u_int64_t samples;
+    // time covered by the increases, from the carried sample on
+    timestamp_t minTimestamp;
+    timestamp_t maxTimestamp;
+    // the last sample appended, carried over to the next bucket
+    timestamp_t prevTimestamp;
+    double prevValue;
+    char hasPrev;
+    // the sample carried from the previous bucket
+    timestamp_t carriedTimestamp;
+    double carriedValue;
+    char hasCarried;
+    // the two newest samples of the bucket
+    timestamp_t lastTimestamp;
+    double lastValue;
+    timestamp_t beforeLastTimestamp;
+    double beforeLastValue;
+    // samples from this time on belong to the next bucket
+    timestamp_t bucketEnd;
+} CounterContext;
+
+typedef struct TwaContext
+{
+    timestamp_t bucketStart;
+    timestamp_t bucketEnd;
+    double area; // under the samples of the bucket, linearly interpolated
+    u_int64_t count;
+    // oldest and newest samples of the bucket
+    timestamp_t firstTimestamp;
+    double firstValue;
+    timestamp_t lastTimestamp;
+    double lastValue;
+    // the last sample appended to the bucket, carried over to the next one
+    timestamp_t prevTimestamp;
+    double prevValue;
+    // the sample carried from the previous bucket, a neighbour once the bucket is set
+    timestamp_t carriedTimestamp;
+    double carriedValue;
+    char hasCarried;
+    // the nearest samples on either side of the bucket
+    timestamp_t beforeTimestamp;
+    double beforeValue;
+    char hasBefore;
+    timestamp_t afterTimestamp;
+    double afterValue;
+    char hasAfter;
+} TwaContext;
+
 void *SingleValueCreateContext() {
     SingleValueContext *context = (SingleValueContext *)malloc(sizeof(SingleValueContext));
     context->value = 0;
@@ -75,7 +129,7 @@ void *AvgCreateContext() {
     return context;
 }
 
-void AvgAddValue(void *contextPtr, double value) {
+void AvgAddValue(void *contextPtr, double value, timestamp_t timestamp) {
     AvgContext *context = (AvgContext *)contextPtr;
     context->val += value;
     context->cnt++;
@@ -107,6 +161,13 @@ void AvgReadContext(void *contextPtr, RedisModuleIO *io) {
     context->cnt = RedisModule_LoadDouble(io);
 }
 
+void AvgMergeContext(void *contextPtr, const void *srcPtr) {
+    AvgContext *context = (AvgContext *)contextPtr;
+    const AvgContext *src = (const AvgContext *)srcPtr;
+    context->val += src->val;
+    context->cnt += src->cnt;
+}
+
 void *StdCreateContext() {
     StdContext *context = (StdContext *)malloc(sizeof(StdContext));
     context->cnt = 0;
@@ -115,13 +176,21 @@ void *StdCreateContext() {
     return context;
 }
 
-void StdAddValue(void *contextPtr, double value) {
+void StdAddValue(void *contextPtr, double value, timestamp_t timestamp) {
     StdContext *context = (StdContext *)contextPtr;
     ++context->cnt;
     context->sum += value;
     context->sum_2 += value * value;
 }
 
+void StdMergeContext(void *contextPtr, const void *srcPtr) {
+    StdContext *context = (StdContext *)contextPtr;
+    const StdContext *src = (const StdContext *)srcPtr;
+    context->cnt += src->cnt;
+    context->sum += src->sum;
+    context->sum_2 += src->sum_2;
+}
+
 static inline double variance(double sum, double sum_2, double count) {
     if (count == 0) {
         return 0;
@@ -196,6 +265,333 @@ void StdReadContext(void *contextPtr, RedisModuleIO *io) {
     context->cnt = RedisModule_LoadUnsigned(io);
 }
 
+// Increase of a counter between two samples, a decrease means the counter was reset to 0
+static double counterIncrease(timestamp_t t1, double v1, timestamp_t t2, double v2) {
+    // reverse queries append the newer sample first
+    double older = t1 < t2 ? v1 : v2;
+    double newer = t1 < t2 ? v2 : v1;
+    return newer >= older ? newer - older : newer;
+}
+
+void CounterReset(void *contextPtr) {
+    CounterContext *context = (CounterContext *)contextPtr;
+    context->increase = 0;
+    context->pairs = 0;
+    context->samples = 0;
+    // the last sample of the previous bucket opens this one, so a reset or an increase between
+    // the buckets is not lost
+    context->hasCarried = context->hasPrev;
+    context->carriedTimestamp = context->prevTimestamp;
+    context->carriedValue = context->prevValue;
+    context->minTimestamp = context->prevTimestamp;
+    context->maxTimestamp = context->prevTimestamp;
+    context->bucketEnd = UINT64_MAX;
+}
+
+void CounterSetBucket(void *contextPtr, timestamp_t start, timestamp_t end) {
+    CounterContext *context = (CounterContext *)contextPtr;
+    context->bucketEnd = end;
+    // reverse queries carry a sample from the newer bucket, its increase was counted there
+    if (context->hasPrev && context->prevTimestamp >= end) {
+        context->hasPrev = FALSE;
+        context->hasCarried = FALSE;
+    }
+}
+
+void *CounterCreateContext() {
+    CounterContext *context = (CounterContext *)calloc(1, sizeof(CounterContext));
+    CounterReset(context);
+    return context;
+}
+
+void CounterAppendValue(void *contextPtr, double value, timestamp_t timestamp) {
+    CounterContext *context = (CounterContext *)contextPtr;
+    if (timestamp >= context->bucketEnd) {
+        // the increase up to the next bucket is counted there
+        return;
+    }
+    // reverse queries append the sample that opens a bucket twice, see seedAggregations
+    if (context->hasPrev && context->prevTimestamp != timestamp) {
+        context->increase +=
+            counterIncrease(context->prevTimestamp, context->prevValue, timestamp, value);
+        context->pairs++;
+    }
+    if (context->hasPrev || context->samples > 0) {
+        context->minTimestamp = min(context->minTimestamp, timestamp);
+        context->maxTimestamp = max(context->maxTimestamp, timestamp);
+    } else {
+        context->minTimestamp = context->maxTimestamp = timestamp;
+    }
+    if (context->samples == 0 || timestamp > context->lastTimestamp) {
+        context->beforeLastTimestamp = context->lastTimestamp;
+        context->beforeLastValue = context->lastValue;
+        context->lastTimestamp = timestamp;
+        context->lastValue = value;
+    } else if (context->samples == 1 || timestamp > context->beforeLastTimestamp) {
+        context->beforeLastTimestamp = timestamp;
+        context->beforeLastValue = value;
+    }
+    context->samples++;
+    context->prevTimestamp = timestamp;
+    context->prevValue = value;
+    context->hasPrev = TRUE;
+}
+
+int IncreaseFinalize(void *contextPtr, double *value) {
+    CounterContext *context = (CounterContext *)contextPtr;
+    if (context->pairs == 0) {
+        return TSDB_ERROR;
+    }
+    *value = context->increase;
+    return TSDB_OK;
+}
+
+// Per second, timestamps being in milliseconds
+int RateFinalize(void *contextPtr, double *value) {
+    CounterContext *context = (CounterContext *)contextPtr;
+    if (context->pairs == 0 || context->maxTimestamp == context->minTimestamp) {
+        return TSDB_ERROR;
+    }
+    *value = context->increase * 1000 / (context->maxTimestamp - context->minTimestamp);
+    return TSDB_OK;
+}
+
+// Per second rate between the two newest samples of the bucket
+int IRateFinalize(void *contextPtr, double *value) {
+    CounterContext *context = (CounterContext *)contextPtr;
+    timestamp_t olderTimestamp;
+    double olderValue;
+    if (context->samples >= 2) {
+        olderTimestamp = context->beforeLastTimestamp;
+        olderValue = context->beforeLastValue;
+    } else if (context->samples == 1 && context->hasCarried &&
+               context->carriedTimestamp < context->lastTimestamp) {
+        olderTimestamp = context->carriedTimestamp;
+        olderValue = context->carriedValue;
+    } else {
+        return TSDB_ERROR;
+    }
+    if (olderTimestamp == context->lastTimestamp) {
+        return TSDB_ERROR;
+    }
+    *value = counterIncrease(olderTimestamp, olderValue, context->lastTimestamp, context->lastValue) *
+             1000 / (context->lastTimestamp - olderTimestamp);
+    return TSDB_OK;
+}
+
+void CounterWriteContext(void *contextPtr, RedisModuleIO *io) {
+    CounterContext *context = (CounterContext *)contextPtr;
+    RedisModule_SaveDouble(io, context->increase);
+    RedisModule_SaveUnsigned(io, context->pairs);
+    RedisModule_SaveUnsigned(io, context->samples);
+    RedisModule_SaveUnsigned(io, context->minTimestamp);
+    RedisModule_SaveUnsigned(io, context->maxTimestamp);
+    RedisModule_SaveUnsigned(io, context->prevTimestamp);
+    RedisModule_SaveDouble(io, context->prevValue);
+    RedisModule_SaveUnsigned(io, context->hasPrev);
+    RedisModule_SaveUnsigned(io, context->carriedTimestamp);
+    RedisModule_SaveDouble(io, context->carriedValue);
+    RedisModule_SaveUnsigned(io, context->hasCarried);
+    RedisModule_SaveUnsigned(io, context->lastTimestamp);
+    RedisModule_SaveDouble(io, context->lastValue);
+    RedisModule_SaveUnsigned(io, context->beforeLastTimestamp);
+    RedisModule_SaveDouble(io, context->beforeLastValue);
+    RedisModule_SaveUnsigned(io, context->bucketEnd);
+}
+
+void CounterReadContext(void *contextPtr, RedisModuleIO *io) {
+    CounterContext *context = (CounterContext *)contextPtr;
+    context->increase = RedisModule_LoadDouble(io);
+    context->pairs = RedisModule_LoadUnsigned(io);
+    context->samples = RedisModule_LoadUnsigned(io);
+    context->minTimestamp = RedisModule_LoadUnsigned(io);
+    context->maxTimestamp = RedisModule_LoadUnsigned(io);
+    context->prevTimestamp = RedisModule_LoadUnsigned(io);
+    context->prevValue = RedisModule_LoadDouble(io);
+    context->hasPrev = RedisModule_LoadUnsigned(io);
+    context->carriedTimestamp = RedisModule_LoadUnsigned(io);
+    context->carriedValue = RedisModule_LoadDouble(io);
+    context->hasCarried = RedisModule_LoadUnsigned(io);
+    context->lastTimestamp = RedisModule_LoadUnsigned(io);
+    context->lastValue = RedisModule_LoadDouble(io);
+    context->beforeLastTimestamp = RedisModule_LoadUnsigned(io);
+    context->beforeLastValue = RedisModule_LoadDouble(io);
+    context->bucketEnd = RedisModule_LoadUnsigned(io);
+}
+
+static double interpolate(timestamp_t t1, double v1, timestamp_t t2, double v2, double t) {
+    return v1 + (v2 - v1) * (t - (double)t1) / ((double)t2 - (double)t1);
+}
+
+void TwaReset(void *contextPtr) {
+    TwaContext *context = (TwaContext *)contextPtr;
+    if (context->count > 0) {
+        context->hasCarried = TRUE;
+        context->carriedTimestamp = context->prevTimestamp;
+        context->carriedValue = context->prevValue;
+    }
+    context->bucketStart = 0;
+    context->bucketEnd = UINT64_MAX;
+    context->area = 0;
+    context->count = 0;
+    context->hasBefore = FALSE;
+    context->hasAfter = FALSE;
+}
+
+void *TwaCreateContext() {
+    TwaContext *context = (TwaContext *)calloc(1, sizeof(TwaContext));
+    TwaReset(context);
+    return context;
+}
+
+static void twaAddNeighbour(TwaContext *context, double value, timestamp_t timestamp) {
+    if (timestamp < context->bucketStart) {
+        if (!context->hasBefore || timestamp > context->beforeTimestamp) {
+            context->beforeTimestamp = timestamp;
+            context->beforeValue = value;
+            context->hasBefore = TRUE;
+        }
+    } else if (!context->hasAfter || timestamp < context->afterTimestamp) {
+        context->afterTimestamp = timestamp;
+        context->afterValue = value;
+        context->hasAfter = TRUE;
+    }
+}
+
+void TwaSetBucket(void *contextPtr, timestamp_t start, timestamp_t end) {
+    TwaContext *context = (TwaContext *)contextPtr;
+    context->bucketStart = start;
+    context->bucketEnd = end;
+    if (context->hasBefore && context->beforeTimestamp >= start) {
+        context->hasBefore = FALSE;
+    }
+    if (context->hasAfter && context->afterTimestamp < end) {
+        context->hasAfter = FALSE;
+    }
+    if (context->hasCarried &&
+        (context->carriedTimestamp < start || context->carriedTimestamp >= end)) {
+        twaAddNeighbour(context, context->carriedValue, context->carriedTimestamp);
+    }
+}
+
+void TwaAppendValue(void *contextPtr, double value, timestamp_t timestamp) {
+    TwaContext *context = (TwaContext *)contextPtr;
+    if (timestamp < context->bucketStart || timestamp >= context->bucketEnd) {
+        twaAddNeighbour(context, value, timestamp);
+        return;
+    }
+    if (context->count == 0) {
+        context->firstTimestamp = context->lastTimestamp = timestamp;
+        context->firstValue = context->lastValue = value;
+    } else {
+        // a trapezoid between consecutive samples, whichever way they come
+        timestamp_t width = timestamp > context->prevTimestamp ? timestamp - context->prevTimestamp
+                                                               : context->prevTimestamp - timestamp;
+        context->area += width * (value + context->prevValue) / 2;
+        if (timestamp < context->firstTimestamp) {
+            context->firstTimestamp = timestamp;
+            context->firstValue = value;
+        } else if (timestamp > context->lastTimestamp) {
+            context->lastTimestamp = timestamp;
+            context->lastValue = value;
+        }
+    }
+    context->prevTimestamp = timestamp;
+    context->prevValue = value;
+    context->count++;
+}
+
+/*
+ * The average of the samples linearly interpolated over the bucket. The neighbours give the values
+ * at the bucket bounds, without them the average only spans the samples of the bucket.
+ */
+int TwaFinalize(void *contextPtr, double *value) {
+    TwaContext *context = (TwaContext *)contextPtr;
+    if (context->count == 0) {
+        if (!context->hasBefore || !context->hasAfter) {
+            return TSDB_ERROR;
+        }
+        // a straight line averages to its value in the middle
+        double middle = context->bucketStart + (context->bucketEnd - context->bucketStart) / 2.0;
+        *value = interpolate(context->beforeTimestamp,
+                             context->beforeValue,
+                             context->afterTimestamp,
+                             context->afterValue,
+                             middle);
+        return TSDB_OK;
+    }
+    double area = context->area;
+    timestamp_t from = context->firstTimestamp;
+    timestamp_t to = context->lastTimestamp;
+    if (context->hasBefore && context->firstTimestamp > context->bucketStart) {
+        double startValue = interpolate(context->beforeTimestamp,
+                                        context->beforeValue,
+                                        context->firstTimestamp,
+                                        context->firstValue,
+                                        context->bucketStart);
+        area += (context->firstTimestamp - context->bucketStart) *
+                (startValue + context->firstValue) / 2;
+        from = context->bucketStart;
+    }
+    if (context->hasAfter) {
+        double endValue = interpolate(context->lastTimestamp,
+                                      context->lastValue,
+                                      context->afterTimestamp,
+                                      context->afterValue,
+                                      context->bucketEnd);
+        area += (context->bucketEnd - context->lastTimestamp) * (context->lastValue + endValue) / 2;
+        to = context->bucketEnd;
+    }
+    *value = to > from ? area / (to - from) : context->firstValue;
+    return TSDB_OK;
+}
+
+void TwaWriteContext(void *contextPtr, RedisModuleIO *io) {
+    TwaContext *context = (TwaContext *)contextPtr;
+    RedisModule_SaveUnsigned(io, context->bucketStart);
+    RedisModule_SaveUnsigned(io, context->bucketEnd);
+    RedisModule_SaveDouble(io, context->area);
+    RedisModule_SaveUnsigned(io, context->count);
+    RedisModule_SaveUnsigned(io, context->firstTimestamp);
+    RedisModule_SaveDouble(io, context->firstValue);
+    RedisModule_SaveUnsigned(io, context->lastTimestamp);
+    RedisModule_SaveDouble(io, context->lastValue);
+    RedisModule_SaveUnsigned(io, context->prevTimestamp);
+    RedisModule_SaveDouble(io, context->prevValue);
+    RedisModule_SaveUnsigned(io, context->carriedTimestamp);
+    RedisModule_SaveDouble(io, context->carriedValue);
+    RedisModule_SaveUnsigned(io, context->hasCarried);
+    RedisModule_SaveUnsigned(io, context->beforeTimestamp);
+    RedisModule_SaveDouble(io, context->beforeValue);
+    RedisModule_SaveUnsigned(io, context->hasBefore);
+    RedisModule_SaveUnsigned(io, context->afterTimestamp);
+    RedisModule_SaveDouble(io, context->afterValue);
+    RedisModule_SaveUnsigned(io, context->hasAfter);
+}
+
+void TwaReadContext(void *contextPtr, RedisModuleIO *io) {
+    TwaContext *context = (TwaContext *)contextPtr;
+    context->bucketStart = RedisModule_LoadUnsigned(io);
+    context->bucketEnd = RedisModule_LoadUnsigned(io);
+    context->area = RedisModule_LoadDouble(io);
+    context->count = RedisModule_LoadUnsigned(io);
+    context->firstTimestamp = RedisModule_LoadUnsigned(io);
+    context->firstValue = RedisModule_LoadDouble(io);
+    context->lastTimestamp = RedisModule_LoadUnsigned(io);
+    context->lastValue = RedisModule_LoadDouble(io);
+    context->prevTimestamp = RedisModule_LoadUnsigned(io);
+    context->prevValue = RedisModule_LoadDouble(io);
+    context->carriedTimestamp = RedisModule_LoadUnsigned(io);
+    context->carriedValue = RedisModule_LoadDouble(io);
+    context->hasCarried = RedisModule_LoadUnsigned(io);
+    context->beforeTimestamp = RedisModule_LoadUnsigned(io);
+    context->beforeValue = RedisModule_LoadDouble(io);
+    context->hasBefore = RedisModule_LoadUnsigned(io);
+    context->afterTimestamp = RedisModule_LoadUnsigned(io);
+    context->afterValue = RedisModule_LoadDouble(io);
+    context->hasAfter = RedisModule_LoadUnsigned(io);
+}
+
 void rm_free(void *ptr) {
     free(ptr);
 }
@@ -206,7 +602,9 @@ static AggregationClass aggAvg = { .createContext = AvgCreateContext,
                                    .finalize = AvgFinalize,
                                    .writeContext = AvgWriteContext,
                                    .readContext = AvgReadContext,
-                                   .resetContext = AvgReset };
+                                   .resetContext = AvgReset,
+                                   .contextSize = sizeof(AvgContext),
+                                   .mergeContext = AvgMergeContext };
 
 static AggregationClass aggStdP = { .createContext = StdCreateContext,
                                     .appendValue = StdAddValue,
@@ -214,7 +612,9 @@ static AggregationClass aggStdP = { .createContext = StdCreateContext,
                                     .finalize = StdPopulationFinalize,
                                     .writeContext = StdWriteContext,
                                     .readContext = StdReadContext,
-                                    .resetContext = StdReset };
+                                    .resetContext = StdReset,
+                                    .contextSize = sizeof(StdContext),
+                                    .mergeContext = StdMergeContext };
 
 static AggregationClass aggStdS = { .createContext = StdCreateContext,
                                     .appendValue = StdAddValue,
@@ -222,7 +622,9 @@ static AggregationClass aggStdS = { .createContext = StdCreateContext,
                                     .finalize = StdSamplesFinalize,
                                     .writeContext = StdWriteContext,
                                     .readContext = StdReadContext,
-                                    .resetContext = StdReset };
+                                    .resetContext = StdReset,
+                                    .contextSize = sizeof(StdContext),
+                                    .mergeContext = StdMergeContext };
 
 static AggregationClass aggVarP = { .createContext = StdCreateContext,
                                     .appendValue = StdAddValue,
@@ -230,7 +632,9 @@ static AggregationClass aggVarP = { .createContext = StdCreateContext,
                                     .finalize = VarPopulationFinalize,
                                     .writeContext = StdWriteContext,
                                     .readContext = StdReadContext,
-                                    .resetContext = StdReset };
+                                    .resetContext = StdReset,
+                                    .contextSize = sizeof(StdContext),
+                                    .mergeContext = StdMergeContext };
 
 static AggregationClass aggVarS = { .createContext = StdCreateContext,
                                     .appendValue = StdAddValue,
@@ -238,7 +642,9 @@ static AggregationClass aggVarS = { .createContext = StdCreateContext,
                                     .finalize = VarSamplesFinalize,
                                     .writeContext = StdWriteContext,
                                     .readContext = StdReadContext,
-                                    .resetContext = StdReset };
+                                    .resetContext = StdReset,
+                                    .contextSize = sizeof(StdContext),
+                                    .mergeContext = StdMergeContext };
 
 void *MaxMinCreateContext() {
     MaxMinContext *context = (MaxMinContext *)malloc(sizeof(MaxMinContext));
@@ -248,7 +654,7 @@ void *MaxMinCreateContext() {
     return context;
 }
 
-void MaxMinAppendValue(void *contextPtr, double value) {
+void MaxMinAppendValue(void *contextPtr, double value, timestamp_t timestamp) {
     MaxMinContext *context = (MaxMinContext *)contextPtr;
     if (context->isResetted) {
         context->isResetted = FALSE;
@@ -264,6 +670,16 @@ void MaxMinAppendValue(void *contextPtr, double value) {
     }
 }
 
+void MaxMinMergeContext(void *contextPtr, const void *srcPtr) {
+    MaxMinContext *context = (MaxMinContext *)contextPtr;
+    const MaxMinContext *src = (const MaxMinContext *)srcPtr;
+    if (src->isResetted) {
+        return;
+    }
+    MaxMinAppendValue(context, src->maxValue, 0);
+    MaxMinAppendValue(context, src->minValue, 0);
+}
+
 int MaxFinalize(void *contextPtr, double *value) {
     MaxMinContext *context = (MaxMinContext *)contextPtr;
     if (context->isResetted == TRUE) {
@@ -315,13 +731,13 @@ void MaxMinReadContext(void *contextPtr, RedisModuleIO *io) {
     free(sb);
 }
 
-void SumAppendValue(void *contextPtr, double value) {
+void SumAppendValue(void *contextPtr, double value, timestamp_t timestamp) {
     SingleValueContext *context = (SingleValueContext *)contextPtr;
     context->value += value;
     context->isResetted = FALSE;
 }
 
-void CountAppendValue(void *contextPtr, double value) {
+void CountAppendValue(void *contextPtr, double value, timestamp_t timestamp) {
     SingleValueContext *context = (SingleValueContext *)contextPtr;
     context->value++;
     context->isResetted = FALSE;
@@ -333,7 +749,7 @@ int CountFinalize(void *contextPtr, double *val) {
     return TSDB_OK;
 }
 
-void FirstAppendValue(void *contextPtr, double value) {
+void FirstAppendValue(void *contextPtr, double value, timestamp_t timestamp) {
     SingleValueContext *context = (SingleValueContext *)contextPtr;
     if (context->isResetted) {
         context->isResetted = FALSE;
@@ -341,19 +757,44 @@ void FirstAppendValue(void *contextPtr, double value) {
     }
 }
 
-void LastAppendValue(void *contextPtr, double value) {
+void LastAppendValue(void *contextPtr, double value, timestamp_t timestamp) {
     SingleValueContext *context = (SingleValueContext *)contextPtr;
     context->value = value;
     context->isResetted = FALSE;
 }
 
+void SumMergeContext(void *contextPtr, const void *srcPtr) {
+    SingleValueContext *context = (SingleValueContext *)contextPtr;
+    const SingleValueContext *src = (const SingleValueContext *)srcPtr;
+    if (!src->isResetted) {
+        context->value += src->value;
+        context->isResetted = FALSE;
+    }
+}
+
+void FirstMergeContext(void *contextPtr, const void *srcPtr) {
+    SingleValueContext *context = (SingleValueContext *)contextPtr;
+    if (context->isResetted) {
+        *context = *(const SingleValueContext *)srcPtr;
+    }
+}
+
+void LastMergeContext(void *contextPtr, const void *srcPtr) {
+    const SingleValueContext *src = (const SingleValueContext *)srcPtr;
+    if (!src->isResetted) {
+        *(SingleValueContext *)contextPtr = *src;
+    }
+}
+
 static AggregationClass aggMax = { .createContext = MaxMinCreateContext,
                                    .appendValue = MaxMinAppendValue,
                                    .freeContext = rm_free,
                                    .finalize = MaxFinalize,
                                    .writeContext = MaxMinWriteContext,
                                    .readContext = MaxMinReadContext,
-                                   .resetContext = MaxMinReset };
+                                   .resetContext = MaxMinReset,
+                                   .contextSize = sizeof(MaxMinContext),
+                                   .mergeContext = MaxMinMergeContext };
 
 static AggregationClass aggMin = { .createContext = MaxMinCreateContext,
                                    .appendValue = MaxMinAppendValue,
@@ -361,7 +802,9 @@ static AggregationClass aggMin = { .createContext = MaxMinCreateContext,
                                    .finalize = MinFinalize,
                                    .writeContext = MaxMinWriteContext,
                                    .readContext = MaxMinReadContext,
-                                   .resetContext = MaxMinReset };
+                                   .resetContext = MaxMinReset,
+                                   .contextSize = sizeof(MaxMinContext),
+                                   .mergeContext = MaxMinMergeContext };
 
 static AggregationClass aggSum = { .createContext = SingleValueCreateContext,
                                    .appendValue = SumAppendValue,
@@ -369,7 +812,9 @@ static AggregationClass aggSum = { .createContext = SingleValueCreateContext,
                                    .finalize = SingleValueFinalize,
                                    .writeContext = SingleValueWriteContext,
                                    .readContext = SingleValueReadContext,
-                                   .resetContext = SingleValueReset };
+                                   .resetContext = SingleValueReset,
+                                   .contextSize = sizeof(SingleValueContext),
+                                   .mergeContext = SumMergeContext };
 
 static AggregationClass aggCount = { .createContext = SingleValueCreateContext,
                                      .appendValue = CountAppendValue,
@@ -377,7 +822,9 @@ static AggregationClass aggCount = { .createContext = SingleValueCreateContext,
                                      .finalize = CountFinalize,
                                      .writeContext = SingleValueWriteContext,
                                      .readContext = SingleValueReadContext,
-                                     .resetContext = SingleValueReset };
+                                     .resetContext = SingleValueReset,
+                                     .contextSize = sizeof(SingleValueContext),
+                                     .mergeContext = SumMergeContext };
 
 static AggregationClass aggFirst = { .createContext = SingleValueCreateContext,
                                      .appendValue = FirstAppendValue,
@@ -385,7 +832,9 @@ static AggregationClass aggFirst = { .createContext = SingleValueCreateContext,
                                      .finalize = SingleValueFinalize,
                                      .writeContext = SingleValueWriteContext,
                                      .readContext = SingleValueReadContext,
-                                     .resetContext = SingleValueReset };
+                                     .resetContext = SingleValueReset,
+                                     .contextSize = sizeof(SingleValueContext),
+                                     .mergeContext = FirstMergeContext };
 
 static AggregationClass aggLast = { .createContext = SingleValueCreateContext,
                                     .appendValue = LastAppendValue,
@@ -393,7 +842,9 @@ static AggregationClass aggLast = { .createContext = SingleValueCreateContext,
                                     .finalize = SingleValueFinalize,
                                     .writeContext = SingleValueWriteContext,
                                     .readContext = SingleValueReadContext,
-                                    .resetContext = SingleValueReset };
+                                    .resetContext = SingleValueReset,
+                                    .contextSize = sizeof(SingleValueContext),
+                                    .mergeContext = LastMergeContext };
 
 static AggregationClass aggRange = { .createContext = MaxMinCreateContext,
                                      .appendValue = MaxMinAppendValue,
@@ -401,7 +852,146 @@ static AggregationClass aggRange = { .createContext = MaxMinCreateContext,
                                      .finalize = RangeFinalize,
                                      .writeContext = MaxMinWriteContext,
                                      .readContext = MaxMinReadContext,
-                                     .resetContext = MaxMinReset };
+                                     .resetContext = MaxMinReset,
+                                     .contextSize = sizeof(MaxMinContext),
+                                     .mergeContext = MaxMinMergeContext };
+
+// Percentiles share the sketch context and only differ in the quantile they finalize
+void QuantileAppendValue(void *contextPtr, double value, timestamp_t timestamp) {
+    QuantileSketch_Add(contextPtr, value);
+}
+
+void QuantileMergeContext(void *contextPtr, const void *srcPtr) {
+    QuantileSketch_Merge(contextPtr, srcPtr);
+}
+
+int P50Finalize(void *contextPtr, double *value) {
+    return QuantileSketch_Quantile(contextPtr, 0.5, value);
+}
+
+int P75Finalize(void *contextPtr, double *value) {
+    return QuantileSketch_Quantile(contextPtr, 0.75, value);
+}
+
+int P90Finalize(void *contextPtr, double *value) {
+    return QuantileSketch_Quantile(contextPtr, 0.9, value);
+}
+
+int P95Finalize(void *contextPtr, double *value) {
+    return QuantileSketch_Quantile(contextPtr, 0.95, value);
+}
+
+int P99Finalize(void *contextPtr, double *value) {
+    return QuantileSketch_Quantile(contextPtr, 0.99, value);
+}
+
+int P999Finalize(void *contextPtr, double *value) {
+    return QuantileSketch_Quantile(contextPtr, 0.999, value);
+}
+
+static AggregationClass aggP50 = { .createContext = QuantileSketch_Create,
+                                   .appendValue = QuantileAppendValue,
+                                   .freeContext = rm_free,
+                                   .finalize = P50Finalize,
+                                   .writeContext = QuantileSketch_Write,
+                                   .readContext = QuantileSketch_Read,
+                                   .resetContext = QuantileSketch_Reset,
+                                   .contextSize = sizeof(QuantileSketch),
+                                   .mergeContext = QuantileMergeContext };
+
+static AggregationClass aggP75 = { .createContext = QuantileSketch_Create,
+                                   .appendValue = QuantileAppendValue,
+                                   .freeContext = rm_free,
+                                   .finalize = P75Finalize,
+                                   .writeContext = QuantileSketch_Write,
+                                   .readContext = QuantileSketch_Read,
+                                   .resetContext = QuantileSketch_Reset,
+                                   .contextSize = sizeof(QuantileSketch),
+                                   .mergeContext = QuantileMergeContext };
+
+static AggregationClass aggP90 = { .createContext = QuantileSketch_Create,
+                                   .appendValue = QuantileAppendValue,
+                                   .freeContext = rm_free,
+                                   .finalize = P90Finalize,
+                                   .writeContext = QuantileSketch_Write,
+                                   .readContext = QuantileSketch_Read,
+                                   .resetContext = QuantileSketch_Reset,
+                                   .contextSize = sizeof(QuantileSketch),
+                                   .mergeContext = QuantileMergeContext };
+
+static AggregationClass aggP95 = { .createContext = QuantileSketch_Create,
+                                   .appendValue = QuantileAppendValue,
+                                   .freeContext = rm_free,
+                                   .finalize = P95Finalize,
+                                   .writeContext = QuantileSketch_Write,
+                                   .readContext = QuantileSketch_Read,
+                                   .resetContext = QuantileSketch_Reset,
+                                   .contextSize = sizeof(QuantileSketch),
+                                   .mergeContext = QuantileMergeContext };
+
+static AggregationClass aggP99 = { .createContext = QuantileSketch_Create,
+                                   .appendValue = QuantileAppendValue,
+                                   .freeContext = rm_free,
+                                   .finalize = P99Finalize,
+                                   .writeContext = QuantileSketch_Write,
+                                   .readContext = QuantileSketch_Read,
+                                   .resetContext = QuantileSketch_Reset,
+                                   .contextSize = sizeof(QuantileSketch),
+                                   .mergeContext = QuantileMergeContext };
+
+static AggregationClass aggP999 = { .createContext = QuantileSketch_Create,
+                                    .appendValue = QuantileAppendValue,
+                                    .freeContext = rm_free,
+                                    .finalize = P999Finalize,
+                                    .writeContext = QuantileSketch_Write,
+                                    .readContext = QuantileSketch_Read,
+                                    .resetContext = QuantileSketch_Reset,
+                                    .contextSize = sizeof(QuantileSketch),
+                                    .mergeContext = QuantileMergeContext };
+
+static AggregationClass aggRate = { .createContext = CounterCreateContext,
+                                    .appendValue = CounterAppendValue,
+                                    .freeContext = rm_free,
+                                    .finalize = RateFinalize,
+                                    .writeContext = CounterWriteContext,
+                                    .readContext = CounterReadContext,
+                                    .resetContext = CounterReset,
+                                    .contextSize = sizeof(CounterContext),
+                                    .carriesSample = true,
+                                    .setBucket = CounterSetBucket };
+
+static AggregationClass aggIncrease = { .createContext = CounterCreateContext,
+                                        .appendValue = CounterAppendValue,
+                                        .freeContext = rm_free,
+                                        .finalize = IncreaseFinalize,
+                                        .writeContext = CounterWriteContext,
+                                        .readContext = CounterReadContext,
+                                        .resetContext = CounterReset,
+                                        .contextSize = sizeof(CounterContext),
+                                        .carriesSample = true,
+                                        .setBucket = CounterSetBucket };
+
+static AggregationClass aggIRate = { .createContext = CounterCreateContext,
+                                     .appendValue = CounterAppendValue,
+                                     .freeContext = rm_free,
+                                     .finalize = IRateFinalize,
+                                     .writeContext = CounterWriteContext,
+                                     .readContext = CounterReadContext,
+                                     .resetContext = CounterReset,
+                                     .contextSize = sizeof(CounterContext),
+                                     .carriesSample = true,
+                                     .setBucket = CounterSetBucket };
+
+static AggregationClass aggTwa = { .createContext = TwaCreateContext,
+                                   .appendValue = TwaAppendValue,
+                                   .freeContext = rm_free,
+                                   .finalize = TwaFinalize,
+                                   .writeContext = TwaWriteContext,
+                                   .readContext = TwaReadContext,
+                                   .resetContext = TwaReset,
+                                   .contextSize = sizeof(TwaContext),
+                                   .carriesSample = true,
+                                   .setBucket = TwaSetBucket };
 
 int StringAggTypeToEnum(const char *agg_type) {
     return StringLenAggTypeToEnum(agg_type, strlen(agg_type));
@@ -428,10 +1018,26 @@ int StringLenAggTypeToEnum(const char *agg_type, size_t len) {
             result = TS_AGG_SUM;
         } else if (strncmp(agg_type_lower, "avg", len) == 0) {
             result = TS_AGG_AVG;
+        } else if (strncmp(agg_type_lower, "p50", len) == 0) {
+            result = TS_AGG_P50;
+        } else if (strncmp(agg_type_lower, "p75", len) == 0) {
+            result = TS_AGG_P75;
+        } else if (strncmp(agg_type_lower, "p90", len) == 0) {
+            result = TS_AGG_P90;
+        } else if (strncmp(agg_type_lower, "p95", len) == 0) {
+            result = TS_AGG_P95;
+        } else if (strncmp(agg_type_lower, "p99", len) == 0) {
+            result = TS_AGG_P99;
+        } else if (strncmp(agg_type_lower, "twa", len) == 0) {
+            result = TS_AGG_TWA;
         }
     } else if (len == 4) {
         if (strncmp(agg_type_lower, "last", len) == 0) {
             result = TS_AGG_LAST;
+        } else if (strncmp(agg_type_lower, "p999", len) == 0) {
+            result = TS_AGG_P999;
+        } else if (strncmp(agg_type_lower, "rate", len) == 0) {
+            result = TS_AGG_RATE;
         }
     } else if (len == 5) {
         if (strncmp(agg_type_lower, "count", len) == 0) {
@@ -448,6 +1054,12 @@ int StringLenAggTypeToEnum(const char *agg_type, size_t len) {
             result = TS_AGG_VAR_P;
         } else if (strncmp(agg_type_lower, "var.s", len) == 0) {
             result = TS_AGG_VAR_S;
+        } else if (strncmp(agg_type_lower, "irate", len) == 0) {
+            result = TS_AGG_IRATE;
+        }
+    } else if (len == 8) {
+        if (strncmp(agg_type_lower, "increase", len) == 0) {
+            result = TS_AGG_INCREASE;
         }
     }
     return result;
@@ -479,6 +1091,26 @@ const char *AggTypeEnumToString(TS_AGG_TYPES_T aggType) {
             return "LAST";
         case TS_AGG_RANGE:
             return "RANGE";
+        case TS_AGG_P50:
+            return "P50";
+        case TS_AGG_P75:
+            return "P75";
+        case TS_AGG_P90:
+            return "P90";
+        case TS_AGG_P95:
+            return "P95";
+        case TS_AGG_P99:
+            return "P99";
+        case TS_AGG_P999:
+            return "P999";
+        case TS_AGG_RATE:
+            return "RATE";
+        case TS_AGG_INCREASE:
+            return "INCREASE";
+        case TS_AGG_IRATE:
+            return "IRATE";
+        case TS_AGG_TWA:
+            return "TWA";
         case TS_AGG_NONE:
         case TS_AGG_INVALID:
         case TS_AGG_TYPES_MAX:
@@ -513,6 +1145,26 @@ AggregationClass *GetAggClass(TS_AGG_TYPES_T aggType) {
             return &aggLast;
         case TS_AGG_RANGE:
             return &aggRange;
+        case TS_AGG_P50:
+            return &aggP50;
+        case TS_AGG_P75:
+            return &aggP75;
+        case TS_AGG_P90:
+            return &aggP90;
+        case TS_AGG_P95:
+            return &aggP95;
+        case TS_AGG_P99:
+            return &aggP99;
+        case TS_AGG_P999:
+            return &aggP999;
+        case TS_AGG_RATE:
+            return &aggRate;
+        case TS_AGG_INCREASE:
+            return &aggIncrease;
+        case TS_AGG_IRATE:
+            return &aggIRate;
+        case TS_AGG_TWA:
+            return &aggTwa;
         case TS_AGG_NONE:
         case TS_AGG_INVALID:
         case TS_AGG_TYPES_MAX:
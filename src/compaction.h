@@ -15,13 +15,49 @@ typedef struct AggregationClass
 {
     void *(*createContext)();
     void (*freeContext)(void *context);
-    void (*appendValue)(void *context, double value);
+    // samples come in time order, or in reverse time order for reverse queries
+    void (*appendValue)(void *context, double value, timestamp_t timestamp);
+    // starts the next bucket, see carriesSample
     void (*resetContext)(void *context);
     void (*writeContext)(void *context, RedisModuleIO *io);
     void (*readContext)(void *context, RedisModuleIO *io);
     int (*finalize)(void *context, double *value);
+    size_t contextSize;
+    /*
+     * Aggregations carrying a sample also see the samples next to their bucket: resetContext keeps
+     * the last sample of the bucket for the next one, and the sample after the bucket, in query
+     * order, is appended before it is finalized. setBucket, when set, gives the bounds of the
+     * bucket [start, end) before its samples are appended, samples outside them are neighbours.
+     */
+    bool carriesSample;
+    void (*setBucket)(void *context, timestamp_t start, timestamp_t end);
+    // folds `src` into `context` as if its samples were appended after those of `context`, NULL
+    // when the partial contexts of a bucket cannot be combined
+    void (*mergeContext)(void *context, const void *src);
 } AggregationClass;
 
+// How the buckets without samples are reported, see AggregationArgs
+typedef enum
+{
+    TS_FILL_NONE,     // the value of each aggregation, NaN when it has none
+    TS_FILL_PREVIOUS, // the last sample before the bucket
+    TS_FILL_LINEAR,   // interpolated between the samples around the bucket
+    TS_FILL_VALUE,    // a fixed value
+} TS_FILL_T;
+
+// AGGREGATION type[,type...] timeBucket, every aggregation is evaluated over the same buckets
+typedef struct AggregationArgs
+{
+    api_timestamp_t timeDelta;
+    size_t count; // 0 without AGGREGATION
+    TS_AGG_TYPES_T types[TS_AGG_TYPES_MAX];
+    AggregationClass *classes[TS_AGG_TYPES_MAX];
+    // [EMPTY] [FILL PREVIOUS | LINEAR | VALUE value], FILL implies EMPTY
+    bool empty;
+    TS_FILL_T fill;
+    double fillValue;
+} AggregationArgs;
+
 AggregationClass *GetAggClass(TS_AGG_TYPES_T aggType);
 int StringAggTypeToEnum(const char *agg_type);
 int RMStringLenAggTypeToEnum(RedisModuleString *aggTypeStr);
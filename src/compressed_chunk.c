@@ -7,10 +7,12 @@
 #include "compressed_chunk.h"
 
 #include "chunk.h"
+#include "cold_tier.h"
 #include "generic_chunk.h"
 
 #include <assert.h> // assert
 #include <limits.h>
+#include <math.h>
 #include <stdio.h>  // printf
 #include <stdlib.h> // malloc
 #include "rmutil/alloc.h"
@@ -32,7 +34,19 @@ Chunk_t *Compressed_NewChunk(size_t size) {
 
 void Compressed_FreeChunk(Chunk_t *chunk) {
     CompressedChunk *cmpChunk = chunk;
-    free(cmpChunk->data);
+    // a pinned chunk outlives its owner until the last reader releases it
+    uint32_t refs = __atomic_load_n(&cmpChunk->refs, __ATOMIC_ACQUIRE);
+    while (refs > 0) {
+        if (__atomic_compare_exchange_n(
+                &cmpChunk->refs, &refs, refs - 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return;
+        }
+    }
+    if (cmpChunk->cold) {
+        ColdTier_Release(cmpChunk->data, cmpChunk->size);
+    } else {
+        free(cmpChunk->data);
+    }
     cmpChunk->data = NULL;
     free(chunk);
 }
@@ -43,9 +57,20 @@ Chunk_t *Compressed_CloneChunk(Chunk_t *chunk) {
     memcpy(newChunk, oldChunk, sizeof(CompressedChunk));
     newChunk->data = malloc(newChunk->size);
     memcpy(newChunk->data, oldChunk->data, oldChunk->size);
+    newChunk->cold = false;
+    newChunk->refs = 0;
     return newChunk;
 }
 
+Chunk_t *Compressed_RetainChunk(Chunk_t *chunk) {
+    __atomic_add_fetch(&((CompressedChunk *)chunk)->refs, 1, __ATOMIC_RELAXED);
+    return chunk;
+}
+
+bool Compressed_IsChunkShared(Chunk_t *chunk) {
+    return __atomic_load_n(&((CompressedChunk *)chunk)->refs, __ATOMIC_ACQUIRE) > 0;
+}
+
 static void swapChunks(CompressedChunk *a, CompressedChunk *b) {
     CompressedChunk tmp = *a;
     *a = *b;
@@ -65,6 +90,17 @@ static void ensureAddSample(CompressedChunk *chunk, Sample *sample) {
     }
 }
 
+void Compressed_ResizeChunk(Chunk_t *chunk, size_t size) {
+    CompressedChunk *cmpChunk = chunk;
+    // gorilla.c writes whole u_int64_t words
+    size += (sizeof(binary_t) - size % sizeof(binary_t)) % sizeof(binary_t);
+    cmpChunk->data = realloc(cmpChunk->data, size);
+    if (size > cmpChunk->size) {
+        memset((char *)cmpChunk->data + cmpChunk->size, 0, size - cmpChunk->size);
+    }
+    cmpChunk->size = size;
+}
+
 static void trimChunk(CompressedChunk *chunk) {
     int excess = (chunk->size * BIT - chunk->idx) / BIT;
 
@@ -161,6 +197,29 @@ ChunkResult Compressed_UpsertSample(UpsertCtx *uCtx, int *size, DuplicatePolicy
     return rv;
 }
 
+size_t Compressed_DelRange(Chunk_t *chunk, timestamp_t startTs, timestamp_t endTs) {
+    CompressedChunk *oldChunk = (CompressedChunk *)chunk;
+    CompressedChunk *newChunk = Compressed_NewChunk(oldChunk->size);
+    Compressed_Iterator *iter = Compressed_NewChunkIterator(oldChunk, CHUNK_ITER_OP_NONE, NULL);
+
+    size_t deleted = 0;
+    Sample iterSample;
+    while (Compressed_ChunkIteratorGetNext(iter, &iterSample) == CR_OK) {
+        if (iterSample.timestamp >= startTs && iterSample.timestamp <= endTs) {
+            deleted++;
+            continue;
+        }
+        ensureAddSample(newChunk, &iterSample);
+    }
+
+    // the old buffer is freed (or released from the cold tier) with newChunk
+    swapChunks(newChunk, oldChunk);
+
+    Compressed_FreeChunkIterator(iter);
+    Compressed_FreeChunk(newChunk);
+    return deleted;
+}
+
 ChunkResult Compressed_AddSample(Chunk_t *chunk, Sample *sample) {
     return Compressed_Append((CompressedChunk *)chunk, sample->timestamp, sample->value);
 }
@@ -173,17 +232,35 @@ timestamp_t Compressed_GetFirstTimestamp(Chunk_t *chunk) {
     return ((CompressedChunk *)chunk)->baseTimestamp;
 }
 
+bool Compressed_GetValueRange(Chunk_t *chunk, double *min, double *max) {
+    CompressedChunk *cmpChunk = chunk;
+    if (cmpChunk->count == 0) {
+        return false;
+    }
+    *min = cmpChunk->minValue;
+    *max = cmpChunk->maxValue;
+    return true;
+}
+
 timestamp_t Compressed_GetLastTimestamp(Chunk_t *chunk) {
     return ((CompressedChunk *)chunk)->prevTimestamp;
 }
 
+// Sizes are of memory held in RAM, a cold chunk only accounts for its struct
 size_t Compressed_GetChunkSize(Chunk_t *chunk, bool includeStruct) {
     CompressedChunk *cmpChunk = chunk;
-    size_t size = cmpChunk->size * sizeof(char);
+    size_t size = cmpChunk->cold ? 0 : cmpChunk->size * sizeof(char);
     size += includeStruct ? sizeof(*cmpChunk) : 0;
     return size;
 }
 
+size_t Compressed_GetChunkDataSize(Chunk_t *chunk) {
+    if (((CompressedChunk *)chunk)->cold) {
+        return 0;
+    }
+    return (((CompressedChunk *)chunk)->idx + BIT - 1) / BIT;
+}
+
 static Chunk *decompressChunk(CompressedChunk *compressedChunk) {
     Sample sample;
     uint64_t numSamples = compressedChunk->count;
@@ -207,10 +284,27 @@ u_int64_t getIterIdx(ChunkIter_t *iter) {
 }
 // LCOV_EXCL_STOP
 
+static void initForwardIterator(CompressedChunk *compressedChunk, Compressed_Iterator *iter) {
+    iter->chunk = compressedChunk;
+    iter->idx = 0;
+    iter->count = 0;
+
+    iter->prevTS = compressedChunk->baseTimestamp;
+    iter->prevDelta = 0;
+
+    iter->prevValue.d = compressedChunk->baseValue.d;
+    iter->leading = 32;
+    iter->trailing = 32;
+    iter->blocksize = 0;
+}
+
 ChunkIter_t *Compressed_NewChunkIterator(Chunk_t *chunk,
                                          int options,
                                          ChunkIterFuncs *retChunkIterClass) {
     CompressedChunk *compressedChunk = chunk;
+    if (compressedChunk->cold) {
+        ColdTier_WillNeed(compressedChunk->data, compressedChunk->size);
+    }
 
     // for reverse iterator of compressed chunks
     if (options & CHUNK_ITER_OP_REVERSE) {
@@ -222,24 +316,51 @@ ChunkIter_t *Compressed_NewChunkIterator(Chunk_t *chunk,
 
     if (retChunkIterClass != NULL) {
         *retChunkIterClass = *GetChunkIteratorClass(CHUNK_COMPRESSED);
-        ;
     }
 
-    Compressed_Iterator *iter = (Compressed_Iterator *)calloc(1, sizeof(Compressed_Iterator));
+    Compressed_Iterator *iter = (Compressed_Iterator *)malloc(sizeof(Compressed_Iterator));
+    initForwardIterator(compressedChunk, iter);
+    return (ChunkIter_t *)iter;
+}
 
-    iter->chunk = compressedChunk;
-    iter->idx = 0;
-    iter->count = 0;
+void Compressed_InitChunkIterator(Chunk_t *chunk,
+                                  int options,
+                                  ChunkIterFuncs *retChunkIterClass,
+                                  ChunkIter_t *iter,
+                                  ChunkIterScratch *scratch) {
+    CompressedChunk *compressedChunk = chunk;
+    if (compressedChunk->cold) {
+        ColdTier_WillNeed(compressedChunk->data, compressedChunk->size);
+    }
 
-    iter->prevTS = compressedChunk->baseTimestamp;
-    iter->prevDelta = 0;
+    if (!(options & CHUNK_ITER_OP_REVERSE)) {
+        if (retChunkIterClass != NULL) {
+            *retChunkIterClass = *GetChunkIteratorClass(CHUNK_COMPRESSED);
+        }
+        initForwardIterator(compressedChunk, iter);
+        return;
+    }
 
-    iter->prevValue.d = compressedChunk->baseValue.d;
-    iter->leading = 32;
-    iter->trailing = 32;
-    iter->blocksize = 0;
+    // gorilla can only be decoded forward, decode into the scratch buffer and walk it backwards
+    if (scratch->capacity < compressedChunk->count) {
+        scratch->capacity = compressedChunk->count;
+        scratch->samples = realloc(scratch->samples, scratch->capacity * sizeof(Sample));
+    }
+    Compressed_Iterator forward;
+    initForwardIterator(compressedChunk, &forward);
+    for (u_int64_t i = 0; i < compressedChunk->count; i++) {
+        Compressed_ChunkIteratorGetNext(&forward, &scratch->samples[i]);
+    }
 
-    return (ChunkIter_t *)iter;
+    Compressed_ReverseIterator *reverse = iter;
+    reverse->decoded = (Chunk){
+        .base_timestamp = compressedChunk->baseTimestamp,
+        .samples = scratch->samples,
+        .num_samples = compressedChunk->count,
+        .size = compressedChunk->count * sizeof(Sample),
+    };
+    Uncompressed_InitChunkIterator(
+        &reverse->decoded, CHUNK_ITER_OP_REVERSE, retChunkIterClass, &reverse->samples, NULL);
 }
 
 ChunkResult Compressed_ChunkIteratorGetNext(ChunkIter_t *iter, Sample *sample) {
@@ -291,8 +412,20 @@ static void Compressed_Deserialize(Chunk_t **chunk,
     compchunk->prevLeading = readUnsigned(ctx);
     compchunk->prevTrailing = readUnsigned(ctx);
 
+    compchunk->cold = false;
+    compchunk->refs = 0;
+
     size_t len;
     compchunk->data = (uint64_t *)readStringBuffer(ctx, &len);
+    // the value bounds are not serialized, they are recomputed from the samples
+    Compressed_Iterator iter;
+    Sample sample;
+    initForwardIterator(compchunk, &iter);
+    for (u_int64_t i = 0; i < compchunk->count; i++) {
+        Compressed_ReadNext(&iter, &sample.timestamp, &sample.value);
+        compchunk->minValue = i == 0 ? sample.value : fmin(compchunk->minValue, sample.value);
+        compchunk->maxValue = i == 0 ? sample.value : fmax(compchunk->maxValue, sample.value);
+    }
     *chunk = (Chunk_t *)compchunk;
 }
 
@@ -334,3 +467,11 @@ void Compressed_GearsDeserialize(Chunk_t **chunk, Gears_BufferReader *br) {
                            (ReadUnsignedFunc)RedisGears_BRReadLong,
                            (ReadStringBufferFunc)ownedBufferFromGears);
 }
+
+Chunk_t *Compressed_DefragChunk(RedisModuleDefragCtx *ctx, Chunk_t *chunk) {
+    CompressedChunk *compchunk = DefragPtr(ctx, chunk);
+    if (!compchunk->cold) {
+        compchunk->data = DefragPtr(ctx, compchunk->data);
+    }
+    return compchunk;
+}
@@ -7,6 +7,7 @@
 #ifndef COMPRESSED_CHUNK_H
 #define COMPRESSED_CHUNK_H
 
+#include "chunk.h"
 #include "generic_chunk.h"
 #include "gorilla.h"
 
@@ -17,23 +18,43 @@
 Chunk_t *Compressed_NewChunk(size_t size);
 void Compressed_FreeChunk(Chunk_t *chunk);
 Chunk_t *Compressed_CloneChunk(Chunk_t *chunk);
+Chunk_t *Compressed_RetainChunk(Chunk_t *chunk);
+bool Compressed_IsChunkShared(Chunk_t *chunk);
 Chunk_t *Compressed_SplitChunk(Chunk_t *chunk);
+void Compressed_ResizeChunk(Chunk_t *chunk, size_t size);
 
 // Append a sample to a compressed chunk
 ChunkResult Compressed_AddSample(Chunk_t *chunk, Sample *sample);
 ChunkResult Compressed_UpsertSample(UpsertCtx *uCtx, int *size, DuplicatePolicy duplicatePolicy);
+// Re-encodes the chunk without the samples in [startTs, endTs]
+size_t Compressed_DelRange(Chunk_t *chunk, timestamp_t startTs, timestamp_t endTs);
 
 // Read from compressed chunk using an iterator
 ChunkIter_t *Compressed_NewChunkIterator(Chunk_t *chunk,
                                          int options,
                                          ChunkIterFuncs *retChunkIterClass);
+// Reverse iterator over a compressed chunk: the samples are decoded into the caller's scratch
+// buffer and walked backwards by an uncompressed iterator over a view of that buffer.
+typedef struct Compressed_ReverseIterator
+{
+    ChunkIterator samples; // must stay first, the uncompressed iterator functions operate on it
+    Chunk decoded;
+} Compressed_ReverseIterator;
+
+void Compressed_InitChunkIterator(Chunk_t *chunk,
+                                  int options,
+                                  ChunkIterFuncs *retChunkIterClass,
+                                  ChunkIter_t *iter,
+                                  ChunkIterScratch *scratch);
 ChunkResult Compressed_ChunkIteratorGetNext(ChunkIter_t *iter, Sample *sample);
 void Compressed_FreeChunkIterator(ChunkIter_t *iter);
 
 // Miscellaneous
 size_t Compressed_GetChunkSize(Chunk_t *chunk, bool includeStruct);
+size_t Compressed_GetChunkDataSize(Chunk_t *chunk);
 u_int64_t Compressed_ChunkNumOfSample(Chunk_t *chunk);
 timestamp_t Compressed_GetFirstTimestamp(Chunk_t *chunk);
+bool Compressed_GetValueRange(Chunk_t *chunk, double *min, double *max);
 timestamp_t Compressed_GetLastTimestamp(Chunk_t *chunk);
 
 // RDB
@@ -44,6 +65,9 @@ void Compressed_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io);
 void Compressed_GearsSerialize(Chunk_t *chunk, Gears_BufferWriter *bw);
 void Compressed_GearsDeserialize(Chunk_t **chunk, Gears_BufferReader *br);
 
+// Defrag
+Chunk_t *Compressed_DefragChunk(struct RedisModuleDefragCtx *ctx, Chunk_t *chunk);
+
 /* Used in tests */
 u_int64_t getIterIdx(ChunkIter_t *iter);
 
@@ -5,12 +5,14 @@
  */
 #include "config.h"
 
+#include "cold_tier.h"
 #include "common.h"
 #include "consts.h"
 #include "redismodule.h"
 
 #include <assert.h>
 #include <string.h>
+#include <strings.h>
 #include "rmutil/strings.h"
 #include "rmutil/util.h"
 
@@ -46,6 +48,23 @@ int ReadConfig(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
         TSGlobalConfig.hasGlobalConfig = TRUE;
     }
 
+    TSGlobalConfig.embeddedCompaction = false;
+    if (argc > 1 && RMUtil_ArgIndex("COMPACTION_STORAGE", argv, argc) >= 0) {
+        RedisModuleString *storage;
+        if (RMUtil_ParseArgsAfter("COMPACTION_STORAGE", argv, argc, "s", &storage) !=
+            REDISMODULE_OK) {
+            return TSDB_ERROR;
+        }
+        const char *storage_cstr = RedisModule_StringPtrLen(storage, NULL);
+        if (strcasecmp(storage_cstr, "embedded") == 0) {
+            TSGlobalConfig.embeddedCompaction = true;
+        } else if (strcasecmp(storage_cstr, "keys") != 0) {
+            RedisModule_Log(ctx, "error", "unknown compaction storage: %s \n", storage_cstr);
+            return TSDB_ERROR;
+        }
+        RedisModule_Log(ctx, "verbose", "loaded compaction storage: %s \n", storage_cstr);
+    }
+
     if (argc > 1 && RMUtil_ArgIndex("RETENTION_POLICY", argv, argc) >= 0) {
         if (RMUtil_ParseArgsAfter(
                 "RETENTION_POLICY", argv, argc, "l", &TSGlobalConfig.retentionPolicy) !=
@@ -108,6 +127,77 @@ int ReadConfig(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
 
         RedisModule_Log(ctx, "verbose", "loaded default chunk type: %s \n", chunk_type_cstr);
     }
+
+    if (argc > 1 && RMUtil_ArgIndex("COLD_TIER_PATH", argv, argc) >= 0) {
+        RedisModuleString *path;
+        long long age = COLD_TIER_AGE_DEFAULT;
+        if (RMUtil_ParseArgsAfter("COLD_TIER_PATH", argv, argc, "s", &path) != REDISMODULE_OK) {
+            return TSDB_ERROR;
+        }
+        if (RMUtil_ArgIndex("COLD_TIER_AGE", argv, argc) >= 0 &&
+            (RMUtil_ParseArgsAfter("COLD_TIER_AGE", argv, argc, "l", &age) != REDISMODULE_OK ||
+             age <= 0)) {
+            RedisModule_Log(ctx, "warning", "Unable to parse argument after COLD_TIER_AGE");
+            return TSDB_ERROR;
+        }
+        const char *path_cstr = RedisModule_StringPtrLen(path, NULL);
+        if (ColdTier_Init(path_cstr, age) != TSDB_OK) {
+            RedisModule_Log(ctx, "warning", "cold tier directory is not writable: %s", path_cstr);
+            return TSDB_ERROR;
+        }
+        RedisModule_Log(
+            ctx, "verbose", "loaded cold tier: %s, chunks older than %lld", path_cstr, age);
+    }
+
+    TSGlobalConfig.chunkMergeInterval = CHUNK_MERGE_INTERVAL_DEFAULT;
+    if (argc > 1 && RMUtil_ArgIndex("CHUNK_MERGE_INTERVAL", argv, argc) >= 0) {
+        if (RMUtil_ParseArgsAfter(
+                "CHUNK_MERGE_INTERVAL", argv, argc, "l", &TSGlobalConfig.chunkMergeInterval) !=
+                REDISMODULE_OK ||
+            TSGlobalConfig.chunkMergeInterval < 0) {
+            RedisModule_Log(ctx, "warning", "Unable to parse argument after CHUNK_MERGE_INTERVAL");
+            return TSDB_ERROR;
+        }
+    }
+    RedisModule_Log(ctx,
+                    "verbose",
+                    "loaded CHUNK_MERGE_INTERVAL: %lld",
+                    TSGlobalConfig.chunkMergeInterval);
+
+    TSGlobalConfig.queryThreads = QUERY_THREADS_DEFAULT;
+    if (argc > 1 && RMUtil_ArgIndex("QUERY_THREADS", argv, argc) >= 0) {
+        if (RMUtil_ParseArgsAfter(
+                "QUERY_THREADS", argv, argc, "l", &TSGlobalConfig.queryThreads) != REDISMODULE_OK ||
+            TSGlobalConfig.queryThreads < 0) {
+            RedisModule_Log(ctx, "warning", "Unable to parse argument after QUERY_THREADS");
+            return TSDB_ERROR;
+        }
+    }
+    RedisModule_Log(ctx, "verbose", "loaded QUERY_THREADS: %lld", TSGlobalConfig.queryThreads);
+
+    TSGlobalConfig.queryFanout = QUERY_FANOUT_DEFAULT;
+    if (argc > 1 && RMUtil_ArgIndex("QUERY_FANOUT", argv, argc) >= 0) {
+        if (RMUtil_ParseArgsAfter(
+                "QUERY_FANOUT", argv, argc, "l", &TSGlobalConfig.queryFanout) != REDISMODULE_OK ||
+            TSGlobalConfig.queryFanout < 0) {
+            RedisModule_Log(ctx, "warning", "Unable to parse argument after QUERY_FANOUT");
+            return TSDB_ERROR;
+        }
+    }
+    RedisModule_Log(ctx, "verbose", "loaded QUERY_FANOUT: %lld", TSGlobalConfig.queryFanout);
+
+    TSGlobalConfig.maxExecSliceMs = MAX_EXEC_SLICE_MS_DEFAULT;
+    if (argc > 1 && RMUtil_ArgIndex("MAX_EXEC_SLICE_MS", argv, argc) >= 0) {
+        if (RMUtil_ParseArgsAfter(
+                "MAX_EXEC_SLICE_MS", argv, argc, "l", &TSGlobalConfig.maxExecSliceMs) !=
+                REDISMODULE_OK ||
+            TSGlobalConfig.maxExecSliceMs < 0) {
+            RedisModule_Log(ctx, "warning", "Unable to parse argument after MAX_EXEC_SLICE_MS");
+            return TSDB_ERROR;
+        }
+    }
+    RedisModule_Log(
+        ctx, "verbose", "loaded MAX_EXEC_SLICE_MS: %lld", TSGlobalConfig.maxExecSliceMs);
     return TSDB_OK;
 }
 
@@ -20,6 +20,11 @@ typedef struct
     short options;
     int hasGlobalConfig;
     DuplicatePolicy duplicatePolicy;
+    long long chunkMergeInterval;
+    long long queryThreads;   // size of the thread pool long ranges are split on
+    long long queryFanout;    // pool threads a single query may run on, 0 for all of them
+    long long maxExecSliceMs; // main thread time a query runs for at once, 0 for no limit
+    bool embeddedCompaction; // COMPACTION_POLICY rules become levels inside the source series
 } TSConfig;
 
 extern TSConfig TSGlobalConfig;
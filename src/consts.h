@@ -26,7 +26,18 @@
 #define RETENTION_TIME_DEFAULT          0LL
 #define Chunk_SIZE_BYTES_SECS           4096LL   // fills one page 4096
 #define SPLIT_FACTOR                    1.2
+#define INITIAL_CHUNK_SIZE_BYTES        128LL    // grown in allocator size classes up to the chunk size
 #define DEFAULT_DUPLICATE_POLICY        DP_BLOCK
+#define COLD_TIER_AGE_DEFAULT           86400000LL // one day
+#define CHUNK_MERGE_INTERVAL_DEFAULT    100LL      // milliseconds between merge slices
+#define CHUNK_MERGE_BUDGET              1024       // chunks visited per merge slice
+#define QUERY_THREADS_DEFAULT           0LL        // queries run on the main thread
+#define QUERY_FANOUT_DEFAULT            0LL        // a query may use every query thread
+#define MAX_EXEC_SLICE_MS_DEFAULT       0LL        // a query runs to its end at once
+#define EXEC_SLICE_CHECK_ROWS           1024       // rows queried between two reads of the clock
+#define EXPR_BATCH_ROWS                 256        // rows an expression is evaluated over at once
+#define EXPR_MAX_NESTING                64         // parentheses and signs an expression nests
+#define PARALLEL_RANGE_TASK_CHUNKS      32         // chunks decoded by a range task at least
 
 /* TS.Range Aggregation types */
 typedef enum {
@@ -44,7 +55,17 @@ typedef enum {
     TS_AGG_STD_S,
     TS_AGG_VAR_P,
     TS_AGG_VAR_S,
-    TS_AGG_TYPES_MAX // 13
+    TS_AGG_P50,
+    TS_AGG_P75,
+    TS_AGG_P90,
+    TS_AGG_P95,
+    TS_AGG_P99,
+    TS_AGG_P999,
+    TS_AGG_RATE,
+    TS_AGG_INCREASE,
+    TS_AGG_IRATE,
+    TS_AGG_TWA,
+    TS_AGG_TYPES_MAX // 23
 } TS_AGG_TYPES_T;
 
 
@@ -0,0 +1,286 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "expr.h"
+
+#include "consts.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <rmutil/alloc.h>
+
+typedef struct ExprParser
+{
+    const char *pos;
+    Expr *expr;
+    size_t capacity;
+    size_t depth;   // of the stack after the instructions emitted so far
+    size_t nesting; // of the parentheses and unary operators being parsed
+    const char *err;
+} ExprParser;
+
+static bool parseSum(ExprParser *ps);
+static bool parseUnary(ExprParser *ps);
+
+static void skipSpaces(ExprParser *ps) {
+    while (isspace((unsigned char)*ps->pos)) {
+        ps->pos++;
+    }
+}
+
+static bool isNameChar(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == ':' || c == '.';
+}
+
+static void emit(ExprParser *ps, ExprInstr instr) {
+    Expr *expr = ps->expr;
+    if (expr->length == ps->capacity) {
+        ps->capacity = ps->capacity > 0 ? ps->capacity * 2 : 16;
+        expr->program = realloc(expr->program, ps->capacity * sizeof(ExprInstr));
+    }
+    expr->program[expr->length++] = instr;
+    if (instr.op == ExprOp_Input || instr.op == ExprOp_Constant) {
+        ps->depth++;
+    } else if (instr.op != ExprOp_Neg) {
+        ps->depth--;
+    }
+    if (ps->depth > expr->stackDepth) {
+        expr->stackDepth = ps->depth;
+    }
+}
+
+static void emitInput(ExprParser *ps, const char *name, size_t len) {
+    Expr *expr = ps->expr;
+    int index = Expr_InputIndex(expr, name, len);
+    if (index < 0) {
+        expr->inputs = realloc(expr->inputs, (expr->inputsCount + 1) * sizeof(char *));
+        expr->inputs[expr->inputsCount] = strndup(name, len);
+        index = expr->inputsCount++;
+    }
+    emit(ps, (ExprInstr){ .op = ExprOp_Input, .input = index });
+}
+
+static bool parsePrimary(ExprParser *ps) {
+    skipSpaces(ps);
+    const char *start = ps->pos;
+    if (*start == '(') {
+        ps->pos++;
+        if (!parseSum(ps)) {
+            return false;
+        }
+        skipSpaces(ps);
+        if (*ps->pos != ')') {
+            ps->err = "TSDB: EXPR is missing a closing parenthesis";
+            return false;
+        }
+        ps->pos++;
+        return true;
+    }
+    if (*start == '`') {
+        const char *end = strchr(start + 1, '`');
+        if (end == NULL || end == start + 1) {
+            ps->err = "TSDB: EXPR has an unterminated quoted name";
+            return false;
+        }
+        emitInput(ps, start + 1, end - start - 1);
+        ps->pos = end + 1;
+        return true;
+    }
+    if (isdigit((unsigned char)*start) || (*start == '.' && isdigit((unsigned char)start[1]))) {
+        char *end;
+        const double constant = strtod(start, &end);
+        ps->pos = end;
+        emit(ps, (ExprInstr){ .op = ExprOp_Constant, .constant = constant });
+        return true;
+    }
+    if (isNameChar(*start)) {
+        while (isNameChar(*ps->pos)) {
+            ps->pos++;
+        }
+        emitInput(ps, start, ps->pos - start);
+        return true;
+    }
+    ps->err = "TSDB: EXPR expects a number, a series or a parenthesis";
+    return false;
+}
+
+// An operand with its signs
+static bool parseSign(ExprParser *ps) {
+    if (*ps->pos == '-') {
+        ps->pos++;
+        if (!parseUnary(ps)) {
+            return false;
+        }
+        emit(ps, (ExprInstr){ .op = ExprOp_Neg });
+        return true;
+    }
+    if (*ps->pos == '+') {
+        ps->pos++;
+        return parseUnary(ps);
+    }
+    return parsePrimary(ps);
+}
+
+static bool parseUnary(ExprParser *ps) {
+    skipSpaces(ps);
+    if (ps->nesting == EXPR_MAX_NESTING) {
+        ps->err = "TSDB: EXPR is nested too deeply";
+        return false;
+    }
+    ps->nesting++;
+    bool ok = parseSign(ps);
+    ps->nesting--;
+    return ok;
+}
+
+static bool parseProduct(ExprParser *ps) {
+    if (!parseUnary(ps)) {
+        return false;
+    }
+    while (true) {
+        skipSpaces(ps);
+        const char op = *ps->pos;
+        if (op != '*' && op != '/') {
+            return true;
+        }
+        ps->pos++;
+        if (!parseUnary(ps)) {
+            return false;
+        }
+        emit(ps, (ExprInstr){ .op = op == '*' ? ExprOp_Mul : ExprOp_Div });
+    }
+}
+
+static bool parseSum(ExprParser *ps) {
+    if (!parseProduct(ps)) {
+        return false;
+    }
+    while (true) {
+        skipSpaces(ps);
+        const char op = *ps->pos;
+        if (op != '+' && op != '-') {
+            return true;
+        }
+        ps->pos++;
+        if (!parseProduct(ps)) {
+            return false;
+        }
+        emit(ps, (ExprInstr){ .op = op == '+' ? ExprOp_Add : ExprOp_Sub });
+    }
+}
+
+Expr *Expr_Compile(const char *text, const char **err) {
+    Expr *expr = calloc(1, sizeof(Expr));
+    ExprParser ps = { .pos = text, .expr = expr, .capacity = 0, .depth = 0, .err = NULL };
+    bool ok = parseSum(&ps);
+    skipSpaces(&ps);
+    if (ok && *ps.pos != '\0') {
+        ps.err = "TSDB: EXPR has unexpected characters";
+        ok = false;
+    }
+    if (ok && expr->inputsCount == 0) {
+        ps.err = "TSDB: EXPR does not refer to any series";
+        ok = false;
+    }
+    if (!ok) {
+        *err = ps.err;
+        Expr_Free(expr);
+        return NULL;
+    }
+    return expr;
+}
+
+void Expr_Free(Expr *expr) {
+    for (size_t i = 0; i < expr->inputsCount; i++) {
+        free(expr->inputs[i]);
+    }
+    free(expr->inputs);
+    free(expr->program);
+    free(expr);
+}
+
+int Expr_InputIndex(const Expr *expr, const char *name, size_t len) {
+    for (size_t i = 0; i < expr->inputsCount; i++) {
+        if (strlen(expr->inputs[i]) == len && memcmp(expr->inputs[i], name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void fillRows(double *restrict dst, double value, size_t rows) {
+    for (size_t i = 0; i < rows; i++) {
+        dst[i] = value;
+    }
+}
+
+static void addRows(double *restrict dst, const double *restrict src, size_t rows) {
+    for (size_t i = 0; i < rows; i++) {
+        dst[i] += src[i];
+    }
+}
+
+static void subRows(double *restrict dst, const double *restrict src, size_t rows) {
+    for (size_t i = 0; i < rows; i++) {
+        dst[i] -= src[i];
+    }
+}
+
+static void mulRows(double *restrict dst, const double *restrict src, size_t rows) {
+    for (size_t i = 0; i < rows; i++) {
+        dst[i] *= src[i];
+    }
+}
+
+static void divRows(double *restrict dst, const double *restrict src, size_t rows) {
+    for (size_t i = 0; i < rows; i++) {
+        dst[i] /= src[i];
+    }
+}
+
+static void negRows(double *restrict dst, size_t rows) {
+    for (size_t i = 0; i < rows; i++) {
+        dst[i] = -dst[i];
+    }
+}
+
+void Expr_Eval(const Expr *expr, const double *const *inputs, size_t rows, double *stack) {
+    // every intermediate result takes `rows` values of the stack, an operation reads the one on
+    // top and leaves its result in the one below
+    size_t depth = 0;
+    for (size_t i = 0; i < expr->length; i++) {
+        const ExprInstr *instr = &expr->program[i];
+        switch (instr->op) {
+            case ExprOp_Input:
+                memcpy(stack + depth * rows, inputs[instr->input], rows * sizeof(double));
+                depth++;
+                break;
+            case ExprOp_Constant:
+                fillRows(stack + depth * rows, instr->constant, rows);
+                depth++;
+                break;
+            case ExprOp_Add:
+                depth--;
+                addRows(stack + (depth - 1) * rows, stack + depth * rows, rows);
+                break;
+            case ExprOp_Sub:
+                depth--;
+                subRows(stack + (depth - 1) * rows, stack + depth * rows, rows);
+                break;
+            case ExprOp_Mul:
+                depth--;
+                mulRows(stack + (depth - 1) * rows, stack + depth * rows, rows);
+                break;
+            case ExprOp_Div:
+                depth--;
+                divRows(stack + (depth - 1) * rows, stack + depth * rows, rows);
+                break;
+            case ExprOp_Neg:
+                negRows(stack + (depth - 1) * rows, rows);
+                break;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Arithmetic expressions over series, e.g. `errors / requests * 100`. An expression is compiled to
+ * a postfix program once and evaluated a batch of rows at a time: every operation runs over whole
+ * arrays of doubles, loops the compiler vectorizes.
+ *
+ * Supported are + - * /, unary minus, parentheses, numbers and names of series. A name is made of
+ * letters, digits and `_ : .` and does not start with a digit, or is quoted in backquotes.
+ */
+
+typedef enum ExprOp
+{
+    ExprOp_Input,
+    ExprOp_Constant,
+    ExprOp_Add,
+    ExprOp_Sub,
+    ExprOp_Mul,
+    ExprOp_Div,
+    ExprOp_Neg,
+} ExprOp;
+
+typedef struct ExprInstr
+{
+    ExprOp op;
+    size_t input; // ExprOp_Input
+    double constant;
+} ExprInstr;
+
+typedef struct Expr
+{
+    ExprInstr *program; // in postfix order
+    size_t length;
+    size_t stackDepth; // intermediate results held at once
+    char **inputs;     // the names of the series, in order of first use
+    size_t inputsCount;
+} Expr;
+
+// How the rows of the series of an expression are matched on their timestamps
+typedef enum ExprJoin
+{
+    ExprJoin_Inner,    // only the timestamps every series has
+    ExprJoin_Previous, // a missing value is the last one of the series before the timestamp
+    ExprJoin_Value,    // a missing value is a constant
+} ExprJoin;
+
+// EXPR expression [JOIN INNER|PREVIOUS|VALUE value] [ALIAS label]
+typedef struct ExprArgs
+{
+    Expr *expr; // NULL without EXPR
+    const char *text;
+    ExprJoin join;
+    double joinValue;
+    const char *aliasLabel; // series are named by the value of this label, NULL for the key name
+} ExprArgs;
+
+// Compiles `text`, returns NULL with `err` set to a static message when it is not valid
+Expr *Expr_Compile(const char *text, const char **err);
+
+void Expr_Free(Expr *expr);
+
+// Index of the series named `name` in `expr->inputs`, -1 when the expression does not use it
+int Expr_InputIndex(const Expr *expr, const char *name, size_t len);
+
+/*
+ * Evaluates `rows` rows, `inputs[i]` holding the values of series i. `stack` has room for
+ * `expr->stackDepth * rows` values, the results are left in its first `rows` values.
+ */
+void Expr_Eval(const Expr *expr, const double *const *inputs, size_t rows, double *stack);
+
+#endif
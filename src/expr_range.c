@@ -0,0 +1,366 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "expr_range.h"
+
+#include "common.h"
+#include "consts.h"
+#include "reply.h"
+#include "series_iterator.h"
+#include "series_registry.h"
+
+#include <string.h>
+#include <rmutil/alloc.h>
+
+// A series named by the expression, positioned on its next row
+typedef struct ExprSource
+{
+    Series *series;
+    api_timestamp_t start; // after the retention of the series
+    SeriesIterator iterator;
+    bool opened;
+    bool hasRow;
+    timestamp_t timestamp;
+    double values[TS_AGG_TYPES_MAX];
+    // the last row taken, a missing value with JOIN PREVIOUS
+    bool hasPrevious;
+    double previous[TS_AGG_TYPES_MAX];
+} ExprSource;
+
+typedef struct ExprJoiner
+{
+    ExprSource *sources; // in the order of the inputs of the expression
+    size_t count;
+    size_t valuesCount; // per row, one per aggregation
+    bool rev;
+    ExprJoin join;
+    double joinValue;
+    // the joined rows, EXPR_BATCH_ROWS values per series and aggregation
+    double *batch;
+    timestamp_t timestamps[EXPR_BATCH_ROWS];
+} ExprJoiner;
+
+static void sourceNext(ExprSource *s) {
+    s->hasRow = SeriesIteratorGetNextValues(&s->iterator, &s->timestamp, s->values) == CR_OK;
+}
+
+static bool rowBefore(const ExprJoiner *j, timestamp_t a, timestamp_t b) {
+    return j->rev ? a > b : a < b;
+}
+
+static double *batchColumn(const ExprJoiner *j, size_t source, size_t value) {
+    return &j->batch[(source * j->valuesCount + value) * EXPR_BATCH_ROWS];
+}
+
+static void storeValues(ExprJoiner *j, size_t source, size_t row, const double *values) {
+    for (size_t v = 0; v < j->valuesCount; v++) {
+        batchColumn(j, source, v)[row] = values[v];
+    }
+}
+
+// JOIN INNER, the next timestamp every series has
+static bool joinInner(ExprJoiner *j, size_t row) {
+    while (true) {
+        timestamp_t target = 0;
+        for (size_t i = 0; i < j->count; i++) {
+            const ExprSource *s = &j->sources[i];
+            if (!s->hasRow) {
+                return false;
+            }
+            if (i == 0 || rowBefore(j, target, s->timestamp)) {
+                target = s->timestamp;
+            }
+        }
+        bool aligned = true;
+        for (size_t i = 0; i < j->count; i++) {
+            ExprSource *s = &j->sources[i];
+            while (s->hasRow && rowBefore(j, s->timestamp, target)) {
+                sourceNext(s);
+            }
+            if (!s->hasRow) {
+                return false;
+            }
+            aligned = aligned && s->timestamp == target;
+        }
+        if (aligned) {
+            for (size_t i = 0; i < j->count; i++) {
+                storeValues(j, i, row, j->sources[i].values);
+                sourceNext(&j->sources[i]);
+            }
+            j->timestamps[row] = target;
+            return true;
+        }
+    }
+}
+
+// JOIN PREVIOUS and JOIN VALUE, the next timestamp any series has
+static bool joinOuter(ExprJoiner *j, size_t row) {
+    while (true) {
+        bool found = false;
+        timestamp_t next = 0;
+        for (size_t i = 0; i < j->count; i++) {
+            const ExprSource *s = &j->sources[i];
+            if (s->hasRow && (!found || rowBefore(j, s->timestamp, next))) {
+                next = s->timestamp;
+                found = true;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+        // a series without any value for the timestamp leaves the row out
+        bool complete = true;
+        for (size_t i = 0; i < j->count; i++) {
+            ExprSource *s = &j->sources[i];
+            if (s->hasRow && s->timestamp == next) {
+                storeValues(j, i, row, s->values);
+                memcpy(s->previous, s->values, j->valuesCount * sizeof(double));
+                s->hasPrevious = true;
+                sourceNext(s);
+            } else if (j->join == ExprJoin_Value) {
+                for (size_t v = 0; v < j->valuesCount; v++) {
+                    batchColumn(j, i, v)[row] = j->joinValue;
+                }
+            } else if (j->rev && s->hasRow) {
+                // in reverse the next row of the series is the last one before the timestamp
+                storeValues(j, i, row, s->values);
+            } else if (!j->rev && s->hasPrevious) {
+                storeValues(j, i, row, s->previous);
+            } else {
+                complete = false;
+            }
+        }
+        if (complete) {
+            j->timestamps[row] = next;
+            return true;
+        }
+    }
+}
+
+static long long replyExprRows(RedisModuleCtx *ctx,
+                               const Expr *expr,
+                               ExprJoiner *j,
+                               long long maxResults) {
+    double *results = malloc(j->valuesCount * EXPR_BATCH_ROWS * sizeof(double));
+    double *stack = malloc(expr->stackDepth * EXPR_BATCH_ROWS * sizeof(double));
+    const double **inputs = malloc(j->count * sizeof(double *));
+    double values[TS_AGG_TYPES_MAX];
+    long long arraylen = 0;
+    bool done = false;
+    while (!done) {
+        size_t rows = 0;
+        for (; rows < EXPR_BATCH_ROWS; rows++) {
+            if ((maxResults != -1 && arraylen + (long long)rows >= maxResults) ||
+                !(j->join == ExprJoin_Inner ? joinInner(j, rows) : joinOuter(j, rows))) {
+                done = true;
+                break;
+            }
+        }
+        if (rows == 0) {
+            break;
+        }
+        for (size_t v = 0; v < j->valuesCount; v++) {
+            for (size_t i = 0; i < j->count; i++) {
+                inputs[i] = batchColumn(j, i, v);
+            }
+            Expr_Eval(expr, inputs, rows, stack);
+            memcpy(&results[v * EXPR_BATCH_ROWS], stack, rows * sizeof(double));
+        }
+        for (size_t row = 0; row < rows; row++) {
+            for (size_t v = 0; v < j->valuesCount; v++) {
+                values[v] = results[v * EXPR_BATCH_ROWS + row];
+            }
+            ReplyWithRow(ctx, j->timestamps[row], values, j->valuesCount);
+        }
+        arraylen += rows;
+    }
+    free(inputs);
+    free(stack);
+    free(results);
+    return arraylen;
+}
+
+// Replies with the rows of the expression evaluated over the sources, one source per input
+static void replyExprRange(RedisModuleCtx *ctx,
+                           const ExprArgs *exprArgs,
+                           ExprSource *sources,
+                           api_timestamp_t end_ts,
+                           const SeriesFilter *filter,
+                           const AggregationArgs *aggregation,
+                           long long maxResults,
+                           bool rev) {
+    const Expr *expr = exprArgs->expr;
+    ExprJoiner j = { .sources = sources,
+                     .count = expr->inputsCount,
+                     .valuesCount = max(aggregation->count, 1),
+                     .rev = rev,
+                     .join = exprArgs->join,
+                     .joinValue = exprArgs->joinValue };
+    j.batch = malloc(j.count * j.valuesCount * EXPR_BATCH_ROWS * sizeof(double));
+    for (size_t i = 0; i < j.count; i++) {
+        ExprSource *s = &sources[i];
+        if (s->start <= end_ts &&
+            SeriesQueryAggregations(
+                s->series, &s->iterator, s->start, end_ts, rev, filter, aggregation) == TSDB_OK) {
+            s->opened = true;
+            sourceNext(s);
+        }
+    }
+
+    RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+    RedisModule_ReplySetArrayLength(ctx, replyExprRows(ctx, expr, &j, maxResults));
+
+    for (size_t i = 0; i < j.count; i++) {
+        if (sources[i].opened) {
+            SeriesIteratorClose(&sources[i].iterator);
+        }
+    }
+    free(j.batch);
+}
+
+static bool nameEquals(RedisModuleString *str, const char *name) {
+    size_t len;
+    const char *ptr = RedisModule_StringPtrLen(str, &len);
+    return len == strlen(name) && memcmp(ptr, name, len) == 0;
+}
+
+int ReplyExprSeriesRange(RedisModuleCtx *ctx,
+                         Series *series,
+                         RedisModuleString *keyName,
+                         api_timestamp_t start_ts,
+                         api_timestamp_t end_ts,
+                         const SeriesFilter *filter,
+                         const AggregationArgs *aggregation,
+                         long long maxResults,
+                         bool rev,
+                         const ExprArgs *exprArgs) {
+    const Expr *expr = exprArgs->expr;
+    ExprSource *sources = calloc(expr->inputsCount, sizeof(ExprSource));
+    for (size_t i = 0; i < expr->inputsCount; i++) {
+        for (size_t field = 0; field < series->fieldsCount; field++) {
+            if (nameEquals(series->fieldNames[field], expr->inputs[i])) {
+                sources[i].series = SeriesGetField(series, field);
+                break;
+            }
+        }
+        if (sources[i].series == NULL && nameEquals(keyName, expr->inputs[i])) {
+            sources[i].series = series;
+        }
+        if (sources[i].series == NULL) {
+            free(sources);
+            RTS_ReplyGeneralError(ctx, "TSDB: EXPR names an unknown field or key");
+            return REDISMODULE_ERR;
+        }
+        // the fields share the retention of the series
+        sources[i].start = start_ts;
+        ApplyRetention(series, &sources[i].start, end_ts);
+    }
+
+    replyExprRange(ctx, exprArgs, sources, end_ts, filter, aggregation, maxResults, rev);
+    free(sources);
+    return REDISMODULE_OK;
+}
+
+static RedisModuleString *seriesAlias(const Series *series, const char *aliasLabel) {
+    if (aliasLabel == NULL) {
+        return series->keyName;
+    }
+    for (size_t i = 0; i < series->labelsCount; i++) {
+        if (nameEquals(series->labels[i].key, aliasLabel)) {
+            return series->labels[i].value;
+        }
+    }
+    return NULL;
+}
+
+// Labels of the reply: __source__=key1,key2
+static void replyExprLabels(RedisModuleCtx *ctx, const ExprSource *sources, size_t count) {
+    RedisModuleString *keys = RedisModule_CreateString(NULL, "", 0);
+    for (size_t i = 0; i < count; i++) {
+        size_t keyLen;
+        const char *key = RedisModule_StringPtrLen(sources[i].series->keyName, &keyLen);
+        if (i > 0) {
+            RedisModule_StringAppendBuffer(NULL, keys, ",", 1);
+        }
+        RedisModule_StringAppendBuffer(NULL, keys, key, keyLen);
+    }
+    RedisModule_ReplyWithArray(ctx, 1);
+    RedisModule_ReplyWithArray(ctx, 2);
+    RedisModule_ReplyWithStringBuffer(ctx, "__source__", strlen("__source__"));
+    RedisModule_ReplyWithString(ctx, keys);
+    RedisModule_FreeString(NULL, keys);
+}
+
+int ReplyExprMultiRange(RedisModuleCtx *ctx, RedisModuleDict *result, const MRangeArgs *args) {
+    const ExprArgs *exprArgs = &args->exprArgs;
+    const Expr *expr = exprArgs->expr;
+    ExprSource *sources = calloc(expr->inputsCount, sizeof(ExprSource));
+
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(result, "^", NULL, 0);
+    char *currentKey;
+    size_t currentKeyLen;
+    void *seriesId;
+    while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, &seriesId)) != NULL) {
+        Series *series = SeriesRegistry_Lookup(ctx, (uintptr_t)seriesId);
+        if (series == NULL) {
+            RedisModule_Log(ctx,
+                            "warning",
+                            "couldn't open key or key is not a Timeseries. key=%.*s",
+                            (int)currentKeyLen,
+                            currentKey);
+            // The iterator may have been invalidated, stop and restart from after the current key.
+            RedisModule_DictIteratorStop(iter);
+            iter = RedisModule_DictIteratorStartC(result, ">", currentKey, currentKeyLen);
+            continue;
+        }
+        RedisModuleString *alias = seriesAlias(series, exprArgs->aliasLabel);
+        if (alias == NULL) {
+            continue;
+        }
+        size_t aliasLen;
+        const char *aliasName = RedisModule_StringPtrLen(alias, &aliasLen);
+        const int index = Expr_InputIndex(expr, aliasName, aliasLen);
+        if (index < 0) {
+            continue;
+        }
+        if (sources[index].series != NULL) {
+            RedisModule_DictIteratorStop(iter);
+            free(sources);
+            RTS_ReplyGeneralError(ctx, "TSDB: EXPR names more than one matched series");
+            return REDISMODULE_ERR;
+        }
+        sources[index].series = series;
+        sources[index].start = args->startTimestamp;
+        ApplyRetention(series, &sources[index].start, args->endTimestamp);
+    }
+    RedisModule_DictIteratorStop(iter);
+
+    for (size_t i = 0; i < expr->inputsCount; i++) {
+        if (sources[i].series == NULL) {
+            free(sources);
+            RTS_ReplyGeneralError(ctx, "TSDB: EXPR names a series that was not matched");
+            return REDISMODULE_ERR;
+        }
+    }
+
+    RedisModule_ReplyWithArray(ctx, 1);
+    RedisModule_ReplyWithArray(ctx, 3);
+    RedisModule_ReplyWithStringBuffer(ctx, exprArgs->text, strlen(exprArgs->text));
+    if (args->withLabels) {
+        replyExprLabels(ctx, sources, expr->inputsCount);
+    } else {
+        RedisModule_ReplyWithArray(ctx, 0);
+    }
+    replyExprRange(ctx,
+                   exprArgs,
+                   sources,
+                   args->endTimestamp,
+                   &args->filter,
+                   &args->aggregationArgs,
+                   args->count,
+                   args->reverse);
+    free(sources);
+    return REDISMODULE_OK;
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#ifndef EXPR_RANGE_H
+#define EXPR_RANGE_H
+
+#include "expr.h"
+#include "query_language.h"
+#include "redismodule.h"
+
+/*
+ * TS.RANGE and TS.MRANGE ... EXPR reply with a single series computed from several. The rows of
+ * every series named by the expression are read through their own SeriesIterator, aggregated
+ * first when asked to, and joined on their timestamps by the JOIN policy. Aggregated series share
+ * the bucket timestamps, so the default INNER join lines their buckets up. The joined rows are
+ * gathered into arrays of EXPR_BATCH_ROWS rows per series and the expression is evaluated over
+ * every array at once, per aggregation.
+ */
+
+// TS.RANGE key ... EXPR, the expression names the fields of the series or the key itself
+int ReplyExprSeriesRange(RedisModuleCtx *ctx,
+                         Series *series,
+                         RedisModuleString *keyName,
+                         api_timestamp_t start_ts,
+                         api_timestamp_t end_ts,
+                         const SeriesFilter *filter,
+                         const AggregationArgs *aggregation,
+                         long long maxResults,
+                         bool rev,
+                         const ExprArgs *exprArgs);
+
+// TS.MRANGE ... EXPR, the expression names the matched series by key name or ALIAS label
+int ReplyExprMultiRange(RedisModuleCtx *ctx, RedisModuleDict *result, const MRangeArgs *args);
+
+#endif
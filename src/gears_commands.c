@@ -59,35 +59,26 @@ static void mrange_done(ExecutionPlan *gearsCtx, void *privateData) {
                                 data->args.withLabels,
                                 data->args.startTimestamp,
                                 data->args.endTimestamp,
-                                data->args.aggregationArgs.aggregationClass,
-                                data->args.aggregationArgs.timeDelta,
+                                &data->args.filter,
+                                &data->args.aggregationArgs,
                                 data->args.count,
                                 data->args.reverse);
         }
     }
 
     if (data->args.groupByLabel) {
-        // Apply the reducer
-        ResultSet_ApplyReducer(resultset,
+        // Reduce the groups, max results applies to the reduced series
+        ResultSet_ReplyReduced(rctx,
+                               resultset,
+                               data->args.withLabels,
                                data->args.startTimestamp,
                                data->args.endTimestamp,
-                               data->args.aggregationArgs.aggregationClass,
-                               data->args.aggregationArgs.timeDelta,
-                               -1,
-                               false,
+                               &data->args.filter,
+                               &data->args.aggregationArgs,
+                               data->args.count,
+                               data->args.reverse,
                                data->args.gropuByReducerOp);
 
-        // Do not apply the aggregation on the resultset, do apply max results on the final result
-        replyResultSet(rctx,
-                       resultset,
-                       data->args.withLabels,
-                       data->args.startTimestamp,
-                       data->args.endTimestamp,
-                       NULL,
-                       0,
-                       data->args.count,
-                       data->args.reverse);
-
         ResultSet_Free(resultset);
     }
     RedisModule_UnblockClient(bc, NULL);
@@ -160,6 +151,18 @@ int TSDB_mrange_RG(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, bool
         return REDISMODULE_OK;
     }
     args.reverse = reverse;
+    if (args.topK > 0) {
+        // the series of every shard would have to be ranked together
+        RTS_ReplyGeneralError(ctx, "TSDB: TOPK is not supported on a cluster");
+        MRangeArgs_Free(&args);
+        return REDISMODULE_OK;
+    }
+    if (args.exprArgs.expr != NULL) {
+        // the series of the expression may live on different shards
+        RTS_ReplyGeneralError(ctx, "TSDB: EXPR is not supported on a cluster");
+        MRangeArgs_Free(&args);
+        return REDISMODULE_OK;
+    }
 
     char *err = NULL;
     FlatExecutionPlan *rg_ctx = RedisGears_CreateCtx("ShardIDReader", &err);
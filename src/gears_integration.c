@@ -7,6 +7,7 @@
 #include "indexer.h"
 #include "query_language.h"
 #include "redisgears.h"
+#include "series_registry.h"
 #include "tsdb.h"
 
 #include <assert.h>
@@ -171,13 +172,10 @@ Record *ShardSeriesMapper(ExecutionCtx *rctx, Record *data, void *arg) {
 
     Series *series;
     Record *series_list = RedisGears_ListRecordCreate(0);
-    while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, NULL)) != NULL) {
-        RedisModuleKey *key;
-        RedisModuleString *keyName = RedisModule_CreateString(ctx, currentKey, currentKeyLen);
-        const int status = SilentGetSeries(ctx, keyName, &key, &series, REDISMODULE_READ);
-        RedisModule_FreeString(ctx, keyName);
-
-        if (!status) {
+    void *seriesId;
+    while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, &seriesId)) != NULL) {
+        series = SeriesRegistry_Lookup(ctx, (uintptr_t)seriesId);
+        if (series == NULL) {
             RedisModule_Log(ctx,
                             "warning",
                             "couldn't open key or key is not a Timeseries. key=%.*s",
@@ -188,7 +186,6 @@ Record *ShardSeriesMapper(ExecutionCtx *rctx, Record *data, void *arg) {
         RedisGears_ListRecordAdd(
             series_list,
             SeriesRecord_New(series, predicates->startTimestamp, predicates->endTimestamp));
-        RedisModule_CloseKey(key);
     }
     RedisModule_DictIteratorStop(iter);
     RedisModule_FreeDict(ctx, result);
@@ -210,13 +207,10 @@ Record *ShardMgetMapper(ExecutionCtx *rctx, Record *data, void *arg) {
 
     Series *series;
     Record *series_list = RedisGears_ListRecordCreate(0);
-    while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, NULL)) != NULL) {
-        RedisModuleKey *key;
-        RedisModuleString *keyName = RedisModule_CreateString(ctx, currentKey, currentKeyLen);
-        const int status = SilentGetSeries(ctx, keyName, &key, &series, REDISMODULE_READ);
-        RedisModule_FreeString(ctx, keyName);
-
-        if (!status) {
+    void *seriesId;
+    while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, &seriesId)) != NULL) {
+        series = SeriesRegistry_Lookup(ctx, (uintptr_t)seriesId);
+        if (series == NULL) {
             RedisModule_Log(ctx,
                             "warning",
                             "couldn't open key or key is not a Timeseries. key=%.*s",
@@ -235,7 +229,6 @@ Record *ShardMgetMapper(ExecutionCtx *rctx, Record *data, void *arg) {
             RedisGears_ListRecordAdd(key_record, RedisGears_ListRecordCreate(0));
         }
         RedisGears_ListRecordAdd(key_record, ListWithSeriesLastDatapoint(series));
-        RedisModule_CloseKey(key);
 
         RedisGears_ListRecordAdd(series_list, key_record);
     }
@@ -331,7 +324,7 @@ Record *SeriesRecord_New(Series *series, timestamp_t startTimestamp, timestamp_t
         out->labels[i].value = RedisModule_CreateStringFromString(NULL, series->labels[i].value);
     }
 
-    // clone chunks
+    // pin the chunks instead of copying them, writers copy a pinned chunk before changing it
     out->chunks = calloc(RedisModule_DictSize(series->chunks), sizeof(Chunk_t *));
     RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
     Chunk_t *chunk = NULL;
@@ -342,7 +335,7 @@ Record *SeriesRecord_New(Series *series, timestamp_t startTimestamp, timestamp_t
                 break;
             }
 
-            out->chunks[index] = out->funcs->CloneChunk(chunk);
+            out->chunks[index] = out->funcs->RetainChunk(chunk);
             index++;
         }
     }
@@ -426,7 +419,7 @@ Series *SeriesRecord_IntoSeries(SeriesRecord *record) {
     s->funcs = record->funcs;
     for (int chunk_index = 0; chunk_index < record->chunkCount; chunk_index++) {
         dictOperator(s->chunks,
-                     s->funcs->CloneChunk(record->chunks[chunk_index]),
+                     s->funcs->RetainChunk(record->chunks[chunk_index]),
                      record->funcs->GetFirstTimestamp(record->chunks[chunk_index]),
                      DICT_OP_SET);
     }
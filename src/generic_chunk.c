@@ -9,22 +9,32 @@
 static ChunkFuncs regChunk = {
     .NewChunk = Uncompressed_NewChunk,
     .FreeChunk = Uncompressed_FreeChunk,
+    .CloneChunk = Uncompressed_CloneChunk,
+    .RetainChunk = Uncompressed_RetainChunk,
+    .IsChunkShared = Uncompressed_IsChunkShared,
     .SplitChunk = Uncompressed_SplitChunk,
+    .ResizeChunk = Uncompressed_ResizeChunk,
 
     .AddSample = Uncompressed_AddSample,
     .UpsertSample = Uncompressed_UpsertSample,
+    .DelRange = Uncompressed_DelRange,
 
     .NewChunkIterator = Uncompressed_NewChunkIterator,
+    .InitChunkIterator = Uncompressed_InitChunkIterator,
 
     .GetChunkSize = Uncompressed_GetChunkSize,
+    .GetChunkDataSize = Uncompressed_GetChunkDataSize,
     .GetNumOfSample = Uncompressed_NumOfSample,
     .GetLastTimestamp = Uncompressed_GetLastTimestamp,
     .GetFirstTimestamp = Uncompressed_GetFirstTimestamp,
+    .GetValueRange = Uncompressed_GetValueRange,
 
     .SaveToRDB = Uncompressed_SaveToRDB,
     .LoadFromRDB = Uncompressed_LoadFromRDB,
     .GearsSerialize = Uncompressed_GearsSerialize,
     .GearsDeserialize = Uncompressed_GearsDeserialize,
+
+    .DefragChunk = Uncompressed_DefragChunk,
 };
 
 ChunkIterFuncs uncompressedChunkIteratorClass = {
@@ -37,22 +47,31 @@ static ChunkFuncs comprChunk = {
     .NewChunk = Compressed_NewChunk,
     .FreeChunk = Compressed_FreeChunk,
     .CloneChunk = Compressed_CloneChunk,
+    .RetainChunk = Compressed_RetainChunk,
+    .IsChunkShared = Compressed_IsChunkShared,
     .SplitChunk = Compressed_SplitChunk,
+    .ResizeChunk = Compressed_ResizeChunk,
 
     .AddSample = Compressed_AddSample,
     .UpsertSample = Compressed_UpsertSample,
+    .DelRange = Compressed_DelRange,
 
     .NewChunkIterator = Compressed_NewChunkIterator,
+    .InitChunkIterator = Compressed_InitChunkIterator,
 
     .GetChunkSize = Compressed_GetChunkSize,
+    .GetChunkDataSize = Compressed_GetChunkDataSize,
     .GetNumOfSample = Compressed_ChunkNumOfSample,
     .GetLastTimestamp = Compressed_GetLastTimestamp,
     .GetFirstTimestamp = Compressed_GetFirstTimestamp,
+    .GetValueRange = Compressed_GetValueRange,
 
     .SaveToRDB = Compressed_SaveToRDB,
     .LoadFromRDB = Compressed_LoadFromRDB,
     .GearsSerialize = Compressed_GearsSerialize,
     .GearsDeserialize = Compressed_GearsDeserialize,
+
+    .DefragChunk = Compressed_DefragChunk,
 };
 
 static ChunkIterFuncs compressedChunkIteratorClass = {
@@ -89,6 +108,14 @@ ChunkResult handleDuplicateSample(DuplicatePolicy policy, Sample oldSample, Samp
     }
 }
 
+void *DefragPtr(RedisModuleDefragCtx *ctx, void *ptr) {
+    if (ptr == NULL) {
+        return NULL;
+    }
+    void *newPtr = RedisModule_DefragAlloc(ctx, ptr);
+    return newPtr ? newPtr : ptr;
+}
+
 ChunkFuncs *GetChunkClass(CHUNK_TYPES_T chunkType) {
     switch (chunkType) {
         case CHUNK_REGULAR:
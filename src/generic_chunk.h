@@ -17,6 +17,7 @@
 #include <rmutil/strings.h>
 
 struct RedisModuleIO;
+struct RedisModuleDefragCtx;
 
 typedef struct Sample
 {
@@ -46,6 +47,14 @@ typedef struct UpsertCtx
     Chunk_t *inChunk; // original chunk
 } UpsertCtx;
 
+// Buffer owned by the caller of InitChunkIterator, reused by iterators that decode a whole chunk
+// before walking it (reverse iteration of compressed chunks). Released with free().
+typedef struct ChunkIterScratch
+{
+    Sample *samples;
+    size_t capacity;
+} ChunkIterScratch;
+
 typedef struct ChunkIterFuncs
 {
     void (*Free)(ChunkIter_t *iter);
@@ -58,24 +67,49 @@ typedef struct ChunkFuncs
     Chunk_t *(*NewChunk)(size_t sampleCount);
     void (*FreeChunk)(Chunk_t *chunk);
     Chunk_t *(*CloneChunk)(Chunk_t *chunk);
+    // Pins the chunk for a reader that keeps it past the current command (Gears records, background
+    // readers). A pinned chunk is immutable: writers swap a copy into the series first, see
+    // SeriesUnshareChunk. Every pin is dropped with FreeChunk.
+    Chunk_t *(*RetainChunk)(Chunk_t *chunk);
+    bool (*IsChunkShared)(Chunk_t *chunk);
     Chunk_t *(*SplitChunk)(Chunk_t *chunk);
+    // Grows the data buffer of a chunk to `size` bytes, keeping its samples
+    void (*ResizeChunk)(Chunk_t *chunk, size_t size);
 
     ChunkResult (*AddSample)(Chunk_t *chunk, Sample *sample);
     ChunkResult (*UpsertSample)(UpsertCtx *uCtx, int *size, DuplicatePolicy duplicatePolicy);
+    // Removes the samples in [startTs, endTs] and returns how many were removed
+    size_t (*DelRange)(Chunk_t *chunk, timestamp_t startTs, timestamp_t endTs);
 
     ChunkIter_t *(*NewChunkIterator)(Chunk_t *chunk,
                                      int options,
                                      ChunkIterFuncs *retChunkIterClass);
+    // Like NewChunkIterator, but in caller provided storage (see ChunkIterStorage in
+    // series_iterator.h) that is re-initialized for every chunk and never freed.
+    void (*InitChunkIterator)(Chunk_t *chunk,
+                              int options,
+                              ChunkIterFuncs *retChunkIterClass,
+                              ChunkIter_t *iter,
+                              ChunkIterScratch *scratch);
 
     size_t (*GetChunkSize)(Chunk_t *chunk, bool includeStruct);
+    // Number of buffer bytes that actually hold samples
+    size_t (*GetChunkDataSize)(Chunk_t *chunk);
     u_int64_t (*GetNumOfSample)(Chunk_t *chunk);
     u_int64_t (*GetLastTimestamp)(Chunk_t *chunk);
     u_int64_t (*GetFirstTimestamp)(Chunk_t *chunk);
+    // Bounds of the sample values, false for an empty chunk. They hold every value of the chunk
+    // but may be wider after an upsert or a delete, so they only tell which chunks can be skipped.
+    bool (*GetValueRange)(Chunk_t *chunk, double *min, double *max);
 
     void (*SaveToRDB)(Chunk_t *chunk, struct RedisModuleIO *io);
     void (*LoadFromRDB)(Chunk_t **chunk, struct RedisModuleIO *io);
     void (*GearsSerialize)(Chunk_t *chunk, Gears_BufferWriter *bw);
     void (*GearsDeserialize)(Chunk_t **chunk, Gears_BufferReader *br);
+
+    // Moves the chunk struct and its data buffer if the allocator considers them fragmented.
+    // Returns the (possibly new) chunk pointer.
+    Chunk_t *(*DefragChunk)(struct RedisModuleDefragCtx *ctx, Chunk_t *chunk);
 } ChunkFuncs;
 
 ChunkResult handleDuplicateSample(DuplicatePolicy policy, Sample oldSample, Sample *newSample);
@@ -83,6 +117,9 @@ const char *DuplicatePolicyToString(DuplicatePolicy policy);
 int RMStringLenDuplicationPolicyToEnum(RedisModuleString *aggTypeStr);
 DuplicatePolicy DuplicatePolicyFromString(const char *input, size_t len);
 
+// Returns the relocated allocation, or `ptr` itself when the allocator chose not to move it.
+void *DefragPtr(struct RedisModuleDefragCtx *ctx, void *ptr);
+
 ChunkFuncs *GetChunkClass(CHUNK_TYPES_T chunkClass);
 ChunkIterFuncs *GetChunkIteratorClass(CHUNK_TYPES_T chunkType);
 
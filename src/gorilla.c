@@ -91,6 +91,7 @@
 #include "gorilla.h"
 
 #include <assert.h>
+#include <math.h>
 
 #define BIN_NUM_VALUES 64
 #define BINW BIN_NUM_VALUES
@@ -403,6 +404,7 @@ ChunkResult Compressed_Append(CompressedChunk *chunk, timestamp_t timestamp, dou
         chunk->baseValue.d = chunk->prevValue.d = value;
         chunk->baseTimestamp = chunk->prevTimestamp = timestamp;
         chunk->prevTimestampDelta = 0;
+        chunk->minValue = chunk->maxValue = value;
     } else {
         u_int64_t idx = chunk->idx;
         u_int64_t prevTimestamp = chunk->prevTimestamp;
@@ -413,6 +415,8 @@ ChunkResult Compressed_Append(CompressedChunk *chunk, timestamp_t timestamp, dou
             chunk->prevTimestampDelta = prevTimestampDelta;
             return CR_END;
         }
+        chunk->minValue = fmin(chunk->minValue, value);
+        chunk->maxValue = fmax(chunk->maxValue, value);
     }
     chunk->count++;
     return CR_OK;
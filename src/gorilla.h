@@ -42,6 +42,11 @@ typedef struct CompressedChunk
     union64bits prevValue;
     u_int8_t prevLeading;
     u_int8_t prevTrailing;
+    // bounds of the values, see ChunkFuncs.GetValueRange
+    double minValue;
+    double maxValue;
+    bool cold;     // data lives in a cold tier segment, see cold_tier.h
+    uint32_t refs; // readers pinning the chunk besides its owner, see RetainChunk
 } CompressedChunk;
 
 typedef struct Compressed_Iterator
@@ -6,6 +6,7 @@
 #include "indexer.h"
 
 #include "consts.h"
+#include "memory_stats.h"
 
 #include <assert.h>
 #include <limits.h>
@@ -36,6 +37,25 @@ void FreeLabels(void *value, size_t labelsCount) {
     free(labels);
 }
 
+size_t LabelsMemUsage(const Label *labels, size_t labelsCount) {
+    size_t size = sizeof(Label) * labelsCount;
+    for (size_t i = 0; i < labelsCount; i++) {
+        size_t len;
+        RedisModule_StringPtrLen(labels[i].key, &len);
+        size += len + MEMSTATS_STRING_OVERHEAD;
+        RedisModule_StringPtrLen(labels[i].value, &len);
+        size += len + MEMSTATS_STRING_OVERHEAD;
+    }
+    return size;
+}
+
+size_t IndexMemUsage(RedisModuleString *ts_key, size_t labelsCount) {
+    size_t len;
+    RedisModule_StringPtrLen(ts_key, &len);
+    // every label indexes the key twice, under `k=v` and under `k`
+    return 2 * labelsCount * (len + MEMSTATS_DICT_ENTRY_OVERHEAD);
+}
+
 static int parseValueList(char *token, size_t *count, RedisModuleString ***values) {
     char *iter_ptr;
     if (token == NULL) {
@@ -124,24 +144,39 @@ int CountPredicateType(QueryPredicateList *queries, PredicateType type) {
     return count;
 }
 
-void indexUnderKey(INDEXER_OPERATION_T op, RedisModuleString *key, RedisModuleString *ts_key) {
+void indexUnderKey(INDEXER_OPERATION_T op,
+                   RedisModuleString *key,
+                   RedisModuleString *ts_key,
+                   uint64_t seriesId) {
     int nokey = 0;
     RedisModuleDict *leaf = RedisModule_DictGet(labelsIndex, key, &nokey);
     if (nokey) {
         leaf = RedisModule_CreateDict(NULL);
         RedisModule_DictSet(labelsIndex, key, leaf);
+        size_t len;
+        RedisModule_StringPtrLen(key, &len);
+        TSMemStats.invertedIndex += len + MEMSTATS_DICT_ENTRY_OVERHEAD + MEMSTATS_DICT_OVERHEAD;
     }
 
+    size_t len;
+    RedisModule_StringPtrLen(ts_key, &len);
     if (op == Indexer_Add) {
-        RedisModule_DictSet(leaf, ts_key, NULL);
+        // the leaf entry carries the series id so results resolve without a key lookup
+        void *data = (void *)(uintptr_t)seriesId;
+        if (RedisModule_DictReplace(leaf, ts_key, data) == REDISMODULE_OK) {
+            TSMemStats.invertedIndex += len + MEMSTATS_DICT_ENTRY_OVERHEAD;
+        }
     } else if (op == Indexer_Remove) {
-        RedisModule_DictDel(leaf, ts_key, NULL);
+        if (RedisModule_DictDel(leaf, ts_key, NULL) == REDISMODULE_OK) {
+            TSMemStats.invertedIndex -= len + MEMSTATS_DICT_ENTRY_OVERHEAD;
+        }
     }
 }
 
 void IndexOperation(RedisModuleCtx *ctx,
                     INDEXER_OPERATION_T op,
                     RedisModuleString *ts_key,
+                    uint64_t seriesId,
                     Label *labels,
                     size_t labels_count) {
     const char *key_string, *value_string;
@@ -153,8 +188,8 @@ void IndexOperation(RedisModuleCtx *ctx,
             RedisModule_CreateStringPrintf(ctx, KV_PREFIX, key_string, value_string);
         RedisModuleString *indexed_key = RedisModule_CreateStringPrintf(ctx, K_PREFIX, key_string);
 
-        indexUnderKey(op, indexed_key_value, ts_key);
-        indexUnderKey(op, indexed_key, ts_key);
+        indexUnderKey(op, indexed_key_value, ts_key, seriesId);
+        indexUnderKey(op, indexed_key, ts_key, seriesId);
 
         RedisModule_FreeString(ctx, indexed_key_value);
         RedisModule_FreeString(ctx, indexed_key);
@@ -163,16 +198,19 @@ void IndexOperation(RedisModuleCtx *ctx,
 
 void IndexMetric(RedisModuleCtx *ctx,
                  RedisModuleString *ts_key,
+                 uint64_t seriesId,
                  Label *labels,
                  size_t labels_count) {
-    IndexOperation(ctx, Indexer_Add, ts_key, labels, labels_count);
+    IndexOperation(ctx, Indexer_Add, ts_key, seriesId, labels, labels_count);
+    TSMemStats.labels += LabelsMemUsage(labels, labels_count);
 }
 
 void RemoveIndexedMetric(RedisModuleCtx *ctx,
                          RedisModuleString *ts_key,
                          Label *labels,
                          size_t labels_count) {
-    IndexOperation(ctx, Indexer_Remove, ts_key, labels, labels_count);
+    IndexOperation(ctx, Indexer_Remove, ts_key, 0, labels, labels_count);
+    TSMemStats.labels -= LabelsMemUsage(labels, labels_count);
 }
 
 void _union(RedisModuleCtx *ctx, RedisModuleDict *dest, RedisModuleDict *src) {
@@ -181,8 +219,9 @@ void _union(RedisModuleCtx *ctx, RedisModuleDict *dest, RedisModuleDict *src) {
      */
     RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(src, "^", NULL, 0);
     RedisModuleString *currentKey;
-    while ((currentKey = RedisModule_DictNext(ctx, iter, NULL)) != NULL) {
-        RedisModule_DictSet(dest, currentKey, (void *)1);
+    void *seriesId;
+    while ((currentKey = RedisModule_DictNext(ctx, iter, &seriesId)) != NULL) {
+        RedisModule_DictSet(dest, currentKey, seriesId);
         RedisModule_FreeString(ctx, currentKey);
     }
     RedisModule_DictIteratorStop(iter);
@@ -290,8 +329,9 @@ RedisModuleDict *QueryIndexPredicate(RedisModuleCtx *ctx,
         if (prevResults == NULL) {
             RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(currentLeaf, "^", NULL, 0);
             RedisModuleString *currentKey;
-            while ((currentKey = RedisModule_DictNext(ctx, iter, NULL)) != NULL) {
-                RedisModule_DictSet(localResult, currentKey, (void *)1);
+            void *seriesId;
+            while ((currentKey = RedisModule_DictNext(ctx, iter, &seriesId)) != NULL) {
+                RedisModule_DictSet(localResult, currentKey, seriesId);
                 RedisModule_FreeString(ctx, currentKey);
             }
             RedisModule_DictIteratorStop(iter);
@@ -8,6 +8,7 @@
 
 #include "redismodule.h"
 
+#include <stdint.h>
 #include <sys/types.h>
 
 typedef struct
@@ -54,8 +55,14 @@ void QueryPredicateList_Free(QueryPredicateList *list);
 
 void IndexInit();
 void FreeLabels(void *value, size_t labelsCount);
+// Bytes used by a label set, including the label strings
+size_t LabelsMemUsage(const Label *labels, size_t labelsCount);
+// Bytes a series with `labelsCount` labels adds to the inverted index
+size_t IndexMemUsage(RedisModuleString *ts_key, size_t labelsCount);
+// Indexes `ts_key` under its labels, query results carry `seriesId` as the value of each key
 void IndexMetric(RedisModuleCtx *ctx,
                  RedisModuleString *ts_key,
+                 uint64_t seriesId,
                  Label *labels,
                  size_t labels_count);
 void RemoveIndexedMetric(RedisModuleCtx *ctx,
@@ -0,0 +1,25 @@
+/*
+ * Copyright 2018-2020 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "memory_stats.h"
+
+#include "tsdb.h"
+
+TSMemoryStats TSMemStats = { 0 };
+
+long long MemStats_ChunkSlack() {
+    return TSMemStats.chunkBuffers - TSMemStats.chunkData;
+}
+
+long long MemStats_ChunkDirectory() {
+    return TSMemStats.chunkHeaders + TSMemStats.chunks * MEMSTATS_DICT_ENTRY_OVERHEAD +
+           TSMemStats.seriesCount * MEMSTATS_DICT_OVERHEAD;
+}
+
+long long MemStats_Total() {
+    return TSMemStats.seriesCount * (long long)sizeof(Series) + TSMemStats.chunkBuffers +
+           MemStats_ChunkDirectory() + TSMemStats.labels + TSMemStats.invertedIndex +
+           TSMemStats.compactionRules;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2018-2020 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <stddef.h>
+
+// Estimated cost of bookkeeping allocations that are owned by Redis' dict implementation and
+// cannot be measured directly.
+#define MEMSTATS_DICT_OVERHEAD 48       // an empty RedisModuleDict
+#define MEMSTATS_DICT_ENTRY_OVERHEAD 32 // a rax node holding a key and a value pointer
+#define MEMSTATS_STRING_OVERHEAD 24     // RedisModuleString object and sds header
+
+typedef struct ChunksMemory
+{
+    size_t headers; // chunk structs
+    size_t buffers; // allocated sample buffers
+    size_t data;    // part of `buffers` that holds samples
+} ChunksMemory;
+
+// Module-wide memory counters. They are only updated from the main thread and only account for
+// series stored in the keyspace (temporary series built while answering a query are excluded).
+typedef struct TSMemoryStats
+{
+    long long seriesCount;
+    long long chunks;
+    long long chunkHeaders;
+    long long chunkBuffers;
+    long long chunkData;
+    long long labels;
+    long long invertedIndex;
+    long long compactionRules;
+} TSMemoryStats;
+
+extern TSMemoryStats TSMemStats;
+
+// Adds (`sign` is 1) or removes (`sign` is -1) `chunks` chunks holding `mem` bytes
+static inline void MemStats_AccountChunks(const ChunksMemory *mem, long long chunks, int sign) {
+    TSMemStats.chunks += sign * chunks;
+    TSMemStats.chunkHeaders += sign * (long long)mem->headers;
+    TSMemStats.chunkBuffers += sign * (long long)mem->buffers;
+    TSMemStats.chunkData += sign * (long long)mem->data;
+}
+
+long long MemStats_ChunkSlack();
+long long MemStats_ChunkDirectory();
+long long MemStats_Total();
+
+#endif // MEMORY_STATS_H
@@ -9,18 +9,27 @@
 #include "module.h"
 
 #include "RedisModulesSDK/redismodule.h"
+#include "chunk_merger.h"
+#include "cold_tier.h"
 #include "common.h"
 #include "compaction.h"
 #include "config.h"
 #include "fast_double_parser_c/fast_double_parser_c.h"
 #include "gears_commands.h"
 #include "gears_integration.h"
+#include "expr_range.h"
 #include "indexer.h"
+#include "memory_stats.h"
+#include "parallel_mrange.h"
+#include "parallel_range.h"
 #include "query_language.h"
 #include "rdb.h"
 #include "redisgears.h"
 #include "reply.h"
 #include "resultset.h"
+#include "series_registry.h"
+#include "thread_pool.h"
+#include "topk.h"
 #include "tsdb.h"
 #include "version.h"
 
@@ -61,11 +70,17 @@ int TSDB_info(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     }
 
     int is_debug = RMUtil_ArgExists("DEBUG", argv, argc, 1);
-    if (is_debug) {
-        RedisModule_ReplyWithArray(ctx, 13 * 2);
-    } else {
-        RedisModule_ReplyWithArray(ctx, 12 * 2);
+    int replyLen = is_debug ? 13 * 2 : 12 * 2;
+    if (series->fieldsCount > 0) {
+        replyLen += 2;
+    }
+    if (series->levels != NULL) {
+        replyLen += 2;
     }
+    if (ColdTier_Enabled()) {
+        replyLen += 2 * 2;
+    }
+    RedisModule_ReplyWithArray(ctx, replyLen);
 
     long long skippedSamples;
     long long firstTimestamp = getFirstValidTimestamp(series, &skippedSamples);
@@ -122,6 +137,39 @@ int TSDB_info(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     }
     RedisModule_ReplySetArrayLength(ctx, ruleCount);
 
+    if (ColdTier_Enabled()) {
+        size_t coldChunks, coldBytes;
+        SeriesColdResidency(series, &coldChunks, &coldBytes);
+        RedisModule_ReplyWithSimpleString(ctx, "coldChunkCount");
+        RedisModule_ReplyWithLongLong(ctx, coldChunks);
+        RedisModule_ReplyWithSimpleString(ctx, "coldMemoryUsage");
+        RedisModule_ReplyWithLongLong(ctx, coldBytes);
+    }
+
+    if (series->fieldsCount > 0) {
+        RedisModule_ReplyWithSimpleString(ctx, "fields");
+        RedisModule_ReplyWithArray(ctx, series->fieldsCount);
+        for (size_t i = 0; i < series->fieldsCount; i++) {
+            RedisModule_ReplyWithString(ctx, series->fieldNames[i]);
+        }
+    }
+
+    if (series->levels != NULL) {
+        RedisModule_ReplyWithSimpleString(ctx, "levels");
+        RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+        int levelCount = 0;
+        for (CompactionRule *level = series->levels; level != NULL; level = level->nextRule) {
+            RedisModule_ReplyWithArray(ctx, 5);
+            RedisModule_ReplyWithSimpleString(ctx, AggTypeEnumToString(level->aggType));
+            RedisModule_ReplyWithLongLong(ctx, level->timeBucket);
+            RedisModule_ReplyWithLongLong(ctx, level->level->retentionTime);
+            RedisModule_ReplyWithLongLong(ctx, SeriesGetNumSamples(level->level));
+            RedisModule_ReplyWithLongLong(ctx, RedisModule_DictSize(level->level->chunks));
+            levelCount++;
+        }
+        RedisModule_ReplySetArrayLength(ctx, levelCount);
+    }
+
     if (is_debug) {
         RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, ">", "", 0);
         Chunk_t *chunk = NULL;
@@ -130,7 +178,7 @@ int TSDB_info(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
         RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
         while (RedisModule_DictNextC(iter, NULL, (void *)&chunk)) {
             size_t chunkSize = series->funcs->GetChunkSize(chunk, FALSE);
-            RedisModule_ReplyWithArray(ctx, 5 * 2);
+            RedisModule_ReplyWithArray(ctx, 6 * 2);
             RedisModule_ReplyWithSimpleString(ctx, "startTimestamp");
             RedisModule_ReplyWithLongLong(ctx, series->funcs->GetFirstTimestamp(chunk));
             RedisModule_ReplyWithSimpleString(ctx, "endTimestamp");
@@ -142,6 +190,11 @@ int TSDB_info(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
             RedisModule_ReplyWithLongLong(ctx, chunkSize);
             RedisModule_ReplyWithSimpleString(ctx, "bytesPerSample");
             RedisModule_ReplyWithDouble(ctx, (float)chunkSize / numOfSamples);
+            // allocated but unused bytes, cold chunks keep no data in memory
+            size_t dataSize = series->funcs->GetChunkDataSize(chunk);
+            RedisModule_ReplyWithSimpleString(ctx, "slack");
+            RedisModule_ReplyWithLongLong(
+                ctx, dataSize == 0 && numOfSamples > 0 ? 0 : chunkSize - min(dataSize, chunkSize));
             chunkCount++;
         }
         RedisModule_DictIteratorStop(iter);
@@ -169,6 +222,41 @@ void _TSDB_queryindex_impl(RedisModuleCtx *ctx, QueryPredicateList *queries) {
     RedisModule_ReplySetArrayLength(ctx, replylen);
 }
 
+int TSDB_memstats(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    if (argc != 1) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModule_ReplyWithArray(ctx, 9 * 2);
+    RedisModule_ReplyWithSimpleString(ctx, "seriesCount");
+    RedisModule_ReplyWithLongLong(ctx, TSMemStats.seriesCount);
+    RedisModule_ReplyWithSimpleString(ctx, "seriesHeaders");
+    RedisModule_ReplyWithLongLong(ctx, TSMemStats.seriesCount * sizeof(Series));
+    RedisModule_ReplyWithSimpleString(ctx, "chunkData");
+    RedisModule_ReplyWithLongLong(ctx, TSMemStats.chunkData);
+    RedisModule_ReplyWithSimpleString(ctx, "chunkSlack");
+    RedisModule_ReplyWithLongLong(ctx, MemStats_ChunkSlack());
+    RedisModule_ReplyWithSimpleString(ctx, "chunkDirectory");
+    RedisModule_ReplyWithLongLong(ctx, MemStats_ChunkDirectory());
+    RedisModule_ReplyWithSimpleString(ctx, "labels");
+    RedisModule_ReplyWithLongLong(ctx, TSMemStats.labels);
+    RedisModule_ReplyWithSimpleString(ctx, "invertedIndex");
+    RedisModule_ReplyWithLongLong(ctx, TSMemStats.invertedIndex);
+    RedisModule_ReplyWithSimpleString(ctx, "compactionContexts");
+    RedisModule_ReplyWithLongLong(ctx, TSMemStats.compactionRules);
+    RedisModule_ReplyWithSimpleString(ctx, "total");
+    RedisModule_ReplyWithLongLong(ctx, MemStats_Total());
+    return REDISMODULE_OK;
+}
+
+// INFO timeseries_defrag
+static void TSDB_infoFunc(RedisModuleInfoCtx *ctx, int for_crash_report) {
+    RedisModule_InfoAddSection(ctx, "defrag");
+    RedisModule_InfoAddFieldLongLong(ctx, "defrag_series", TSDefrag.series);
+    RedisModule_InfoAddFieldLongLong(ctx, "defrag_chunks", TSDefrag.chunks);
+    RedisModule_InfoAddFieldLongLong(ctx, "defrag_resumed", TSDefrag.resumed);
+}
+
 int TSDB_queryindex(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_AutoMemory(ctx);
 
@@ -211,14 +299,10 @@ static int replyGroupedMultiRange(RedisModuleCtx *ctx,
     size_t currentKeyLen;
     Series *series = NULL;
 
-    while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, NULL)) != NULL) {
-        RedisModuleKey *key;
-        const int status = SilentGetSeries(ctx,
-                                           RedisModule_CreateString(ctx, currentKey, currentKeyLen),
-                                           &key,
-                                           &series,
-                                           REDISMODULE_READ);
-        if (!status) {
+    void *seriesId;
+    while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, &seriesId)) != NULL) {
+        series = SeriesRegistry_Lookup(ctx, (uintptr_t)seriesId);
+        if (series == NULL) {
             RedisModule_Log(
                 ctx, "warning", "couldn't open key or key is not a Timeseries. key=%s", currentKey);
             // The iterator may have been invalidated, stop and restart from after the current
@@ -228,31 +312,21 @@ static int replyGroupedMultiRange(RedisModuleCtx *ctx,
             continue;
         }
         ResultSet_AddSerie(resultset, series, RedisModule_StringPtrLen(series->keyName, NULL));
-        RedisModule_CloseKey(key);
     }
     RedisModule_DictIteratorStop(iter);
 
-    // Apply the reducer
-    ResultSet_ApplyReducer(resultset,
+    // Reduce the groups, max results applies to the reduced series
+    ResultSet_ReplyReduced(ctx,
+                           resultset,
+                           args.withLabels,
                            args.startTimestamp,
                            args.endTimestamp,
-                           args.aggregationArgs.aggregationClass,
-                           args.aggregationArgs.timeDelta,
+                           &args.filter,
+                           &args.aggregationArgs,
                            args.count,
                            args.reverse,
                            args.gropuByReducerOp);
 
-    // Do not apply the aggregation on the resultset, do apply max results on the final result
-    replyResultSet(ctx,
-                   resultset,
-                   args.withLabels,
-                   args.startTimestamp,
-                   args.endTimestamp,
-                   NULL,
-                   0,
-                   args.count,
-                   args.reverse);
-
     ResultSet_Free(resultset);
     return REDISMODULE_OK;
 }
@@ -266,15 +340,10 @@ static int replyUngroupedMultiRange(RedisModuleCtx *ctx, RedisModuleDict *result
     size_t currentKeyLen;
     long long replylen = 0;
     Series *series;
-    while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, NULL)) != NULL) {
-        RedisModuleKey *key;
-        const int status = SilentGetSeries(ctx,
-                                           RedisModule_CreateString(ctx, currentKey, currentKeyLen),
-                                           &key,
-                                           &series,
-                                           REDISMODULE_READ);
-
-        if (!status) {
+    void *seriesId;
+    while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, &seriesId)) != NULL) {
+        series = SeriesRegistry_Lookup(ctx, (uintptr_t)seriesId);
+        if (series == NULL) {
             RedisModule_Log(ctx,
                             "couldn't open key or key is not a Timeseries. key=%.*s",
                             currentKeyLen,
@@ -289,12 +358,11 @@ static int replyUngroupedMultiRange(RedisModuleCtx *ctx, RedisModuleDict *result
                             args.withLabels,
                             args.startTimestamp,
                             args.endTimestamp,
-                            args.aggregationArgs.aggregationClass,
-                            args.aggregationArgs.timeDelta,
+                            &args.filter,
+                            &args.aggregationArgs,
                             args.count,
                             args.reverse);
         replylen++;
-        RedisModule_CloseKey(key);
     }
     RedisModule_DictIteratorStop(iter);
     RedisModule_ReplySetArrayLength(ctx, replylen);
@@ -315,7 +383,13 @@ int TSDB_generic_mrange(RedisModuleCtx *ctx, RedisModuleString **argv, int argc,
         QueryIndex(ctx, args.queryPredicates->list, args.queryPredicates->count);
 
     int result = REDISMODULE_OK;
-    if (args.groupByLabel) {
+    if (args.exprArgs.expr != NULL) {
+        result = ReplyExprMultiRange(ctx, resultSeries, &args);
+    } else if (args.topK > 0) {
+        result = ReplyTopKMultiRange(ctx, resultSeries, &args);
+    } else if (ParallelMRange_Reply(ctx, resultSeries, &args)) {
+        // replied once the thread pool is done with the series
+    } else if (args.groupByLabel) {
         TS_ResultSet *resultset = ResultSet_Create();
         ResultSet_GroupbyLabel(resultset, args.groupByLabel);
 
@@ -343,6 +417,32 @@ int TSDB_mrevrange(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     return TSDB_generic_mrange(ctx, argv, argc, true);
 }
 
+// LEVEL aggregation:bucket, selects an embedded compaction level of the series
+static int parseLevelArgument(RedisModuleCtx *ctx,
+                              Series *series,
+                              RedisModuleString **argv,
+                              int argc,
+                              CompactionRule **level) {
+    RedisModuleString *levelStr;
+    if (RMUtil_ParseArgsAfter("LEVEL", argv, argc, "s", &levelStr) != REDISMODULE_OK) {
+        RTS_ReplyGeneralError(ctx, "TSDB: missing LEVEL");
+        return REDISMODULE_ERR;
+    }
+    int aggType;
+    uint64_t timeBucket;
+    if (ParseCompactionLevel(RedisModule_StringPtrLen(levelStr, NULL), &aggType, &timeBucket) !=
+        TRUE) {
+        RTS_ReplyGeneralError(ctx, "TSDB: invalid LEVEL");
+        return REDISMODULE_ERR;
+    }
+    *level = SeriesGetLevel(series, aggType, timeBucket);
+    if (*level == NULL) {
+        RTS_ReplyGeneralError(ctx, "TSDB: the series has no such level");
+        return REDISMODULE_ERR;
+    }
+    return REDISMODULE_OK;
+}
+
 int TSDB_generic_range(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, bool rev) {
     RedisModule_AutoMemory(ctx);
 	
@@ -356,8 +456,15 @@ int TSDB_generic_range(RedisModuleCtx *ctx, RedisModuleString **argv, int argc,
         return REDISMODULE_ERR;
     }
 
+    if (RMUtil_ArgIndex("LEVEL", argv, argc) > 0) {
+        CompactionRule *level;
+        if (parseLevelArgument(ctx, series, argv, argc, &level) != REDISMODULE_OK) {
+            return REDISMODULE_ERR;
+        }
+        series = level->level;
+    }
+
     api_timestamp_t start_ts, end_ts;
-    api_timestamp_t time_delta = 0;
     if (parseRangeArguments(ctx, series, 2, argv, &start_ts, &end_ts) != REDISMODULE_OK) {
         return REDISMODULE_ERR;
     }
@@ -367,13 +474,104 @@ int TSDB_generic_range(RedisModuleCtx *ctx, RedisModuleString **argv, int argc,
         return REDISMODULE_ERR;
     }
 
-    AggregationClass *aggObject = NULL;
-    int aggregationResult = parseAggregationArgs(ctx, argv, argc, &time_delta, &aggObject);
+    RangeCursor cursor;
+    if (parseCursorArguments(ctx, argv, argc, &cursor) != REDISMODULE_OK) {
+        return REDISMODULE_ERR;
+    }
+    if (cursor.resume && !rev) {
+        start_ts = max(start_ts, cursor.resumeTimestamp);
+    } else if (cursor.resume) {
+        end_ts = min(end_ts, cursor.resumeTimestamp);
+    }
+
+    AggregationArgs aggregation;
+    int aggregationResult = parseAggregationArgs(ctx, argv, argc, &aggregation);
     if (aggregationResult == TSDB_ERROR) {
         return REDISMODULE_ERR;
     }
 
-    ReplySeriesRange(ctx, series, start_ts, end_ts, aggObject, time_delta, count, rev);
+    SeriesFilter filter;
+    if (parseFilterByArgs(ctx, argv, argc, &filter) != REDISMODULE_OK) {
+        return REDISMODULE_ERR;
+    }
+    const bool withFields = series->fieldsCount > 0 || RMUtil_ArgIndex("FIELDS", argv, argc) > 0;
+    if (withFields && filter.byValue) {
+        RTS_ReplyGeneralError(ctx, "TSDB: FILTER_BY_VALUE is not supported with fields");
+        free(filter.timestamps);
+        return REDISMODULE_ERR;
+    }
+
+    // past the key, which may well be called EXPR, JOIN or ALIAS
+    ExprArgs exprArgs;
+    if (parseExprArgs(ctx, argv + 2, argc - 2, &exprArgs) != REDISMODULE_OK) {
+        free(filter.timestamps);
+        return REDISMODULE_ERR;
+    }
+    if (exprArgs.expr != NULL) {
+        if (cursor.paginated || exprArgs.aliasLabel != NULL) {
+            RTS_ReplyGeneralError(ctx, "TSDB: EXPR of TS.RANGE does not support LIMIT or ALIAS");
+        } else {
+            ReplyExprSeriesRange(ctx,
+                                 series,
+                                 argv[1],
+                                 start_ts,
+                                 end_ts,
+                                 &filter,
+                                 &aggregation,
+                                 count,
+                                 rev,
+                                 &exprArgs);
+        }
+        Expr_Free(exprArgs.expr);
+        free(filter.timestamps);
+        RedisModule_CloseKey(key);
+        return REDISMODULE_OK;
+    }
+
+    if (cursor.paginated) {
+        size_t fieldsCount = 0;
+        size_t *fieldIndices = NULL;
+        if (withFields &&
+            parseFieldsSelection(ctx, series, argv, argc, &fieldsCount, &fieldIndices) !=
+                REDISMODULE_OK) {
+            free(filter.timestamps);
+            return REDISMODULE_ERR;
+        }
+        ReplySeriesRangePage(ctx,
+                             series,
+                             fieldIndices,
+                             fieldsCount,
+                             start_ts,
+                             end_ts,
+                             &filter,
+                             &aggregation,
+                             cursor.limit,
+                             rev);
+        free(fieldIndices);
+    } else if (withFields) {
+        size_t fieldsCount;
+        size_t *fieldIndices;
+        if (parseFieldsSelection(ctx, series, argv, argc, &fieldsCount, &fieldIndices) !=
+            REDISMODULE_OK) {
+            free(filter.timestamps);
+            return REDISMODULE_ERR;
+        }
+        ReplySeriesFieldsRange(ctx,
+                               series,
+                               fieldIndices,
+                               fieldsCount,
+                               start_ts,
+                               end_ts,
+                               &filter,
+                               &aggregation,
+                               count,
+                               rev);
+        free(fieldIndices);
+    } else if (count != -1 ||
+               !ParallelRange_Reply(ctx, series, start_ts, end_ts, &filter, &aggregation, rev)) {
+        ReplySeriesRange(ctx, series, start_ts, end_ts, &filter, &aggregation, count, rev);
+    }
+    free(filter.timestamps);
 
     RedisModule_CloseKey(key);
     return REDISMODULE_OK;
@@ -397,26 +595,44 @@ static void handleCompaction(RedisModuleCtx *ctx,
     if (rule->startCurrentTimeBucket == -1LL) {
         // first sample, lets init the startCurrentTimeBucket
         rule->startCurrentTimeBucket = currentTimestamp;
+        if (rule->aggClass->setBucket != NULL) {
+            rule->aggClass->setBucket(
+                rule->aggContext, currentTimestamp, currentTimestamp + rule->timeBucket);
+        }
     }
 
     if (currentTimestamp > rule->startCurrentTimeBucket) {
-        RedisModuleKey *key =
-            RedisModule_OpenKey(ctx, rule->destKey, REDISMODULE_READ | REDISMODULE_WRITE);
-        if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
-            // key doesn't exist anymore and we don't do anything
-            return;
+        // embedded levels are written in place, without a keyspace lookup
+        RedisModuleKey *key = NULL;
+        Series *destSeries = rule->level;
+        if (destSeries == NULL) {
+            key = RedisModule_OpenKey(ctx, rule->destKey, REDISMODULE_READ | REDISMODULE_WRITE);
+            if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
+                // key doesn't exist anymore and we don't do anything
+                return;
+            }
+            destSeries = RedisModule_ModuleTypeGetValue(key);
         }
-        Series *destSeries = RedisModule_ModuleTypeGetValue(key);
 
         double aggVal;
+        if (rule->aggClass->carriesSample) {
+            // the sample after the bucket
+            rule->aggClass->appendValue(rule->aggContext, value, timestamp);
+        }
         if (rule->aggClass->finalize(rule->aggContext, &aggVal) == TSDB_OK) {
             SeriesAddSample(destSeries, rule->startCurrentTimeBucket, aggVal);
         }
         rule->aggClass->resetContext(rule->aggContext);
         rule->startCurrentTimeBucket = currentTimestamp;
-        RedisModule_CloseKey(key);
+        if (rule->aggClass->setBucket != NULL) {
+            rule->aggClass->setBucket(
+                rule->aggContext, currentTimestamp, currentTimestamp + rule->timeBucket);
+        }
+        if (key != NULL) {
+            RedisModule_CloseKey(key);
+        }
     }
-    rule->aggClass->appendValue(rule->aggContext, value);
+    rule->aggClass->appendValue(rule->aggContext, value, timestamp);
 }
 
 static int internalAdd_without_reply(RedisModuleCtx *ctx,
@@ -449,6 +665,9 @@ static int internalAdd_without_reply(RedisModuleCtx *ctx,
             handleCompaction(ctx, series, rule, timestamp, value);
             rule = rule->nextRule;
         }
+        for (rule = series->levels; rule != NULL; rule = rule->nextRule) {
+            handleCompaction(ctx, series, rule, timestamp, value);
+        }
     }
     //RedisModule_ReplyWithLongLong(ctx, timestamp);
     return REDISMODULE_OK;
@@ -484,11 +703,55 @@ static int internalAdd(RedisModuleCtx *ctx,
             handleCompaction(ctx, series, rule, timestamp, value);
             rule = rule->nextRule;
         }
+        for (rule = series->levels; rule != NULL; rule = rule->nextRule) {
+            handleCompaction(ctx, series, rule, timestamp, value);
+        }
     }
     RedisModule_ReplyWithLongLong(ctx, timestamp);
     return REDISMODULE_OK;
 }
 
+/*
+ * TS.ADD key timestamp value [value ...] on a series created with FIELDS, one value per field.
+ * The first field goes through the regular path; the others share its timestamps and
+ * duplicate policy, so they accept the sample whenever it does.
+ */
+static int internalAddFields(RedisModuleCtx *ctx,
+                             Series *series,
+                             api_timestamp_t timestamp,
+                             RedisModuleString **argv,
+                             int argc,
+                             DuplicatePolicy dp_override) {
+    if (argc < 3 + (int)series->fieldsCount) {
+        return RTS_ReplyGeneralError(ctx, "TSDB: a value is required for every field");
+    }
+    double *values = malloc(sizeof(double) * series->fieldsCount);
+    for (size_t i = 0; i < series->fieldsCount; i++) {
+        const char *valueCStr = RedisModule_StringPtrLen(argv[3 + i], NULL);
+        if (fast_double_parser_c_parse_number(valueCStr, &values[i]) == NULL) {
+            free(values);
+            return RTS_ReplyGeneralError(ctx, "TSDB: invalid value");
+        }
+    }
+
+    if (internalAdd_without_reply(ctx, series, timestamp, values[0], dp_override) !=
+        REDISMODULE_OK) {
+        free(values);
+        return REDISMODULE_ERR;
+    }
+    for (size_t i = 1; i < series->fieldsCount; i++) {
+        Series *field = series->fields[i - 1];
+        if (timestamp <= field->lastTimestamp && field->totalSamples != 0) {
+            SeriesUpsertSample(field, timestamp, values[i], dp_override);
+        } else {
+            SeriesAddSample(field, timestamp, values[i]);
+        }
+    }
+    free(values);
+    RedisModule_ReplyWithLongLong(ctx, timestamp);
+    return REDISMODULE_OK;
+}
+
 static inline int add(RedisModuleCtx *ctx,
                       RedisModuleString *keyName,
                       RedisModuleString *timestampStr,
@@ -537,7 +800,17 @@ static inline int add(RedisModuleCtx *ctx,
             return REDISMODULE_ERR;
         }
     }
-    int rv = internalAdd(ctx, series, timestamp, value, dp);
+    if (series->fieldsCount > 0 && argv == NULL) {
+        // TS.MADD gives a single value per key, its keys are found at a fixed step
+        RedisModule_CloseKey(key);
+        return RTS_ReplyGeneralError(ctx, "TSDB: TS.MADD does not support keys with fields");
+    }
+    int rv;
+    if (series->fieldsCount > 0) {
+        rv = internalAddFields(ctx, series, timestamp, argv, argc, dp);
+    } else {
+        rv = internalAdd(ctx, series, timestamp, value, dp);
+    }
     RedisModule_CloseKey(key);
     return rv;
 }
@@ -644,7 +917,9 @@ int CreateTsKey(RedisModuleCtx *ctx,
         return TSDB_ERROR;
     }
 
-    IndexMetric(ctx, keyName, (*series)->labels, (*series)->labelsCount);
+    (*series)->db = RedisModule_GetSelectedDb(ctx);
+    SeriesRegistry_Add(*series);
+    IndexMetric(ctx, keyName, (*series)->id, (*series)->labels, (*series)->labelsCount);
 
     return TSDB_OK;
 }
@@ -670,7 +945,18 @@ int TSDB_create(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
         return RTS_ReplyGeneralError(ctx, "TSDB: key already exists");
     }
 
+    size_t fieldsCount;
+    RedisModuleString **fieldNames;
+    if (parseFieldsFromArgs(ctx, argv, argc, &fieldsCount, &fieldNames) != REDISMODULE_OK) {
+        FreeLabels(cCtx.labels, cCtx.labelsCount);
+        RedisModule_CloseKey(key);
+        return REDISMODULE_ERR;
+    }
+
     CreateTsKey(ctx, keyName, &cCtx, &series, &key);
+    if (fieldsCount > 0) {
+        SeriesSetFields(series, fieldNames, fieldsCount);
+    }
     RedisModule_CloseKey(key);
 
     RedisModule_Log(ctx, "verbose", "created new series");
@@ -718,14 +1004,47 @@ int TSDB_alter(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
         // set new newLabels
         series->labels = cCtx.labels;
         series->labelsCount = cCtx.labelsCount;
-        IndexMetric(ctx, keyName, series->labels, series->labelsCount);
+        IndexMetric(ctx, keyName, series->id, series->labels, series->labelsCount);
     }
+    SeriesSyncFields(series);
     RedisModule_ReplyWithSimpleString(ctx, "OK");
     RedisModule_ReplicateVerbatim(ctx);
     RedisModule_CloseKey(key);
     return REDISMODULE_OK;
 }
 
+/*
+TS.DEL key fromTimestamp toTimestamp
+ */
+int TSDB_delete(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 4) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    Series *series;
+    RedisModuleKey *key;
+    if (!GetSeries(ctx, argv[1], &key, &series, REDISMODULE_READ | REDISMODULE_WRITE)) {
+        return REDISMODULE_ERR;
+    }
+
+    api_timestamp_t start_ts, end_ts;
+    if (parseRangeArguments(ctx, series, 2, argv, &start_ts, &end_ts) != REDISMODULE_OK) {
+        RedisModule_CloseKey(key);
+        return REDISMODULE_ERR;
+    }
+
+    size_t deleted = 0;
+    if (start_ts <= end_ts) {
+        deleted = SeriesDelRange(ctx, series, start_ts, end_ts);
+    }
+    RedisModule_ReplyWithLongLong(ctx, deleted);
+    RedisModule_ReplicateVerbatim(ctx);
+    RedisModule_CloseKey(key);
+    return REDISMODULE_OK;
+}
+
 /*
 TS.DELETERULE SOURCE_KEY DEST_KEY
  */
@@ -808,6 +1127,9 @@ int TSDB_createRule(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     if (srcSeries->srcKey) {
         return RTS_ReplyGeneralError(ctx, "TSDB: the source key already has a source rule");
     }
+    if (srcSeries->fieldsCount > 0) {
+        return RTS_ReplyGeneralError(ctx, "TSDB: compaction rules are not supported with fields");
+    }
 
     // Second verify the destination doesn't have other rule
     Series *destSeries;
@@ -817,6 +1139,9 @@ int TSDB_createRule(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     if (!statusD) {
         return REDISMODULE_ERR;
     }
+    if (destSeries->fieldsCount > 0) {
+        return RTS_ReplyGeneralError(ctx, "TSDB: compaction rules are not supported with fields");
+    }
     srcKeyName = RedisModule_CreateStringFromString(ctx, srcKeyName);
     if (!SeriesSetSrcRule(destSeries, srcKeyName)) {
         return RTS_ReplyGeneralError(ctx, "TSDB: the destination key already has a rule");
@@ -863,6 +1188,9 @@ int TSDB_incrby(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     }
 
     series = RedisModule_ModuleTypeGetValue(key);
+    if (series->fieldsCount > 0) {
+        return RTS_ReplyGeneralError(ctx, "TSDB: TS.INCRBY/TS.DECRBY are not supported with fields");
+    }
 
     double incrby = 0;
     if (RMUtil_ParseArgs(argv, argc, 2, "d", &incrby) != REDISMODULE_OK) {
@@ -953,14 +1281,10 @@ int TSDB_mget(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     size_t currentKeyLen;
     long long replylen = 0;
     Series *series;
-    while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, NULL)) != NULL) {
-        RedisModuleKey *key;
-        const int status = SilentGetSeries(ctx,
-                                           RedisModule_CreateString(ctx, currentKey, currentKeyLen),
-                                           &key,
-                                           &series,
-                                           REDISMODULE_READ);
-        if (!status) {
+    void *seriesId;
+    while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, &seriesId)) != NULL) {
+        series = SeriesRegistry_Lookup(ctx, (uintptr_t)seriesId);
+        if (series == NULL) {
             RedisModule_Log(ctx,
                             "warning",
                             "couldn't open key or key is not a Timeseries. key=%.*s",
@@ -977,7 +1301,6 @@ int TSDB_mget(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
         }
         ReplyWithSeriesLastDatapoint(ctx, series);
         replylen++;
-        RedisModule_CloseKey(key);
     }
     RedisModule_ReplySetArrayLength(ctx, replylen);
     RedisModule_DictIteratorStop(iter);
@@ -2044,6 +2367,19 @@ int NotifyCallback(RedisModuleCtx *original_ctx,
 
     if (strcasecmp(event, "del") == 0) {
         CleanLastDeletedSeries(ctx, key);
+    } else if (strcasecmp(event, "rename_to") == 0 || strcasecmp(event, "move_to") == 0 ||
+               strcasecmp(event, "restore") == 0 || strcasecmp(event, "expire") == 0) {
+        // the original context has the db of the event selected
+        RedisModuleKey *seriesKey;
+        Series *series;
+        if (SilentGetSeries(original_ctx, key, &seriesKey, &series, REDISMODULE_READ)) {
+            if (strcasecmp(event, "expire") == 0) {
+                SeriesRegistry_Invalidate(series);
+            } else {
+                SeriesRelink(original_ctx, series, key);
+            }
+            RedisModule_CloseKey(seriesKey);
+        }
     }
 
     RedisModule_FreeThreadSafeContext(ctx);
@@ -2061,11 +2397,49 @@ void module_loaded(RedisModuleCtx *ctx, RedisModuleEvent eid, uint64_t subevent,
     }
 }
 
+static void unlinkSeriesCallback(RedisModuleCtx *ctx,
+                                 RedisModuleString *keyname,
+                                 RedisModuleKey *key,
+                                 void *privdata) {
+    if (key == NULL || RedisModule_ModuleTypeGetType(key) != SeriesType) {
+        return;
+    }
+    SeriesUnlink(keyname, RedisModule_ModuleTypeGetValue(key));
+}
+
+// A threaded flush frees the whole keyspace on the lazyfree thread without unlinking each key,
+// so the index and the memory counters are detached here while we still hold the GIL.
+void flushdb_callback(RedisModuleCtx *ctx, RedisModuleEvent eid, uint64_t subevent, void *data) {
+    RedisModuleFlushInfo *flushInfo = (RedisModuleFlushInfo *)data;
+    if (subevent != REDISMODULE_SUBEVENT_FLUSHDB_START || flushInfo->sync) {
+        return;
+    }
+    const int selectedDb = RedisModule_GetSelectedDb(ctx);
+    int db = flushInfo->dbnum == -1 ? 0 : flushInfo->dbnum;
+    while (RedisModule_SelectDb(ctx, db) == REDISMODULE_OK) {
+        RedisModuleScanCursor *cursor = RedisModule_ScanCursorCreate();
+        while (RedisModule_Scan(ctx, cursor, unlinkSeriesCallback, NULL))
+            ;
+        RedisModule_ScanCursorDestroy(cursor);
+        if (flushInfo->dbnum != -1) {
+            break;
+        }
+        db++;
+    }
+    RedisModule_SelectDb(ctx, selectedDb);
+}
+
+void swapdb_callback(RedisModuleCtx *ctx, RedisModuleEvent eid, uint64_t subevent, void *data) {
+    RedisModuleSwapDbInfo *swapInfo = (RedisModuleSwapDbInfo *)data;
+    SeriesRegistry_SwapDb(swapInfo->dbnum_first, swapInfo->dbnum_second);
+}
+
 /*
 module loading function, possible arguments:
 /*
 module loading function, possible arguments:
 COMPACTION_POLICY - compaction policy from parse_policies,h
+COMPACTION_STORAGE - KEYS or EMBEDDED, where the COMPACTION_POLICY series are stored
 RETENTION_POLICY - long that represents the retention in milliseconds
 MAX_SAMPLE_PER_CHUNK - how many samples per chunk
 example:
@@ -2117,6 +2491,8 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
         return REDISMODULE_ERR;
     }
 
+    SeriesInitMainThread();
+
     // ignore errors from redis gears registration, this can fail if the module is not loaded.
     register_rg(ctx);
 
@@ -2125,16 +2501,25 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
                                   .rdb_save = series_rdb_save,
                                   .aof_rewrite = RMUtil_DefaultAofRewrite,
                                   .mem_usage = SeriesMemUsage,
-                                  .free = FreeSeries };
+                                  .free = FreeSeries,
+                                  .free_effort = SeriesFreeEffort,
+                                  .unlink = SeriesUnlink,
+                                  .defrag = DefragSeries };
 
-    SeriesType = RedisModule_CreateDataType(ctx, "TSDB-TYPE", TS_SIZE_RDB_VER, &tm);
+    SeriesType = RedisModule_CreateDataType(ctx, "TSDB-TYPE", TS_LEVELS_RDB_VER, &tm);
     if (SeriesType == NULL)
         return REDISMODULE_ERR;
+    // servers before 6.0 have no module INFO sections
+    if (RedisModule_RegisterInfoFunc != NULL) {
+        RedisModule_RegisterInfoFunc(ctx, TSDB_infoFunc);
+    }
     IndexInit();
+    SeriesRegistry_Init();
     RMUtil_RegisterWriteDenyOOMCmd(ctx, "ts.create", TSDB_create);
     RMUtil_RegisterWriteDenyOOMCmd(ctx, "ts.alter", TSDB_alter);
     RMUtil_RegisterWriteDenyOOMCmd(ctx, "ts.createrule", TSDB_createRule);
     RMUtil_RegisterWriteCmd(ctx, "ts.deleterule", TSDB_deleteRule);
+    RMUtil_RegisterWriteCmd(ctx, "ts.del", TSDB_delete);
     RMUtil_RegisterWriteDenyOOMCmd(ctx, "ts.add", TSDB_add);
     RMUtil_RegisterWriteDenyOOMCmd(ctx, "ts.incrby", TSDB_incrby);
     RMUtil_RegisterWriteDenyOOMCmd(ctx, "ts.decrby", TSDB_incrby);
@@ -2147,6 +2532,10 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
 
     RMUtil_RegisterReadCmd(ctx, "ts.info", TSDB_info);
 
+    if (RedisModule_CreateCommand(ctx, "ts.memstats", TSDB_memstats, "readonly", 0, 0, 0) ==
+        REDISMODULE_ERR)
+        return REDISMODULE_ERR;
+
     if(RedisModule_CreateCommand(ctx, "ts.load", TSDB_load, "write deny-oom", 1, -1, 3) == REDISMODULE_ERR)
         return REDISMODULE_ERR;
     
@@ -2196,6 +2585,13 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
     RedisModule_SubscribeToKeyspaceEvents(ctx, REDISMODULE_NOTIFY_GENERIC, NotifyCallback);
 
     RedisModule_SubscribeToServerEvent(ctx, RedisModuleEvent_ModuleChange, module_loaded);
+    RedisModule_SubscribeToServerEvent(ctx, RedisModuleEvent_FlushDB, flushdb_callback);
+    RedisModule_SubscribeToServerEvent(ctx, RedisModuleEvent_SwapDB, swapdb_callback);
+    ChunkMerger_Start(ctx, TSGlobalConfig.chunkMergeInterval);
+    if (ThreadPool_Init(TSGlobalConfig.queryThreads) != TSDB_OK) {
+        RedisModule_Log(ctx, "warning", "Failed to start the query threads");
+        return REDISMODULE_ERR;
+    }
 
     return REDISMODULE_OK;
 }
@@ -0,0 +1,339 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "parallel_mrange.h"
+
+#include "config.h"
+#include "indexer.h"
+#include "reply.h"
+#include "resultset.h"
+#include "series_iterator.h"
+#include "series_registry.h"
+#include "series_snapshot.h"
+#include "thread_pool.h"
+
+#include <string.h>
+#include <rmutil/alloc.h>
+
+// A matched series, queried by one pool thread
+typedef struct MRangeSeries
+{
+    // a snapshot of the pinned chunks, with copies of the key name and of the labels replied
+    Series series;
+    Chunk_t **chunks;
+    size_t chunksCount;
+    api_timestamp_t start; // after the retention of the series
+    SeriesRows rows;
+} MRangeSeries;
+
+typedef struct ParallelMRange
+{
+    RedisModuleBlockedClient *bc;
+    api_timestamp_t start;
+    api_timestamp_t end;
+    bool reverse;
+    SeriesFilter filter; // owns its timestamps
+    AggregationArgs aggregation;
+    bool withLabels;
+    long long count;
+    char *groupByLabel; // NULL when not grouped
+    MultiSeriesReduceOp reducerOp;
+    MRangeSeries *series; // in key order
+    size_t seriesCount;
+    size_t next;    // the next series to be taken by a pool thread
+    size_t pending; // jobs still running, the last one to finish unblocks the client
+    // without a pool, the series queried on the main thread when the previous slice ended
+    SeriesIterator iterator;
+    bool iterating;
+} ParallelMRange;
+
+static bool openSeries(const ParallelMRange *query, MRangeSeries *s, SeriesIterator *iter) {
+    return s->chunksCount > 0 && SeriesQueryAggregations(&s->series,
+                                                         iter,
+                                                         s->start,
+                                                         query->end,
+                                                         query->reverse,
+                                                         &query->filter,
+                                                         &query->aggregation) == TSDB_OK;
+}
+
+// Appends up to `budget` rows of the series, false once it has none left
+static bool queryRows(const ParallelMRange *query,
+                      MRangeSeries *s,
+                      SeriesIterator *iter,
+                      size_t budget) {
+    // a grouped query applies COUNT to the reduced series only
+    const long long limit = query->groupByLabel != NULL ? -1 : query->count;
+    timestamp_t timestamp;
+    double values[TS_AGG_TYPES_MAX];
+    for (; budget > 0; budget--) {
+        if ((limit != -1 && s->rows.count >= (size_t)limit) ||
+            SeriesIteratorGetNextValues(iter, &timestamp, values) != CR_OK) {
+            return false;
+        }
+        double *row = SeriesRowsAppend(&s->rows, timestamp);
+        memcpy(row, values, s->rows.valuesCount * sizeof(double));
+    }
+    return true;
+}
+
+static void querySeries(const ParallelMRange *query, MRangeSeries *s) {
+    SeriesIterator iter;
+    if (openSeries(query, s, &iter)) {
+        queryRows(query, s, &iter, SIZE_MAX);
+        SeriesIteratorClose(&iter);
+    }
+}
+
+/*
+ * Queries the series on the main thread until MAX_EXEC_SLICE_MS is spent, the series left and the
+ * iterator of the current one are kept for the next slice. True once every series is done.
+ */
+static bool runSlice(ParallelMRange *query) {
+    const mstime_t deadline = RedisModule_Milliseconds() + TSGlobalConfig.maxExecSliceMs;
+    while (query->next < query->seriesCount) {
+        MRangeSeries *s = &query->series[query->next];
+        if (!query->iterating && !openSeries(query, s, &query->iterator)) {
+            query->next++;
+            continue;
+        }
+        query->iterating = true;
+        if (!queryRows(query, s, &query->iterator, EXEC_SLICE_CHECK_ROWS)) {
+            SeriesIteratorClose(&query->iterator);
+            query->iterating = false;
+            query->next++;
+        }
+        if (RedisModule_Milliseconds() >= deadline) {
+            break;
+        }
+    }
+    return query->next == query->seriesCount;
+}
+
+static void runJob(void *arg) {
+    ParallelMRange *query = arg;
+    size_t i;
+    while ((i = __atomic_fetch_add(&query->next, 1, __ATOMIC_RELAXED)) < query->seriesCount) {
+        querySeries(query, &query->series[i]);
+    }
+    if (__atomic_sub_fetch(&query->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+        RedisModule_UnblockClient(query->bc, query);
+    }
+}
+
+static void freeSeries(MRangeSeries *s) {
+    SeriesSnapshotFree(&s->series);
+    SeriesReleaseChunks(s->series.funcs, s->chunks, s->chunksCount);
+    RedisModule_FreeString(NULL, s->series.keyName);
+    if (s->series.labels != NULL) {
+        FreeLabels(s->series.labels, s->series.labelsCount);
+    }
+    SeriesRowsFree(&s->rows);
+}
+
+static void freeMRange(ParallelMRange *query) {
+    if (query->iterating) {
+        SeriesIteratorClose(&query->iterator);
+    }
+    for (size_t i = 0; i < query->seriesCount; i++) {
+        freeSeries(&query->series[i]);
+    }
+    free(query->series);
+    free(query->filter.timestamps);
+    free(query->groupByLabel);
+    free(query);
+}
+
+static void freeMRangePrivdata(RedisModuleCtx *ctx, void *privdata) {
+    freeMRange(privdata);
+}
+
+static void replyGroupedMRange(RedisModuleCtx *ctx, ParallelMRange *query) {
+    TS_ResultSet *resultset = ResultSet_Create();
+    ResultSet_GroupbyLabel(resultset, query->groupByLabel);
+    for (size_t i = 0; i < query->seriesCount; i++) {
+        MRangeSeries *s = &query->series[i];
+        ResultSet_AddSerieRows(resultset,
+                               &s->series,
+                               RedisModule_StringPtrLen(s->series.keyName, NULL),
+                               &s->rows);
+    }
+    ResultSet_ReplyReduced(ctx,
+                           resultset,
+                           query->withLabels,
+                           query->start,
+                           query->end,
+                           &query->filter,
+                           &query->aggregation,
+                           query->count,
+                           query->reverse,
+                           query->reducerOp);
+    ResultSet_Free(resultset);
+}
+
+static void replyQuery(RedisModuleCtx *ctx, ParallelMRange *query) {
+    if (query->groupByLabel != NULL) {
+        replyGroupedMRange(ctx, query);
+        return;
+    }
+
+    RedisModule_ReplyWithArray(ctx, query->seriesCount);
+    for (size_t i = 0; i < query->seriesCount; i++) {
+        const MRangeSeries *s = &query->series[i];
+        RedisModule_ReplyWithArray(ctx, 3);
+        RedisModule_ReplyWithString(ctx, s->series.keyName);
+        if (query->withLabels) {
+            ReplyWithSeriesLabels(ctx, &s->series);
+        } else {
+            RedisModule_ReplyWithArray(ctx, 0);
+        }
+        RedisModule_ReplyWithArray(ctx, s->rows.count);
+        for (size_t row = 0; row < s->rows.count; row++) {
+            ReplyWithRow(ctx,
+                         s->rows.timestamps[row],
+                         &s->rows.values[row * s->rows.valuesCount],
+                         s->rows.valuesCount);
+        }
+    }
+}
+
+// Runs on the main thread once every series of the query is done
+static int replyMRange(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    replyQuery(ctx, RedisModule_GetBlockedClientPrivateData(ctx));
+    return REDISMODULE_OK;
+}
+
+// The next slice of a query, events are processed between two slices
+static void resumeSlice(RedisModuleCtx *ctx, void *data) {
+    ParallelMRange *query = data;
+    if (runSlice(query)) {
+        RedisModule_UnblockClient(query->bc, query);
+    } else {
+        RedisModule_CreateTimer(ctx, 0, resumeSlice, query);
+    }
+}
+
+// Aggregations reading the samples around the range and EMPTY see the whole series
+static bool readsOutsideRange(const AggregationArgs *aggregation) {
+    if (aggregation->count > 0 && aggregation->empty) {
+        return true;
+    }
+    for (size_t i = 0; i < aggregation->count; i++) {
+        if (aggregation->classes[i]->carriesSample) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Pins the series for the query, false when the query cannot run on the pool
+static bool addSeries(ParallelMRange *query, Series *series, bool wholeSeries) {
+    if (series->fieldsCount > 0) {
+        return false;
+    }
+    MRangeSeries *s = &query->series[query->seriesCount++];
+    s->start = query->start;
+    s->chunks = NULL;
+    s->chunksCount = 0;
+    // retention is applied to the series replied one by one only, like on the main thread
+    if (query->groupByLabel != NULL || ApplyRetention(series, &s->start, query->end)) {
+        s->chunks = wholeSeries ? SeriesPinChunks(series, 0, UINT64_MAX, &s->chunksCount)
+                                : SeriesPinChunks(series, s->start, query->end, &s->chunksCount);
+    }
+    s->series = SeriesSnapshot(series->funcs, s->chunks, s->chunksCount);
+    s->series.keyName = RedisModule_CreateStringFromString(NULL, series->keyName);
+    // GROUPBY reads the labels when the series are grouped, on the main thread
+    if (query->withLabels || query->groupByLabel != NULL) {
+        s->series.labelsCount = series->labelsCount;
+        s->series.labels = malloc(series->labelsCount * sizeof(Label));
+        for (size_t i = 0; i < series->labelsCount; i++) {
+            Label *label = &s->series.labels[i];
+            label->key = RedisModule_CreateStringFromString(NULL, series->labels[i].key);
+            label->value = RedisModule_CreateStringFromString(NULL, series->labels[i].value);
+        }
+    }
+    s->rows = (SeriesRows){ .valuesCount = max(query->aggregation.count, 1) };
+    return true;
+}
+
+static ParallelMRange *createMRange(const MRangeArgs *args, size_t seriesCapacity) {
+    ParallelMRange *query = calloc(1, sizeof(ParallelMRange));
+    query->start = args->startTimestamp;
+    query->end = args->endTimestamp;
+    query->reverse = args->reverse;
+    query->filter = args->filter;
+    if (args->filter.timestampsCount > 0) {
+        query->filter.timestamps = malloc(args->filter.timestampsCount * sizeof(timestamp_t));
+        memcpy(query->filter.timestamps,
+               args->filter.timestamps,
+               args->filter.timestampsCount * sizeof(timestamp_t));
+    } else {
+        query->filter.timestamps = NULL;
+    }
+    query->aggregation = args->aggregationArgs;
+    query->withLabels = args->withLabels;
+    query->count = args->count;
+    query->groupByLabel = args->groupByLabel != NULL ? strdup(args->groupByLabel) : NULL;
+    query->reducerOp = args->gropuByReducerOp;
+    query->series = calloc(seriesCapacity, sizeof(MRangeSeries));
+    return query;
+}
+
+bool ParallelMRange_Reply(RedisModuleCtx *ctx, RedisModuleDict *result, const MRangeArgs *args) {
+    const int denyBlocking = REDISMODULE_CTX_FLAGS_MULTI | REDISMODULE_CTX_FLAGS_LUA |
+                             REDISMODULE_CTX_FLAGS_DENY_BLOCKING;
+    const size_t matched = RedisModule_DictSize(result);
+    const bool pooled = ThreadPool_Size() > 0;
+    if ((pooled ? matched < 2 : TSGlobalConfig.maxExecSliceMs == 0 || matched == 0) ||
+        (RedisModule_GetContextFlags(ctx) & denyBlocking)) {
+        return false;
+    }
+    // the rows keep the finalized values only, a percentile reducer merges the bucket sketches
+    if (args->groupByLabel != NULL &&
+        MultiSeriesReduceOpAggType(args->gropuByReducerOp) != TS_AGG_NONE) {
+        return false;
+    }
+
+    ParallelMRange *query = createMRange(args, matched);
+    const bool wholeSeries = readsOutsideRange(&args->aggregationArgs);
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(result, "^", NULL, 0);
+    void *seriesId;
+    while (RedisModule_DictNextC(iter, NULL, &seriesId) != NULL) {
+        Series *series = SeriesRegistry_Lookup(ctx, (uintptr_t)seriesId);
+        if (series == NULL) {
+            continue;
+        }
+        if (!addSeries(query, series, wholeSeries)) {
+            RedisModule_DictIteratorStop(iter);
+            freeMRange(query);
+            return false;
+        }
+    }
+    RedisModule_DictIteratorStop(iter);
+
+    if (!pooled) {
+        // the first slice runs right away, the client is blocked only if there is more to do
+        if (runSlice(query)) {
+            replyQuery(ctx, query);
+            freeMRange(query);
+            return true;
+        }
+        query->bc = RedisModule_BlockClient(ctx, replyMRange, NULL, freeMRangePrivdata, 0);
+        RedisModule_CreateTimer(ctx, 0, resumeSlice, query);
+        return true;
+    }
+
+    size_t jobs = min(ThreadPool_MaxTasks(TSGlobalConfig.queryFanout), query->seriesCount);
+    if (jobs == 0) {
+        freeMRange(query);
+        return false;
+    }
+    query->pending = jobs;
+    query->bc = RedisModule_BlockClient(ctx, replyMRange, NULL, freeMRangePrivdata, 0);
+    for (size_t i = 0; i < jobs; i++) {
+        ThreadPool_Push(runJob, query);
+    }
+    return true;
+}
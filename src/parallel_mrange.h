@@ -0,0 +1,32 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#ifndef PARALLEL_MRANGE_H
+#define PARALLEL_MRANGE_H
+
+#include "query_language.h"
+#include "redismodule.h"
+
+#include <stdbool.h>
+
+/*
+ * The series matched by TS.MRANGE and TS.MREVRANGE are queried on the thread pool while the client
+ * is blocked. The main thread looks the series up and pins the chunks of their ranges (see
+ * RetainChunk), the pool threads take the series one at a time and decode and aggregate them into
+ * rows, and the reply is put together from the rows on the main thread once the client is
+ * unblocked. GROUPBY reduces the rows there as well.
+ *
+ * Without a pool, MAX_EXEC_SLICE_MS bounds the time the main thread spends on the query at once:
+ * the series are queried into rows in slices, the client is blocked after the first one and the
+ * next slices run from a timer, so that the events waiting meanwhile are processed in between.
+ */
+
+// Replies like TSDB_generic_mrange from the thread pool, or in slices on the main thread. Returns
+// false without replying when the query is better run at once: without a pool or
+// MAX_EXEC_SLICE_MS, when the client cannot be blocked, for fewer than two series on the pool, or
+// when a series has fields.
+bool ParallelMRange_Reply(RedisModuleCtx *ctx, RedisModuleDict *result, const MRangeArgs *args);
+
+#endif
@@ -0,0 +1,303 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "parallel_range.h"
+
+#include "config.h"
+#include "reply.h"
+#include "series_iterator.h"
+#include "series_snapshot.h"
+#include "thread_pool.h"
+
+#include <math.h>
+#include <string.h>
+#include <rmutil/alloc.h>
+
+struct ParallelRange;
+
+// A group of contiguous chunks, aggregated by one pool thread
+typedef struct RangeTask
+{
+    struct ParallelRange *range;
+    // a snapshot of the chunks of the task
+    Series series;
+    // the buckets closed inside the task, or its samples without aggregation
+    SeriesRows rows;
+    // the first and last buckets of the task in query order, which may go on in the tasks around
+    bool hasFirst;
+    timestamp_t firstBucket;
+    void *first[TS_AGG_TYPES_MAX];
+    bool hasLast;
+    timestamp_t lastBucket;
+    void *last[TS_AGG_TYPES_MAX];
+} RangeTask;
+
+typedef struct ParallelRange
+{
+    RedisModuleBlockedClient *bc;
+    api_timestamp_t start;
+    api_timestamp_t end;
+    bool reverse;
+    SeriesFilter filter; // owns its timestamps
+    AggregationArgs aggregation;
+    size_t valuesCount;
+    ChunkFuncs *funcs;
+    Chunk_t **chunks; // pinned, in time order
+    size_t chunksCount;
+    RangeTask *tasks; // in query order
+    size_t tasksCount;
+    size_t pending; // tasks still running, the last one to finish replies
+} ParallelRange;
+
+static void createContexts(const AggregationArgs *aggregation, void **contexts) {
+    for (size_t i = 0; i < aggregation->count; i++) {
+        contexts[i] = aggregation->classes[i]->createContext();
+    }
+}
+
+static void freeContexts(const AggregationArgs *aggregation, void **contexts) {
+    for (size_t i = 0; i < aggregation->count; i++) {
+        aggregation->classes[i]->freeContext(contexts[i]);
+    }
+}
+
+// False when the first aggregation has no value for the bucket, the others give NaN
+static bool finalizeContexts(const AggregationArgs *aggregation, void **contexts, double *values) {
+    for (size_t i = 0; i < aggregation->count; i++) {
+        if (aggregation->classes[i]->finalize(contexts[i], &values[i]) != TSDB_OK) {
+            if (i == 0) {
+                return false;
+            }
+            values[i] = NAN;
+        }
+    }
+    return true;
+}
+
+// Closes a bucket of the task, the first one is kept unfinalized for the task before it
+static void closeBucket(RangeTask *task, timestamp_t bucket, void **contexts) {
+    const AggregationArgs *aggregation = &task->range->aggregation;
+    if (!task->hasFirst) {
+        task->hasFirst = true;
+        task->firstBucket = bucket;
+        memcpy(task->first, contexts, aggregation->count * sizeof(void *));
+        createContexts(aggregation, contexts);
+        return;
+    }
+    double values[TS_AGG_TYPES_MAX];
+    if (finalizeContexts(aggregation, contexts, values)) {
+        memcpy(SeriesRowsAppend(&task->rows, bucket), values, aggregation->count * sizeof(double));
+    }
+    for (size_t i = 0; i < aggregation->count; i++) {
+        aggregation->classes[i]->resetContext(contexts[i]);
+    }
+}
+
+static void aggregateTask(RangeTask *task, SeriesIterator *iter) {
+    const AggregationArgs *aggregation = &task->range->aggregation;
+    void *contexts[TS_AGG_TYPES_MAX];
+    createContexts(aggregation, contexts);
+    bool open = false;
+    timestamp_t bucket = 0;
+    Sample sample;
+    while (SeriesIteratorGetNext(iter, &sample) == CR_OK) {
+        timestamp_t sampleBucket = sample.timestamp - (sample.timestamp % aggregation->timeDelta);
+        if (open && sampleBucket != bucket) {
+            closeBucket(task, bucket, contexts);
+        }
+        open = true;
+        bucket = sampleBucket;
+        for (size_t i = 0; i < aggregation->count; i++) {
+            aggregation->classes[i]->appendValue(contexts[i], sample.value, sample.timestamp);
+        }
+    }
+    if (open && !task->hasFirst) {
+        task->hasFirst = true;
+        task->firstBucket = bucket;
+        memcpy(task->first, contexts, aggregation->count * sizeof(void *));
+    } else if (open) {
+        task->hasLast = true;
+        task->lastBucket = bucket;
+        memcpy(task->last, contexts, aggregation->count * sizeof(void *));
+    } else {
+        freeContexts(aggregation, contexts);
+    }
+}
+
+static void freeRange(ParallelRange *range) {
+    for (size_t i = 0; i < range->tasksCount; i++) {
+        RangeTask *task = &range->tasks[i];
+        if (task->hasFirst) {
+            freeContexts(&range->aggregation, task->first);
+        }
+        if (task->hasLast) {
+            freeContexts(&range->aggregation, task->last);
+        }
+        SeriesRowsFree(&task->rows);
+        SeriesSnapshotFree(&task->series);
+    }
+    SeriesReleaseChunks(range->funcs, range->chunks, range->chunksCount);
+    free(range->tasks);
+    free(range->filter.timestamps);
+    free(range);
+}
+
+// Replies with the bucket merged from the tasks it spans, if any
+static long long replyPending(RedisModuleCtx *ctx,
+                              const ParallelRange *range,
+                              void **pending,
+                              timestamp_t bucket) {
+    double values[TS_AGG_TYPES_MAX];
+    if (pending == NULL || !finalizeContexts(&range->aggregation, pending, values)) {
+        return 0;
+    }
+    ReplyWithRow(ctx, bucket, values, range->valuesCount);
+    return 1;
+}
+
+// Runs on the thread of the last task, every other task is done with the range
+static void replyRange(ParallelRange *range) {
+    RedisModuleCtx *ctx = RedisModule_GetThreadSafeContext(range->bc);
+    long long arraylen = 0;
+    void **pending = NULL;
+    timestamp_t pendingBucket = 0;
+
+    RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+    for (size_t i = 0; i < range->tasksCount; i++) {
+        RangeTask *task = &range->tasks[i];
+        if (task->hasFirst) {
+            if (pending != NULL && pendingBucket == task->firstBucket) {
+                for (size_t j = 0; j < range->aggregation.count; j++) {
+                    range->aggregation.classes[j]->mergeContext(pending[j], task->first[j]);
+                }
+            } else {
+                arraylen += replyPending(ctx, range, pending, pendingBucket);
+                pending = task->first;
+                pendingBucket = task->firstBucket;
+            }
+        }
+        if (task->rows.count > 0 || task->hasLast) {
+            arraylen += replyPending(ctx, range, pending, pendingBucket);
+            pending = NULL;
+        }
+        for (size_t row = 0; row < task->rows.count; row++) {
+            ReplyWithRow(ctx,
+                         task->rows.timestamps[row],
+                         &task->rows.values[row * range->valuesCount],
+                         range->valuesCount);
+        }
+        arraylen += task->rows.count;
+        if (task->hasLast) {
+            pending = task->last;
+            pendingBucket = task->lastBucket;
+        }
+    }
+    arraylen += replyPending(ctx, range, pending, pendingBucket);
+    RedisModule_ReplySetArrayLength(ctx, arraylen);
+
+    RedisModule_FreeThreadSafeContext(ctx);
+    RedisModule_UnblockClient(range->bc, NULL);
+    freeRange(range);
+}
+
+static void runTask(void *arg) {
+    RangeTask *task = arg;
+    ParallelRange *range = task->range;
+
+    SeriesIterator iter;
+    SeriesQueryAggregations(
+        &task->series, &iter, range->start, range->end, range->reverse, &range->filter, NULL);
+    if (range->aggregation.count > 0) {
+        aggregateTask(task, &iter);
+    } else {
+        Sample sample;
+        while (SeriesIteratorGetNext(&iter, &sample) == CR_OK) {
+            *SeriesRowsAppend(&task->rows, sample.timestamp) = sample.value;
+        }
+    }
+    SeriesIteratorClose(&iter);
+
+    if (__atomic_sub_fetch(&range->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+        replyRange(range);
+    }
+}
+
+static bool canSplit(RedisModuleCtx *ctx,
+                     const Series *series,
+                     const AggregationArgs *aggregation) {
+    const int denyBlocking = REDISMODULE_CTX_FLAGS_MULTI | REDISMODULE_CTX_FLAGS_LUA |
+                             REDISMODULE_CTX_FLAGS_DENY_BLOCKING;
+    if (ThreadPool_Size() == 0 || series->fieldsCount > 0 ||
+        (RedisModule_GetContextFlags(ctx) & denyBlocking)) {
+        return false;
+    }
+    if (aggregation->empty) {
+        return false;
+    }
+    for (size_t i = 0; i < aggregation->count; i++) {
+        if (aggregation->classes[i]->mergeContext == NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParallelRange_Reply(RedisModuleCtx *ctx,
+                         Series *series,
+                         api_timestamp_t start_ts,
+                         api_timestamp_t end_ts,
+                         const SeriesFilter *filter,
+                         const AggregationArgs *aggregation,
+                         bool rev) {
+    if (!canSplit(ctx, series, aggregation) || !ApplyRetention(series, &start_ts, end_ts)) {
+        return false;
+    }
+    size_t chunksCount;
+    Chunk_t **chunks = SeriesPinChunks(series, start_ts, end_ts, &chunksCount);
+    size_t tasksCount = min(ThreadPool_MaxTasks(TSGlobalConfig.queryFanout),
+                            chunksCount / PARALLEL_RANGE_TASK_CHUNKS);
+    if (tasksCount < 2) {
+        SeriesReleaseChunks(series->funcs, chunks, chunksCount);
+        return false;
+    }
+
+    ParallelRange *range = malloc(sizeof(ParallelRange));
+    range->start = start_ts;
+    range->end = end_ts;
+    range->reverse = rev;
+    range->filter = *filter;
+    if (filter->timestampsCount > 0) {
+        range->filter.timestamps = malloc(filter->timestampsCount * sizeof(timestamp_t));
+        memcpy(range->filter.timestamps,
+               filter->timestamps,
+               filter->timestampsCount * sizeof(timestamp_t));
+    } else {
+        range->filter.timestamps = NULL;
+    }
+    range->aggregation = *aggregation;
+    range->valuesCount = max(aggregation->count, 1);
+    range->funcs = series->funcs;
+    range->chunks = chunks;
+    range->chunksCount = chunksCount;
+    range->tasks = calloc(tasksCount, sizeof(RangeTask));
+    range->tasksCount = tasksCount;
+    range->pending = tasksCount;
+    for (size_t i = 0; i < tasksCount; i++) {
+        // the chunks are split evenly, the tasks are kept in query order
+        size_t group = rev ? tasksCount - 1 - i : i;
+        RangeTask *task = &range->tasks[i];
+        size_t from = chunksCount * group / tasksCount;
+        size_t to = chunksCount * (group + 1) / tasksCount;
+        task->range = range;
+        task->series = SeriesSnapshot(range->funcs, &range->chunks[from], to - from);
+        task->rows.valuesCount = range->valuesCount;
+    }
+
+    range->bc = RedisModule_BlockClient(ctx, NULL, NULL, NULL, 0);
+    for (size_t i = 0; i < tasksCount; i++) {
+        ThreadPool_Push(runTask, &range->tasks[i]);
+    }
+    return true;
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#ifndef PARALLEL_RANGE_H
+#define PARALLEL_RANGE_H
+
+#include "compaction.h"
+#include "consts.h"
+#include "redismodule.h"
+#include "tsdb.h"
+
+#include <stdbool.h>
+
+/*
+ * A long range of a single series is split into groups of contiguous chunks, decoded and
+ * aggregated on the thread pool while the client is blocked. The chunks of the range are pinned
+ * (see RetainChunk) so writers copy them instead of changing them under the workers. The buckets
+ * at the edges of a group are kept as aggregation contexts and merged with those of the next
+ * group, the last task to finish replies in query order.
+ */
+
+// Replies like ReplySeriesRange without a COUNT, from the thread pool. Returns false without
+// replying when the range is short or the query cannot be split: without a pool, when the client
+// cannot be blocked, for a series with fields, with EMPTY or FILL, or with an aggregation whose
+// contexts cannot be merged.
+bool ParallelRange_Reply(RedisModuleCtx *ctx,
+                         Series *series,
+                         api_timestamp_t start_ts,
+                         api_timestamp_t end_ts,
+                         const SeriesFilter *filter,
+                         const AggregationArgs *aggregation,
+                         bool rev);
+
+#endif
@@ -71,6 +71,23 @@ static int parse_interval_policy(char *policy, SimpleCompactionRule *rule) {
     return TRUE;
 }
 
+int ParseCompactionLevel(const char *level, int *aggType, uint64_t *timeBucket) {
+    const char *sep = strchr(level, ':');
+    if (sep == NULL || sep == level || (size_t)(sep - level) >= 20) {
+        return FALSE;
+    }
+    char agg_type[20];
+    memcpy(agg_type, level, sep - level);
+    agg_type[sep - level] = '\0';
+    int agg_type_index = StringAggTypeToEnum(agg_type);
+    if (agg_type_index == TS_AGG_INVALID ||
+        parse_string_to_millisecs(sep + 1, timeBucket) == FALSE || *timeBucket == 0) {
+        return FALSE;
+    }
+    *aggType = agg_type_index;
+    return TRUE;
+}
+
 static size_t count_char_in_str(const char *string, size_t len, char lookup) {
     size_t count = 0;
     for (size_t i = 0; i < len; i++) {
@@ -18,6 +18,8 @@ typedef struct SimpleCompactionRule
     int aggType;
 } SimpleCompactionRule;
 
+// parses a single level in the "AGGREGATION_FUNCTION:\d[s|m|M|h|d]" format, e.g. "avg:1h"
+int ParseCompactionLevel(const char *level, int *aggType, uint64_t *timeBucket);
 int ParseCompactionPolicy(const char *policy_string,
                           SimpleCompactionRule **parsed_rules,
                           uint64_t *count_rules);
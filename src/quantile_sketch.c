@@ -0,0 +1,235 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "quantile_sketch.h"
+
+#include <math.h>
+#include <string.h>
+#include <rmutil/alloc.h>
+
+#define QUANTILE_SKETCH_GAMMA ((1 + QUANTILE_SKETCH_ACCURACY) / (1 - QUANTILE_SKETCH_ACCURACY))
+
+// The bin with key k holds the values in (gamma^(k-1), gamma^k]
+static inline int32_t valueKey(double value) {
+    return (int32_t)ceil(log(value) / log(QUANTILE_SKETCH_GAMMA));
+}
+
+// The value of a bin, within QUANTILE_SKETCH_ACCURACY of every value it holds
+static inline double keyValue(int32_t key) {
+    return 2 * exp(key * log(QUANTILE_SKETCH_GAMMA)) / (QUANTILE_SKETCH_GAMMA + 1);
+}
+
+static void storeReset(QuantileSketchStore *store) {
+    store->count = 0;
+    store->offset = 0;
+    store->minKey = 0;
+    store->maxKey = 0;
+    memset(store->bins, 0, sizeof(store->bins));
+}
+
+// Moves the window of bins to start at `offset`, the bins below it are collapsed into the first one.
+// The caller makes sure no bin is left above the window.
+static void storeRebase(QuantileSketchStore *store, int32_t offset) {
+    int64_t shift = (int64_t)offset - store->offset;
+    uint32_t *bins = store->bins;
+    if (shift > 0) {
+        uint32_t collapsed = 0;
+        for (int64_t i = 0; i < shift && i < QUANTILE_SKETCH_BINS; i++) {
+            collapsed += bins[i];
+        }
+        if (shift < QUANTILE_SKETCH_BINS) {
+            memmove(bins, bins + shift, (QUANTILE_SKETCH_BINS - shift) * sizeof(*bins));
+            memset(bins + QUANTILE_SKETCH_BINS - shift, 0, shift * sizeof(*bins));
+        } else {
+            memset(bins, 0, sizeof(store->bins));
+        }
+        bins[0] += collapsed;
+        if (store->minKey < offset) {
+            store->minKey = offset;
+        }
+        if (store->maxKey < offset) {
+            store->maxKey = offset;
+        }
+    } else if (shift < 0) {
+        memmove(bins - shift, bins, (QUANTILE_SKETCH_BINS + shift) * sizeof(*bins));
+        memset(bins, 0, -shift * sizeof(*bins));
+    }
+    store->offset = offset;
+}
+
+static void storeAdd(QuantileSketchStore *store, int32_t key, uint32_t count) {
+    if (store->count == 0) {
+        // leave room on both sides of the first key
+        store->offset = key - QUANTILE_SKETCH_BINS / 2;
+        store->minKey = store->maxKey = key;
+    } else if (key < store->offset) {
+        if (store->maxKey - key < QUANTILE_SKETCH_BINS) {
+            storeRebase(store, key);
+        } else {
+            // out of range, the lowest values lose accuracy first
+            key = store->offset;
+        }
+    } else if (key - store->offset >= QUANTILE_SKETCH_BINS) {
+        storeRebase(store, key - QUANTILE_SKETCH_BINS + 1);
+    }
+    store->bins[key - store->offset] += count;
+    store->count += count;
+    if (key < store->minKey) {
+        store->minKey = key;
+    }
+    if (key > store->maxKey) {
+        store->maxKey = key;
+    }
+}
+
+static void storeMerge(QuantileSketchStore *dest, const QuantileSketchStore *src) {
+    if (src->count == 0) {
+        return;
+    }
+    for (int32_t key = src->minKey; key <= src->maxKey; key++) {
+        uint32_t count = src->bins[key - src->offset];
+        if (count > 0) {
+            storeAdd(dest, key, count);
+        }
+    }
+}
+
+// Key of the bin holding the value of ascending rank `rank`, which must be below store->count
+static int32_t storeKeyAtRank(const QuantileSketchStore *store, uint64_t rank) {
+    uint64_t seen = 0;
+    for (int32_t key = store->minKey; key < store->maxKey; key++) {
+        seen += store->bins[key - store->offset];
+        if (seen > rank) {
+            return key;
+        }
+    }
+    return store->maxKey;
+}
+
+static void storeWrite(const QuantileSketchStore *store, RedisModuleIO *io) {
+    RedisModule_SaveUnsigned(io, store->count);
+    if (store->count == 0) {
+        return;
+    }
+    RedisModule_SaveSigned(io, store->minKey);
+    RedisModule_SaveSigned(io, store->maxKey);
+    for (int32_t key = store->minKey; key <= store->maxKey; key++) {
+        RedisModule_SaveUnsigned(io, store->bins[key - store->offset]);
+    }
+}
+
+static void storeRead(QuantileSketchStore *store, RedisModuleIO *io) {
+    storeReset(store);
+    if (RedisModule_LoadUnsigned(io) == 0) {
+        return;
+    }
+    int32_t minKey = RedisModule_LoadSigned(io);
+    int32_t maxKey = RedisModule_LoadSigned(io);
+    for (int32_t key = minKey; key <= maxKey; key++) {
+        uint32_t count = RedisModule_LoadUnsigned(io);
+        if (count > 0) {
+            storeAdd(store, key, count);
+        }
+    }
+}
+
+void *QuantileSketch_Create() {
+    QuantileSketch *sketch = malloc(sizeof(QuantileSketch));
+    QuantileSketch_Reset(sketch);
+    return sketch;
+}
+
+void QuantileSketch_Reset(void *sketchPtr) {
+    QuantileSketch *sketch = sketchPtr;
+    sketch->zeroCount = 0;
+    sketch->min = INFINITY;
+    sketch->max = -INFINITY;
+    storeReset(&sketch->positive);
+    storeReset(&sketch->negative);
+}
+
+void QuantileSketch_Add(void *sketchPtr, double value) {
+    QuantileSketch *sketch = sketchPtr;
+    if (!isfinite(value)) {
+        return;
+    }
+    if (value > QUANTILE_SKETCH_MIN_VALUE) {
+        storeAdd(&sketch->positive, valueKey(value), 1);
+    } else if (value < -QUANTILE_SKETCH_MIN_VALUE) {
+        storeAdd(&sketch->negative, valueKey(-value), 1);
+    } else {
+        sketch->zeroCount++;
+    }
+    if (value < sketch->min) {
+        sketch->min = value;
+    }
+    if (value > sketch->max) {
+        sketch->max = value;
+    }
+}
+
+void QuantileSketch_Merge(QuantileSketch *dest, const QuantileSketch *src) {
+    storeMerge(&dest->positive, &src->positive);
+    storeMerge(&dest->negative, &src->negative);
+    dest->zeroCount += src->zeroCount;
+    if (src->min < dest->min) {
+        dest->min = src->min;
+    }
+    if (src->max > dest->max) {
+        dest->max = src->max;
+    }
+}
+
+uint64_t QuantileSketch_Count(const QuantileSketch *sketch) {
+    return sketch->negative.count + sketch->zeroCount + sketch->positive.count;
+}
+
+int QuantileSketch_Quantile(const QuantileSketch *sketch, double q, double *value) {
+    uint64_t count = QuantileSketch_Count(sketch);
+    if (count == 0) {
+        return TSDB_ERROR;
+    }
+    // the extremes are exact
+    if (q <= 0) {
+        *value = sketch->min;
+        return TSDB_OK;
+    } else if (q >= 1) {
+        *value = sketch->max;
+        return TSDB_OK;
+    }
+    uint64_t rank = (uint64_t)(q * (count - 1));
+    double result;
+    if (rank < sketch->negative.count) {
+        // the negative store is ascending by absolute value, its highest key is the lowest value
+        rank = sketch->negative.count - 1 - rank;
+        result = -keyValue(storeKeyAtRank(&sketch->negative, rank));
+    } else if (rank < sketch->negative.count + sketch->zeroCount) {
+        result = 0;
+    } else {
+        rank -= sketch->negative.count + sketch->zeroCount;
+        result = keyValue(storeKeyAtRank(&sketch->positive, rank));
+    }
+    // keep the estimate within the extremes
+    *value = fmin(fmax(result, sketch->min), sketch->max);
+    return TSDB_OK;
+}
+
+void QuantileSketch_Write(void *sketchPtr, RedisModuleIO *io) {
+    QuantileSketch *sketch = sketchPtr;
+    RedisModule_SaveUnsigned(io, sketch->zeroCount);
+    RedisModule_SaveDouble(io, sketch->min);
+    RedisModule_SaveDouble(io, sketch->max);
+    storeWrite(&sketch->positive, io);
+    storeWrite(&sketch->negative, io);
+}
+
+void QuantileSketch_Read(void *sketchPtr, RedisModuleIO *io) {
+    QuantileSketch *sketch = sketchPtr;
+    sketch->zeroCount = RedisModule_LoadUnsigned(io);
+    sketch->min = RedisModule_LoadDouble(io);
+    sketch->max = RedisModule_LoadDouble(io);
+    storeRead(&sketch->positive, io);
+    storeRead(&sketch->negative, io);
+}
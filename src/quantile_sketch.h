@@ -0,0 +1,57 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#ifndef QUANTILE_SKETCH_H
+#define QUANTILE_SKETCH_H
+
+#include "consts.h"
+#include "redismodule.h"
+
+#include <stdint.h>
+
+// Relative accuracy of the quantiles returned by the sketch
+#define QUANTILE_SKETCH_ACCURACY 0.01
+// Bins per sign, bounds the dynamic range kept at full accuracy to about 1:7e8
+#define QUANTILE_SKETCH_BINS 1024
+// Absolute values below this are counted as zero
+#define QUANTILE_SKETCH_MIN_VALUE 1e-9
+
+// Counts of the values whose absolute value maps to the keys [offset, offset + BINS)
+typedef struct QuantileSketchStore
+{
+    uint64_t count;
+    int32_t offset;
+    int32_t minKey; // non empty keys, valid while count > 0
+    int32_t maxKey;
+    uint32_t bins[QUANTILE_SKETCH_BINS];
+} QuantileSketchStore;
+
+/*
+ * A DDSketch: values are counted in logarithmic bins, so any quantile is answered within
+ * QUANTILE_SKETCH_ACCURACY of the real value, whatever the distribution. The memory is fixed, when
+ * values span more than the bins can hold the lowest bins are collapsed together. Sketches of the
+ * same accuracy can be merged without losing accuracy.
+ */
+typedef struct QuantileSketch
+{
+    uint64_t zeroCount;
+    double min;
+    double max;
+    QuantileSketchStore positive;
+    QuantileSketchStore negative; // keyed by the absolute value
+} QuantileSketch;
+
+void *QuantileSketch_Create();
+void QuantileSketch_Reset(void *sketch);
+// NaN and infinite values are ignored
+void QuantileSketch_Add(void *sketch, double value);
+void QuantileSketch_Merge(QuantileSketch *dest, const QuantileSketch *src);
+uint64_t QuantileSketch_Count(const QuantileSketch *sketch);
+// Returns TSDB_ERROR when the sketch is empty
+int QuantileSketch_Quantile(const QuantileSketch *sketch, double q, double *value);
+void QuantileSketch_Write(void *sketch, RedisModuleIO *io);
+void QuantileSketch_Read(void *sketch, RedisModuleIO *io);
+
+#endif
@@ -4,6 +4,7 @@
  * This file is available under the Redis Labs Source Available License Agreement
  */
 #include "query_language.h"
+#include "resultset.h"
 
 #include <limits.h>
 #include "rmutil/alloc.h"
@@ -44,6 +45,102 @@ int parseLabelsFromArgs(RedisModuleString **argv, int argc, size_t *label_count,
     return REDISMODULE_OK;
 }
 
+// Arguments that end a FIELDS list
+static const char *fieldsStopWords[] = { "RETENTION", "UNCOMPRESSED", "CHUNK_SIZE",
+                                         "DUPLICATE_POLICY", "LABELS", "COUNT",
+                                         "AGGREGATION", "EMPTY", "FILL",
+                                         "FILTER_BY_TS", "FILTER_BY_VALUE", "LEVEL",
+                                         "LIMIT", "CURSOR", NULL };
+
+static int fieldsArgsCount(RedisModuleString **argv, int argc, int first_field_pos) {
+    int count = 0;
+    for (int i = first_field_pos; i < argc; i++, count++) {
+        const char *arg = RedisModule_StringPtrLen(argv[i], NULL);
+        for (const char **stopWord = fieldsStopWords; *stopWord != NULL; stopWord++) {
+            if (strcasecmp(arg, *stopWord) == 0) {
+                return count;
+            }
+        }
+    }
+    return count;
+}
+
+int parseFieldsFromArgs(RedisModuleCtx *ctx,
+                        RedisModuleString **argv,
+                        int argc,
+                        size_t *fieldsCount,
+                        RedisModuleString ***fieldNames) {
+    *fieldsCount = 0;
+    *fieldNames = NULL;
+    int pos = RMUtil_ArgIndex("FIELDS", argv, argc);
+    if (pos < 0) {
+        return REDISMODULE_OK;
+    }
+    int count = fieldsArgsCount(argv, argc, pos + 1);
+    if (count == 0) {
+        RTS_ReplyGeneralError(ctx, "TSDB: Couldn't parse FIELDS");
+        return REDISMODULE_ERR;
+    }
+    for (int i = pos + 1; i < pos + 1 + count; i++) {
+        for (int j = pos + 1; j < i; j++) {
+            if (RedisModule_StringCompare(argv[i], argv[j]) == 0) {
+                RTS_ReplyGeneralError(ctx, "TSDB: duplicate field name");
+                return REDISMODULE_ERR;
+            }
+        }
+    }
+
+    RedisModuleString **names = malloc(sizeof(RedisModuleString *) * count);
+    for (int i = 0; i < count; i++) {
+        names[i] = RedisModule_CreateStringFromString(NULL, argv[pos + 1 + i]);
+    }
+    *fieldsCount = count;
+    *fieldNames = names;
+    return REDISMODULE_OK;
+}
+
+int parseFieldsSelection(RedisModuleCtx *ctx,
+                         Series *series,
+                         RedisModuleString **argv,
+                         int argc,
+                         size_t *count,
+                         size_t **fieldIndices) {
+    int pos = RMUtil_ArgIndex("FIELDS", argv, argc);
+    size_t *indices;
+    if (pos < 0) {
+        // all fields, in creation order
+        *count = series->fieldsCount;
+        indices = malloc(sizeof(size_t) * series->fieldsCount);
+        for (size_t i = 0; i < series->fieldsCount; i++) {
+            indices[i] = i;
+        }
+        *fieldIndices = indices;
+        return REDISMODULE_OK;
+    }
+
+    if (series->fieldsCount == 0) {
+        RTS_ReplyGeneralError(ctx, "TSDB: the key has no fields");
+        return REDISMODULE_ERR;
+    }
+    *count = fieldsArgsCount(argv, argc, pos + 1);
+    if (*count == 0) {
+        RTS_ReplyGeneralError(ctx, "TSDB: Couldn't parse FIELDS");
+        return REDISMODULE_ERR;
+    }
+    indices = malloc(sizeof(size_t) * (*count));
+    for (size_t i = 0; i < *count; i++) {
+        int index = SeriesGetFieldIndex(series, argv[pos + 1 + i]);
+        if (index < 0) {
+            free(indices);
+            RTS_ReplyGeneralError(ctx, "TSDB: unknown field");
+            return REDISMODULE_ERR;
+        }
+        indices[i] = index;
+    }
+    *fieldIndices = indices;
+    return REDISMODULE_OK;
+}
+
 int ParseDuplicatePolicy(RedisModuleCtx *ctx,
                          RedisModuleString **argv,
                          int argc,
@@ -201,23 +298,108 @@ int _parseAggregationArgs(RedisModuleCtx *ctx,
     return TSDB_NOTEXISTS;
 }
 
+// [EMPTY] [FILL PREVIOUS | LINEAR | VALUE value] right after the AGGREGATION arguments
+static int parseEmptyArgs(RedisModuleCtx *ctx,
+                          RedisModuleString **argv,
+                          int argc,
+                          int offset,
+                          AggregationArgs *aggregation) {
+    if (offset < argc && RMUtil_StringEqualsCaseC(argv[offset], "EMPTY")) {
+        aggregation->empty = true;
+        offset++;
+    }
+    if (offset >= argc || !RMUtil_StringEqualsCaseC(argv[offset], "FILL")) {
+        return TSDB_OK;
+    }
+    aggregation->empty = true;
+    if (offset + 1 >= argc) {
+        RTS_ReplyGeneralError(ctx, "TSDB: FILL argument is missing");
+        return TSDB_ERROR;
+    }
+    RedisModuleString *fill = argv[offset + 1];
+    if (RMUtil_StringEqualsCaseC(fill, "PREVIOUS")) {
+        aggregation->fill = TS_FILL_PREVIOUS;
+    } else if (RMUtil_StringEqualsCaseC(fill, "LINEAR")) {
+        aggregation->fill = TS_FILL_LINEAR;
+    } else if (RMUtil_StringEqualsCaseC(fill, "VALUE")) {
+        if (offset + 2 >= argc ||
+            RedisModule_StringToDouble(argv[offset + 2], &aggregation->fillValue) !=
+                REDISMODULE_OK) {
+            RTS_ReplyGeneralError(ctx, "TSDB: Couldn't parse FILL VALUE");
+            return TSDB_ERROR;
+        }
+        aggregation->fill = TS_FILL_VALUE;
+    } else {
+        RTS_ReplyGeneralError(ctx, "TSDB: FILL must be PREVIOUS, LINEAR or VALUE");
+        return TSDB_ERROR;
+    }
+    return TSDB_OK;
+}
+
 int parseAggregationArgs(RedisModuleCtx *ctx,
                          RedisModuleString **argv,
                          int argc,
-                         api_timestamp_t *time_delta,
-                         AggregationClass **agg_object) {
-    int agg_type;
-    int result = _parseAggregationArgs(ctx, argv, argc, time_delta, &agg_type);
-    if (result == TSDB_OK) {
-        *agg_object = GetAggClass(agg_type);
-        if (*agg_object == NULL) {
+                         AggregationArgs *aggregation) {
+    aggregation->timeDelta = 0;
+    aggregation->count = 0;
+    aggregation->empty = false;
+    aggregation->fill = TS_FILL_NONE;
+    aggregation->fillValue = 0;
+    int offset = RMUtil_ArgIndex("AGGREGATION", argv, argc);
+    if (offset <= 0) {
+        return TSDB_NOTEXISTS;
+    }
+
+    RedisModuleString *aggTypeStr = NULL;
+    long long temp_time_delta = 0;
+    if (RMUtil_ParseArgs(argv, argc, offset + 1, "sl", &aggTypeStr, &temp_time_delta) !=
+        REDISMODULE_OK) {
+        RTS_ReplyGeneralError(ctx, "TSDB: Couldn't parse AGGREGATION");
+        return TSDB_ERROR;
+    }
+    if (!aggTypeStr) {
+        RTS_ReplyGeneralError(ctx, "TSDB: Unknown aggregation type");
+        return TSDB_ERROR;
+    }
+
+    size_t len;
+    const char *type = RedisModule_StringPtrLen(aggTypeStr, &len);
+    const char *end = type + len;
+    while (true) {
+        const char *comma = memchr(type, ',', end - type);
+        const char *typeEnd = comma != NULL ? comma : end;
+        int agg_type = typeEnd > type ? StringLenAggTypeToEnum(type, typeEnd - type) : -1;
+        if (agg_type < 0 || agg_type >= TS_AGG_TYPES_MAX) {
+            RTS_ReplyGeneralError(ctx, "TSDB: Unknown aggregation type");
+            return TSDB_ERROR;
+        }
+        // a valid type appears once, so the list never outgrows TS_AGG_TYPES_MAX
+        for (size_t i = 0; i < aggregation->count; i++) {
+            if (aggregation->types[i] == agg_type) {
+                RTS_ReplyGeneralError(ctx, "TSDB: duplicate aggregation type");
+                return TSDB_ERROR;
+            }
+        }
+        AggregationClass *aggClass = GetAggClass(agg_type);
+        if (aggClass == NULL) {
             RTS_ReplyGeneralError(ctx, "TSDB: Failed to retrieve aggregation class");
             return TSDB_ERROR;
         }
-        return TSDB_OK;
-    } else {
-        return result;
+        aggregation->types[aggregation->count] = agg_type;
+        aggregation->classes[aggregation->count] = aggClass;
+        aggregation->count++;
+        if (comma == NULL) {
+            break;
+        }
+        type = comma + 1;
+    }
+
+    if (temp_time_delta <= 0) {
+        RTS_ReplyGeneralError(ctx, "TSDB: timeBucket must be greater than zero");
+        return TSDB_ERROR;
     }
+    aggregation->timeDelta = (api_timestamp_t)temp_time_delta;
+    return parseEmptyArgs(ctx, argv, argc, offset + 3, aggregation);
 }
 
 int parseRangeArguments(RedisModuleCtx *ctx,
@@ -276,6 +458,98 @@ int parseCountArgument(RedisModuleCtx *ctx, RedisModuleString **argv, int argc,
     return TSDB_OK;
 }
 
+int parseCursorArguments(RedisModuleCtx *ctx,
+                         RedisModuleString **argv,
+                         int argc,
+                         RangeCursor *cursor) {
+    *cursor = (RangeCursor){ .paginated = false, .limit = -1, .resume = false };
+    int limitPos = RMUtil_ArgIndex("LIMIT", argv, argc);
+    int cursorPos = RMUtil_ArgIndex("CURSOR", argv, argc);
+    if (limitPos < 0 && cursorPos < 0) {
+        return REDISMODULE_OK;
+    }
+    if (limitPos < 0 || cursorPos < 0) {
+        RTS_ReplyGeneralError(ctx, "TSDB: LIMIT and CURSOR must be used together");
+        return REDISMODULE_ERR;
+    }
+    if (RMUtil_ArgIndex("COUNT", argv, argc) > 0) {
+        RTS_ReplyGeneralError(ctx, "TSDB: COUNT cannot be combined with CURSOR");
+        return REDISMODULE_ERR;
+    }
+    if (limitPos + 1 >= argc ||
+        RedisModule_StringToLongLong(argv[limitPos + 1], &cursor->limit) != REDISMODULE_OK ||
+        cursor->limit <= 0) {
+        RTS_ReplyGeneralError(ctx, "TSDB: Couldn't parse LIMIT");
+        return REDISMODULE_ERR;
+    }
+    long long token;
+    if (cursorPos + 1 >= argc ||
+        RedisModule_StringToLongLong(argv[cursorPos + 1], &token) != REDISMODULE_OK ||
+        token < 0) {
+        RTS_ReplyGeneralError(ctx, "TSDB: invalid CURSOR");
+        return REDISMODULE_ERR;
+    }
+    cursor->paginated = true;
+    // a token is the timestamp to resume from plus one, 0 starts from the beginning
+    if (token > 0) {
+        cursor->resume = true;
+        cursor->resumeTimestamp = token - 1;
+    }
+    return REDISMODULE_OK;
+}
+
+static int compareTimestamps(const void *a, const void *b) {
+    timestamp_t x = *(const timestamp_t *)a, y = *(const timestamp_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+int parseFilterByArgs(RedisModuleCtx *ctx,
+                      RedisModuleString **argv,
+                      int argc,
+                      SeriesFilter *filter) {
+    *filter = (SeriesFilter){ .timestampsCount = 0, .timestamps = NULL, .byValue = false };
+    int valuePos = RMUtil_ArgIndex("FILTER_BY_VALUE", argv, argc);
+    if (valuePos > 0) {
+        if (valuePos + 2 >= argc ||
+            RedisModule_StringToDouble(argv[valuePos + 1], &filter->minValue) != REDISMODULE_OK ||
+            RedisModule_StringToDouble(argv[valuePos + 2], &filter->maxValue) != REDISMODULE_OK) {
+            RTS_ReplyGeneralError(ctx, "TSDB: Couldn't parse FILTER_BY_VALUE");
+            return REDISMODULE_ERR;
+        }
+        filter->byValue = true;
+    }
+
+    int tsPos = RMUtil_ArgIndex("FILTER_BY_TS", argv, argc);
+    if (tsPos < 0) {
+        return REDISMODULE_OK;
+    }
+    // the timestamps run up to the next argument that is not one
+    int last = tsPos + 1;
+    long long timestamp;
+    while (last < argc && RedisModule_StringToLongLong(argv[last], &timestamp) == REDISMODULE_OK &&
+           timestamp >= 0) {
+        last++;
+    }
+    if (last == tsPos + 1) {
+        RTS_ReplyGeneralError(ctx, "TSDB: FILTER_BY_TS argument is missing");
+        return REDISMODULE_ERR;
+    }
+    filter->timestamps = malloc(sizeof(timestamp_t) * (last - tsPos - 1));
+    for (int i = tsPos + 1; i < last; i++) {
+        RedisModule_StringToLongLong(argv[i], &timestamp);
+        filter->timestamps[filter->timestampsCount++] = timestamp;
+    }
+    qsort(filter->timestamps, filter->timestampsCount, sizeof(timestamp_t), compareTimestamps);
+    size_t unique = 1;
+    for (size_t i = 1; i < filter->timestampsCount; i++) {
+        if (filter->timestamps[i] != filter->timestamps[unique - 1]) {
+            filter->timestamps[unique++] = filter->timestamps[i];
+        }
+    }
+    filter->timestampsCount = unique;
+    return REDISMODULE_OK;
+}
+
 QueryPredicateList *parseLabelListFromArgs(RedisModuleCtx *ctx,
                                            RedisModuleString **argv,
                                            int start,
@@ -332,7 +606,23 @@ QueryPredicateList *parseLabelListFromArgs(RedisModuleCtx *ctx,
     return queries;
 }
 
+static const struct
+{
+    const char *name;
+    MultiSeriesReduceOp op;
+} percentileReducers[] = {
+    { "p50", MultiSeriesReduceOp_P50 }, { "p75", MultiSeriesReduceOp_P75 },
+    { "p90", MultiSeriesReduceOp_P90 }, { "p95", MultiSeriesReduceOp_P95 },
+    { "p99", MultiSeriesReduceOp_P99 }, { "p999", MultiSeriesReduceOp_P999 },
+};
+
 int parseMultiSeriesReduceOp(const char *reducerstr, MultiSeriesReduceOp *reducerOp) {
+    for (size_t i = 0; i < sizeof(percentileReducers) / sizeof(*percentileReducers); i++) {
+        if (strcasecmp(reducerstr, percentileReducers[i].name) == 0) {
+            *reducerOp = percentileReducers[i].op;
+            return TSDB_OK;
+        }
+    }
     if (strncasecmp(reducerstr, "sum", 3) == 0) {
         *reducerOp = MultiSeriesReduceOp_Sum;
         return TSDB_OK;
@@ -348,6 +638,115 @@ int parseMultiSeriesReduceOp(const char *reducerstr, MultiSeriesReduceOp *reduce
     return TSDB_ERROR;
 }
 
+static int parseTopKScore(const char *scorestr, TopKScore *score) {
+    if (strcasecmp(scorestr, "max") == 0) {
+        *score = TopKScore_Max;
+    } else if (strcasecmp(scorestr, "avg") == 0) {
+        *score = TopKScore_Avg;
+    } else if (strcasecmp(scorestr, "sum") == 0) {
+        *score = TopKScore_Sum;
+    } else if (strcasecmp(scorestr, "last") == 0) {
+        *score = TopKScore_Last;
+    } else {
+        return TSDB_ERROR;
+    }
+    return TSDB_OK;
+}
+
+// TOPK k BY max|avg|sum|last [ASC|DESC], before the FILTER label list
+static int parseTopKArgs(RedisModuleCtx *ctx,
+                         RedisModuleString **argv,
+                         int argc,
+                         MRangeArgs *args) {
+    args->topK = 0;
+    args->topKScore = TopKScore_Max;
+    args->topKAscending = false;
+    const int pos = RMUtil_ArgIndex("TOPK", argv, argc);
+    if (pos < 0) {
+        return REDISMODULE_OK;
+    }
+    if (pos + 3 >= argc || strcasecmp(RedisModule_StringPtrLen(argv[pos + 2], NULL), "BY") != 0) {
+        RTS_ReplyGeneralError(ctx, "TSDB: TOPK requires a count and a BY score");
+        return REDISMODULE_ERR;
+    }
+    if (RedisModule_StringToLongLong(argv[pos + 1], &args->topK) != REDISMODULE_OK ||
+        args->topK <= 0) {
+        RTS_ReplyGeneralError(ctx, "TSDB: TOPK count must be a positive integer");
+        return REDISMODULE_ERR;
+    }
+    if (parseTopKScore(RedisModule_StringPtrLen(argv[pos + 3], NULL), &args->topKScore) !=
+        TSDB_OK) {
+        RTS_ReplyGeneralError(ctx, "TSDB: TOPK score must be one of max, avg, sum or last");
+        return REDISMODULE_ERR;
+    }
+    if (pos + 4 < argc) {
+        const char *order = RedisModule_StringPtrLen(argv[pos + 4], NULL);
+        args->topKAscending = strcasecmp(order, "ASC") == 0;
+    }
+    return REDISMODULE_OK;
+}
+
+static int parseExprJoin(RedisModuleCtx *ctx,
+                         RedisModuleString **argv,
+                         int argc,
+                         ExprArgs *out) {
+    const int pos = RMUtil_ArgIndex("JOIN", argv, argc);
+    if (pos < 0) {
+        return REDISMODULE_OK;
+    }
+    const char *join = pos + 1 < argc ? RedisModule_StringPtrLen(argv[pos + 1], NULL) : "";
+    if (strcasecmp(join, "INNER") == 0) {
+        out->join = ExprJoin_Inner;
+    } else if (strcasecmp(join, "PREVIOUS") == 0) {
+        out->join = ExprJoin_Previous;
+    } else if (strcasecmp(join, "VALUE") == 0 && pos + 2 < argc &&
+               RedisModule_StringToDouble(argv[pos + 2], &out->joinValue) == REDISMODULE_OK) {
+        out->join = ExprJoin_Value;
+    } else {
+        RTS_ReplyGeneralError(ctx, "TSDB: JOIN must be INNER, PREVIOUS or VALUE value");
+        return REDISMODULE_ERR;
+    }
+    return REDISMODULE_OK;
+}
+
+int parseExprArgs(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, ExprArgs *out) {
+    *out = (ExprArgs){ .expr = NULL, .text = NULL, .join = ExprJoin_Inner, .aliasLabel = NULL };
+    const int pos = RMUtil_ArgIndex("EXPR", argv, argc);
+    if (pos < 0) {
+        if (RMUtil_ArgIndex("JOIN", argv, argc) > 0 || RMUtil_ArgIndex("ALIAS", argv, argc) > 0) {
+            RTS_ReplyGeneralError(ctx, "TSDB: JOIN and ALIAS require EXPR");
+            return REDISMODULE_ERR;
+        }
+        return REDISMODULE_OK;
+    }
+    if (pos + 1 >= argc) {
+        RTS_ReplyGeneralError(ctx, "TSDB: EXPR requires an expression");
+        return REDISMODULE_ERR;
+    }
+    if (parseExprJoin(ctx, argv, argc, out) != REDISMODULE_OK) {
+        return REDISMODULE_ERR;
+    }
+    const int aliasPos = RMUtil_ArgIndex("ALIAS", argv, argc);
+    if (aliasPos > 0) {
+        if (aliasPos + 1 >= argc) {
+            RTS_ReplyGeneralError(ctx, "TSDB: ALIAS requires a label");
+            return REDISMODULE_ERR;
+        }
+        out->aliasLabel = RedisModule_StringPtrLen(argv[aliasPos + 1], NULL);
+    }
+
+    const char *err = NULL;
+    out->text = RedisModule_StringPtrLen(argv[pos + 1], NULL);
+    out->expr = Expr_Compile(out->text, &err);
+    if (out->expr == NULL) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), RTS_ERR " %s", err);
+        RedisModule_ReplyWithError(ctx, msg);
+        return REDISMODULE_ERR;
+    }
+    return REDISMODULE_OK;
+}
+
 int parseMRangeCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, MRangeArgs *out) {
     if (argc < 4) {
         RedisModule_WrongArity(ctx);
@@ -357,8 +756,10 @@ int parseMRangeCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc,
     MRangeArgs args;
     args.groupByLabel = NULL;
     args.queryPredicates = NULL;
+    args.exprArgs.expr = NULL;
     args.aggregationArgs.timeDelta = 0;
-    args.aggregationArgs.aggregationClass = NULL;
+    args.aggregationArgs.count = 0;
+    args.filter = (SeriesFilter){ .timestampsCount = 0, .timestamps = NULL, .byValue = false };
 
     Series fake_series = { 0 };
     fake_series.lastTimestamp = LLONG_MAX;
@@ -367,8 +768,7 @@ int parseMRangeCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc,
         return REDISMODULE_ERR;
     }
 
-    const int aggregationResult = parseAggregationArgs(
-        ctx, argv, argc, &args.aggregationArgs.timeDelta, &args.aggregationArgs.aggregationClass);
+    const int aggregationResult = parseAggregationArgs(ctx, argv, argc, &args.aggregationArgs);
     if (aggregationResult == TSDB_ERROR) {
         return REDISMODULE_ERR;
     }
@@ -437,6 +837,43 @@ int parseMRangeCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc,
             QueryPredicateList_Free(queries);
             return REDISMODULE_ERR;
         }
+        // a percentile reducer merges the sketches the members keep for every bucket
+        if (MultiSeriesReduceOpAggType(args.gropuByReducerOp) != TS_AGG_NONE &&
+            (args.aggregationArgs.count != 1 || args.aggregationArgs.empty ||
+             args.aggregationArgs.types[0] < TS_AGG_P50 ||
+             args.aggregationArgs.types[0] > TS_AGG_P999)) {
+            RTS_ReplyGeneralError(
+                ctx, "TSDB: a percentile reducer needs a single percentile AGGREGATION");
+            QueryPredicateList_Free(queries);
+            return REDISMODULE_ERR;
+        }
+    }
+
+    // FILTER_BY_TS and FILTER_BY_VALUE come before the FILTER label list
+    if (parseFilterByArgs(ctx, argv, filter_location, &args.filter) != REDISMODULE_OK) {
+        QueryPredicateList_Free(queries);
+        return REDISMODULE_ERR;
+    }
+
+    if (parseTopKArgs(ctx, argv, filter_location, &args) != REDISMODULE_OK) {
+        MRangeArgs_Free(&args);
+        return REDISMODULE_ERR;
+    }
+    if (args.topK > 0 && args.groupByLabel != NULL) {
+        RTS_ReplyGeneralError(ctx, "TSDB: TOPK is not supported with GROUPBY");
+        MRangeArgs_Free(&args);
+        return REDISMODULE_ERR;
+    }
+
+    // EXPR, JOIN and ALIAS come before the FILTER label list as well
+    if (parseExprArgs(ctx, argv, filter_location, &args.exprArgs) != REDISMODULE_OK) {
+        MRangeArgs_Free(&args);
+        return REDISMODULE_ERR;
+    }
+    if (args.exprArgs.expr != NULL && (args.topK > 0 || args.groupByLabel != NULL)) {
+        RTS_ReplyGeneralError(ctx, "TSDB: EXPR is not supported with TOPK or GROUPBY");
+        MRangeArgs_Free(&args);
+        return REDISMODULE_ERR;
     }
     *out = args;
     return REDISMODULE_OK;
@@ -444,4 +881,8 @@ int parseMRangeCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc,
 
 void MRangeArgs_Free(MRangeArgs *args) {
     QueryPredicateList_Free(args->queryPredicates);
+    free(args->filter.timestamps);
+    if (args->exprArgs.expr != NULL) {
+        Expr_Free(args->exprArgs.expr);
+    }
 }
@@ -5,6 +5,7 @@
  */
 
 #include "config.h"
+#include "expr.h"
 #include "generic_chunk.h"
 #include "indexer.h"
 #include "redismodule.h"
@@ -17,16 +18,29 @@
 #ifndef REDISTIMESERIES_QUERY_LANGUAGE_H
 #define REDISTIMESERIES_QUERY_LANGUAGE_H
 
-typedef struct AggregationArgs
+// LIMIT n CURSOR token of TS.RANGE / TS.REVRANGE, see ReplySeriesRangePage
+typedef struct RangeCursor
 {
-    api_timestamp_t timeDelta;
-    AggregationClass *aggregationClass;
-} AggregationArgs;
+    bool paginated;
+    long long limit;
+    bool resume; // false for the first page, cursor "0"
+    api_timestamp_t resumeTimestamp;
+} RangeCursor;
+
+// The score TOPK ranks the series of TS.MRANGE by, over the samples of the range
+typedef enum TopKScore
+{
+    TopKScore_Max,
+    TopKScore_Avg,
+    TopKScore_Sum,
+    TopKScore_Last,
+} TopKScore;
 
 typedef struct MRangeArgs
 {
     api_timestamp_t startTimestamp;
     api_timestamp_t endTimestamp;
+    SeriesFilter filter;
     AggregationArgs aggregationArgs;
     bool withLabels;
     long long count; // AKA limit
@@ -34,10 +48,27 @@ typedef struct MRangeArgs
     const char *groupByLabel;
     MultiSeriesReduceOp gropuByReducerOp;
     bool reverse;
+    long long topK; // 0 replies with every series
+    TopKScore topKScore;
+    bool topKAscending;
+    ExprArgs exprArgs;
 } MRangeArgs;
 
 int parseLabelsFromArgs(RedisModuleString **argv, int argc, size_t *label_count, Label **labels);
 
+int parseFieldsFromArgs(RedisModuleCtx *ctx,
+                        RedisModuleString **argv,
+                        int argc,
+                        size_t *fieldsCount,
+                        RedisModuleString ***fieldNames);
+
+int parseFieldsSelection(RedisModuleCtx *ctx,
+                         Series *series,
+                         RedisModuleString **argv,
+                         int argc,
+                         size_t *count,
+                         size_t **fieldIndices);
+
 int ParseDuplicatePolicy(RedisModuleCtx *ctx,
                          RedisModuleString **argv,
                          int argc,
@@ -54,11 +85,11 @@ int _parseAggregationArgs(RedisModuleCtx *ctx,
                           api_timestamp_t *time_delta,
                           int *agg_type);
 
+// Parses AGGREGATION with a comma separated list of types, e.g. `AGGREGATION min,max,avg 60000`
 int parseAggregationArgs(RedisModuleCtx *ctx,
                          RedisModuleString **argv,
                          int argc,
-                         api_timestamp_t *time_delta,
-                         AggregationClass **agg_object);
+                         AggregationArgs *aggregation);
 
 int parseRangeArguments(RedisModuleCtx *ctx,
                         Series *series,
@@ -69,6 +100,20 @@ int parseRangeArguments(RedisModuleCtx *ctx,
 
 int parseCountArgument(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, long long *count);
 
+int parseCursorArguments(RedisModuleCtx *ctx,
+                         RedisModuleString **argv,
+                         int argc,
+                         RangeCursor *cursor);
+
+// Parses FILTER_BY_TS ts... and FILTER_BY_VALUE min max, the timestamps are freed by the caller
+int parseFilterByArgs(RedisModuleCtx *ctx,
+                      RedisModuleString **argv,
+                      int argc,
+                      SeriesFilter *filter);
+
+// Parses EXPR expression [JOIN INNER|PREVIOUS|VALUE value] [ALIAS label], see expr_range.h
+int parseExprArgs(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, ExprArgs *out);
+
 QueryPredicateList *parseLabelListFromArgs(RedisModuleCtx *ctx,
                                            RedisModuleString **argv,
                                            int start,
@@ -5,14 +5,73 @@
  */
 #include "rdb.h"
 
+#include "cold_tier.h"
 #include "consts.h"
 #include "endianconv.h"
+#include "series_registry.h"
 
 #include <string.h>
 #include <rmutil/alloc.h>
 
+static void loadChunks(RedisModuleIO *io, Series *series) {
+    Chunk_t *chunk = NULL;
+    // Free the default allocated chunk given LoadFromRDB will allocate a proper sized chunk
+    timestamp_t rax_key = htonu64(0);
+    chunk = (Chunk_t *)RedisModule_DictGetC(series->chunks, &rax_key, sizeof(rax_key), NULL);
+    if (chunk != NULL) {
+        SeriesAccountChunk(series, chunk, -1);
+        series->funcs->FreeChunk(chunk);
+    }
+    dictOperator(series->chunks, NULL, 0, DICT_OP_DEL);
+    uint64_t numChunks = RedisModule_LoadUnsigned(io);
+    for (int i = 0; i < numChunks; ++i) {
+        series->funcs->LoadFromRDB(&chunk, io);
+        dictOperator(series->chunks, chunk, series->funcs->GetFirstTimestamp(chunk), DICT_OP_SET);
+        SeriesAccountChunk(series, chunk, 1);
+    }
+    series->lastChunk = chunk;
+}
+
+static void loadFields(RedisModuleIO *io, Series *series) {
+    uint64_t fieldsCount = RedisModule_LoadUnsigned(io);
+    if (fieldsCount == 0) {
+        return;
+    }
+    RedisModuleString **fieldNames = malloc(sizeof(RedisModuleString *) * fieldsCount);
+    for (size_t i = 0; i < fieldsCount; i++) {
+        fieldNames[i] = RedisModule_LoadString(io);
+    }
+    SeriesSetFields(series, fieldNames, fieldsCount);
+    for (size_t i = 1; i < fieldsCount; i++) {
+        Series *field = series->fields[i - 1];
+        field->lastTimestamp = series->lastTimestamp;
+        field->lastValue = RedisModule_LoadDouble(io);
+        field->totalSamples = RedisModule_LoadUnsigned(io);
+        loadChunks(io, field);
+        SeriesDemoteChunks(field);
+    }
+}
+
+static void loadLevels(RedisModuleIO *io, Series *series) {
+    uint64_t levelsCount = RedisModule_LoadUnsigned(io);
+    for (size_t i = 0; i < levelsCount; i++) {
+        uint64_t aggType = RedisModule_LoadUnsigned(io);
+        uint64_t timeBucket = RedisModule_LoadUnsigned(io);
+        uint64_t retentionTime = RedisModule_LoadUnsigned(io);
+        CompactionRule *level = SeriesAddLevel(series, aggType, timeBucket, retentionTime);
+        level->startCurrentTimeBucket = RedisModule_LoadUnsigned(io);
+        level->aggClass->readContext(level->aggContext, io);
+
+        Series *levelSeries = level->level;
+        levelSeries->lastTimestamp = RedisModule_LoadUnsigned(io);
+        levelSeries->lastValue = RedisModule_LoadDouble(io);
+        levelSeries->totalSamples = RedisModule_LoadUnsigned(io);
+        loadChunks(io, levelSeries);
+    }
+}
+
 void *series_rdb_load(RedisModuleIO *io, int encver) {
-    if (encver < TS_ENC_VER && encver > TS_SIZE_RDB_VER) {
+    if (encver < TS_ENC_VER || encver > TS_LEVELS_RDB_VER) {
         RedisModule_LogIOError(io, "error", "data is not in the correct encoding");
         return NULL;
     }
@@ -23,6 +82,13 @@ void *series_rdb_load(RedisModuleIO *io, int encver) {
 
     CreateCtx cCtx = { 0 };
     RedisModuleString *keyName = RedisModule_LoadString(io);
+    // RESTORE may load the value under another name than the one it was saved with
+    RedisModuleString *ioKeyName =
+        RedisModule_GetKeyNameFromIO ? (RedisModuleString *)RedisModule_GetKeyNameFromIO(io) : NULL;
+    if (ioKeyName != NULL && RedisModule_StringCompare(ioKeyName, keyName) != 0) {
+        RedisModule_FreeString(NULL, keyName);
+        keyName = RedisModule_CreateStringFromString(NULL, ioKeyName);
+    }
     cCtx.retentionTime = RedisModule_LoadUnsigned(io);
     cCtx.chunkSizeBytes = RedisModule_LoadUnsigned(io);
     if (encver < TS_SIZE_RDB_VER) {
@@ -87,28 +153,24 @@ void *series_rdb_load(RedisModuleIO *io, int encver) {
             }
         }
     } else {
-        Chunk_t *chunk = NULL;
-        // Free the default allocated chunk given LoadFromRDB will allocate a proper sized chunk
-        timestamp_t rax_key = htonu64(0);
-        chunk = (Chunk_t *)RedisModule_DictGetC(series->chunks, &rax_key, sizeof(rax_key), NULL);
-        if (chunk != NULL) {
-            series->funcs->FreeChunk(chunk);
-        }
-        dictOperator(series->chunks, NULL, 0, DICT_OP_DEL);
-        uint64_t numChunks = RedisModule_LoadUnsigned(io);
-        for (int i = 0; i < numChunks; ++i) {
-            series->funcs->LoadFromRDB(&chunk, io);
-            dictOperator(
-                series->chunks, chunk, series->funcs->GetFirstTimestamp(chunk), DICT_OP_SET);
-        }
+        loadChunks(io, series);
         series->totalSamples = totalSamples;
         series->srcKey = srcKey;
         series->lastTimestamp = lastTimestamp;
         series->lastValue = lastValue;
-        series->lastChunk = chunk;
     }
 
-    IndexMetric(ctx, keyName, series->labels, series->labelsCount);
+    SeriesDemoteChunks(series);
+    if (encver >= TS_FIELDS_RDB_VER) {
+        loadFields(io, series);
+    }
+    if (encver >= TS_LEVELS_RDB_VER) {
+        loadLevels(io, series);
+    }
+
+    // the db of the key is not known while loading, the first lookup resolves it
+    SeriesRegistry_Add(series);
+    IndexMetric(ctx, keyName, series->id, series->labels, series->labelsCount);
     return series;
 }
 
@@ -122,6 +184,17 @@ unsigned int countRules(Series *series) {
     return count;
 }
 
+static void saveChunks(RedisModuleIO *io, Series *series) {
+    Chunk_t *chunk;
+    uint64_t numChunks = RedisModule_DictSize(series->chunks);
+    RedisModule_SaveUnsigned(io, numChunks);
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
+    while (RedisModule_DictNextC(iter, NULL, &chunk)) {
+        series->funcs->SaveToRDB(chunk, io);
+    }
+    RedisModule_DictIteratorStop(iter);
+}
+
 void series_rdb_save(RedisModuleIO *io, void *value) {
     Series *series = value;
     RedisModule_SaveString(io, series->keyName);
@@ -156,13 +229,34 @@ void series_rdb_save(RedisModuleIO *io, void *value) {
         rule = rule->nextRule;
     }
 
-    Chunk_t *chunk;
-    uint64_t numChunks = RedisModule_DictSize(series->chunks);
-    RedisModule_SaveUnsigned(io, numChunks);
-    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
-    while (RedisModule_DictNextC(iter, NULL, &chunk)) {
-        series->funcs->SaveToRDB(chunk, io);
-        numChunks--;
+    saveChunks(io, series);
+
+    RedisModule_SaveUnsigned(io, series->fieldsCount);
+    for (size_t i = 0; i < series->fieldsCount; i++) {
+        RedisModule_SaveString(io, series->fieldNames[i]);
+    }
+    for (size_t i = 1; i < series->fieldsCount; i++) {
+        Series *field = series->fields[i - 1];
+        RedisModule_SaveDouble(io, field->lastValue);
+        RedisModule_SaveUnsigned(io, field->totalSamples);
+        saveChunks(io, field);
+    }
+
+    uint64_t levelsCount = 0;
+    for (CompactionRule *level = series->levels; level != NULL; level = level->nextRule) {
+        levelsCount++;
+    }
+    RedisModule_SaveUnsigned(io, levelsCount);
+    for (CompactionRule *level = series->levels; level != NULL; level = level->nextRule) {
+        Series *levelSeries = level->level;
+        RedisModule_SaveUnsigned(io, level->aggType);
+        RedisModule_SaveUnsigned(io, level->timeBucket);
+        RedisModule_SaveUnsigned(io, levelSeries->retentionTime);
+        RedisModule_SaveUnsigned(io, level->startCurrentTimeBucket);
+        level->aggClass->writeContext(level->aggContext, io);
+        RedisModule_SaveUnsigned(io, levelSeries->lastTimestamp);
+        RedisModule_SaveDouble(io, levelSeries->lastValue);
+        RedisModule_SaveUnsigned(io, levelSeries->totalSamples);
+        saveChunks(io, levelSeries);
     }
-    RedisModule_DictIteratorStop(iter);
 }
@@ -18,8 +18,8 @@ int ReplySeriesArrayPos(RedisModuleCtx *ctx,
                         bool withlabels,
                         api_timestamp_t start_ts,
                         api_timestamp_t end_ts,
-                        AggregationClass *aggObject,
-                        int64_t time_delta,
+                        const SeriesFilter *filter,
+                        const AggregationArgs *aggregation,
                         long long maxResults,
                         bool rev) {
     RedisModule_ReplyWithArray(ctx, 3);
@@ -29,43 +29,106 @@ int ReplySeriesArrayPos(RedisModuleCtx *ctx,
     } else {
         RedisModule_ReplyWithArray(ctx, 0);
     }
-    ReplySeriesRange(ctx, s, start_ts, end_ts, aggObject, time_delta, maxResults, rev);
+    ReplySeriesRange(ctx, s, start_ts, end_ts, filter, aggregation, maxResults, rev);
     return REDISMODULE_OK;
 }
 
-int ReplySeriesRange(RedisModuleCtx *ctx,
-                     Series *series,
-                     api_timestamp_t start_ts,
-                     api_timestamp_t end_ts,
-                     AggregationClass *aggObject,
-                     int64_t time_delta,
-                     long long maxResults,
-                     bool rev) {
-    Sample sample;
+// TODO: move to parseRangeArguments(?)
+bool ApplyRetention(const Series *series, api_timestamp_t *start_ts, api_timestamp_t end_ts) {
+    if (series->retentionTime) {
+        *start_ts = series->lastTimestamp > series->retentionTime
+                        ? max(*start_ts, series->lastTimestamp - series->retentionTime)
+                        : *start_ts;
+    }
+    // if new start_ts > end_ts, there are no results to return
+    return *start_ts <= end_ts;
+}
+
+static size_t aggregationsCount(const AggregationArgs *aggregation) {
+    return aggregation != NULL ? aggregation->count : 0;
+}
+
+void ReplyWithRow(RedisModuleCtx *ctx,
+                  timestamp_t timestamp,
+                  const double *values,
+                  size_t valuesCount) {
+    RedisModule_ReplyWithArray(ctx, valuesCount + 1);
+    RedisModule_ReplyWithLongLong(ctx, timestamp);
+    for (size_t i = 0; i < valuesCount; i++) {
+        ReplyWithValue(ctx, values[i]);
+    }
+}
+
+// Where a range reply stopped, filled in for paginated replies only
+typedef struct RangePage
+{
+    bool more;        // rows were left out because of the limit
+    timestamp_t last; // timestamp of the last row replied
+} RangePage;
+
+static int replySeriesFieldsRange(RedisModuleCtx *ctx,
+                                  Series *series,
+                                  const size_t *fieldIndices,
+                                  size_t fieldsCount,
+                                  api_timestamp_t start_ts,
+                                  api_timestamp_t end_ts,
+                                  const SeriesFilter *filter,
+                                  const AggregationArgs *aggregation,
+                                  long long maxResults,
+                                  bool rev,
+                                  RangePage *page);
+
+static int replySeriesRange(RedisModuleCtx *ctx,
+                            Series *series,
+                            api_timestamp_t start_ts,
+                            api_timestamp_t end_ts,
+                            const SeriesFilter *filter,
+                            const AggregationArgs *aggregation,
+                            long long maxResults,
+                            bool rev,
+                            RangePage *page) {
+    if (series->fieldsCount > 0) {
+        return replySeriesFieldsRange(ctx,
+                                      series,
+                                      NULL,
+                                      series->fieldsCount,
+                                      start_ts,
+                                      end_ts,
+                                      filter,
+                                      aggregation,
+                                      maxResults,
+                                      rev,
+                                      page);
+    }
+
+    timestamp_t timestamp;
+    double values[TS_AGG_TYPES_MAX];
+    const size_t valuesCount = max(aggregationsCount(aggregation), 1);
     long long arraylen = 0;
 
-    // In case a retention is set shouldn't return chunks older than the retention
-    // TODO: move to parseRangeArguments(?)
-    if (series->retentionTime) {
-        start_ts = series->lastTimestamp > series->retentionTime
-                       ? max(start_ts, series->lastTimestamp - series->retentionTime)
-                       : start_ts;
-        // if new start_ts > end_ts, there are no results to return
-        if (start_ts > end_ts) {
-            return RedisModule_ReplyWithArray(ctx, 0);
-        }
+    if (!ApplyRetention(series, &start_ts, end_ts)) {
+        return RedisModule_ReplyWithArray(ctx, 0);
     }
 
     SeriesIterator iterator;
-    if (SeriesQuery(series, &iterator, start_ts, end_ts, rev, aggObject, time_delta) != TSDB_OK) {
+    if (SeriesQueryAggregations(series, &iterator, start_ts, end_ts, rev, filter, aggregation) !=
+        TSDB_OK) {
         return RedisModule_ReplyWithArray(ctx, 0);
     }
 
     RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
-    while (SeriesIteratorGetNext(&iterator, &sample) == CR_OK &&
-           (maxResults == -1 || arraylen < maxResults)) {
-        ReplyWithSample(ctx, sample.timestamp, sample.value);
+    while (SeriesIteratorGetNextValues(&iterator, &timestamp, values) == CR_OK) {
+        if (maxResults != -1 && arraylen >= maxResults) {
+            if (page != NULL) {
+                page->more = true;
+            }
+            break;
+        }
+        ReplyWithRow(ctx, timestamp, values, valuesCount);
         arraylen++;
+        if (page != NULL) {
+            page->last = timestamp;
+        }
     }
     SeriesIteratorClose(&iterator);
 
@@ -73,6 +136,160 @@ int ReplySeriesRange(RedisModuleCtx *ctx,
     return REDISMODULE_OK;
 }
 
+int ReplySeriesRange(RedisModuleCtx *ctx,
+                     Series *series,
+                     api_timestamp_t start_ts,
+                     api_timestamp_t end_ts,
+                     const SeriesFilter *filter,
+                     const AggregationArgs *aggregation,
+                     long long maxResults,
+                     bool rev) {
+    return replySeriesRange(
+        ctx, series, start_ts, end_ts, filter, aggregation, maxResults, rev, NULL);
+}
+
+/*
+ * Replies with rows of [timestamp, value...], one value per requested field (all fields when
+ * fieldIndices is NULL), or one value per aggregation of every field when several aggregations
+ * are requested. All fields share the timestamps of the series, so their iterators are advanced
+ * in lockstep, aggregated or not. Filtering by value would break the lockstep, only FILTER_BY_TS
+ * applies to the fields.
+ */
+static int replySeriesFieldsRange(RedisModuleCtx *ctx,
+                                  Series *series,
+                                  const size_t *fieldIndices,
+                                  size_t fieldsCount,
+                                  api_timestamp_t start_ts,
+                                  api_timestamp_t end_ts,
+                                  const SeriesFilter *filter,
+                                  const AggregationArgs *aggregation,
+                                  long long maxResults,
+                                  bool rev,
+                                  RangePage *page) {
+    if (!ApplyRetention(series, &start_ts, end_ts)) {
+        return RedisModule_ReplyWithArray(ctx, 0);
+    }
+
+    SeriesFilter fieldFilter = filter != NULL ? *filter : (SeriesFilter){ 0 };
+    fieldFilter.byValue = false;
+    SeriesIterator *iterators = malloc(sizeof(SeriesIterator) * fieldsCount);
+    size_t opened = 0;
+    for (; opened < fieldsCount; opened++) {
+        Series *field =
+            SeriesGetField(series, fieldIndices != NULL ? fieldIndices[opened] : opened);
+        if (SeriesQueryAggregations(
+                field, &iterators[opened], start_ts, end_ts, rev, &fieldFilter, aggregation) !=
+            TSDB_OK) {
+            break;
+        }
+    }
+
+    long long arraylen = 0;
+    RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+    if (opened == fieldsCount) {
+        const size_t valuesCount = max(aggregationsCount(aggregation), 1);
+        double *values = malloc(sizeof(double) * fieldsCount * valuesCount);
+        timestamp_t timestamp;
+        while (true) {
+            size_t i = 0;
+            for (; i < fieldsCount; i++) {
+                double *fieldValues = &values[i * valuesCount];
+                if (SeriesIteratorGetNextValues(&iterators[i], &timestamp, fieldValues) != CR_OK) {
+                    break;
+                }
+            }
+            if (i < fieldsCount) {
+                break;
+            }
+            if (maxResults != -1 && arraylen >= maxResults) {
+                if (page != NULL) {
+                    page->more = true;
+                }
+                break;
+            }
+            ReplyWithRow(ctx, timestamp, values, fieldsCount * valuesCount);
+            arraylen++;
+            if (page != NULL) {
+                page->last = timestamp;
+            }
+        }
+        free(values);
+    }
+    RedisModule_ReplySetArrayLength(ctx, arraylen);
+
+    for (size_t i = 0; i < opened; i++) {
+        SeriesIteratorClose(&iterators[i]);
+    }
+    free(iterators);
+    return REDISMODULE_OK;
+}
+
+int ReplySeriesFieldsRange(RedisModuleCtx *ctx,
+                           Series *series,
+                           const size_t *fieldIndices,
+                           size_t fieldsCount,
+                           api_timestamp_t start_ts,
+                           api_timestamp_t end_ts,
+                           const SeriesFilter *filter,
+                           const AggregationArgs *aggregation,
+                           long long maxResults,
+                           bool rev) {
+    return replySeriesFieldsRange(ctx,
+                                  series,
+                                  fieldIndices,
+                                  fieldsCount,
+                                  start_ts,
+                                  end_ts,
+                                  filter,
+                                  aggregation,
+                                  maxResults,
+                                  rev,
+                                  NULL);
+}
+
+int ReplySeriesRangePage(RedisModuleCtx *ctx,
+                         Series *series,
+                         const size_t *fieldIndices,
+                         size_t fieldsCount,
+                         api_timestamp_t start_ts,
+                         api_timestamp_t end_ts,
+                         const SeriesFilter *filter,
+                         const AggregationArgs *aggregation,
+                         long long limit,
+                         bool rev) {
+    RangePage page = { .more = false, .last = 0 };
+    RedisModule_ReplyWithArray(ctx, 2);
+    if (series->fieldsCount > 0) {
+        replySeriesFieldsRange(ctx,
+                               series,
+                               fieldIndices,
+                               fieldsCount,
+                               start_ts,
+                               end_ts,
+                               filter,
+                               aggregation,
+                               limit,
+                               rev,
+                               &page);
+    } else {
+        replySeriesRange(ctx, series, start_ts, end_ts, filter, aggregation, limit, rev, &page);
+    }
+
+    // Timestamps are unique within a series, so the next one to read is a complete position.
+    // Aggregated pages resume at the next bucket, which starts on a bucket boundary.
+    timestamp_t next = 0;
+    if (page.more && !rev) {
+        next = page.last + (aggregationsCount(aggregation) > 0 ? aggregation->timeDelta : 1);
+    } else if (page.more && page.last > 0) {
+        next = page.last - 1;
+    } else {
+        return RedisModule_ReplyWithSimpleString(ctx, "0");
+    }
+    char cursor[32];
+    int len = snprintf(cursor, sizeof(cursor), "%llu", (unsigned long long)next + 1);
+    return RedisModule_ReplyWithStringBuffer(ctx, cursor, len);
+}
+
 void ReplyWithSeriesLabels(RedisModuleCtx *ctx, const Series *series) {
     RedisModule_ReplyWithArray(ctx, series->labelsCount);
     for (int i = 0; i < series->labelsCount; i++) {
@@ -85,18 +302,29 @@ void ReplyWithSeriesLabels(RedisModuleCtx *ctx, const Series *series) {
 // double string presentation requires 15 digit integers +
 // '.' + "e+" or "e-" + 3 digits of exponent
 #define MAX_VAL_LEN 24
-void ReplyWithSample(RedisModuleCtx *ctx, u_int64_t timestamp, double value) {
-    RedisModule_ReplyWithArray(ctx, 2);
-    RedisModule_ReplyWithLongLong(ctx, timestamp);
+void ReplyWithValue(RedisModuleCtx *ctx, double value) {
     char buf[MAX_VAL_LEN + 1];
     int str_len = fpconv_dtoa(value, buf);
     buf[str_len] = '\0';
     RedisModule_ReplyWithSimpleString(ctx, buf);
 }
 
+void ReplyWithSample(RedisModuleCtx *ctx, u_int64_t timestamp, double value) {
+    RedisModule_ReplyWithArray(ctx, 2);
+    RedisModule_ReplyWithLongLong(ctx, timestamp);
+    ReplyWithValue(ctx, value);
+}
+
 void ReplyWithSeriesLastDatapoint(RedisModuleCtx *ctx, const Series *series) {
     if (SeriesGetNumSamples(series) == 0) {
         RedisModule_ReplyWithArray(ctx, 0);
+    } else if (series->fieldsCount > 0) {
+        RedisModule_ReplyWithArray(ctx, series->fieldsCount + 1);
+        RedisModule_ReplyWithLongLong(ctx, series->lastTimestamp);
+        ReplyWithValue(ctx, series->lastValue);
+        for (size_t i = 1; i < series->fieldsCount; i++) {
+            ReplyWithValue(ctx, series->fields[i - 1]->lastValue);
+        }
     } else {
         ReplyWithSample(ctx, series->lastTimestamp, series->lastValue);
     }
@@ -16,24 +16,64 @@ int ReplySeriesArrayPos(RedisModuleCtx *ctx,
                         bool withlabels,
                         api_timestamp_t start_ts,
                         api_timestamp_t end_ts,
-                        AggregationClass *aggObject,
-                        int64_t time_delta,
+                        const SeriesFilter *filter,
+                        const AggregationArgs *aggregation,
                         long long maxResults,
                         bool rev);
 
+// Replies with [timestamp, value] rows, [timestamp, value...] when several aggregations are given
 int ReplySeriesRange(RedisModuleCtx *ctx,
                      Series *series,
                      api_timestamp_t start_ts,
                      api_timestamp_t end_ts,
-                     AggregationClass *aggObject,
-                     int64_t time_delta,
+                     const SeriesFilter *filter,
+                     const AggregationArgs *aggregation,
                      long long maxResults,
                      bool rev);
 
+int ReplySeriesFieldsRange(RedisModuleCtx *ctx,
+                           Series *series,
+                           const size_t *fieldIndices,
+                           size_t fieldsCount,
+                           api_timestamp_t start_ts,
+                           api_timestamp_t end_ts,
+                           const SeriesFilter *filter,
+                           const AggregationArgs *aggregation,
+                           long long maxResults,
+                           bool rev);
+
+/*
+ * Replies with [rows, cursor]: at most `limit` rows of the range (as ReplySeriesRange, or as
+ * ReplySeriesFieldsRange for a series with fields) followed by the cursor that resumes after
+ * them, "0" once the range is exhausted. See parseCursorArguments.
+ */
+int ReplySeriesRangePage(RedisModuleCtx *ctx,
+                         Series *series,
+                         const size_t *fieldIndices,
+                         size_t fieldsCount,
+                         api_timestamp_t start_ts,
+                         api_timestamp_t end_ts,
+                         const SeriesFilter *filter,
+                         const AggregationArgs *aggregation,
+                         long long limit,
+                         bool rev);
+
+// In case a retention is set shouldn't return chunks older than the retention, false when nothing
+// is left of the range
+bool ApplyRetention(const Series *series, api_timestamp_t *start_ts, api_timestamp_t end_ts);
+
 void ReplyWithSeriesLabels(RedisModuleCtx *ctx, const Series *series);
 
+void ReplyWithValue(RedisModuleCtx *ctx, double value);
+
 void ReplyWithSample(RedisModuleCtx *ctx, u_int64_t timestamp, double value);
 
+// Replies with [timestamp, value...]
+void ReplyWithRow(RedisModuleCtx *ctx,
+                  timestamp_t timestamp,
+                  const double *values,
+                  size_t valuesCount);
+
 void ReplyWithSeriesLastDatapoint(RedisModuleCtx *ctx, const Series *series);
 
 #endif // REDISTIMESERIES_REPLY_H
@@ -7,6 +7,7 @@
 #include "resultset.h"
 
 #include "indexer.h"
+#include "quantile_sketch.h"
 #include "redismodule.h"
 #include "reply.h"
 #include "series_iterator.h"
@@ -15,6 +16,8 @@
 
 #include "rmutil/alloc.h"
 
+#include <math.h>
+
 struct TS_ResultSet
 {
     RedisModuleDict *groups;
@@ -26,221 +29,367 @@ struct TS_GroupList
     char *labelValue;
     size_t count;
     Series **list;
+    SeriesRows **rows; // the rows queried for each series already, NULL to query them
 };
 
 TS_GroupList *GroupList_Create();
 
 void GroupList_Free(TS_GroupList *g);
 
-void GroupList_ApplyReducer(TS_GroupList *group,
-                            char *labelKey,
-                            timestamp_t ts,
-                            timestamp_t ts1,
-                            AggregationClass *pClass,
-                            int64_t delta,
-                            long long results,
+void GroupList_ReplyReduced(RedisModuleCtx *ctx,
+                            TS_GroupList *group,
+                            const char *labelKey,
+                            bool withlabels,
+                            api_timestamp_t start_ts,
+                            api_timestamp_t end_ts,
+                            const SeriesFilter *filter,
+                            const AggregationArgs *aggregation,
+                            long long maxResults,
                             bool rev,
                             MultiSeriesReduceOp reducerOp);
 
-void GroupList_ReplyResultSet(RedisModuleCtx *ctx,
-                              TS_GroupList *group,
-                              bool withlabels,
-                              u_int64_t start_ts,
-                              u_int64_t end_ts,
-                              AggregationClass *aggregation,
-                              int64_t delta,
-                              long long maxResults,
-                              bool rev);
-
-void FreeTempSeries(Series *s) {
-    if (!s)
-        return;
-    RedisModule_FreeString(NULL, s->keyName);
-    if (s->chunks) {
-        RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(s->chunks, "^", NULL, 0);
-        Chunk_t *currentChunk;
-        while (RedisModule_DictNextC(iter, NULL, (void **)&currentChunk) != NULL) {
-            s->funcs->FreeChunk(currentChunk);
-        }
-        RedisModule_DictIteratorStop(iter);
-        RedisModule_FreeDict(NULL, s->chunks);
-    }
-    if (s->labels) {
-        FreeLabels(s->labels, s->labelsCount);
-    }
-    free(s);
-}
-
 TS_GroupList *GroupList_Create() {
     TS_GroupList *g = (TS_GroupList *)malloc(sizeof(TS_GroupList));
     g->count = 0;
     g->labelValue = NULL;
     g->list = NULL;
+    g->rows = NULL;
     return g;
 }
 
 void GroupList_Free(TS_GroupList *groupList) {
-    for (int i = 0; i < groupList->count; i++) {
-        FreeTempSeries(groupList->list[i]);
-    }
     free(groupList->labelValue);
     if (groupList->list)
         free(groupList->list);
+    free(groupList->rows);
     free(groupList);
 }
 
-int GroupList_AddSerie(TS_GroupList *g, Series *serie, const char *name) {
+int GroupList_AddSerie(TS_GroupList *g, Series *serie, const char *name, SeriesRows *rows) {
     if (g->list == NULL) {
         g->list = (Series **)malloc(sizeof(Series *));
     } else {
         g->list = (Series **)realloc(g->list, sizeof(Series *) * (g->count + 1));
     }
     g->list[g->count] = serie;
+    if (rows != NULL) {
+        // a group is either queried in full or made of rows only
+        g->rows = (SeriesRows **)realloc(g->rows, sizeof(SeriesRows *) * (g->count + 1));
+        g->rows[g->count] = rows;
+    }
     g->count++;
     return REDISMODULE_OK;
 }
 
-void GroupList_ReplyResultSet(RedisModuleCtx *ctx,
-                              TS_GroupList *group,
-                              bool withlabels,
-                              u_int64_t start_ts,
-                              u_int64_t end_ts,
-                              AggregationClass *aggregation,
-                              int64_t timeDelta,
-                              long long maxResults,
-                              bool rev) {
-    for (int i = 0; i < group->count; i++) {
-        ReplySeriesArrayPos(ctx,
-                            group->list[i],
-                            withlabels,
-                            start_ts,
-                            end_ts,
-                            aggregation,
-                            timeDelta,
-                            maxResults,
-                            rev);
+static const char *reducerName(MultiSeriesReduceOp reducerOp) {
+    switch (reducerOp) {
+        case MultiSeriesReduceOp_Max:
+            return "max";
+        case MultiSeriesReduceOp_Min:
+            return "min";
+        case MultiSeriesReduceOp_Sum:
+            return "sum";
+        case MultiSeriesReduceOp_P50:
+            return "p50";
+        case MultiSeriesReduceOp_P75:
+            return "p75";
+        case MultiSeriesReduceOp_P90:
+            return "p90";
+        case MultiSeriesReduceOp_P95:
+            return "p95";
+        case MultiSeriesReduceOp_P99:
+            return "p99";
+        case MultiSeriesReduceOp_P999:
+            return "p999";
     }
+    return "";
 }
 
-Label *createReducedSeriesLabels(char *labelKey, char *labelValue, MultiSeriesReduceOp reducerOp) {
-    // Labels:
-    // <label>=<groupbyvalue>
-    // __reducer__=<reducer>
-    // __source__=key1,key2,key3
-    char *reducer_str = NULL;
+static DuplicatePolicy reducerPolicy(MultiSeriesReduceOp reducerOp) {
     switch (reducerOp) {
         case MultiSeriesReduceOp_Max:
-            reducer_str = "max";
-            break;
+            return DP_MAX;
         case MultiSeriesReduceOp_Min:
-            reducer_str = "min";
-            break;
+            return DP_MIN;
         case MultiSeriesReduceOp_Sum:
-            reducer_str = "sum";
-            break;
+            return DP_SUM;
+        default:
+            return DP_INVALID;
     }
-    Label *labels = malloc(sizeof(Label) * 3);
-    labels[0].key = RedisModule_CreateStringPrintf(NULL, "%s", labelKey);
-    labels[0].value = RedisModule_CreateStringPrintf(NULL, "%s", labelValue);
-    labels[1].key = RedisModule_CreateStringPrintf(NULL, "__reducer__");
-    labels[1].value = RedisModule_CreateString(NULL, reducer_str, strlen(reducer_str));
-    labels[2].key = RedisModule_CreateStringPrintf(NULL, "__source__");
-    labels[2].value = RedisModule_CreateStringPrintf(NULL, "");
-    return labels;
 }
 
-TS_ResultSet *ResultSet_Create() {
-    TS_ResultSet *r = malloc(sizeof(TS_ResultSet));
-    r->groups = RedisModule_CreateDict(NULL);
-    r->labelkey = NULL;
-    return r;
+TS_AGG_TYPES_T MultiSeriesReduceOpAggType(MultiSeriesReduceOp reducerOp) {
+    switch (reducerOp) {
+        case MultiSeriesReduceOp_P50:
+            return TS_AGG_P50;
+        case MultiSeriesReduceOp_P75:
+            return TS_AGG_P75;
+        case MultiSeriesReduceOp_P90:
+            return TS_AGG_P90;
+        case MultiSeriesReduceOp_P95:
+            return TS_AGG_P95;
+        case MultiSeriesReduceOp_P99:
+            return TS_AGG_P99;
+        case MultiSeriesReduceOp_P999:
+            return TS_AGG_P999;
+        default:
+            return TS_AGG_NONE;
+    }
 }
 
-int GroupList_SetLabelValue(TS_GroupList *r, const char *label) {
-    r->labelValue = strdup(label);
-    return true;
+static void replyWithLabel(RedisModuleCtx *ctx, const char *key, const char *value) {
+    RedisModule_ReplyWithArray(ctx, 2);
+    RedisModule_ReplyWithStringBuffer(ctx, key, strlen(key));
+    RedisModule_ReplyWithStringBuffer(ctx, value, strlen(value));
 }
 
-int ResultSet_GroupbyLabel(TS_ResultSet *r, const char *label) {
-    r->labelkey = strdup(label);
-    return true;
+static void replyReducedLabels(RedisModuleCtx *ctx,
+                               const TS_GroupList *group,
+                               const char *labelKey,
+                               MultiSeriesReduceOp reducerOp) {
+    // Labels:
+    // <label>=<groupbyvalue>
+    // __reducer__=<reducer>
+    // __source__=key1,key2,key3
+    RedisModule_ReplyWithArray(ctx, 3);
+    replyWithLabel(ctx, labelKey, group->labelValue);
+    replyWithLabel(ctx, "__reducer__", reducerName(reducerOp));
+
+    RedisModuleString *sources = RedisModule_CreateString(NULL, "", 0);
+    for (size_t i = 0; i < group->count; i++) {
+        size_t keyLen = 0;
+        const char *keyname = RedisModule_StringPtrLen(group->list[i]->keyName, &keyLen);
+        RedisModule_StringAppendBuffer(NULL, sources, keyname, keyLen);
+        // check if its the last item in the group, if not append a comma
+        if (i < group->count - 1) {
+            RedisModule_StringAppendBuffer(NULL, sources, ",", 1);
+        }
+    }
+    RedisModule_ReplyWithArray(ctx, 2);
+    RedisModule_ReplyWithStringBuffer(ctx, "__source__", strlen("__source__"));
+    RedisModule_ReplyWithString(ctx, sources);
+    RedisModule_FreeString(NULL, sources);
 }
 
-int ResultSet_ApplyReducer(TS_ResultSet *r,
-                           api_timestamp_t start_ts,
-                           api_timestamp_t end_ts,
-                           AggregationClass *aggObject,
-                           int64_t time_delta,
-                           long long maxResults,
-                           bool rev,
-                           MultiSeriesReduceOp reducerOp) {
-    // ^ seek the smallest element of the radix tree.
-    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(r->groups, "^", NULL, 0);
-    TS_GroupList *groupList;
-    while (RedisModule_DictNextC(iter, NULL, (void **)&groupList) != NULL) {
-        GroupList_ApplyReducer(groupList,
-                               r->labelkey,
-                               start_ts,
-                               end_ts,
-                               aggObject,
-                               time_delta,
-                               maxResults,
-                               rev,
-                               reducerOp);
+// A member of a group being merged, positioned on its next row
+typedef struct GroupMember
+{
+    SeriesIterator iterator; // unless the rows were queried already
+    const SeriesRows *rows;
+    size_t row;
+    timestamp_t timestamp;
+    const double *values;
+    double buffer[TS_AGG_TYPES_MAX];
+    void *sketch; // the sketch of the bucket with a percentile reducer, NULL otherwise
+} GroupMember;
+
+// Moves the member to its next row, false once it has none left
+static bool groupMemberNext(GroupMember *member) {
+    if (member->rows != NULL) {
+        if (member->row == member->rows->count) {
+            return false;
+        }
+        member->timestamp = member->rows->timestamps[member->row];
+        member->values = &member->rows->values[member->row * member->rows->valuesCount];
+        member->row++;
+        return true;
     }
-    RedisModule_DictIteratorStop(iter);
+    member->values = member->buffer;
+    if (member->sketch != NULL) {
+        // the iterator merges the context of the next bucket into it
+        QuantileSketch_Reset(member->sketch);
+    }
+    return SeriesIteratorGetNextValues(&member->iterator, &member->timestamp, member->buffer) ==
+           CR_OK;
+}
+
+/*
+ * Heap of the members of a group by their next timestamp, in query order. Members on the same
+ * timestamp come out in group order, so their values are folded in the order they were added.
+ */
+typedef struct GroupHeap
+{
+    GroupMember *members;
+    size_t *heap; // indices of the members with rows left
+    size_t count;
+    bool rev;
+} GroupHeap;
+
+static bool groupHeapBefore(const GroupHeap *h, size_t a, size_t b) {
+    const timestamp_t first = h->members[h->heap[a]].timestamp;
+    const timestamp_t second = h->members[h->heap[b]].timestamp;
+    if (first != second) {
+        return h->rev ? first > second : first < second;
+    }
+    return h->heap[a] < h->heap[b];
+}
+
+static void groupHeapDown(GroupHeap *h, size_t i) {
+    while (true) {
+        size_t next = i;
+        const size_t left = 2 * i + 1, right = 2 * i + 2;
+        if (left < h->count && groupHeapBefore(h, left, next)) {
+            next = left;
+        }
+        if (right < h->count && groupHeapBefore(h, right, next)) {
+            next = right;
+        }
+        if (next == i) {
+            return;
+        }
+        const size_t tmp = h->heap[i];
+        h->heap[i] = h->heap[next];
+        h->heap[next] = tmp;
+        i = next;
+    }
+}
 
-    return TSDB_OK;
+// Moves the member on top to its next row, drops it once it has none left
+static void groupHeapAdvance(GroupHeap *h) {
+    if (!groupMemberNext(&h->members[h->heap[0]])) {
+        h->heap[0] = h->heap[--h->count];
+    }
+    groupHeapDown(h, 0);
+}
+
+// Replies with the rows of the members merged, the values of a timestamp reduced together
+static long long replyReducedRows(RedisModuleCtx *ctx,
+                                  GroupHeap *h,
+                                  size_t valuesCount,
+                                  api_timestamp_t start_ts,
+                                  api_timestamp_t end_ts,
+                                  long long maxResults,
+                                  MultiSeriesReduceOp reducerOp) {
+    const DuplicatePolicy dp = reducerPolicy(reducerOp);
+    // a percentile reducer finalizes the merged sketch as its aggregation would
+    const TS_AGG_TYPES_T percentile = MultiSeriesReduceOpAggType(reducerOp);
+    AggregationClass *quantile = percentile != TS_AGG_NONE ? GetAggClass(percentile) : NULL;
+    void *sketch = quantile != NULL ? QuantileSketch_Create() : NULL;
+    double values[TS_AGG_TYPES_MAX];
+    long long arraylen = 0;
+    while (h->count > 0 && (maxResults == -1 || arraylen < maxResults)) {
+        const timestamp_t timestamp = h->members[h->heap[0]].timestamp;
+        if (sketch != NULL) {
+            QuantileSketch_Reset(sketch);
+            QuantileSketch_Merge(sketch, h->members[h->heap[0]].sketch);
+        } else {
+            memcpy(values, h->members[h->heap[0]].values, valuesCount * sizeof(double));
+        }
+        groupHeapAdvance(h);
+        while (h->count > 0 && h->members[h->heap[0]].timestamp == timestamp) {
+            if (sketch != NULL) {
+                QuantileSketch_Merge(sketch, h->members[h->heap[0]].sketch);
+                groupHeapAdvance(h);
+                continue;
+            }
+            const double *other = h->members[h->heap[0]].values;
+            for (size_t i = 0; i < valuesCount; i++) {
+                Sample reduced = { .timestamp = timestamp, .value = other[i] };
+                handleDuplicateSample(
+                    dp, (Sample){ .timestamp = timestamp, .value = values[i] }, &reduced);
+                values[i] = reduced.value;
+            }
+            groupHeapAdvance(h);
+        }
+        if (sketch != NULL && quantile->finalize(sketch, &values[0]) != TSDB_OK) {
+            values[0] = NAN;
+        }
+        // buckets may start before the range, only the rows inside it are replied
+        if (timestamp >= start_ts && timestamp <= end_ts) {
+            ReplyWithRow(ctx, timestamp, values, valuesCount);
+            arraylen++;
+        }
+    }
+    free(sketch);
+    return arraylen;
 }
-void GroupList_ApplyReducer(TS_GroupList *group,
-                            char *labelKey,
-                            timestamp_t startTimestamp,
-                            timestamp_t endTimestamp,
-                            AggregationClass *aggregation,
-                            int64_t timeDelta,
+
+/*
+ * Replies with the group reduced to a single series. The rows of the members are merged on a heap
+ * as they are queried, so only a row per member is held at a time.
+ */
+void GroupList_ReplyReduced(RedisModuleCtx *ctx,
+                            TS_GroupList *group,
+                            const char *labelKey,
+                            bool withlabels,
+                            api_timestamp_t start_ts,
+                            api_timestamp_t end_ts,
+                            const SeriesFilter *filter,
+                            const AggregationArgs *aggregation,
                             long long maxResults,
                             bool rev,
                             MultiSeriesReduceOp reducerOp) {
-    Label *labels = createReducedSeriesLabels(labelKey, group->labelValue, reducerOp);
-    size_t serie_name_len = strlen(labelKey) + strlen(group->labelValue) + 2;
-    char *serie_name = malloc(serie_name_len);
-    serie_name_len = sprintf(serie_name, "%s=%s", labelKey, group->labelValue);
-
-    // create a temp serie
-    CreateCtx cCtx = {
-        .labels = NULL, .labelsCount = 0, .chunkSizeBytes = Chunk_SIZE_BYTES_SECS, .options = 0
-    };
-    cCtx.options |= SERIES_OPT_UNCOMPRESSED;
-    cCtx.isTemporary = true;
-
-    Series *reduced = NewSeries(RedisModule_CreateString(NULL, serie_name, serie_name_len), &cCtx);
-
-    Series *source = NULL;
-    for (int i = 0; i < group->count; i++) {
-        source = group->list[i];
-        MultiSerieReduce(
-            reduced, source, reducerOp, startTimestamp, endTimestamp, aggregation, timeDelta, rev);
+    RedisModule_ReplyWithArray(ctx, 3);
+    RedisModuleString *name =
+        RedisModule_CreateStringPrintf(NULL, "%s=%s", labelKey, group->labelValue);
+    RedisModule_ReplyWithString(ctx, name);
+    RedisModule_FreeString(NULL, name);
+    if (withlabels) {
+        replyReducedLabels(ctx, group, labelKey, reducerOp);
+    } else {
+        RedisModule_ReplyWithArray(ctx, 0);
+    }
 
-        size_t keyLen = 0;
-        const char *keyname = RedisModule_StringPtrLen(source->keyName, &keyLen);
-        RedisModule_StringAppendBuffer(NULL, labels[2].value, keyname, keyLen);
-        // check if its the last item in the group, if not append a comma
-        if (i < group->count - 1) {
-            RedisModule_StringAppendBuffer(NULL, labels[2].value, ",", 1);
+    GroupHeap h = { .members = calloc(group->count, sizeof(GroupMember)),
+                    .heap = malloc(group->count * sizeof(size_t)),
+                    .count = 0,
+                    .rev = rev };
+    const bool mergeSketches = MultiSeriesReduceOpAggType(reducerOp) != TS_AGG_NONE;
+    for (size_t i = 0; i < group->count; i++) {
+        GroupMember *member = &h.members[i];
+        if (group->rows != NULL) {
+            member->rows = group->rows[i];
+        } else {
+            SeriesQueryAggregations(
+                group->list[i], &member->iterator, start_ts, end_ts, rev, filter, aggregation);
+            if (mergeSketches) {
+                member->sketch = QuantileSketch_Create();
+                member->iterator.aggregationCapture = member->sketch;
+            }
+        }
+        if (groupMemberNext(member)) {
+            h.heap[h.count++] = i;
         }
     }
-    group->list[0] = reduced;
-    group->count = 1;
+    for (size_t i = h.count / 2; i-- > 0;) {
+        groupHeapDown(&h, i);
+    }
 
-    // replace labels
-    FreeLabels(reduced->labels, reduced->labelsCount);
-    reduced->labels = labels;
-    reduced->labelsCount = 3;
+    // with several aggregations the rows hold a value per aggregation
+    const size_t valuesCount = aggregation != NULL ? max(aggregation->count, 1) : 1;
+    RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+    long long arraylen =
+        replyReducedRows(ctx, &h, valuesCount, start_ts, end_ts, maxResults, reducerOp);
+    RedisModule_ReplySetArrayLength(ctx, arraylen);
+
+    if (group->rows == NULL) {
+        for (size_t i = 0; i < group->count; i++) {
+            SeriesIteratorClose(&h.members[i].iterator);
+            free(h.members[i].sketch);
+        }
+    }
+    free(h.members);
+    free(h.heap);
+}
 
-    free(serie_name);
+TS_ResultSet *ResultSet_Create() {
+    TS_ResultSet *r = malloc(sizeof(TS_ResultSet));
+    r->groups = RedisModule_CreateDict(NULL);
+    r->labelkey = NULL;
+    return r;
 }
 
-int ResultSet_AddSerie(TS_ResultSet *r, Series *serie, const char *name) {
+int GroupList_SetLabelValue(TS_GroupList *r, const char *label) {
+    r->labelValue = strdup(label);
+    return true;
+}
+
+int ResultSet_GroupbyLabel(TS_ResultSet *r, const char *label) {
+    r->labelkey = strdup(label);
+    return true;
+}
+
+static int resultSetAddSerie(TS_ResultSet *r, Series *serie, const char *name, SeriesRows *rows) {
     int result = false;
 
     char *labelValue = SeriesGetCStringLabelValue(serie, r->labelkey);
@@ -255,35 +404,46 @@ int ResultSet_AddSerie(TS_ResultSet *r, Series *serie, const char *name) {
             RedisModule_DictSetC(r->groups, (void *)labelValue, labelLen, labelGroup);
         }
         free(labelValue);
-        result = GroupList_AddSerie(labelGroup, serie, name);
+        result = GroupList_AddSerie(labelGroup, serie, name, rows);
     }
 
     return result;
 }
 
-void replyResultSet(RedisModuleCtx *ctx,
-                    TS_ResultSet *r,
-                    bool withlabels,
-                    api_timestamp_t start_ts,
-                    api_timestamp_t end_ts,
-                    AggregationClass *aggObject,
-                    int64_t time_delta,
-                    long long maxResults,
-                    bool rev) {
+int ResultSet_AddSerie(TS_ResultSet *r, Series *serie, const char *name) {
+    return resultSetAddSerie(r, serie, name, NULL);
+}
+
+int ResultSet_AddSerieRows(TS_ResultSet *r, Series *serie, const char *name, SeriesRows *rows) {
+    return resultSetAddSerie(r, serie, name, rows);
+}
+
+void ResultSet_ReplyReduced(RedisModuleCtx *ctx,
+                            TS_ResultSet *r,
+                            bool withlabels,
+                            api_timestamp_t start_ts,
+                            api_timestamp_t end_ts,
+                            const SeriesFilter *filter,
+                            const AggregationArgs *aggregation,
+                            long long maxResults,
+                            bool rev,
+                            MultiSeriesReduceOp reducerOp) {
     RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(r->groups, "^", NULL, 0);
 
     RedisModule_ReplyWithArray(ctx, RedisModule_DictSize(r->groups));
     TS_GroupList *innerGroupList;
     while (RedisModule_DictNextC(iter, NULL, (void **)&innerGroupList) != NULL) {
-        GroupList_ReplyResultSet(ctx,
-                                 innerGroupList,
-                                 withlabels,
-                                 start_ts,
-                                 end_ts,
-                                 aggObject,
-                                 time_delta,
-                                 maxResults,
-                                 rev);
+        GroupList_ReplyReduced(ctx,
+                               innerGroupList,
+                               r->labelkey,
+                               withlabels,
+                               start_ts,
+                               end_ts,
+                               filter,
+                               aggregation,
+                               maxResults,
+                               rev,
+                               reducerOp);
     }
 
     RedisModule_DictIteratorStop(iter);
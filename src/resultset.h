@@ -21,28 +21,34 @@ int ResultSet_SetLabelKey(TS_ResultSet *r, const char *labelKey);
 
 int ResultSet_SetLabelValue(TS_ResultSet *r, const char *label);
 
-int ResultSet_ApplyReducer(TS_ResultSet *r,
-                           api_timestamp_t start_ts,
-                           api_timestamp_t end_ts,
-                           AggregationClass *aggObject,
-                           int64_t time_delta,
-                           long long maxResults,
-                           bool rev,
-                           MultiSeriesReduceOp reducerOp);
-
 int parseMultiSeriesReduceOp(const char *reducerstr, MultiSeriesReduceOp *reducerOp);
 
+// The percentile aggregation of a REDUCE pNN reducer, TS_AGG_NONE for min, max and sum
+TS_AGG_TYPES_T MultiSeriesReduceOpAggType(MultiSeriesReduceOp reducerOp);
+
 int ResultSet_AddSerie(TS_ResultSet *r, Series *serie, const char *name);
 
-void replyResultSet(RedisModuleCtx *ctx,
-                    TS_ResultSet *r,
-                    bool withlabels,
-                    api_timestamp_t start_ts,
-                    api_timestamp_t end_ts,
-                    AggregationClass *aggObject,
-                    int64_t time_delta,
-                    long long maxResults,
-                    bool rev);
+// Adds a series whose range was queried into `rows` already, the reply merges the rows instead.
+// The series and the rows must outlive the reply, only the key name of the series is used then.
+int ResultSet_AddSerieRows(TS_ResultSet *r, Series *serie, const char *name, SeriesRows *rows);
+
+/*
+ * Replies with a series per group, the members of the group queried over the range and merged by
+ * timestamp, the values of a timestamp reduced by `reducerOp`. `maxResults` applies to the rows
+ * of the reduced series. A percentile reducer needs a single percentile aggregation: the sketches
+ * of the members for a bucket are merged, so it cannot reduce rows added with
+ * ResultSet_AddSerieRows.
+ */
+void ResultSet_ReplyReduced(RedisModuleCtx *ctx,
+                            TS_ResultSet *r,
+                            bool withlabels,
+                            api_timestamp_t start_ts,
+                            api_timestamp_t end_ts,
+                            const SeriesFilter *filter,
+                            const AggregationArgs *aggregation,
+                            long long maxResults,
+                            bool rev,
+                            MultiSeriesReduceOp reducerOp);
 
 void ResultSet_Free(TS_ResultSet *r);
 
@@ -7,6 +7,9 @@
 
 #include "tsdb.h"
 
+#include <math.h>
+#include <string.h>
+
 static int SeriesChunkIteratorOptions(SeriesIterator *iter) {
     int options = 0;
     if (iter->reverse) {
@@ -15,59 +18,260 @@ static int SeriesChunkIteratorOptions(SeriesIterator *iter) {
     return options;
 }
 
+static inline void resetChunkIterator(SeriesIterator *iterator,
+                                      const ChunkFuncs *funcs,
+                                      void *currentChunk) {
+    iterator->currentChunk = currentChunk;
+    funcs->InitChunkIterator(currentChunk,
+                             SeriesChunkIteratorOptions(iterator),
+                             &iterator->chunkIteratorFuncs,
+                             iterator->chunkIterator,
+                             &iterator->chunkIteratorScratch);
+}
+
+// Packs the aggregation contexts into the iterator storage, the ones left over are allocated
+static void initAggregationContexts(SeriesIterator *iter) {
+    size_t used = 0;
+    for (size_t i = 0; i < iter->aggregationsCount; i++) {
+        AggregationClass *aggregation = iter->aggregations[i];
+        size_t size = (aggregation->contextSize + sizeof(double) - 1) & ~(sizeof(double) - 1);
+        if (used + size <= sizeof(iter->aggregationStorage)) {
+            iter->aggregationContexts[i] = iter->aggregationStorage.bytes + used;
+            // resetContext keeps state carried between buckets, start from a clean context
+            memset(iter->aggregationContexts[i], 0, size);
+            aggregation->resetContext(iter->aggregationContexts[i]);
+            used += size;
+        } else {
+            iter->aggregationContexts[i] = aggregation->createContext();
+        }
+    }
+}
+
+ChunkResult _seriesIteratorGetNext(SeriesIterator *iterator, Sample *currentSample);
+
+static bool carriesSample(SeriesIterator *iter) {
+    for (size_t i = 0; i < iter->aggregationsCount; i++) {
+        if (iter->aggregations[i]->carriesSample) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The nearest sample passing the filter outside the range, before it or after it
+static bool sampleOutsideRange(SeriesIterator *iter, bool before, Sample *sample) {
+    SeriesIterator outside;
+    if (before) {
+        if (iter->minTimestamp == 0) {
+            return false;
+        }
+        SeriesQueryAggregations(
+            iter->series, &outside, 0, iter->minTimestamp - 1, true, iter->filter, NULL);
+    } else {
+        if (iter->maxTimestamp == UINT64_MAX) {
+            return false;
+        }
+        SeriesQueryAggregations(
+            iter->series, &outside, iter->maxTimestamp + 1, UINT64_MAX, false, iter->filter, NULL);
+    }
+    bool found = _seriesIteratorGetNext(&outside, sample) == CR_OK;
+    SeriesIteratorClose(&outside);
+    return found;
+}
+
+static void appendCarriedSample(SeriesIterator *iter, const Sample *sample) {
+    for (size_t i = 0; i < iter->aggregationsCount; i++) {
+        if (iter->aggregations[i]->carriesSample) {
+            iter->aggregations[i]->appendValue(
+                iter->aggregationContexts[i], sample->value, sample->timestamp);
+        }
+    }
+}
+
+static void resetAggregations(SeriesIterator *iter) {
+    for (size_t i = 0; i < iter->aggregationsCount; i++) {
+        iter->aggregations[i]->resetContext(iter->aggregationContexts[i]);
+    }
+}
+
+/*
+ * Aggregations that carry a sample across buckets see the samples next to every bucket, so a
+ * bucket gets the same value in forward and reverse queries, whatever the range. The sample
+ * preceding the range in query order is carried into the first bucket, the one following it is
+ * appended to the last bucket. It also starts the empty buckets reported before the first sample.
+ */
+static void seedAggregations(SeriesIterator *iter) {
+    iter->aggregationHasLastSample =
+        (carriesSample(iter) || iter->aggregationEmpty) &&
+        sampleOutsideRange(iter, !iter->reverse, &iter->aggregationLastSample);
+    if (iter->aggregationHasLastSample && carriesSample(iter)) {
+        appendCarriedSample(iter, &iter->aggregationLastSample);
+        resetAggregations(iter);
+    }
+}
+
+static inline timestamp_t bucketOf(SeriesIterator *iter, timestamp_t timestamp) {
+    return timestamp - (timestamp % iter->aggregationTimeDelta);
+}
+
+// Gives the bounds of the bucket, clipped to the range, to the aggregations that take them
+static void setBucket(SeriesIterator *iter, timestamp_t bucket) {
+    timestamp_t start = max(bucket, iter->minTimestamp);
+    timestamp_t end = iter->maxTimestamp - bucket < iter->aggregationTimeDelta
+                          ? iter->maxTimestamp + 1
+                          : bucket + iter->aggregationTimeDelta;
+    for (size_t i = 0; i < iter->aggregationsCount; i++) {
+        if (iter->aggregations[i]->setBucket != NULL) {
+            iter->aggregations[i]->setBucket(iter->aggregationContexts[i], start, end);
+        }
+    }
+}
+
+static bool isInlineContext(SeriesIterator *iter, void *context) {
+    return (char *)context >= iter->aggregationStorage.bytes &&
+           (char *)context < iter->aggregationStorage.bytes + sizeof(iter->aggregationStorage);
+}
+
+static inline bool filterByTimestamps(const SeriesIterator *iter) {
+    return iter->filter != NULL && iter->filter->timestampsCount > 0;
+}
+
+// Keeps the timestamps of FILTER_BY_TS within the range
+static void initFilter(SeriesIterator *iter, const SeriesFilter *filter) {
+    iter->filter = filter;
+    iter->filterTimestamps = NULL;
+    iter->filterTimestampsCount = 0;
+    if (filterByTimestamps(iter)) {
+        const timestamp_t *first = filter->timestamps;
+        const timestamp_t *end = filter->timestamps + filter->timestampsCount;
+        while (first < end && *first < iter->minTimestamp) {
+            first++;
+        }
+        while (end > first && end[-1] > iter->maxTimestamp) {
+            end--;
+        }
+        iter->filterTimestamps = first;
+        iter->filterTimestampsCount = end - first;
+    }
+}
+
+// The next timestamp of FILTER_BY_TS to find, in query order
+static inline timestamp_t nextFilterTimestamp(const SeriesIterator *iter) {
+    return iter->reverse ? iter->filterTimestamps[iter->filterTimestampsCount - 1]
+                         : iter->filterTimestamps[0];
+}
+
+static inline void dropFilterTimestamp(SeriesIterator *iter) {
+    if (!iter->reverse) {
+        iter->filterTimestamps++;
+    }
+    iter->filterTimestampsCount--;
+}
+
+// False when no value of the chunk passes FILTER_BY_VALUE, from the bounds of its values
+static bool chunkMayMatch(const SeriesIterator *iter, Chunk_t *chunk) {
+    double min, max;
+    return iter->filter == NULL || !iter->filter->byValue ||
+           !iter->series->funcs->GetValueRange(chunk, &min, &max) ||
+           !(max < iter->filter->minValue || min > iter->filter->maxValue);
+}
+
 // Initiates SeriesIterator, find the correct chunk and initiate a ChunkIterator
-int SeriesQuery(Series *series,
-                SeriesIterator *iter,
-                timestamp_t start_ts,
-                timestamp_t end_ts,
-                bool rev,
-                AggregationClass *aggregation,
-                int64_t time_delta) {
+static int seriesQuery(Series *series,
+                       SeriesIterator *iter,
+                       timestamp_t start_ts,
+                       timestamp_t end_ts,
+                       bool rev,
+                       const SeriesFilter *filter,
+                       const AggregationArgs *aggregation) {
+    size_t aggregationsCount = aggregation != NULL ? aggregation->count : 0;
     iter->series = series;
     iter->minTimestamp = start_ts;
     iter->maxTimestamp = end_ts;
     iter->reverse = rev;
-    iter->aggregation = NULL;
-    iter->aggregationContext = NULL;
-    iter->aggregationTimeDelta = time_delta;
+    initFilter(iter, filter);
+    iter->aggregationsCount = aggregationsCount;
+    iter->aggregationTimeDelta = aggregationsCount > 0 ? aggregation->timeDelta : 0;
     iter->aggregationIsFirstSample = TRUE;
     iter->aggregationIsFinalized = FALSE;
+    iter->aggregationEmpty = aggregationsCount > 0 && aggregation->empty;
+    iter->aggregationFill = aggregationsCount > 0 ? aggregation->fill : TS_FILL_NONE;
+    iter->aggregationFillValue = aggregationsCount > 0 ? aggregation->fillValue : 0;
+    iter->aggregationHasNextSample = false;
+    iter->aggregationGapBuckets = 0;
+    iter->aggregationCapture = NULL;
+    iter->chunkIterator = (ChunkIter_t *)&iter->chunkIteratorStorage;
+    iter->chunkIteratorScratch = (ChunkIterScratch){ 0 };
+    iter->dictIter = NULL;
 
     timestamp_t rax_key;
     ChunkFuncs *funcs = series->funcs;
 
-    if (aggregation) {
-        iter->aggregation = aggregation;
-        iter->aggregationContext = iter->aggregation->createContext();
+    for (size_t i = 0; i < aggregationsCount; i++) {
+        iter->aggregations[i] = aggregation->classes[i];
     }
+    initAggregationContexts(iter);
+    seedAggregations(iter);
 
+    // with FILTER_BY_TS the query starts at the chunk of the first timestamp to find
+    timestamp_t first = start_ts, last = end_ts;
+    if (iter->filterTimestampsCount > 0) {
+        first = iter->filterTimestamps[0];
+        last = iter->filterTimestamps[iter->filterTimestampsCount - 1];
+    }
     if (iter->reverse == false) {
         iter->DictGetNext = RedisModule_DictNextC;
-        seriesEncodeTimestamp(&rax_key, iter->minTimestamp);
+        seriesEncodeTimestamp(&rax_key, first);
     } else {
         iter->DictGetNext = RedisModule_DictPrevC;
-        seriesEncodeTimestamp(&rax_key, iter->maxTimestamp);
+        seriesEncodeTimestamp(&rax_key, last);
     }
 
-    // get first chunk within query range
-    iter->dictIter =
-        RedisModule_DictIteratorStartC(series->chunks, "<=", &rax_key, sizeof(rax_key));
-    if (!iter->DictGetNext(iter->dictIter, NULL, (void *)&iter->currentChunk)) {
-        RedisModule_DictIteratorReseekC(iter->dictIter, "^", NULL, 0);
-        iter->DictGetNext(iter->dictIter, NULL, (void *)&iter->currentChunk);
+    Chunk_t *chunk = series->lastChunk;
+    // short ranges and last point queries never leave the last chunk, skip the dict lookup
+    if (funcs->GetNumOfSample(chunk) == 0 || first < funcs->GetFirstTimestamp(chunk)) {
+        // get first chunk within query range
+        iter->dictIter =
+            RedisModule_DictIteratorStartC(series->chunks, "<=", &rax_key, sizeof(rax_key));
+        if (!iter->DictGetNext(iter->dictIter, NULL, (void *)&chunk)) {
+            RedisModule_DictIteratorReseekC(iter->dictIter, "^", NULL, 0);
+            iter->DictGetNext(iter->dictIter, NULL, (void *)&chunk);
+        }
     }
+    resetChunkIterator(iter, funcs, chunk);
 
-    iter->chunkIterator = funcs->NewChunkIterator(
-        iter->currentChunk, SeriesChunkIteratorOptions(iter), &iter->chunkIteratorFuncs);
-
-    if (aggregation) {
+    if (aggregationsCount > 0) {
         timestamp_t init_ts = (rev == false) ? series->funcs->GetFirstTimestamp(iter->currentChunk)
                                              : series->funcs->GetLastTimestamp(iter->currentChunk);
-        iter->aggregationLastTimestamp = init_ts - (init_ts % time_delta);
+        iter->aggregationLastTimestamp = bucketOf(iter, init_ts);
     }
     return TSDB_OK;
 }
 
+int SeriesQuery(Series *series,
+                SeriesIterator *iter,
+                timestamp_t start_ts,
+                timestamp_t end_ts,
+                bool rev,
+                AggregationClass *aggregation,
+                int64_t time_delta) {
+    AggregationArgs args = { .timeDelta = time_delta,
+                             .count = aggregation != NULL,
+                             .classes = { aggregation },
+                             .fill = TS_FILL_NONE };
+    return seriesQuery(series, iter, start_ts, end_ts, rev, NULL, &args);
+}
+
+int SeriesQueryAggregations(Series *series,
+                            SeriesIterator *iter,
+                            timestamp_t start_ts,
+                            timestamp_t end_ts,
+                            bool rev,
+                            const SeriesFilter *filter,
+                            const AggregationArgs *aggregation) {
+    return seriesQuery(series, iter, start_ts, end_ts, rev, filter, aggregation);
+}
+
 // this is an internal function that routes the next call to the appropriate chunk iterator function
 static inline ChunkResult SeriesGetNext(SeriesIterator *iter, Sample *sample) {
     return iter->chunkIteratorFuncs.GetNext(iter->chunkIterator, sample);
@@ -79,50 +283,114 @@ static inline ChunkResult SeriesGetPrevious(SeriesIterator *iter, Sample *sample
 }
 
 void SeriesIteratorClose(SeriesIterator *iterator) {
-    iterator->chunkIteratorFuncs.Free(iterator->chunkIterator);
+    for (size_t i = 0; i < iterator->aggregationsCount; i++) {
+        if (!isInlineContext(iterator, iterator->aggregationContexts[i])) {
+            iterator->aggregations[i]->freeContext(iterator->aggregationContexts[i]);
+        }
+    }
+    free(iterator->chunkIteratorScratch.samples);
 
-    if (iterator->aggregationContext != NULL) {
-        iterator->aggregation->freeContext(iterator->aggregationContext);
+    if (iterator->dictIter != NULL) {
+        RedisModule_DictIteratorStop(iterator->dictIter);
     }
+}
 
-    RedisModule_DictIteratorStop(iterator->dictIter);
+/*
+ * Moves to the next chunk of the range that may hold a sample passing the filter, false when there
+ * is none left. FILTER_BY_TS seeks the chunk of the next timestamp to find, instead of walking
+ * through the chunks before it.
+ */
+static bool nextChunk(SeriesIterator *iter) {
+    ChunkFuncs *funcs = iter->series->funcs;
+    Chunk_t *chunk;
+    if (iter->dictIter == NULL) {
+        return false;
+    }
+    timestamp_t next = 0;
+    if (filterByTimestamps(iter)) {
+        if (iter->filterTimestampsCount == 0) {
+            return false;
+        }
+        next = nextFilterTimestamp(iter);
+        timestamp_t rax_key;
+        seriesEncodeTimestamp(&rax_key, next);
+        RedisModule_DictIteratorReseekC(iter->dictIter, "<=", &rax_key, sizeof(rax_key));
+    }
+    while (iter->DictGetNext(iter->dictIter, NULL, (void *)&chunk)) {
+        if (!iter->reverse ? funcs->GetFirstTimestamp(chunk) > iter->maxTimestamp
+                           : funcs->GetLastTimestamp(chunk) < iter->minTimestamp) {
+            return false; // the chunks left are out of range
+        }
+        // the chunk the next timestamp was sought in may end before it
+        if (filterByTimestamps(iter) && (!iter->reverse ? funcs->GetLastTimestamp(chunk) < next
+                                                        : funcs->GetFirstTimestamp(chunk) > next)) {
+            continue;
+        }
+        if (chunkMayMatch(iter, chunk)) {
+            resetChunkIterator(iter, funcs, chunk);
+            return true;
+        }
+    }
+    return false;
 }
 
-static inline void resetChunkIterator(SeriesIterator *iterator,
-                                      const ChunkFuncs *funcs,
-                                      void *currentChunk) {
-    iterator->chunkIteratorFuncs.Free(iterator->chunkIterator);
-    iterator->chunkIterator = funcs->NewChunkIterator(
-        currentChunk, SeriesChunkIteratorOptions(iterator), &iterator->chunkIteratorFuncs);
+/*
+ * Whether the sample passes the filter. When it does not, `skipChunk` tells whether the samples
+ * left in the current chunk cannot pass it either.
+ */
+static bool filterSample(SeriesIterator *iter, const Sample *sample, bool *skipChunk) {
+    const SeriesFilter *filter = iter->filter;
+    ChunkFuncs *funcs = iter->series->funcs;
+    if (filter->timestampsCount > 0) {
+        // the timestamps the series has no sample at are passed
+        while (iter->filterTimestampsCount > 0 &&
+               (!iter->reverse ? nextFilterTimestamp(iter) < sample->timestamp
+                               : nextFilterTimestamp(iter) > sample->timestamp)) {
+            dropFilterTimestamp(iter);
+        }
+        if (iter->filterTimestampsCount == 0) {
+            return false;
+        }
+        timestamp_t next = nextFilterTimestamp(iter);
+        if (next != sample->timestamp) {
+            *skipChunk = !iter->reverse ? funcs->GetLastTimestamp(iter->currentChunk) < next
+                                        : funcs->GetFirstTimestamp(iter->currentChunk) > next;
+            return false;
+        }
+        dropFilterTimestamp(iter);
+    }
+    // NaN never passes
+    if (filter->byValue &&
+        !(sample->value >= filter->minValue && sample->value <= filter->maxValue)) {
+        *skipChunk = !chunkMayMatch(iter, iter->currentChunk);
+        return false;
+    }
+    return true;
 }
 
 // Fills sample from chunk. If all samples were extracted from the chunk, we
 // move to the next chunk.
 ChunkResult _seriesIteratorGetNext(SeriesIterator *iterator, Sample *currentSample) {
     ChunkResult res;
-    ChunkFuncs *funcs = iterator->series->funcs;
-    Chunk_t *currentChunk = iterator->currentChunk;
     const uint64_t itt_max_ts = iterator->maxTimestamp;
     const uint64_t itt_min_ts = iterator->minTimestamp;
     const int not_reverse = !iterator->reverse;
-    if (not_reverse) {
-        while (TRUE) {
-            res = SeriesGetNext(iterator, currentSample);
-            if (res == CR_END) { // Reached the end of the chunk
-                if (!iterator->DictGetNext(iterator->dictIter, NULL, (void *)&currentChunk) ||
-                    funcs->GetFirstTimestamp(currentChunk) > itt_max_ts ||
-                    funcs->GetLastTimestamp(currentChunk) < itt_min_ts) {
-                    return CR_END; // No more chunks or they out of range
-                }
-                resetChunkIterator(iterator, funcs, currentChunk);
-                if (SeriesGetNext(iterator, currentSample) != CR_OK) {
-                    return CR_END;
-                }
-            } else if (res == CR_ERR) {
-                return CR_ERR;
+    while (TRUE) {
+        if (filterByTimestamps(iterator) && iterator->filterTimestampsCount == 0) {
+            return CR_END; // every timestamp to find was passed
+        }
+        res = not_reverse ? SeriesGetNext(iterator, currentSample)
+                          : SeriesGetPrevious(iterator, currentSample);
+        if (res == CR_END) { // Reached the end of the chunk
+            if (!nextChunk(iterator)) {
+                return CR_END; // No more chunks or they out of range
             }
-            // check timestamp is within range
-            // forward range handling
+            continue;
+        } else if (res == CR_ERR) {
+            return CR_ERR;
+        }
+        // check timestamp is within range
+        if (not_reverse) {
             if (currentSample->timestamp < itt_min_ts) {
                 // didn't reach the starting point of the requested range
                 continue;
@@ -131,93 +399,233 @@ ChunkResult _seriesIteratorGetNext(SeriesIterator *iterator, Sample *currentSamp
                 // reached the end of the requested range
                 return CR_END;
             }
-            return CR_OK;
-        }
-    } else {
-        while (TRUE) {
-            res = SeriesGetPrevious(iterator, currentSample);
-            if (res == CR_END) { // Reached the end of the chunk
-                if (!iterator->DictGetNext(iterator->dictIter, NULL, (void *)&currentChunk) ||
-                    funcs->GetFirstTimestamp(currentChunk) > itt_max_ts ||
-                    funcs->GetLastTimestamp(currentChunk) < itt_min_ts) {
-                    return CR_END; // No more chunks or they out of range
-                }
-                resetChunkIterator(iterator, funcs, currentChunk);
-                if (SeriesGetPrevious(iterator, currentSample) != CR_OK) {
-                    return CR_END;
-                }
-            } else if (res == CR_ERR) {
-                return CR_ERR;
-            }
-            // reverse range handling
+        } else {
             if (currentSample->timestamp > itt_max_ts) {
                 // didn't reach our starting range
                 continue;
             }
             if (currentSample->timestamp < itt_min_ts) {
-                // didn't reach the starting point of the requested range
+                // reached the end of the requested range
                 return CR_END;
             }
-            return CR_OK;
         }
+        bool skipChunk = false;
+        if (iterator->filter != NULL && !filterSample(iterator, currentSample, &skipChunk)) {
+            if (skipChunk && !nextChunk(iterator)) {
+                return CR_END;
+            }
+            continue;
+        }
+        return CR_OK;
     }
-    return CR_OK;
-}
-
-ChunkResult SeriesIteratorGetNextAggregated(SeriesIterator *iterator, Sample *currentSample) {
-    Sample internalSample = { 0 };
-    ChunkResult result = _seriesIteratorGetNext(iterator, &internalSample);
-    bool hasSample = FALSE;
-    while (result == CR_OK) {
-        if ((iterator->reverse == FALSE &&
-             internalSample.timestamp >=
-                 iterator->aggregationLastTimestamp + iterator->aggregationTimeDelta) ||
-            (iterator->reverse == TRUE &&
-             internalSample.timestamp < iterator->aggregationLastTimestamp)) {
-            // update the last timestamp before because its relevant for first sample and others
-            if (iterator->aggregationIsFirstSample == FALSE) {
-                double value;
-                if (iterator->aggregation->finalize(iterator->aggregationContext, &value) ==
-                    TSDB_OK) {
-                    currentSample->timestamp = iterator->aggregationLastTimestamp;
-                    currentSample->value = value;
-                    hasSample = TRUE;
-                    iterator->aggregation->resetContext(iterator->aggregationContext);
-                }
+}
+
+// Finalizes the current bucket, false when the first aggregation has no value for it
+static bool finalizeBucket(SeriesIterator *iterator, double *values) {
+    if (iterator->aggregationCapture != NULL) {
+        iterator->aggregations[0]->mergeContext(iterator->aggregationCapture,
+                                                iterator->aggregationContexts[0]);
+    }
+    for (size_t i = 0; i < iterator->aggregationsCount; i++) {
+        if (iterator->aggregations[i]->finalize(iterator->aggregationContexts[i], &values[i]) !=
+            TSDB_OK) {
+            if (i == 0) {
+                return false;
             }
-            iterator->aggregationLastTimestamp =
-                internalSample.timestamp -
-                (internalSample.timestamp % iterator->aggregationTimeDelta);
+            values[i] = NAN;
         }
-        iterator->aggregationIsFirstSample = FALSE;
-        iterator->aggregation->appendValue(iterator->aggregationContext, internalSample.value);
-        if (hasSample) {
-            return CR_OK;
+    }
+    return true;
+}
+
+// The value of an empty bucket with FILL, from the samples around it
+static double fillValue(SeriesIterator *iter, timestamp_t bucket) {
+    const Sample *before = iter->reverse ? &iter->aggregationNextSample : &iter->aggregationLastSample;
+    const Sample *after = iter->reverse ? &iter->aggregationLastSample : &iter->aggregationNextSample;
+    switch (iter->aggregationFill) {
+        case TS_FILL_PREVIOUS:
+            return before->value;
+        case TS_FILL_LINEAR:
+            return before->value + (after->value - before->value) *
+                                       ((double)bucket - (double)before->timestamp) /
+                                       ((double)after->timestamp - (double)before->timestamp);
+        case TS_FILL_VALUE:
+            return iter->aggregationFillValue;
+        case TS_FILL_NONE:
+            break;
+    }
+    return NAN;
+}
+
+/*
+ * Queues `count` empty buckets from `bucket` on, in query order. They lie between the last sample
+ * aggregated and the next one, which closes each of them as it closes a bucket with samples.
+ */
+static void queueEmptyBuckets(SeriesIterator *iter, timestamp_t bucket, u_int64_t count) {
+    iter->aggregationGapBucket = bucket;
+    iter->aggregationGapBuckets = count;
+}
+
+static void nextEmptyBucket(SeriesIterator *iter, timestamp_t *timestamp, double *values) {
+    timestamp_t bucket = iter->aggregationGapBucket;
+    if (iter->aggregationFill == TS_FILL_NONE) {
+        setBucket(iter, bucket);
+        appendCarriedSample(iter, &iter->aggregationNextSample);
+        for (size_t i = 0; i < iter->aggregationsCount; i++) {
+            if (iter->aggregations[i]->finalize(iter->aggregationContexts[i], &values[i]) !=
+                TSDB_OK) {
+                values[i] = NAN;
+            }
+        }
+        resetAggregations(iter);
+    } else {
+        double value = fillValue(iter, bucket);
+        for (size_t i = 0; i < iter->aggregationsCount; i++) {
+            values[i] = value;
         }
-        result = _seriesIteratorGetNext(iterator, &internalSample);
     }
+    *timestamp = bucket;
+    iter->aggregationGapBucket = iter->reverse ? bucket - iter->aggregationTimeDelta
+                                               : bucket + iter->aggregationTimeDelta;
+    iter->aggregationGapBuckets--;
+}
 
-    if (result == CR_END) {
-        if (iterator->aggregationIsFinalized || iterator->aggregationIsFirstSample) {
+static void appendSample(SeriesIterator *iter, const Sample *sample) {
+    for (size_t i = 0; i < iter->aggregationsCount; i++) {
+        iter->aggregations[i]->appendValue(
+            iter->aggregationContexts[i], sample->value, sample->timestamp);
+    }
+    iter->aggregationLastSample = *sample;
+    iter->aggregationHasLastSample = true;
+}
+
+static void openBucket(SeriesIterator *iter, const Sample *sample) {
+    iter->aggregationLastTimestamp = bucketOf(iter, sample->timestamp);
+    iter->aggregationIsFirstSample = FALSE;
+    setBucket(iter, iter->aggregationLastTimestamp);
+    appendSample(iter, sample);
+}
+
+// Number of buckets from one bucket to another
+static inline u_int64_t bucketDistance(SeriesIterator *iter, timestamp_t from, timestamp_t to) {
+    return (from < to ? to - from : from - to) / iter->aggregationTimeDelta;
+}
+
+static ChunkResult seriesIteratorGetNextAggregated(SeriesIterator *iterator,
+                                                   timestamp_t *timestamp,
+                                                   double *values) {
+    const int64_t delta = iterator->aggregationTimeDelta;
+    Sample sample;
+    while (true) {
+        if (iterator->aggregationGapBuckets > 0) {
+            nextEmptyBucket(iterator, timestamp, values);
+            return CR_OK;
+        }
+        if (iterator->aggregationHasNextSample) {
+            // the sample that closed the previous bucket opens its own
+            iterator->aggregationHasNextSample = false;
+            openBucket(iterator, &iterator->aggregationNextSample);
+        }
+        if (iterator->aggregationIsFinalized) {
             return CR_END;
-        } else {
-            double value;
-            if (iterator->aggregation->finalize(iterator->aggregationContext, &value) == TSDB_OK) {
-                currentSample->timestamp = iterator->aggregationLastTimestamp;
-                currentSample->value = value;
-            }
+        }
+
+        ChunkResult result = _seriesIteratorGetNext(iterator, &sample);
+        if (result == CR_ERR) {
+            return CR_ERR;
+        }
+        // the first and last buckets of the range and the series limit the empty buckets
+        const timestamp_t firstBucket =
+            bucketOf(iterator, iterator->reverse ? iterator->maxTimestamp : iterator->minTimestamp);
+        const timestamp_t lastBucket =
+            bucketOf(iterator, iterator->reverse ? iterator->minTimestamp : iterator->maxTimestamp);
+        if (result == CR_END) {
             iterator->aggregationIsFinalized = TRUE;
+            bool hasNext = (carriesSample(iterator) || iterator->aggregationEmpty) &&
+                           sampleOutsideRange(iterator,
+                                              iterator->reverse,
+                                              &iterator->aggregationNextSample);
+            if (iterator->aggregationIsFirstSample) {
+                // nothing in range, it is empty when the series goes on at both ends
+                if (iterator->aggregationEmpty && iterator->aggregationHasLastSample && hasNext) {
+                    queueEmptyBuckets(
+                        iterator, firstBucket, bucketDistance(iterator, firstBucket, lastBucket) + 1);
+                }
+                continue;
+            }
+            if (hasNext) {
+                appendCarriedSample(iterator, &iterator->aggregationNextSample);
+            }
+            const timestamp_t closed = iterator->aggregationLastTimestamp;
+            bool found = finalizeBucket(iterator, values);
+            *timestamp = closed;
+            if (iterator->aggregationEmpty && hasNext) {
+                resetAggregations(iterator);
+                queueEmptyBuckets(iterator,
+                                  iterator->reverse ? closed - delta : closed + delta,
+                                  bucketDistance(iterator, closed, lastBucket));
+            }
+            if (found) {
+                return CR_OK;
+            }
+            continue;
+        }
+
+        timestamp_t bucket = bucketOf(iterator, sample.timestamp);
+        if (iterator->aggregationIsFirstSample) {
+            if (iterator->aggregationEmpty && iterator->aggregationHasLastSample &&
+                bucket != firstBucket) {
+                queueEmptyBuckets(iterator, firstBucket, bucketDistance(iterator, firstBucket, bucket));
+                iterator->aggregationNextSample = sample;
+                iterator->aggregationHasNextSample = true;
+            } else {
+                openBucket(iterator, &sample);
+            }
+            continue;
+        }
+        if (bucket == iterator->aggregationLastTimestamp) {
+            appendSample(iterator, &sample);
+            continue;
+        }
+
+        // the sample closes the bucket
+        const timestamp_t closed = iterator->aggregationLastTimestamp;
+        appendCarriedSample(iterator, &sample);
+        bool found = finalizeBucket(iterator, values);
+        *timestamp = closed;
+        // a skipped bucket must not leak into the next one either
+        resetAggregations(iterator);
+        if (iterator->aggregationEmpty) {
+            queueEmptyBuckets(iterator,
+                              iterator->reverse ? closed - delta : closed + delta,
+                              bucketDistance(iterator, closed, bucket) - 1);
+        }
+        iterator->aggregationNextSample = sample;
+        iterator->aggregationHasNextSample = true;
+        if (found) {
             return CR_OK;
         }
-    } else {
-        return CR_ERR;
     }
 }
 
 ChunkResult SeriesIteratorGetNext(SeriesIterator *iterator, Sample *currentSample) {
-    if (iterator->aggregation == NULL) {
+    if (iterator->aggregationsCount == 0) {
         return _seriesIteratorGetNext(iterator, currentSample);
     } else {
-        return SeriesIteratorGetNextAggregated(iterator, currentSample);
+        return seriesIteratorGetNextAggregated(
+            iterator, &currentSample->timestamp, &currentSample->value);
+    }
+}
+
+ChunkResult SeriesIteratorGetNextValues(SeriesIterator *iterator,
+                                        timestamp_t *timestamp,
+                                        double *values) {
+    if (iterator->aggregationsCount == 0) {
+        Sample sample;
+        ChunkResult result = _seriesIteratorGetNext(iterator, &sample);
+        *timestamp = sample.timestamp;
+        values[0] = sample.value;
+        return result;
     }
+    return seriesIteratorGetNextAggregated(iterator, timestamp, values);
 }
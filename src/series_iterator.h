@@ -3,28 +3,72 @@
  *
  * This file is available under the Redis Labs Source Available License Agreement
  */
+#include "chunk.h"
+#include "compressed_chunk.h"
 #include "tsdb.h"
 
 #ifndef REDIS_TIMESERIES_CLEAN_SERIES_ITERATOR_H
 #define REDIS_TIMESERIES_CLEAN_SERIES_ITERATOR_H
 
+// Room for the chunk iterator of any chunk type, see ChunkFuncs.InitChunkIterator
+typedef union ChunkIterStorage
+{
+    ChunkIterator uncompressed;
+    Compressed_Iterator compressed;
+    Compressed_ReverseIterator compressedReverse;
+} ChunkIterStorage;
+
+// Aggregation contexts are packed inside the iterator while they fit, the rest go to the heap
+#define SERIES_ITERATOR_AGG_STORAGE_SIZE 256
+
+/*
+ * A query keeps its chunk iterator and aggregation contexts inline, so iterating a range does not
+ * allocate. The iterator points into itself and must not be moved after SeriesQuery.
+ */
 typedef struct SeriesIterator
 {
     Series *series;
-    RedisModuleDictIter *dictIter;
+    RedisModuleDictIter *dictIter; // NULL when the whole range is in the last chunk
     Chunk_t *currentChunk;
     ChunkIter_t *chunkIterator;
     ChunkIterFuncs chunkIteratorFuncs;
+    ChunkIterStorage chunkIteratorStorage;
+    ChunkIterScratch chunkIteratorScratch;
     api_timestamp_t maxTimestamp;
     api_timestamp_t minTimestamp;
     bool reverse;
+    // FILTER_BY_TS and FILTER_BY_VALUE, NULL without them
+    const SeriesFilter *filter;
+    // the timestamps of FILTER_BY_TS left to find in the range, from the last one in reverse
+    const timestamp_t *filterTimestamps;
+    size_t filterTimestampsCount;
     void *(*DictGetNext)(RedisModuleDictIter *di, size_t *keylen, void **dataptr);
-    AggregationClass *aggregation;
-    void *aggregationContext;
+    size_t aggregationsCount; // 0 for raw samples
+    AggregationClass *aggregations[TS_AGG_TYPES_MAX];
+    void *aggregationContexts[TS_AGG_TYPES_MAX];
+    union
+    {
+        char bytes[SERIES_ITERATOR_AGG_STORAGE_SIZE];
+        double align;
+    } aggregationStorage;
     timestamp_t aggregationLastTimestamp;
     int64_t aggregationTimeDelta;
     bool aggregationIsFirstSample;
     bool aggregationIsFinalized;
+    // EMPTY and FILL, see AggregationArgs
+    bool aggregationEmpty;
+    TS_FILL_T aggregationFill;
+    double aggregationFillValue;
+    // the last sample aggregated, or the one before the range in query order
+    Sample aggregationLastSample;
+    bool aggregationHasLastSample;
+    // the sample after the empty buckets left, it opens its bucket once they are reported
+    Sample aggregationNextSample;
+    bool aggregationHasNextSample;
+    timestamp_t aggregationGapBucket;
+    u_int64_t aggregationGapBuckets;
+    // when set, the context of the first aggregation is merged into it as each bucket is finalized
+    void *aggregationCapture;
 } SeriesIterator;
 
 int SeriesQuery(Series *series,
@@ -35,8 +79,29 @@ int SeriesQuery(Series *series,
                 AggregationClass *aggregation,
                 int64_t time_delta);
 
+/*
+ * Like SeriesQuery, with every aggregation of `aggregation` (NULL for raw samples) fed in one pass.
+ * Only the samples passing `filter` (NULL for all of them) are returned or aggregated, the chunks
+ * that cannot hold any of them are skipped without being decoded.
+ */
+int SeriesQueryAggregations(Series *series,
+                            SeriesIterator *iter,
+                            timestamp_t start_ts,
+                            timestamp_t end_ts,
+                            bool rev,
+                            const SeriesFilter *filter,
+                            const AggregationArgs *aggregation);
+
+// Returns the next sample, or bucket of a query with a single aggregation
 ChunkResult SeriesIteratorGetNext(SeriesIterator *iterator, Sample *currentSample);
 
+// Returns the next bucket with one value per aggregation, in query order, or the next sample as a
+// single value. Buckets the first aggregation has no value for are skipped, the other
+// aggregations give NaN for the buckets they have no value for.
+ChunkResult SeriesIteratorGetNextValues(SeriesIterator *iterator,
+                                        timestamp_t *timestamp,
+                                        double *values);
+
 void SeriesIteratorClose(SeriesIterator *iterator);
 
 #endif // REDIS_TIMESERIES_CLEAN_SERIES_ITERATOR_H
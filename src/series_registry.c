@@ -0,0 +1,75 @@
+/*
+ * Copyright 2018-2020 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "series_registry.h"
+
+#include "endianconv.h"
+#include "module.h"
+#include "tsdb.h"
+
+static RedisModuleDict *registry = NULL;
+static uint64_t nextSeriesId = 1;
+
+void SeriesRegistry_Init() {
+    registry = RedisModule_CreateDict(NULL);
+}
+
+void SeriesRegistry_Add(Series *series) {
+    if (series->id == 0) {
+        series->id = nextSeriesId++;
+    }
+    uint64_t key = htonu64(series->id);
+    RedisModule_DictReplaceC(registry, &key, sizeof(key), series);
+}
+
+void SeriesRegistry_Remove(Series *series) {
+    uint64_t key = htonu64(series->id);
+    RedisModule_DictDelC(registry, &key, sizeof(key), NULL);
+}
+
+void SeriesRegistry_Update(Series *series) {
+    uint64_t key = htonu64(series->id);
+    RedisModule_DictReplaceC(registry, &key, sizeof(key), series);
+}
+
+Series *SeriesRegistry_Lookup(RedisModuleCtx *ctx, uint64_t id) {
+    uint64_t key = htonu64(id);
+    Series *series = RedisModule_DictGetC(registry, &key, sizeof(key), NULL);
+    if (series == NULL) {
+        return NULL;
+    }
+    int db = RedisModule_GetSelectedDb(ctx);
+    if (series->db != -1) {
+        return series->db == db ? series : NULL;
+    }
+
+    // Opening the key applies its TTL, which may free the series: only compare the pointer
+    // until it is known to still be there.
+    RedisModuleKey *seriesKey = RedisModule_OpenKey(ctx, series->keyName, REDISMODULE_READ);
+    bool found = RedisModule_ModuleTypeGetType(seriesKey) == SeriesType &&
+                 RedisModule_ModuleTypeGetValue(seriesKey) == series;
+    if (found && RedisModule_GetExpire(seriesKey) == REDISMODULE_NO_EXPIRE) {
+        series->db = db;
+    }
+    RedisModule_CloseKey(seriesKey);
+    return found ? series : NULL;
+}
+
+void SeriesRegistry_Invalidate(Series *series) {
+    series->db = -1;
+}
+
+void SeriesRegistry_SwapDb(int first, int second) {
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(registry, "^", NULL, 0);
+    Series *series;
+    while (RedisModule_DictNextC(iter, NULL, (void *)&series) != NULL) {
+        if (series->db == first) {
+            series->db = second;
+        } else if (series->db == second) {
+            series->db = first;
+        }
+    }
+    RedisModule_DictIteratorStop(iter);
+}
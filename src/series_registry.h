@@ -0,0 +1,32 @@
+/*
+ * Copyright 2018-2020 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#ifndef SERIES_REGISTRY_H
+#define SERIES_REGISTRY_H
+
+#include "redismodule.h"
+
+#include <stdint.h>
+
+struct Series;
+
+// Every series in the keyspace gets a stable numeric id that the inverted index stores next to
+// its key name. Multi-series commands resolve query results through this table instead of
+// opening every matched key. An entry lives from key creation (or load) until the value is
+// unlinked; renames and moves keep the id.
+
+void SeriesRegistry_Init();
+// Registers the series, assigning a new id unless it already has one
+void SeriesRegistry_Add(struct Series *series);
+void SeriesRegistry_Remove(struct Series *series);
+// Points the id of the series at its current address, after active defrag moved it
+void SeriesRegistry_Update(struct Series *series);
+// Returns the series with this id if it is visible in the db selected in `ctx`, NULL otherwise
+struct Series *SeriesRegistry_Lookup(RedisModuleCtx *ctx, uint64_t id);
+// Forces the next lookup of the series through the keyspace (TTL set, db unknown)
+void SeriesRegistry_Invalidate(struct Series *series);
+void SeriesRegistry_SwapDb(int first, int second);
+
+#endif
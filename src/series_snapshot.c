@@ -0,0 +1,69 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "series_snapshot.h"
+
+#include <stdbool.h>
+#include <rmutil/alloc.h>
+
+Chunk_t **SeriesPinChunks(Series *series,
+                          api_timestamp_t start_ts,
+                          api_timestamp_t end_ts,
+                          size_t *count) {
+    ChunkFuncs *funcs = series->funcs;
+    size_t capacity = 16;
+    Chunk_t **chunks = malloc(capacity * sizeof(Chunk_t *));
+    *count = 0;
+
+    timestamp_t rax_key;
+    seriesEncodeTimestamp(&rax_key, start_ts);
+    RedisModuleDictIter *iter =
+        RedisModule_DictIteratorStartC(series->chunks, "<=", &rax_key, sizeof(rax_key));
+    Chunk_t *chunk;
+    bool found = RedisModule_DictNextC(iter, NULL, (void *)&chunk) != NULL;
+    if (!found) {
+        RedisModule_DictIteratorReseekC(iter, "^", NULL, 0);
+        found = RedisModule_DictNextC(iter, NULL, (void *)&chunk) != NULL;
+    }
+    for (; found; found = RedisModule_DictNextC(iter, NULL, (void *)&chunk) != NULL) {
+        if (funcs->GetNumOfSample(chunk) == 0 || funcs->GetLastTimestamp(chunk) < start_ts) {
+            continue;
+        }
+        if (funcs->GetFirstTimestamp(chunk) > end_ts) {
+            break;
+        }
+        if (*count == capacity) {
+            capacity *= 2;
+            chunks = realloc(chunks, capacity * sizeof(Chunk_t *));
+        }
+        chunks[(*count)++] = funcs->RetainChunk(chunk);
+    }
+    RedisModule_DictIteratorStop(iter);
+    return chunks;
+}
+
+void SeriesReleaseChunks(ChunkFuncs *funcs, Chunk_t **chunks, size_t count) {
+    // the chunks replaced or deleted since they were pinned are freed here
+    for (size_t i = 0; i < count; i++) {
+        funcs->FreeChunk(chunks[i]);
+    }
+    free(chunks);
+}
+
+Series SeriesSnapshot(ChunkFuncs *funcs, Chunk_t **chunks, size_t count) {
+    RedisModuleDict *dict = RedisModule_CreateDict(NULL);
+    for (size_t i = 0; i < count; i++) {
+        timestamp_t rax_key;
+        seriesEncodeTimestamp(&rax_key, funcs->GetFirstTimestamp(chunks[i]));
+        RedisModule_DictSetC(dict, &rax_key, sizeof(rax_key), chunks[i]);
+    }
+    return (Series){ .chunks = dict,
+                     .lastChunk = count > 0 ? chunks[count - 1] : NULL,
+                     .funcs = funcs };
+}
+
+void SeriesSnapshotFree(Series *snapshot) {
+    RedisModule_FreeDict(NULL, snapshot->chunks);
+}
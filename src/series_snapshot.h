@@ -0,0 +1,35 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#ifndef SERIES_SNAPSHOT_H
+#define SERIES_SNAPSHOT_H
+
+#include "consts.h"
+#include "generic_chunk.h"
+#include "tsdb.h"
+
+#include <stddef.h>
+
+/*
+ * Queries running off the main thread read pinned chunks (see RetainChunk): writers copy them
+ * instead of changing them, and they outlive a deleted series until they are released.
+ */
+
+// Pins the chunks of the series holding samples of [start_ts, end_ts], in time order
+Chunk_t **SeriesPinChunks(Series *series,
+                          api_timestamp_t start_ts,
+                          api_timestamp_t end_ts,
+                          size_t *count);
+
+// Drops the pins of SeriesPinChunks, may run on any thread
+void SeriesReleaseChunks(ChunkFuncs *funcs, Chunk_t **chunks, size_t count);
+
+// A series over pinned chunks, which a SeriesIterator can query on any thread. Only its chunks,
+// last chunk and chunk functions are set, it must hold at least one chunk to be queried.
+Series SeriesSnapshot(ChunkFuncs *funcs, Chunk_t **chunks, size_t count);
+
+void SeriesSnapshotFree(Series *snapshot);
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "thread_pool.h"
+
+#include "consts.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <rmutil/alloc.h>
+
+typedef struct ThreadPoolTask
+{
+    ThreadPoolJob job;
+    void *arg;
+    struct ThreadPoolTask *next;
+} ThreadPoolTask;
+
+static pthread_mutex_t queueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queueNotEmpty = PTHREAD_COND_INITIALIZER;
+static ThreadPoolTask *queueHead = NULL;
+static ThreadPoolTask *queueTail = NULL;
+static size_t poolSize = 0;
+
+static void *workerMain(void *unused) {
+    while (true) {
+        pthread_mutex_lock(&queueLock);
+        while (queueHead == NULL) {
+            pthread_cond_wait(&queueNotEmpty, &queueLock);
+        }
+        ThreadPoolTask *task = queueHead;
+        queueHead = task->next;
+        if (queueHead == NULL) {
+            queueTail = NULL;
+        }
+        pthread_mutex_unlock(&queueLock);
+
+        task->job(task->arg);
+        free(task);
+    }
+    return NULL;
+}
+
+int ThreadPool_Init(size_t threads) {
+    for (; poolSize < threads; poolSize++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, workerMain, NULL) != 0) {
+            return TSDB_ERROR;
+        }
+        pthread_detach(thread);
+    }
+    return TSDB_OK;
+}
+
+size_t ThreadPool_Size() {
+    return poolSize;
+}
+
+size_t ThreadPool_MaxTasks(long long fanout) {
+    if (fanout > 0 && (size_t)fanout < poolSize) {
+        return fanout;
+    }
+    return poolSize;
+}
+
+void ThreadPool_Push(ThreadPoolJob job, void *arg) {
+    ThreadPoolTask *task = malloc(sizeof(ThreadPoolTask));
+    task->job = job;
+    task->arg = arg;
+    task->next = NULL;
+
+    pthread_mutex_lock(&queueLock);
+    if (queueTail == NULL) {
+        queueHead = task;
+    } else {
+        queueTail->next = task;
+    }
+    queueTail = task;
+    pthread_cond_signal(&queueNotEmpty);
+    pthread_mutex_unlock(&queueLock);
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+
+// A job run on one of the pool threads, it must not touch the keyspace
+typedef void (*ThreadPoolJob)(void *arg);
+
+// Starts `threads` worker threads, 0 leaves the pool empty and every query on the main thread
+int ThreadPool_Init(size_t threads);
+
+// Number of worker threads, 0 when the pool is disabled
+size_t ThreadPool_Size();
+
+// Number of jobs a single query may run at once, the pool size capped by a non-zero `fanout`
+size_t ThreadPool_MaxTasks(long long fanout);
+
+// Queues a job, jobs start in the order they were queued
+void ThreadPool_Push(ThreadPoolJob job, void *arg);
+
+#endif
@@ -0,0 +1,261 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "topk.h"
+
+#include "indexer.h"
+#include "reply.h"
+#include "series_iterator.h"
+#include "series_registry.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <rmutil/alloc.h>
+
+// A series ranked by TOPK
+typedef struct TopKEntry
+{
+    Series *series;
+    double score;
+    size_t order; // of the series in key order, the first one wins a tie
+} TopKEntry;
+
+/*
+ * The k best series so far, the worst of them on top so that it is the one a better series
+ * replaces.
+ */
+typedef struct TopKHeap
+{
+    TopKEntry *entries;
+    size_t count;
+    size_t capacity;
+    bool ascending;
+} TopKHeap;
+
+// True when `a` ranks before `b`. A NaN score ranks after any other score.
+static bool rankedBefore(const TopKHeap *h, const TopKEntry *a, const TopKEntry *b) {
+    if (isnan(a->score) != isnan(b->score)) {
+        return isnan(b->score);
+    }
+    if (!isnan(a->score) && a->score != b->score) {
+        return h->ascending ? a->score < b->score : a->score > b->score;
+    }
+    return a->order < b->order;
+}
+
+static void topKSwap(TopKHeap *h, size_t i, size_t j) {
+    const TopKEntry tmp = h->entries[i];
+    h->entries[i] = h->entries[j];
+    h->entries[j] = tmp;
+}
+
+static void topKHeapDown(TopKHeap *h, size_t i) {
+    while (true) {
+        size_t next = i;
+        const size_t left = 2 * i + 1, right = 2 * i + 2;
+        if (left < h->count && rankedBefore(h, &h->entries[next], &h->entries[left])) {
+            next = left;
+        }
+        if (right < h->count && rankedBefore(h, &h->entries[next], &h->entries[right])) {
+            next = right;
+        }
+        if (next == i) {
+            return;
+        }
+        topKSwap(h, i, next);
+        i = next;
+    }
+}
+
+static void topKHeapUp(TopKHeap *h, size_t i) {
+    while (i > 0) {
+        const size_t parent = (i - 1) / 2;
+        if (!rankedBefore(h, &h->entries[parent], &h->entries[i])) {
+            return;
+        }
+        topKSwap(h, i, parent);
+        i = parent;
+    }
+}
+
+static void topKHeapOffer(TopKHeap *h, const TopKEntry *entry) {
+    if (h->count < h->capacity) {
+        h->entries[h->count++] = *entry;
+        topKHeapUp(h, h->count - 1);
+    } else if (rankedBefore(h, entry, &h->entries[0])) {
+        h->entries[0] = *entry;
+        topKHeapDown(h, 0);
+    }
+}
+
+/*
+ * Bounds of the values of the chunks overlapping the range, false when the range holds no
+ * sample. The bounds of a chunk leave NaN values out, NaN bounds are never used to skip a series.
+ */
+static bool rangeValueBounds(Series *series,
+                             api_timestamp_t start_ts,
+                             api_timestamp_t end_ts,
+                             double *lower,
+                             double *upper) {
+    ChunkFuncs *funcs = series->funcs;
+    bool found = false;
+    timestamp_t rax_key;
+    seriesEncodeTimestamp(&rax_key, start_ts);
+    RedisModuleDictIter *iter =
+        RedisModule_DictIteratorStartC(series->chunks, "<=", &rax_key, sizeof(rax_key));
+    Chunk_t *chunk;
+    bool more = RedisModule_DictNextC(iter, NULL, (void *)&chunk) != NULL;
+    if (!more) {
+        RedisModule_DictIteratorReseekC(iter, "^", NULL, 0);
+        more = RedisModule_DictNextC(iter, NULL, (void *)&chunk) != NULL;
+    }
+    for (; more; more = RedisModule_DictNextC(iter, NULL, (void *)&chunk) != NULL) {
+        if (funcs->GetNumOfSample(chunk) == 0 || funcs->GetLastTimestamp(chunk) < start_ts) {
+            continue;
+        }
+        if (funcs->GetFirstTimestamp(chunk) > end_ts) {
+            break;
+        }
+        double min, max;
+        if (!funcs->GetValueRange(chunk, &min, &max)) {
+            continue;
+        }
+        *lower = found ? fmin(*lower, min) : min;
+        *upper = found ? fmax(*upper, max) : max;
+        found = true;
+    }
+    RedisModule_DictIteratorStop(iter);
+    return found;
+}
+
+// False when the series cannot take the place of the worst of the k best so far
+static bool mayEnterTopK(const TopKHeap *h, TopKScore score, double lower, double upper) {
+    if (h->count < h->capacity || score == TopKScore_Sum) {
+        return true;
+    }
+    // a series scoring the same as the worst one loses the tie, it comes later in key order
+    const double kth = h->entries[0].score;
+    return isnan(kth) || (h->ascending ? !(lower >= kth) : !(upper <= kth));
+}
+
+// Scores the series over the samples of the range, false when it has none
+static bool scoreSeries(Series *series,
+                        api_timestamp_t start_ts,
+                        api_timestamp_t end_ts,
+                        const SeriesFilter *filter,
+                        TopKScore score,
+                        double *result) {
+    SeriesIterator iter;
+    // the last sample is the first one in reverse
+    if (SeriesQueryAggregations(
+            series, &iter, start_ts, end_ts, score == TopKScore_Last, filter, NULL) != TSDB_OK) {
+        return false;
+    }
+    Sample sample;
+    size_t count = 0;
+    double total = 0;
+    double max = NAN;
+    while (SeriesIteratorGetNext(&iter, &sample) == CR_OK) {
+        count++;
+        if (score == TopKScore_Last) {
+            total = sample.value;
+            break;
+        }
+        total += sample.value;
+        if (isnan(max) || sample.value > max) {
+            max = sample.value;
+        }
+    }
+    SeriesIteratorClose(&iter);
+    if (count == 0) {
+        return false;
+    }
+    switch (score) {
+        case TopKScore_Max:
+            *result = max;
+            break;
+        case TopKScore_Avg:
+            *result = total / count;
+            break;
+        case TopKScore_Sum:
+        case TopKScore_Last:
+            *result = total;
+            break;
+    }
+    return true;
+}
+
+static void rankSeries(TopKHeap *h, Series *series, size_t order, const MRangeArgs *args) {
+    api_timestamp_t start_ts = args->startTimestamp;
+    if (!ApplyRetention(series, &start_ts, args->endTimestamp)) {
+        return;
+    }
+    double lower, upper;
+    if (!rangeValueBounds(series, start_ts, args->endTimestamp, &lower, &upper) ||
+        !mayEnterTopK(h, args->topKScore, lower, upper)) {
+        return;
+    }
+    TopKEntry entry = { .series = series, .order = order };
+    if (scoreSeries(series,
+                    start_ts,
+                    args->endTimestamp,
+                    &args->filter,
+                    args->topKScore,
+                    &entry.score)) {
+        topKHeapOffer(h, &entry);
+    }
+}
+
+int ReplyTopKMultiRange(RedisModuleCtx *ctx, RedisModuleDict *result, const MRangeArgs *args) {
+    const size_t matched = RedisModule_DictSize(result);
+    TopKHeap h = { .capacity = min((size_t)args->topK, matched),
+                   .count = 0,
+                   .ascending = args->topKAscending };
+    h.entries = malloc(max(h.capacity, 1) * sizeof(TopKEntry));
+
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(result, "^", NULL, 0);
+    char *currentKey;
+    size_t currentKeyLen;
+    size_t order = 0;
+    void *seriesId;
+    while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, &seriesId)) != NULL) {
+        Series *series = SeriesRegistry_Lookup(ctx, (uintptr_t)seriesId);
+        if (series == NULL) {
+            RedisModule_Log(ctx,
+                            "warning",
+                            "couldn't open key or key is not a Timeseries. key=%.*s",
+                            (int)currentKeyLen,
+                            currentKey);
+            // The iterator may have been invalidated, stop and restart from after the current key.
+            RedisModule_DictIteratorStop(iter);
+            iter = RedisModule_DictIteratorStartC(result, ">", currentKey, currentKeyLen);
+            continue;
+        }
+        rankSeries(&h, series, order++, args);
+    }
+    RedisModule_DictIteratorStop(iter);
+
+    // the worst winner is on top, popping it to the back sorts the winners best first
+    const size_t winners = h.count;
+    while (h.count > 0) {
+        topKSwap(&h, 0, --h.count);
+        topKHeapDown(&h, 0);
+    }
+
+    RedisModule_ReplyWithArray(ctx, winners);
+    for (size_t i = 0; i < winners; i++) {
+        ReplySeriesArrayPos(ctx,
+                            h.entries[i].series,
+                            args->withLabels,
+                            args->startTimestamp,
+                            args->endTimestamp,
+                            &args->filter,
+                            &args->aggregationArgs,
+                            args->count,
+                            args->reverse);
+    }
+    free(h.entries);
+    return REDISMODULE_OK;
+}
@@ -0,0 +1,22 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#ifndef TOPK_H
+#define TOPK_H
+
+#include "query_language.h"
+#include "redismodule.h"
+
+/*
+ * TS.MRANGE ... TOPK k BY max|avg|sum|last [ASC|DESC] scores every matched series over the raw
+ * samples of its range in a single pass and keeps the k best on a bounded heap. Only the winners
+ * are queried for the reply, best first. The value bounds of the chunks (see GetValueRange) tell
+ * which series cannot beat the k-th best, those are not decoded at all.
+ */
+
+// Replies like TSDB_generic_mrange with the `args->topK` best series of `result` only
+int ReplyTopKMultiRange(RedisModuleCtx *ctx, RedisModuleDict *result, const MRangeArgs *args);
+
+#endif
@@ -5,19 +5,32 @@
  */
 #include "tsdb.h"
 
+#include "cold_tier.h"
 #include "config.h"
 #include "consts.h"
 #include "endianconv.h"
 #include "indexer.h"
 #include "module.h"
 #include "series_iterator.h"
+#include "series_registry.h"
 
 #include <math.h>
+#include <pthread.h>
 #include "rmutil/alloc.h"
 #include "rmutil/logging.h"
 #include "rmutil/strings.h"
 
-static Series *lastDeletedSeries = NULL;
+// Compaction state of the last unlinked series, kept until its "del" notification
+typedef struct DeletedSeries
+{
+    const Series *series; // only compared, the value may be gone already
+    RedisModuleString *keyName;
+    RedisModuleString *srcKey;
+    CompactionRule *rules;
+} DeletedSeries;
+
+static DeletedSeries lastDeletedSeries = { 0 };
+static pthread_t mainThread;
 
 int GetSeries(RedisModuleCtx *ctx,
               RedisModuleString *keyName,
@@ -71,6 +84,25 @@ int dictOperator(RedisModuleDict *d, void *chunk, timestamp_t ts, DictOp op) {
     return REDISMODULE_OK; // silence compiler
 }
 
+/*
+ * Chunks are not preallocated at the full chunk size. They start small and grow as samples are
+ * appended, so slowly ingesting series do not keep mostly empty buffers around. The chunk dict is
+ * still created with the series: a single entry costs far less than the buffer did, and every
+ * reader walks series->chunks.
+ */
+static size_t seriesInitialChunkSize(const Series *series) {
+    return min(INITIAL_CHUNK_SIZE_BYTES, series->chunkSizeBytes);
+}
+
+// Next jemalloc size class: four classes per doubling, e.g. 128, 160, 192, 224, 256, 320...
+static size_t nextChunkSize(size_t size) {
+    size_t step = 16;
+    while (step * 8 <= size) {
+        step *= 2;
+    }
+    return (size / step + 1) * step;
+}
+
 Series *NewSeries(RedisModuleString *keyName, CreateCtx *cCtx) {
     Series *newSeries = (Series *)malloc(sizeof(Series));
     newSeries->keyName = keyName;
@@ -87,6 +119,17 @@ Series *NewSeries(RedisModuleString *keyName, CreateCtx *cCtx) {
     newSeries->options = cCtx->options;
     newSeries->duplicatePolicy = cCtx->duplicatePolicy;
     newSeries->isTemporary = cCtx->isTemporary;
+    newSeries->isUnlinked = false;
+    newSeries->chunksMemory = (ChunksMemory){ 0 };
+    newSeries->fieldsCount = 0;
+    newSeries->fieldNames = NULL;
+    newSeries->fields = NULL;
+    newSeries->levels = NULL;
+    newSeries->id = 0;
+    newSeries->db = -1;
+    if (!newSeries->isTemporary) {
+        TSMemStats.seriesCount++;
+    }
 
     if (newSeries->options & SERIES_OPT_UNCOMPRESSED) {
         newSeries->options |= SERIES_OPT_UNCOMPRESSED;
@@ -94,12 +137,58 @@ Series *NewSeries(RedisModuleString *keyName, CreateCtx *cCtx) {
     } else {
         newSeries->funcs = GetChunkClass(CHUNK_COMPRESSED);
     }
-    Chunk_t *newChunk = newSeries->funcs->NewChunk(newSeries->chunkSizeBytes);
+    Chunk_t *newChunk = newSeries->funcs->NewChunk(seriesInitialChunkSize(newSeries));
     dictOperator(newSeries->chunks, newChunk, 0, DICT_OP_SET);
+    SeriesAccountChunk(newSeries, newChunk, 1);
     newSeries->lastChunk = newChunk;
     return newSeries;
 }
 
+/*
+ * Chunks pinned by a reader (see RetainChunk) are immutable. Before changing one in place, a writer
+ * swaps a private copy into the series and drops its own reference to the pinned version, which is
+ * freed once the last reader releases it.
+ */
+static Chunk_t *seriesUnshareChunk(Series *series, Chunk_t *chunk) {
+    ChunkFuncs *funcs = series->funcs;
+    if (!funcs->IsChunkShared(chunk)) {
+        return chunk;
+    }
+    // chunks are keyed by their first timestamp, except the first one which may be keyed 0
+    timestamp_t ts = funcs->GetNumOfSample(chunk) > 0 ? funcs->GetFirstTimestamp(chunk) : 0;
+    timestamp_t rax_key;
+    seriesEncodeTimestamp(&rax_key, ts);
+    if (RedisModule_DictGetC(series->chunks, &rax_key, sizeof(rax_key), NULL) != chunk) {
+        ts = 0;
+    }
+    Chunk_t *copy = funcs->CloneChunk(chunk);
+    dictOperator(series->chunks, copy, ts, DICT_OP_REPLACE);
+    SeriesAccountChunk(series, chunk, -1);
+    SeriesAccountChunk(series, copy, 1);
+    if (series->lastChunk == chunk) {
+        series->lastChunk = copy;
+    }
+    funcs->FreeChunk(chunk);
+    return copy;
+}
+
+void SeriesAccountChunk(Series *series, Chunk_t *chunk, int sign) {
+    ChunkFuncs *funcs = series->funcs;
+    size_t buffer = funcs->GetChunkSize(chunk, false);
+    ChunksMemory mem = {
+        .headers = funcs->GetChunkSize(chunk, true) - buffer,
+        .buffers = buffer,
+        .data = funcs->GetChunkDataSize(chunk),
+    };
+    // unsigned wrap-around makes the subtraction well defined
+    series->chunksMemory.headers += sign * mem.headers;
+    series->chunksMemory.buffers += sign * mem.buffers;
+    series->chunksMemory.data += sign * mem.data;
+    if (!series->isTemporary) {
+        MemStats_AccountChunks(&mem, 1, sign);
+    }
+}
+
 void SeriesTrim(Series *series) {
     if (series->retentionTime == 0) {
         return;
@@ -122,6 +211,7 @@ void SeriesTrim(Series *series) {
             RedisModule_DictIteratorReseekC(iter, ">", currentKey, keyLen);
 
             series->totalSamples -= series->funcs->GetNumOfSample(currentChunk);
+            SeriesAccountChunk(series, currentChunk, -1);
             series->funcs->FreeChunk(currentChunk);
         } else {
             break;
@@ -138,48 +228,47 @@ void seriesEncodeTimestamp(void *buf, timestamp_t timestamp) {
 }
 
 void freeLastDeletedSeries() {
-    if (lastDeletedSeries == NULL) {
+    if (lastDeletedSeries.keyName == NULL) {
         return;
     }
-    CompactionRule *rule = lastDeletedSeries->rules;
+    CompactionRule *rule = lastDeletedSeries.rules;
     while (rule != NULL) {
         CompactionRule *nextRule = rule->nextRule;
         FreeCompactionRule(rule);
         rule = nextRule;
     }
-    if (lastDeletedSeries->srcKey != NULL) {
-        RedisModule_FreeString(NULL, lastDeletedSeries->srcKey);
+    if (lastDeletedSeries.srcKey != NULL) {
+        RedisModule_FreeString(NULL, lastDeletedSeries.srcKey);
     }
-    RedisModule_FreeString(NULL, lastDeletedSeries->keyName);
-    free(lastDeletedSeries);
-    lastDeletedSeries = NULL;
+    RedisModule_FreeString(NULL, lastDeletedSeries.keyName);
+    lastDeletedSeries = (DeletedSeries){ 0 };
 }
 
 void CleanLastDeletedSeries(RedisModuleCtx *ctx, RedisModuleString *key) {
-    if (lastDeletedSeries != NULL &&
-        RedisModule_StringCompare(lastDeletedSeries->keyName, key) == 0) {
-        CompactionRule *rule = lastDeletedSeries->rules;
+    if (lastDeletedSeries.keyName != NULL &&
+        RedisModule_StringCompare(lastDeletedSeries.keyName, key) == 0) {
+        CompactionRule *rule = lastDeletedSeries.rules;
         while (rule != NULL) {
             RedisModuleKey *seriesKey;
             Series *dstSeries;
             const int status = GetSeries(
                 ctx, rule->destKey, &seriesKey, &dstSeries, REDISMODULE_READ | REDISMODULE_WRITE);
             if (status) {
-                SeriesDeleteSrcRule(dstSeries, lastDeletedSeries->keyName);
+                SeriesDeleteSrcRule(dstSeries, lastDeletedSeries.keyName);
                 RedisModule_CloseKey(seriesKey);
             }
             rule = rule->nextRule;
         }
-        if (lastDeletedSeries->srcKey) {
+        if (lastDeletedSeries.srcKey) {
             RedisModuleKey *seriesKey;
             Series *srcSeries;
             const int status = GetSeries(ctx,
-                                         lastDeletedSeries->srcKey,
+                                         lastDeletedSeries.srcKey,
                                          &seriesKey,
                                          &srcSeries,
                                          REDISMODULE_READ | REDISMODULE_WRITE);
             if (status) {
-                SeriesDeleteRule(srcSeries, lastDeletedSeries->keyName);
+                SeriesDeleteRule(srcSeries, lastDeletedSeries.keyName);
                 RedisModule_CloseKey(seriesKey);
             }
         }
@@ -187,53 +276,422 @@ void CleanLastDeletedSeries(RedisModuleCtx *ctx, RedisModuleString *key) {
     freeLastDeletedSeries();
 }
 
-// Releases Series and all its compaction rules
+void SeriesInitMainThread() {
+    mainThread = pthread_self();
+}
+
+// Detaches everything that is shared with the rest of the keyspace (index entries, compaction
+// rules, memory counters) so what remains can be freed from any thread. Must hold the GIL.
+static void seriesDetach(RedisModuleCtx *ctx, Series *series) {
+    if (series->isTemporary || series->isUnlinked) {
+        return;
+    }
+    RemoveIndexedMetric(ctx, series->keyName, series->labels, series->labelsCount);
+    SeriesRegistry_Remove(series);
+    MemStats_AccountChunks(&series->chunksMemory, RedisModule_DictSize(series->chunks), -1);
+    TSMemStats.seriesCount--;
+    for (size_t i = 1; i < series->fieldsCount; i++) {
+        Series *field = series->fields[i - 1];
+        MemStats_AccountChunks(&field->chunksMemory, RedisModule_DictSize(field->chunks), -1);
+        field->isUnlinked = true;
+    }
+    for (CompactionRule *level = series->levels; level != NULL; level = level->nextRule) {
+        Series *levelSeries = level->level;
+        MemStats_AccountChunks(
+            &levelSeries->chunksMemory, RedisModule_DictSize(levelSeries->chunks), -1);
+        TSMemStats.compactionRules -= CompactionRuleMemUsage(level);
+        levelSeries->isUnlinked = true;
+    }
+
+    // the rules are cleaned on the following "del" notification
+    freeLastDeletedSeries();
+    lastDeletedSeries.series = series;
+    lastDeletedSeries.keyName = series->keyName;
+    lastDeletedSeries.srcKey = series->srcKey;
+    lastDeletedSeries.rules = series->rules;
+    series->keyName = NULL;
+    series->srcKey = NULL;
+    series->rules = NULL;
+    series->isUnlinked = true;
+}
+
+// Undoes seriesDetach for a value that was unlinked from its key without being freed
+static void seriesAttach(Series *series) {
+    if (lastDeletedSeries.series == series) {
+        series->keyName = lastDeletedSeries.keyName;
+        series->srcKey = lastDeletedSeries.srcKey;
+        series->rules = lastDeletedSeries.rules;
+        lastDeletedSeries = (DeletedSeries){ 0 };
+    }
+    MemStats_AccountChunks(&series->chunksMemory, RedisModule_DictSize(series->chunks), 1);
+    TSMemStats.seriesCount++;
+    for (size_t i = 1; i < series->fieldsCount; i++) {
+        Series *field = series->fields[i - 1];
+        MemStats_AccountChunks(&field->chunksMemory, RedisModule_DictSize(field->chunks), 1);
+        field->isUnlinked = false;
+    }
+    for (CompactionRule *level = series->levels; level != NULL; level = level->nextRule) {
+        Series *levelSeries = level->level;
+        MemStats_AccountChunks(
+            &levelSeries->chunksMemory, RedisModule_DictSize(levelSeries->chunks), 1);
+        TSMemStats.compactionRules += CompactionRuleMemUsage(level);
+        levelSeries->isUnlinked = false;
+    }
+    series->isUnlinked = false;
+    SeriesRegistry_Add(series);
+}
+
+/*
+ * Called when a series value lands under `keyName` in the db selected in `ctx` without being
+ * created there (RENAME, MOVE, RESTORE). The server unlinks a renamed or moved value from its old
+ * key first, which detached it; the detached state is taken back and the index entries follow
+ * the new name.
+ */
+void SeriesRelink(RedisModuleCtx *ctx, Series *series, RedisModuleString *keyName) {
+    bool indexed = true;
+    if (series->isUnlinked) {
+        seriesAttach(series);
+        indexed = false;
+    }
+    if (series->keyName == NULL || RedisModule_StringCompare(series->keyName, keyName) != 0) {
+        if (indexed) {
+            RemoveIndexedMetric(ctx, series->keyName, series->labels, series->labelsCount);
+        }
+        if (series->keyName != NULL) {
+            RedisModule_FreeString(NULL, series->keyName);
+        }
+        series->keyName = RedisModule_CreateStringFromString(NULL, keyName);
+        indexed = false;
+    }
+    if (!indexed) {
+        IndexMetric(ctx, series->keyName, series->id, series->labels, series->labelsCount);
+    }
+    // the next lookup checks for a TTL carried over from the old key
+    SeriesRegistry_Invalidate(series);
+}
+
+// Called on the main thread when the key is removed from the keyspace, before the value is
+// possibly handed to the lazyfree thread
+void SeriesUnlink(RedisModuleString *key, const void *value) {
+    RedisModuleCtx *ctx = RedisModule_GetThreadSafeContext(NULL);
+    seriesDetach(ctx, (Series *)value);
+    RedisModule_FreeThreadSafeContext(ctx);
+}
+
+// Number of allocations FreeSeries will release, used by the server to decide whether to free
+// the value in the background
+size_t SeriesFreeEffort(RedisModuleString *key, const void *value) {
+    const Series *series = value;
+    size_t effort = RedisModule_DictSize(series->chunks) + series->labelsCount;
+    for (size_t i = 1; i < series->fieldsCount; i++) {
+        effort += RedisModule_DictSize(series->fields[i - 1]->chunks);
+    }
+    for (CompactionRule *level = series->levels; level != NULL; level = level->nextRule) {
+        effort += RedisModule_DictSize(level->level->chunks);
+    }
+    return effort;
+}
+
+// Releases the rule without touching the memory counters, may run on the lazyfree thread
+static void freeCompactionRule(CompactionRule *rule) {
+    if (rule->destKey != NULL) {
+        RedisModule_FreeString(NULL, rule->destKey);
+    }
+    if (rule->level != NULL) {
+        FreeSeries(rule->level);
+    }
+    ((AggregationClass *)rule->aggClass)->freeContext(rule->aggContext);
+    free(rule);
+}
+
+// Releases Series and all its chunks, may run on the lazyfree thread
 void FreeSeries(void *value) {
     Series *currentSeries = (Series *)value;
+    if (!currentSeries->isTemporary && !currentSeries->isUnlinked) {
+        // Servers without the unlink callback, or an overwritten value that is freed lazily,
+        // reach here without notice; the shared state must still be touched under the GIL.
+        RedisModuleCtx *ctx = RedisModule_GetThreadSafeContext(NULL);
+        const bool lock = !pthread_equal(pthread_self(), mainThread);
+        if (lock) {
+            RedisModule_ThreadSafeContextLock(ctx);
+        }
+        seriesDetach(ctx, currentSeries);
+        if (lock) {
+            RedisModule_ThreadSafeContextUnlock(ctx);
+        }
+        RedisModule_FreeThreadSafeContext(ctx);
+    }
+
     RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(currentSeries->chunks, "^", NULL, 0);
     Chunk_t *currentChunk;
     while (RedisModule_DictNextC(iter, NULL, (void *)&currentChunk) != NULL) {
         currentSeries->funcs->FreeChunk(currentChunk);
     }
     RedisModule_DictIteratorStop(iter);
-
-    RedisModuleCtx *ctx = RedisModule_GetThreadSafeContext(NULL);
-    RedisModule_AutoMemory(ctx);
-    if (!currentSeries->isTemporary) {
-        RemoveIndexedMetric(
-            ctx, currentSeries->keyName, currentSeries->labels, currentSeries->labelsCount);
-    }
+    RedisModule_FreeDict(NULL, currentSeries->chunks);
 
     FreeLabels(currentSeries->labels, currentSeries->labelsCount);
 
-    RedisModule_FreeThreadSafeContext(ctx);
-    RedisModule_FreeDict(NULL, currentSeries->chunks);
+    for (size_t i = 0; i < currentSeries->fieldsCount; i++) {
+        if (i > 0) {
+            FreeSeries(currentSeries->fields[i - 1]);
+        }
+        RedisModule_FreeString(NULL, currentSeries->fieldNames[i]);
+    }
+    free(currentSeries->fields);
+    free(currentSeries->fieldNames);
+
+    // the levels were taken out of the memory counters when the series was detached
+    CompactionRule *level = currentSeries->levels;
+    while (level != NULL) {
+        CompactionRule *nextLevel = level->nextRule;
+        freeCompactionRule(level);
+        level = nextLevel;
+    }
 
-    if (currentSeries->isTemporary) {
+    // fields do not own a key name
+    if (currentSeries->isTemporary && currentSeries->keyName != NULL) {
         RedisModule_FreeString(NULL, currentSeries->keyName);
-        free(currentSeries);
-    } else {
-        freeLastDeletedSeries();
-        lastDeletedSeries = currentSeries;
     }
+    free(currentSeries);
 }
 
-void FreeCompactionRule(void *value) {
-    CompactionRule *rule = (CompactionRule *)value;
-    RedisModule_FreeString(NULL, rule->destKey);
-    ((AggregationClass *)rule->aggClass)->freeContext(rule->aggContext);
-    free(rule);
+static Series *newFieldSeries(Series *series) {
+    CreateCtx cCtx = { .retentionTime = series->retentionTime,
+                       .chunkSizeBytes = series->chunkSizeBytes,
+                       .options = series->options,
+                       .duplicatePolicy = series->duplicatePolicy,
+                       .isTemporary = series->isTemporary };
+    Series *field = NewSeries(NULL, &cCtx);
+    if (!field->isTemporary) {
+        // fields are counted as part of the series that owns them
+        TSMemStats.seriesCount--;
+    }
+    return field;
 }
 
-size_t SeriesGetChunksSize(Series *series) {
-    size_t size = 0;
-    Chunk_t *currentChunk;
-    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
-    while (RedisModule_DictNextC(iter, NULL, (void *)&currentChunk)) {
-        size += series->funcs->GetChunkSize(currentChunk, true);
+static Series *newLevelSeries(Series *series, uint64_t retentionTime) {
+    CreateCtx cCtx = { .retentionTime = retentionTime,
+                       .chunkSizeBytes = series->chunkSizeBytes,
+                       .options = series->options,
+                       .duplicatePolicy = DP_LAST };
+    Series *level = NewSeries(NULL, &cCtx);
+    // levels are counted as part of the series that owns them
+    TSMemStats.seriesCount--;
+    return level;
+}
+
+// Takes ownership of the field names; field 0 keeps using the series own chunks
+void SeriesSetFields(Series *series, RedisModuleString **fieldNames, size_t fieldsCount) {
+    series->fieldsCount = fieldsCount;
+    series->fieldNames = fieldNames;
+    series->fields = fieldsCount > 1 ? malloc(sizeof(Series *) * (fieldsCount - 1)) : NULL;
+    for (size_t i = 1; i < fieldsCount; i++) {
+        series->fields[i - 1] = newFieldSeries(series);
+    }
+}
+
+Series *SeriesGetField(Series *series, size_t index) {
+    return index == 0 ? series : series->fields[index - 1];
+}
+
+int SeriesGetFieldIndex(const Series *series, RedisModuleString *fieldName) {
+    for (size_t i = 0; i < series->fieldsCount; i++) {
+        if (RedisModule_StringCompare(series->fieldNames[i], fieldName) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Applies the series configuration (after TS.ALTER) to all its fields
+void SeriesSyncFields(Series *series) {
+    for (size_t i = 1; i < series->fieldsCount; i++) {
+        Series *field = series->fields[i - 1];
+        field->retentionTime = series->retentionTime;
+        field->chunkSizeBytes = series->chunkSizeBytes;
+        field->duplicatePolicy = series->duplicatePolicy;
+    }
+}
+
+static void defragRules(RedisModuleDefragCtx *ctx, CompactionRule **rulePtr) {
+    while (*rulePtr != NULL) {
+        CompactionRule *rule = DefragPtr(ctx, *rulePtr);
+        *rulePtr = rule;
+        if (rule->destKey != NULL) {
+            RedisModuleString *destKey = RedisModule_DefragRedisModuleString(ctx, rule->destKey);
+            if (destKey != NULL) {
+                rule->destKey = destKey;
+            }
+        }
+        // aggregation contexts are single flat allocations
+        rule->aggContext = DefragPtr(ctx, rule->aggContext);
+        rulePtr = &rule->nextRule;
+    }
+}
+
+static void defragLabels(RedisModuleDefragCtx *ctx, Series *series) {
+    series->labels = DefragPtr(ctx, series->labels);
+    for (size_t i = 0; i < series->labelsCount; i++) {
+        RedisModuleString *str;
+        if ((str = RedisModule_DefragRedisModuleString(ctx, series->labels[i].key)) != NULL) {
+            series->labels[i].key = str;
+        }
+        if ((str = RedisModule_DefragRedisModuleString(ctx, series->labels[i].value)) != NULL) {
+            series->labels[i].value = str;
+        }
+    }
+}
+
+/*
+ * Walks the chunks from the iterator position, replacing the ones that moved, and adds the number
+ * of chunks visited to a non-NULL `visited`. With a non-NULL stoppedAt, returns 1 once Redis asks us to stop,
+ * after storing the key of the last handled chunk.
+ */
+static int defragChunks(RedisModuleDefragCtx *ctx,
+                        Series *series,
+                        RedisModuleDictIter *iter,
+                        timestamp_t *stoppedAt,
+                        long long *visited) {
+    void *currentKey;
+    size_t keyLen;
+    Chunk_t *chunk;
+    timestamp_t rax_key;
+    while ((currentKey = RedisModule_DictNextC(iter, &keyLen, (void *)&chunk)) != NULL) {
+        memcpy(&rax_key, currentKey, sizeof(rax_key));
+        // readers hold on to the address of a pinned chunk
+        Chunk_t *newChunk = series->funcs->IsChunkShared(chunk)
+                                ? chunk
+                                : series->funcs->DefragChunk(ctx, chunk);
+        if (newChunk != chunk) {
+            RedisModule_DictReplaceC(series->chunks, &rax_key, sizeof(rax_key), newChunk);
+            RedisModule_DictIteratorReseekC(iter, ">", &rax_key, sizeof(rax_key));
+            if (series->lastChunk == chunk) {
+                series->lastChunk = newChunk;
+            }
+        }
+        if (visited != NULL) {
+            (*visited)++;
+        }
+        if (stoppedAt != NULL && RedisModule_DefragShouldStop(ctx)) {
+            *stoppedAt = ntohu64(rax_key);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Fields are walked in full on the first call, they are not covered by the cursor
+static void defragFields(RedisModuleDefragCtx *ctx, Series *series) {
+    if (series->fieldsCount == 0) {
+        return;
+    }
+    series->fieldNames = DefragPtr(ctx, series->fieldNames);
+    series->fields = DefragPtr(ctx, series->fields);
+    for (size_t i = 0; i < series->fieldsCount; i++) {
+        RedisModuleString *str = RedisModule_DefragRedisModuleString(ctx, series->fieldNames[i]);
+        if (str != NULL) {
+            series->fieldNames[i] = str;
+        }
+        if (i == 0) {
+            continue;
+        }
+        Series *field = DefragPtr(ctx, series->fields[i - 1]);
+        series->fields[i - 1] = field;
+        RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(field->chunks, "^", NULL, 0);
+        defragChunks(ctx, field, iter, NULL, NULL);
+        RedisModule_DictIteratorStop(iter);
+    }
+}
+
+// Like fields, levels are walked in full on the first call
+static void defragLevels(RedisModuleDefragCtx *ctx, Series *series) {
+    defragRules(ctx, &series->levels);
+    for (CompactionRule *level = series->levels; level != NULL; level = level->nextRule) {
+        level->level = DefragPtr(ctx, level->level);
+        RedisModuleDictIter *iter =
+            RedisModule_DictIteratorStartC(level->level->chunks, "^", NULL, 0);
+        defragChunks(ctx, level->level, iter, NULL, NULL);
+        RedisModule_DictIteratorStop(iter);
+    }
+}
+
+TSDefragStats TSDefrag = { 0 };
+
+// Chunks visited by the walk in progress, counted in TSDefrag once it completes. Redis defrags a
+// single key at a time, so there is at most one walk in progress.
+static long long defragWalkChunks = 0;
+
+/*
+ * Active defrag callback.
+ *
+ * The series metadata is handled on the first call only. Chunks are then walked in timestamp
+ * order; when Redis asks us to stop, the key of the last handled chunk plus one is stored as the
+ * cursor and the next call resumes from the chunk following it. A cursor of 0 is the first call:
+ * Redis passes it to the first call of a late defrag (a series whose free effort is above
+ * active-defrag-max-scan-fields) as well. Returns 1 if there is more work to do.
+ */
+int DefragSeries(RedisModuleDefragCtx *ctx, RedisModuleString *key, void **value) {
+    Series *series = *value;
+    unsigned long cursor = 0;
+    timestamp_t rax_key;
+    RedisModuleDictIter *iter;
+
+    if (RedisModule_DefragCursorGet(ctx, &cursor) == REDISMODULE_OK && cursor != 0) {
+        seriesEncodeTimestamp(&rax_key, cursor - 1);
+        iter = RedisModule_DictIteratorStartC(series->chunks, ">", &rax_key, sizeof(rax_key));
+        TSDefrag.resumed++;
+    } else {
+        series = DefragPtr(ctx, series);
+        if (series != *value && series->id != 0) {
+            SeriesRegistry_Update(series);
+        }
+        *value = series;
+
+        RedisModuleString *str;
+        if ((str = RedisModule_DefragRedisModuleString(ctx, series->keyName)) != NULL) {
+            series->keyName = str;
+        }
+        if (series->srcKey != NULL &&
+            (str = RedisModule_DefragRedisModuleString(ctx, series->srcKey)) != NULL) {
+            series->srcKey = str;
+        }
+        defragLabels(ctx, series);
+        defragRules(ctx, &series->rules);
+        defragFields(ctx, series);
+        defragLevels(ctx, series);
+        iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
+        defragWalkChunks = 0;
     }
+
+    timestamp_t stoppedAt;
+    int more = defragChunks(ctx, series, iter, &stoppedAt, &defragWalkChunks);
     RedisModule_DictIteratorStop(iter);
-    return size;
+    if (more) {
+        RedisModule_DefragCursorSet(ctx, stoppedAt + 1);
+    } else {
+        TSDefrag.series++;
+        TSDefrag.chunks += defragWalkChunks;
+        defragWalkChunks = 0;
+    }
+    return more;
+}
+
+size_t CompactionRuleMemUsage(const CompactionRule *rule) {
+    if (rule->destKey == NULL) {
+        return sizeof(CompactionRule) + rule->aggClass->contextSize;
+    }
+    size_t destKeyLen = 0;
+    RedisModule_StringPtrLen(rule->destKey, &destKeyLen);
+    return sizeof(CompactionRule) + rule->aggClass->contextSize + destKeyLen +
+           MEMSTATS_STRING_OVERHEAD;
+}
+
+// Must hold the GIL, the rule is taken out of the memory counters
+void FreeCompactionRule(void *value) {
+    CompactionRule *rule = (CompactionRule *)value;
+    TSMemStats.compactionRules -= CompactionRuleMemUsage(rule);
+    freeCompactionRule(rule);
 }
 
 char *SeriesGetCStringLabelValue(const Series *series, const char *labelKey) {
@@ -251,24 +709,38 @@ char *SeriesGetCStringLabelValue(const Series *series, const char *labelKey) {
 size_t SeriesMemUsage(const void *value) {
     Series *series = (Series *)value;
 
-    size_t labelLen = 0;
-    uint32_t labelsLen = 0;
-    for (int i = 0; i < series->labelsCount; i++) {
-        RedisModule_StringPtrLen(series->labels[i].key, &labelLen);
-        labelsLen += (labelLen + 1);
-        RedisModule_StringPtrLen(series->labels[i].value, &labelLen);
-        labelsLen += (labelLen + 1);
-    }
-
     size_t rulesSize = 0;
     CompactionRule *rule = series->rules;
     while (rule != NULL) {
-        rulesSize += sizeof(CompactionRule);
+        rulesSize += CompactionRuleMemUsage(rule);
         rule = rule->nextRule;
     }
 
-    return sizeof(series) + rulesSize + labelsLen + sizeof(Label) * series->labelsCount +
-           SeriesGetChunksSize(series);
+    size_t fieldsSize = 0;
+    for (size_t i = 0; i < series->fieldsCount; i++) {
+        size_t nameLen;
+        RedisModule_StringPtrLen(series->fieldNames[i], &nameLen);
+        fieldsSize += sizeof(RedisModuleString *) + nameLen + MEMSTATS_STRING_OVERHEAD;
+        if (i > 0) {
+            Series *field = series->fields[i - 1];
+            fieldsSize += sizeof(Series *) + sizeof(*field) + MEMSTATS_DICT_OVERHEAD +
+                          RedisModule_DictSize(field->chunks) * MEMSTATS_DICT_ENTRY_OVERHEAD +
+                          field->chunksMemory.headers + field->chunksMemory.buffers;
+        }
+    }
+
+    for (CompactionRule *level = series->levels; level != NULL; level = level->nextRule) {
+        Series *levelSeries = level->level;
+        rulesSize += CompactionRuleMemUsage(level) + sizeof(*levelSeries) + MEMSTATS_DICT_OVERHEAD +
+                     RedisModule_DictSize(levelSeries->chunks) * MEMSTATS_DICT_ENTRY_OVERHEAD +
+                     levelSeries->chunksMemory.headers + levelSeries->chunksMemory.buffers;
+    }
+
+    size_t numChunks = RedisModule_DictSize(series->chunks);
+    return sizeof(*series) + MEMSTATS_DICT_OVERHEAD + numChunks * MEMSTATS_DICT_ENTRY_OVERHEAD +
+           series->chunksMemory.headers + series->chunksMemory.buffers + rulesSize + fieldsSize +
+           LabelsMemUsage(series->labels, series->labelsCount) +
+           IndexMemUsage(series->keyName, series->labelsCount);
 }
 
 size_t SeriesGetNumSamples(const Series *series) {
@@ -279,34 +751,48 @@ size_t SeriesGetNumSamples(const Series *series) {
     return numSamples;
 }
 
-int MultiSerieReduce(Series *dest,
-                     Series *source,
-                     MultiSeriesReduceOp op,
-                     timestamp_t startTimestamp,
-                     timestamp_t endTimestamp,
-                     AggregationClass *agg,
-                     int64_t time_delta,
-                     bool rev) {
-    Sample sample;
-    SeriesIterator iterator;
-    SeriesQuery(source, &iterator, startTimestamp, endTimestamp, rev, agg, time_delta);
-    DuplicatePolicy dp = DP_INVALID;
-    switch (op) {
-        case MultiSeriesReduceOp_Max:
-            dp = DP_MAX;
-            break;
-        case MultiSeriesReduceOp_Min:
-            dp = DP_MIN;
-            break;
-        case MultiSeriesReduceOp_Sum:
-            dp = DP_SUM;
-            break;
+double *SeriesRowsAppend(SeriesRows *rows, timestamp_t timestamp) {
+    if (rows->count == rows->capacity) {
+        rows->capacity = rows->capacity > 0 ? rows->capacity * 2 : 64;
+        rows->timestamps = realloc(rows->timestamps, rows->capacity * sizeof(timestamp_t));
+        rows->values = realloc(rows->values, rows->capacity * rows->valuesCount * sizeof(double));
     }
-    while (SeriesIteratorGetNext(&iterator, &sample) == CR_OK) {
-        SeriesUpsertSample(dest, sample.timestamp, sample.value, dp);
+    rows->timestamps[rows->count] = timestamp;
+    return &rows->values[rows->count++ * rows->valuesCount];
+}
+
+void SeriesRowsFree(SeriesRows *rows) {
+    free(rows->timestamps);
+    free(rows->values);
+}
+
+// Recalculates the closed bucket of `rule` starting at `start` and writes it downstream
+static void upsertRuleBucket(RedisModuleCtx *ctx,
+                             Series *series,
+                             CompactionRule *rule,
+                             timestamp_t start) {
+    double val = 0;
+    if (SeriesCalcRange(series, start, start + rule->timeBucket - 1, rule, &val) == TSDB_ERROR) {
+        RedisModule_Log(ctx, "verbose", "%s", "Failed to calculate range for downsample");
+        return;
+    }
+
+    RedisModuleKey *key = NULL;
+    Series *destSeries = rule->level;
+    if (destSeries == NULL &&
+        !SilentGetSeries(
+            ctx, rule->destKey, &key, &destSeries, REDISMODULE_READ | REDISMODULE_WRITE)) {
+        RedisModule_Log(ctx, "verbose", "%s", "Failed to retrieve downsample series");
+        return;
+    }
+    if (destSeries->totalSamples == 0 || start > destSeries->lastTimestamp) {
+        SeriesAddSample(destSeries, start, val);
+    } else {
+        SeriesUpsertSample(destSeries, start, val, DP_LAST);
+    }
+    if (key != NULL) {
+        RedisModule_CloseKey(key);
     }
-    SeriesIteratorClose(&iterator);
-    return 1;
 }
 
 static void upsertCompaction(Series *series, UpsertCtx *uCtx) {
@@ -317,7 +803,7 @@ static void upsertCompaction(Series *series, UpsertCtx *uCtx) {
     RedisModuleCtx *ctx = RedisModule_GetThreadSafeContext(NULL);
     const timestamp_t upsertTimestamp = uCtx->sample.timestamp;
     const timestamp_t seriesLastTimestamp = series->lastTimestamp;
-    while (rule != NULL) {
+    for (; rule != NULL; rule = rule->nextRule) {
         const timestamp_t ruleTimebucket = rule->timeBucket;
         const timestamp_t curAggWindowStart = CalcWindowStart(seriesLastTimestamp, ruleTimebucket);
         if (upsertTimestamp >= curAggWindowStart) {
@@ -325,32 +811,10 @@ static void upsertCompaction(Series *series, UpsertCtx *uCtx) {
             const int rv = SeriesCalcRange(series, curAggWindowStart, UINT64_MAX, rule, NULL);
             if (rv == TSDB_ERROR) {
                 RedisModule_Log(ctx, "verbose", "%s", "Failed to calculate range for downsample");
-                continue;
             }
         } else {
-            const timestamp_t start = CalcWindowStart(upsertTimestamp, ruleTimebucket);
-            // ensure last include/exclude
-            double val = 0;
-            const int rv = SeriesCalcRange(series, start, start + ruleTimebucket - 1, rule, &val);
-            if (rv == TSDB_ERROR) {
-                RedisModule_Log(ctx, "verbose", "%s", "Failed to calculate range for downsample");
-                continue;
-            }
-
-            RedisModuleKey *key;
-            Series *destSeries;
-            if (!GetSeries(ctx, rule->destKey, &key, &destSeries, REDISMODULE_READ)) {
-                RedisModule_Log(ctx, "verbose", "%s", "Failed to retrieve downsample series");
-                continue;
-            }
-            if (destSeries->totalSamples == 0) {
-                SeriesAddSample(destSeries, start, val);
-            } else {
-                SeriesUpsertSample(destSeries, start, val, DP_LAST);
-            }
-            RedisModule_CloseKey(key);
+            upsertRuleBucket(ctx, series, rule, CalcWindowStart(upsertTimestamp, ruleTimebucket));
         }
-        rule = rule->nextRule;
     }
     RedisModule_FreeThreadSafeContext(ctx);
 }
@@ -383,13 +847,17 @@ int SeriesUpsertSample(Series *series,
         }
         chunkFirstTS = funcs->GetFirstTimestamp(chunk);
     }
+    chunk = seriesUnshareChunk(series, chunk);
 
     // Split chunks
     if (funcs->GetChunkSize(chunk, false) > series->chunkSizeBytes * SPLIT_FACTOR) {
+        SeriesAccountChunk(series, chunk, -1);
         Chunk_t *newChunk = funcs->SplitChunk(chunk);
+        SeriesAccountChunk(series, chunk, 1);
         if (newChunk == NULL) {
             return REDISMODULE_ERR;
         }
+        SeriesAccountChunk(series, newChunk, 1);
         timestamp_t newChunkFirstTS = funcs->GetFirstTimestamp(newChunk);
         dictOperator(series->chunks, newChunk, newChunkFirstTS, DICT_OP_SET);
         if (timestamp >= newChunkFirstTS) {
@@ -418,7 +886,9 @@ int SeriesUpsertSample(Series *series,
         dp_policy = TSGlobalConfig.duplicatePolicy;
     }
 
+    SeriesAccountChunk(series, chunk, -1);
     ChunkResult rv = funcs->UpsertSample(&uCtx, &size, dp_policy);
+    SeriesAccountChunk(series, chunk, 1);
     if (rv == CR_OK) {
         series->totalSamples += size;
         if (timestamp == series->lastTimestamp) {
@@ -441,23 +911,271 @@ int SeriesUpsertSample(Series *series,
 int SeriesAddSample(Series *series, api_timestamp_t timestamp, double value) {
     // backfilling or update
     Sample sample = { .timestamp = timestamp, .value = value };
+    seriesUnshareChunk(series, series->lastChunk);
+    SeriesAccountChunk(series, series->lastChunk, -1);
     ChunkResult ret = series->funcs->AddSample(series->lastChunk, &sample);
+    size_t chunkSize;
+    while (ret == CR_END && (chunkSize = series->funcs->GetChunkSize(series->lastChunk, false)) <
+                               (size_t)series->chunkSizeBytes) {
+        series->funcs->ResizeChunk(
+            series->lastChunk, min(nextChunkSize(chunkSize), (size_t)series->chunkSizeBytes));
+        ret = series->funcs->AddSample(series->lastChunk, &sample);
+    }
+    SeriesAccountChunk(series, series->lastChunk, 1);
+    const bool sealed = ret == CR_END;
 
-    if (ret == CR_END) {
+    if (sealed) {
         // When a new chunk is created trim the series
         SeriesTrim(series);
 
-        Chunk_t *newChunk = series->funcs->NewChunk(series->chunkSizeBytes);
+        Chunk_t *newChunk = series->funcs->NewChunk(seriesInitialChunkSize(series));
         dictOperator(series->chunks, newChunk, timestamp, DICT_OP_SET);
         ret = series->funcs->AddSample(newChunk, &sample);
+        SeriesAccountChunk(series, newChunk, 1);
         series->lastChunk = newChunk;
     }
     series->lastTimestamp = timestamp;
     series->lastValue = value;
     series->totalSamples++;
+    if (sealed) {
+        SeriesDemoteChunks(series);
+    }
+    return TSDB_OK;
+}
+
+int SeriesUpdateLastSample(Series *series) {
+    ChunkFuncs *funcs = series->funcs;
+    if (funcs->GetNumOfSample(series->lastChunk) == 0) {
+        series->lastTimestamp = 0;
+        series->lastValue = 0;
+        return TSDB_OK;
+    }
+    ChunkIterFuncs iterFuncs;
+    ChunkIter_t *iter =
+        funcs->NewChunkIterator(series->lastChunk, CHUNK_ITER_OP_NONE, &iterFuncs);
+    Sample sample, last = { 0 };
+    while (iterFuncs.GetNext(iter, &sample) == CR_OK) {
+        last = sample;
+    }
+    iterFuncs.Free(iter);
+    series->lastTimestamp = last.timestamp;
+    series->lastValue = last.value;
     return TSDB_OK;
 }
 
+// Removes the samples in [startTs, endTs] from the chunks of a single series (or field)
+static size_t seriesDelChunks(Series *series, timestamp_t startTs, timestamp_t endTs) {
+    ChunkFuncs *funcs = series->funcs;
+    const timestamp_t lastTimestamp = series->lastTimestamp;
+    size_t deleted = 0;
+
+    // start from the chunk holding startTs
+    timestamp_t rax_key;
+    seriesEncodeTimestamp(&rax_key, startTs);
+    RedisModuleDictIter *iter =
+        RedisModule_DictIteratorStartC(series->chunks, "<=", &rax_key, sizeof(rax_key));
+    if (RedisModule_DictCompareC(iter, "<=", &rax_key, sizeof(rax_key)) != REDISMODULE_OK) {
+        RedisModule_DictIteratorReseekC(iter, "^", NULL, 0);
+    }
+    Chunk_t *chunk;
+    void *currentKey;
+    size_t keyLen;
+    while ((currentKey = RedisModule_DictNextC(iter, &keyLen, (void *)&chunk))) {
+        u_int64_t numSamples = funcs->GetNumOfSample(chunk);
+        if (numSamples == 0) {
+            continue;
+        }
+        timestamp_t firstTS = funcs->GetFirstTimestamp(chunk);
+        if (firstTS > endTs) {
+            break;
+        }
+        if (funcs->GetLastTimestamp(chunk) < startTs) {
+            continue;
+        }
+
+        if (firstTS >= startTs && funcs->GetLastTimestamp(chunk) <= endTs) {
+            // the whole chunk is in range, drop it without decoding
+            RedisModule_DictDelC(series->chunks, currentKey, keyLen, NULL);
+            RedisModule_DictIteratorReseekC(iter, ">", currentKey, keyLen);
+            if (chunk == series->lastChunk) {
+                series->lastChunk = NULL;
+            }
+            deleted += numSamples;
+            SeriesAccountChunk(series, chunk, -1);
+            funcs->FreeChunk(chunk);
+            continue;
+        }
+
+        // boundary chunk, re-encode the samples that are kept
+        timestamp_t chunkKey;
+        memcpy(&chunkKey, currentKey, sizeof(chunkKey));
+        if (funcs->IsChunkShared(chunk)) {
+            chunk = seriesUnshareChunk(series, chunk);
+            RedisModule_DictIteratorReseekC(iter, ">", &chunkKey, sizeof(chunkKey));
+        }
+        SeriesAccountChunk(series, chunk, -1);
+        deleted += funcs->DelRange(chunk, startTs, endTs);
+        SeriesAccountChunk(series, chunk, 1);
+        timestamp_t firstTSAfterOp = funcs->GetFirstTimestamp(chunk);
+        if (firstTSAfterOp != firstTS) {
+            // keep the chunk keyed by its first timestamp, as upsert expects
+            RedisModule_DictDelC(series->chunks, &chunkKey, sizeof(chunkKey), NULL);
+            dictOperator(series->chunks, chunk, firstTSAfterOp, DICT_OP_SET);
+            seriesEncodeTimestamp(&rax_key, firstTSAfterOp);
+            RedisModule_DictIteratorReseekC(iter, ">", &rax_key, sizeof(rax_key));
+        }
+    }
+    RedisModule_DictIteratorStop(iter);
+    series->totalSamples -= deleted;
+
+    if (series->lastChunk == NULL) {
+        if (RedisModule_DictSize(series->chunks) == 0) {
+            Chunk_t *newChunk = funcs->NewChunk(seriesInitialChunkSize(series));
+            dictOperator(series->chunks, newChunk, 0, DICT_OP_SET);
+            SeriesAccountChunk(series, newChunk, 1);
+            series->lastChunk = newChunk;
+        } else {
+            // the newest remaining chunk is appended to from now on
+            iter = RedisModule_DictIteratorStartC(series->chunks, "$", NULL, 0);
+            RedisModule_DictNextC(iter, NULL, (void *)&series->lastChunk);
+            RedisModule_DictIteratorStop(iter);
+            SeriesPromoteChunk(series, seriesUnshareChunk(series, series->lastChunk));
+        }
+    }
+    if (deleted > 0 && lastTimestamp >= startTs && lastTimestamp <= endTs) {
+        SeriesUpdateLastSample(series);
+    }
+    return deleted;
+}
+
+// Feeds the sample before the bucket to aggregations that carry it and gives them the bucket
+// bounds, so a recalculated bucket matches the one compacted as the samples came
+static void openRuleBucket(Series *series, CompactionRule *rule, void *context, timestamp_t start) {
+    AggregationClass *aggClass = rule->aggClass;
+    SeriesIterator iterator;
+    Sample sample;
+    if (aggClass->carriesSample && start > 0 &&
+        SeriesQuery(series, &iterator, 0, start - 1, true, NULL, 0) == TSDB_OK) {
+        if (SeriesIteratorGetNext(&iterator, &sample) == CR_OK) {
+            aggClass->appendValue(context, sample.value, sample.timestamp);
+            aggClass->resetContext(context);
+        }
+        SeriesIteratorClose(&iterator);
+    }
+    if (aggClass->setBucket != NULL) {
+        aggClass->setBucket(context, start, start + rule->timeBucket);
+    }
+}
+
+// Feeds the sample after a closed bucket to aggregations that carry samples
+static void closeRuleBucket(Series *series, CompactionRule *rule, void *context, timestamp_t start) {
+    AggregationClass *aggClass = rule->aggClass;
+    SeriesIterator iterator;
+    Sample sample;
+    if (aggClass->carriesSample &&
+        SeriesQuery(series, &iterator, start + rule->timeBucket, UINT64_MAX, false, NULL, 0) ==
+            TSDB_OK) {
+        if (SeriesIteratorGetNext(&iterator, &sample) == CR_OK) {
+            aggClass->appendValue(context, sample.value, sample.timestamp);
+        }
+        SeriesIteratorClose(&iterator);
+    }
+}
+
+// Returns true if a sample of the series is left between `start` and `end`
+static bool seriesHasSamples(Series *series, timestamp_t start, timestamp_t end) {
+    SeriesIterator iterator;
+    Sample sample;
+    if (SeriesQuery(series, &iterator, start, end, false, NULL, 0) != TSDB_OK) {
+        return false;
+    }
+    bool found = SeriesIteratorGetNext(&iterator, &sample) == CR_OK;
+    SeriesIteratorClose(&iterator);
+    return found;
+}
+
+static void delRangeRule(RedisModuleCtx *ctx,
+                         Series *series,
+                         CompactionRule *rule,
+                         timestamp_t startTs,
+                         timestamp_t endTs) {
+    const timestamp_t openBucket = rule->startCurrentTimeBucket;
+    const timestamp_t bucket = rule->timeBucket;
+    const timestamp_t firstBucket = CalcWindowStart(startTs, bucket);
+    const timestamp_t lastBucket = CalcWindowStart(endTs, bucket);
+    if (openBucket == -1LL || firstBucket > openBucket) {
+        return;
+    }
+    // the current bucket moves back when the newest samples were deleted
+    const bool empty = series->totalSamples == 0;
+    const timestamp_t newOpenBucket =
+        empty ? UINT64_MAX : CalcWindowStart(series->lastTimestamp, bucket);
+
+    // boundary buckets that stay closed are recalculated, the rest is deleted downstream
+    bool keepFirst = firstBucket < newOpenBucket &&
+                     seriesHasSamples(series, firstBucket, firstBucket + bucket - 1);
+    bool keepLast = lastBucket != firstBucket && lastBucket < newOpenBucket &&
+                    seriesHasSamples(series, lastBucket, lastBucket + bucket - 1);
+    timestamp_t delStart = keepFirst ? firstBucket + bucket : firstBucket;
+    timestamp_t delEnd = keepLast ? lastBucket - 1 : lastBucket;
+    if (newOpenBucket < openBucket) {
+        delStart = newOpenBucket < delStart ? newOpenBucket : delStart;
+        delEnd = UINT64_MAX;
+    }
+
+    if (delStart <= delEnd) {
+        RedisModuleKey *key = NULL;
+        Series *destSeries = rule->level;
+        if (destSeries != NULL ||
+            SilentGetSeries(
+                ctx, rule->destKey, &key, &destSeries, REDISMODULE_READ | REDISMODULE_WRITE)) {
+            SeriesDelRange(ctx, destSeries, delStart, delEnd);
+            if (key != NULL) {
+                RedisModule_CloseKey(key);
+            }
+        } else {
+            RedisModule_Log(ctx, "verbose", "%s", "Failed to retrieve downsample series");
+        }
+    }
+    if (keepFirst) {
+        upsertRuleBucket(ctx, series, rule, firstBucket);
+    }
+    if (keepLast) {
+        upsertRuleBucket(ctx, series, rule, lastBucket);
+    }
+
+    if (empty) {
+        rule->aggClass->resetContext(rule->aggContext);
+        rule->startCurrentTimeBucket = -1LL;
+    } else if (newOpenBucket < openBucket || lastBucket >= openBucket) {
+        SeriesCalcRange(series, newOpenBucket, UINT64_MAX, rule, NULL);
+        rule->startCurrentTimeBucket = newOpenBucket;
+    }
+}
+
+static void delRangeCompaction(RedisModuleCtx *ctx,
+                               Series *series,
+                               timestamp_t startTs,
+                               timestamp_t endTs) {
+    for (CompactionRule *rule = series->rules; rule != NULL; rule = rule->nextRule) {
+        delRangeRule(ctx, series, rule, startTs, endTs);
+    }
+    for (CompactionRule *level = series->levels; level != NULL; level = level->nextRule) {
+        delRangeRule(ctx, series, level, startTs, endTs);
+    }
+}
+
+size_t SeriesDelRange(RedisModuleCtx *ctx, Series *series, timestamp_t startTs, timestamp_t endTs) {
+    size_t deleted = seriesDelChunks(series, startTs, endTs);
+    for (size_t i = 1; i < series->fieldsCount; i++) {
+        seriesDelChunks(series->fields[i - 1], startTs, endTs);
+    }
+    if (deleted > 0) {
+        delRangeCompaction(ctx, series, startTs, endTs);
+    }
+    return deleted;
+}
+
 CompactionRule *SeriesAddRule(Series *series,
                               RedisModuleString *destKeyStr,
                               int aggType,
@@ -477,6 +1195,32 @@ CompactionRule *SeriesAddRule(Series *series,
     return rule;
 }
 
+CompactionRule *SeriesAddLevel(Series *series,
+                               int aggType,
+                               uint64_t timeBucket,
+                               uint64_t retentionTime) {
+    CompactionRule *level = NewRule(NULL, aggType, timeBucket);
+    if (level == NULL) {
+        return NULL;
+    }
+    level->level = newLevelSeries(series, retentionTime);
+    CompactionRule **last = &series->levels;
+    while (*last != NULL) {
+        last = &(*last)->nextRule;
+    }
+    *last = level;
+    return level;
+}
+
+CompactionRule *SeriesGetLevel(Series *series, int aggType, uint64_t timeBucket) {
+    for (CompactionRule *level = series->levels; level != NULL; level = level->nextRule) {
+        if (level->aggType == aggType && level->timeBucket == timeBucket) {
+            return level;
+        }
+    }
+    return NULL;
+}
+
 int SeriesCreateRulesFromGlobalConfig(RedisModuleCtx *ctx,
                                       RedisModuleString *keyName,
                                       Series *series,
@@ -490,6 +1234,10 @@ int SeriesCreateRulesFromGlobalConfig(RedisModuleCtx *ctx,
 
     for (i = 0; i < TSGlobalConfig.compactionRulesCount; i++) {
         SimpleCompactionRule *rule = TSGlobalConfig.compactionRules + i;
+        if (TSGlobalConfig.embeddedCompaction) {
+            SeriesAddLevel(series, rule->aggType, rule->timeBucket, rule->retentionSizeMillisec);
+            continue;
+        }
         const char *aggString = AggTypeEnumToString(rule->aggType);
         RedisModuleString *destKey = RedisModule_CreateStringPrintf(
             ctx, "%s_%s_%ld", RedisModule_StringPtrLen(keyName, &len), aggString, rule->timeBucket);
@@ -546,6 +1294,8 @@ CompactionRule *NewRule(RedisModuleString *destKey, int aggType, uint64_t timeBu
     rule->destKey = destKey;
     rule->startCurrentTimeBucket = -1LL;
     rule->nextRule = NULL;
+    rule->level = NULL;
+    TSMemStats.compactionRules += CompactionRuleMemUsage(rule);
 
     return rule;
 }
@@ -607,15 +1357,17 @@ int SeriesCalcRange(Series *series,
         return TSDB_ERROR;
     }
     void *context = aggObject->createContext();
+    openRuleBucket(series, rule, context, start_ts);
 
     while (SeriesIteratorGetNext(&iterator, &sample) == CR_OK) {
-        aggObject->appendValue(context, sample.value);
+        aggObject->appendValue(context, sample.value, sample.timestamp);
     }
     SeriesIteratorClose(&iterator);
     if (val == NULL) { // just update context for current window
         aggObject->freeContext(rule->aggContext);
         rule->aggContext = context;
     } else {
+        closeRuleBucket(series, rule, context, start_ts);
         aggObject->finalize(context, val);
         aggObject->freeContext(context);
     }
@@ -10,6 +10,7 @@
 #include "consts.h"
 #include "generic_chunk.h"
 #include "indexer.h"
+#include "memory_stats.h"
 #include "redismodule.h"
 
 typedef struct CompactionRule
@@ -21,6 +22,7 @@ typedef struct CompactionRule
     void *aggContext;
     struct CompactionRule *nextRule;
     timestamp_t startCurrentTimeBucket;
+    struct Series *level; // destination of an embedded level, destKey is NULL
 } CompactionRule;
 
 typedef struct CreateArima
@@ -65,6 +67,16 @@ typedef struct Series
     size_t totalSamples;
     DuplicatePolicy duplicatePolicy;
     bool isTemporary;
+    bool isUnlinked;
+    ChunksMemory chunksMemory;
+    size_t fieldsCount;
+    RedisModuleString **fieldNames;
+    // fields[i - 1] holds field i, field 0 is the series itself. Each field is a full series with
+    // its own chunks, so the timestamps are stored once per field rather than shared.
+    struct Series **fields;
+    CompactionRule *levels; // downsampled levels stored inside the series
+    uint64_t id;            // registry id, 0 for temporary series and fields
+    int db; // db holding the key while it has no TTL, -1 sends lookups through the keyspace
 } Series;
 
 typedef enum MultiSeriesReduceOp
@@ -72,11 +84,63 @@ typedef enum MultiSeriesReduceOp
     MultiSeriesReduceOp_Min,
     MultiSeriesReduceOp_Max,
     MultiSeriesReduceOp_Sum,
+    // percentiles of the samples of all the members, their bucket sketches merged
+    MultiSeriesReduceOp_P50,
+    MultiSeriesReduceOp_P75,
+    MultiSeriesReduceOp_P90,
+    MultiSeriesReduceOp_P95,
+    MultiSeriesReduceOp_P99,
+    MultiSeriesReduceOp_P999,
 } MultiSeriesReduceOp;
 
+// FILTER_BY_TS ts... and FILTER_BY_VALUE min max, the samples kept before any aggregation
+typedef struct SeriesFilter
+{
+    size_t timestampsCount; // 0 without FILTER_BY_TS
+    timestamp_t *timestamps; // ascending, without duplicates
+    bool byValue;
+    double minValue;
+    double maxValue;
+} SeriesFilter;
+
+// Rows of [timestamp, value...] with `valuesCount` values each, the result of a range query
+typedef struct SeriesRows
+{
+    size_t count;
+    size_t capacity;
+    size_t valuesCount;
+    timestamp_t *timestamps;
+    double *values;
+} SeriesRows;
+
+// Adds a row and returns where its values go
+double *SeriesRowsAppend(SeriesRows *rows, timestamp_t timestamp);
+void SeriesRowsFree(SeriesRows *rows);
+
 Series *NewSeries(RedisModuleString *keyName, CreateCtx *cCtx);
 void FreeSeries(void *value);
+void SeriesUnlink(RedisModuleString *key, const void *value);
+size_t SeriesFreeEffort(RedisModuleString *key, const void *value);
+void SeriesInitMainThread();
+
+void SeriesSetFields(Series *series, RedisModuleString **fieldNames, size_t fieldsCount);
+Series *SeriesGetField(Series *series, size_t index);
+int SeriesGetFieldIndex(const Series *series, RedisModuleString *fieldName);
+void SeriesSyncFields(Series *series);
+
+// Active defrag progress, reported under INFO timeseries_defrag
+typedef struct TSDefragStats
+{
+    long long series;  // series walked in full, metadata included
+    long long chunks;  // chunks visited by those walks
+    long long resumed; // calls that continued a walk from the defrag cursor
+} TSDefragStats;
+
+extern TSDefragStats TSDefrag;
+
+int DefragSeries(RedisModuleDefragCtx *ctx, RedisModuleString *key, void **value);
 void CleanLastDeletedSeries(RedisModuleCtx *ctx, RedisModuleString *key);
+void SeriesRelink(RedisModuleCtx *ctx, Series *series, RedisModuleString *keyName);
 
 int GetSeries(RedisModuleCtx *ctx,
               RedisModuleString *keyName,
@@ -95,20 +159,20 @@ int SilentGetSeries(RedisModuleCtx *ctx,
 
 void FreeCompactionRule(void *value);
 size_t SeriesMemUsage(const void *value);
-int MultiSerieReduce(Series *dest,
-                     Series *source,
-                     MultiSeriesReduceOp op,
-                     timestamp_t start_ts,
-                     timestamp_t end_ts,
-                     AggregationClass *agg,
-                     int64_t time_delta,
-                     bool rev);
+// Adds (`sign` is 1) or removes (`sign` is -1) `chunk` from the series memory counters.
+// Must be called whenever a chunk enters or leaves the series, and around any operation that
+// may change its size.
+void SeriesAccountChunk(Series *series, Chunk_t *chunk, int sign);
+size_t CompactionRuleMemUsage(const CompactionRule *rule);
 int SeriesAddSample(Series *series, api_timestamp_t timestamp, double value);
 int SeriesUpsertSample(Series *series,
                        api_timestamp_t timestamp,
                        double value,
                        DuplicatePolicy dp_override);
 int SeriesUpdateLastSample(Series *series);
+// Deletes the samples in [startTs, endTs] and returns their count. Chunks entirely in the range
+// are dropped without being decoded, only the boundary chunks are re-encoded.
+size_t SeriesDelRange(RedisModuleCtx *ctx, Series *series, timestamp_t startTs, timestamp_t endTs);
 int SeriesDeleteRule(Series *series, RedisModuleString *destKey);
 int SeriesSetSrcRule(Series *series, RedisModuleString *srctKey);
 int SeriesDeleteSrcRule(Series *series, RedisModuleString *srctKey);
@@ -117,6 +181,12 @@ CompactionRule *SeriesAddRule(Series *series,
                               RedisModuleString *destKeyStr,
                               int aggType,
                               uint64_t timeBucket);
+// Adds a downsampled level kept inside the series instead of a destination key
+CompactionRule *SeriesAddLevel(Series *series,
+                               int aggType,
+                               uint64_t timeBucket,
+                               uint64_t retentionTime);
+CompactionRule *SeriesGetLevel(Series *series, int aggType, uint64_t timeBucket);
 int SeriesCreateRulesFromGlobalConfig(RedisModuleCtx *ctx,
                                       RedisModuleString *keyName,
                                       Series *series,
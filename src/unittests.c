@@ -5,9 +5,11 @@
  */
 #include "minunit.h"
 #include "parse_policies.h"
+#include "unittests_cold_tier.c"
 #include "unittests_compressed_chunk.c"
 #include "unittests_parse_duplicate_policy.c"
 #include "unittests_parse_policies.c"
+#include "unittests_quantile_sketch.c"
 #include "unittests_uncompressed_chunk.c"
 
 #include <stdio.h>
@@ -21,6 +23,8 @@ int main(int argc, char *argv[]) {
     MU_RUN_SUITE(uncompressed_chunk_test_suite);
     MU_RUN_SUITE(compressed_chunk_test_suite);
     MU_RUN_SUITE(parse_duplicate_policy_test_suite);
+    MU_RUN_SUITE(cold_tier_test_suite);
+    MU_RUN_SUITE(quantile_sketch_test_suite);
     MU_REPORT();
     return minunit_fail;
 }
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2018-2020 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "cold_tier.h"
+#include "compressed_chunk.h"
+#include "gorilla.h"
+#include "minunit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "rmutil/alloc.h"
+
+static CompressedChunk *newColdTestChunk(size_t samples) {
+    CompressedChunk *chunk = Compressed_NewChunk(4096);
+    for (size_t i = 1; i <= samples; i++) {
+        Sample sample = { .timestamp = i * 10, .value = i * 1.5 };
+        Compressed_AddSample(chunk, &sample);
+    }
+    void *data = ColdTier_Store(chunk->data, chunk->size);
+    if (data != NULL) {
+        free(chunk->data);
+        chunk->data = data;
+        chunk->cold = true;
+    }
+    return chunk;
+}
+
+MU_TEST(test_cold_chunk_read) {
+    CompressedChunk *chunk = newColdTestChunk(200);
+    mu_assert(chunk->cold, "chunk moved to the cold tier");
+    mu_assert_int_eq(0, Compressed_GetChunkSize(chunk, false));
+    mu_assert_int_eq(0, Compressed_GetChunkDataSize(chunk));
+    mu_assert(ColdTier_GetStats().liveBytes >= 4096, "segment holds the chunk");
+
+    Sample sample;
+    ChunkIter_t *iter = Compressed_NewChunkIterator(chunk, CHUNK_ITER_OP_NONE, NULL);
+    for (size_t i = 1; i <= 200; i++) {
+        mu_assert_int_eq(CR_OK, Compressed_ChunkIteratorGetNext(iter, &sample));
+        mu_assert_int_eq(i * 10, sample.timestamp);
+        mu_assert_double_eq(i * 1.5, sample.value);
+    }
+    mu_assert_int_eq(CR_END, Compressed_ChunkIteratorGetNext(iter, &sample));
+    Compressed_FreeChunkIterator(iter);
+
+    CompressedChunk *clone = Compressed_CloneChunk(chunk);
+    mu_assert(!clone->cold, "clones live in RAM");
+    mu_assert_int_eq(200, Compressed_ChunkNumOfSample(clone));
+    Compressed_FreeChunk(clone);
+
+    Compressed_FreeChunk(chunk);
+    mu_assert_int_eq(0, ColdTier_GetStats().liveBytes);
+}
+
+MU_TEST(test_cold_chunk_upsert) {
+    CompressedChunk *chunk = newColdTestChunk(100);
+    UpsertCtx uCtx = { .inChunk = chunk, .sample = { .timestamp = 15, .value = 7 } };
+    int size = 0;
+    mu_assert_int_eq(CR_OK, Compressed_UpsertSample(&uCtx, &size, DP_LAST));
+    mu_assert_int_eq(1, size);
+    mu_assert(!chunk->cold, "writes bring the chunk back to RAM");
+    mu_assert_int_eq(101, Compressed_ChunkNumOfSample(chunk));
+    mu_assert_int_eq(0, ColdTier_GetStats().liveBytes);
+    Compressed_FreeChunk(chunk);
+}
+
+MU_TEST_SUITE(cold_tier_test_suite) {
+    // segment files are unlinked as soon as they are mapped
+    ColdTier_Init("/tmp", 1);
+    MU_RUN_TEST(test_cold_chunk_read);
+    MU_RUN_TEST(test_cold_chunk_upsert);
+}
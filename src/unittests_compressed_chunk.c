@@ -196,10 +196,171 @@ MU_TEST(test_Compressed_SplitChunk_force_realloc) {
     Compressed_FreeChunk(chunk);
 }
 
+MU_TEST(test_Compressed_GetChunkDataSize) {
+    const size_t chunk_size = 4096;
+    CompressedChunk *chunk = Compressed_NewChunk(chunk_size);
+    mu_assert_int_eq(0, Compressed_GetChunkDataSize(chunk));
+    size_t prev = 0;
+    ChunkResult rv = CR_OK;
+    for (timestamp_t ts = 1; rv == CR_OK; ts++) {
+        Sample sample = { .timestamp = ts * 10, .value = ts * 1.5 };
+        rv = Compressed_AddSample(chunk, &sample);
+        size_t dataSize = Compressed_GetChunkDataSize(chunk);
+        mu_assert(dataSize >= prev, "data size must not shrink on append");
+        mu_assert(dataSize <= Compressed_GetChunkSize(chunk, false), "data fits in the buffer");
+        prev = dataSize;
+    }
+    mu_assert(prev > chunk_size - sizeof(binary_t) * 2, "a full chunk has little slack");
+    Compressed_FreeChunk(chunk);
+}
+
+MU_TEST(test_Compressed_DelRange) {
+    CompressedChunk *chunk = Compressed_NewChunk(4096);
+    for (timestamp_t ts = 1; ts <= 100; ts++) {
+        Sample sample = { .timestamp = ts, .value = ts };
+        Compressed_AddSample(chunk, &sample);
+    }
+    mu_assert_int_eq(0, Compressed_DelRange(chunk, 200, 300));
+    mu_assert_int_eq(10, Compressed_DelRange(chunk, 1, 10));
+    mu_assert_int_eq(21, Compressed_DelRange(chunk, 40, 60));
+    mu_assert_int_eq(69, Compressed_ChunkNumOfSample(chunk));
+    mu_assert_int_eq(11, Compressed_GetFirstTimestamp(chunk));
+    mu_assert_int_eq(100, Compressed_GetLastTimestamp(chunk));
+
+    ChunkIter_t *iter = Compressed_NewChunkIterator(chunk, CHUNK_ITER_OP_NONE, NULL);
+    Sample sample;
+    timestamp_t expected = 11;
+    while (Compressed_ChunkIteratorGetNext(iter, &sample) == CR_OK) {
+        mu_assert_int_eq(expected, sample.timestamp);
+        mu_assert_double_eq(expected, sample.value);
+        expected = expected == 39 ? 61 : expected + 1;
+    }
+    mu_assert_int_eq(101, expected);
+    Compressed_FreeChunkIterator(iter);
+    Compressed_FreeChunk(chunk);
+}
+
+MU_TEST(test_Compressed_RetainChunk) {
+    CompressedChunk *chunk = Compressed_NewChunk(4096);
+    for (timestamp_t ts = 1; ts <= 10; ts++) {
+        Sample sample = { .timestamp = ts, .value = ts };
+        Compressed_AddSample(chunk, &sample);
+    }
+    Compressed_RetainChunk(chunk);
+    Compressed_RetainChunk(chunk);
+    mu_check(Compressed_IsChunkShared(chunk));
+
+    CompressedChunk *copy = Compressed_CloneChunk(chunk);
+    mu_check(!Compressed_IsChunkShared(copy));
+    mu_assert_int_eq(5, Compressed_DelRange(copy, 1, 5));
+    mu_assert_int_eq(10, Compressed_ChunkNumOfSample(chunk));
+    mu_assert_int_eq(1, Compressed_GetFirstTimestamp(chunk));
+    Compressed_FreeChunk(copy);
+
+    Compressed_FreeChunk(chunk);
+    Compressed_FreeChunk(chunk);
+    mu_check(!Compressed_IsChunkShared(chunk));
+    mu_assert_int_eq(10, Compressed_GetLastTimestamp(chunk));
+    Compressed_FreeChunk(chunk);
+}
+
+MU_TEST(test_Compressed_ResizeChunk) {
+    CompressedChunk *chunk = Compressed_NewChunk(16);
+    timestamp_t ts = 1;
+    Sample sample = { .timestamp = ts, .value = ts };
+    while (Compressed_AddSample(chunk, &sample) == CR_OK) {
+        ts++;
+        sample = (Sample){ .timestamp = ts * 7, .value = ts * 1.5 };
+    }
+    // grown sizes are kept aligned to the word gorilla writes
+    Compressed_ResizeChunk(chunk, 100);
+    mu_assert_int_eq(104, chunk->size);
+    mu_assert_int_eq(CR_OK, Compressed_AddSample(chunk, &sample));
+    mu_assert_int_eq(ts, Compressed_ChunkNumOfSample(chunk));
+
+    ChunkIter_t *iter = Compressed_NewChunkIterator(chunk, CHUNK_ITER_OP_NONE, NULL);
+    timestamp_t expected = 1;
+    while (Compressed_ChunkIteratorGetNext(iter, &sample) == CR_OK) {
+        mu_assert_int_eq(expected == 1 ? 1 : expected * 7, sample.timestamp);
+        expected++;
+    }
+    mu_assert_int_eq(ts + 1, expected);
+    Compressed_FreeChunkIterator(iter);
+    Compressed_FreeChunk(chunk);
+}
+
+MU_TEST(test_Compressed_InitChunkIterator) {
+    CompressedChunk *chunk = Compressed_NewChunk(4096);
+    for (timestamp_t ts = 1; ts <= 100; ts++) {
+        Sample sample = { .timestamp = ts, .value = ts };
+        Compressed_AddSample(chunk, &sample);
+    }
+    Compressed_ReverseIterator storage;
+    ChunkIterScratch scratch = { 0 };
+    ChunkIterFuncs funcs;
+    Sample sample;
+
+    Compressed_InitChunkIterator(chunk, CHUNK_ITER_OP_NONE, &funcs, &storage, &scratch);
+    mu_assert_int_eq(CR_OK, funcs.GetNext(&storage, &sample));
+    mu_assert_int_eq(1, sample.timestamp);
+    mu_check(scratch.samples == NULL);
+
+    // the scratch buffer is kept for the next chunk
+    for (int round = 0; round < 2; round++) {
+        Compressed_InitChunkIterator(chunk, CHUNK_ITER_OP_REVERSE, &funcs, &storage, &scratch);
+        timestamp_t expected = 100;
+        while (funcs.GetPrev(&storage, &sample) == CR_OK) {
+            mu_assert_int_eq(expected, sample.timestamp);
+            mu_assert_double_eq(expected, sample.value);
+            expected--;
+        }
+        mu_assert_int_eq(0, expected);
+        mu_assert_int_eq(100, scratch.capacity);
+    }
+    free(scratch.samples);
+    Compressed_FreeChunk(chunk);
+}
+
+MU_TEST(test_Compressed_GetValueRange) {
+    CompressedChunk *chunk = Compressed_NewChunk(4096);
+    double min, max;
+    mu_check(!Compressed_GetValueRange(chunk, &min, &max));
+    for (timestamp_t ts = 1; ts <= 100; ts++) {
+        Sample sample = { .timestamp = ts, .value = ts == 50 ? NAN : ts };
+        Compressed_AddSample(chunk, &sample);
+    }
+    mu_check(Compressed_GetValueRange(chunk, &min, &max));
+    mu_assert_double_eq(1, min);
+    mu_assert_double_eq(100, max);
+
+    int size;
+    UpsertCtx uCtx = { .inChunk = chunk, .sample = { .timestamp = 30, .value = -5 } };
+    Compressed_UpsertSample(&uCtx, &size, DP_LAST);
+    mu_check(Compressed_GetValueRange(chunk, &min, &max));
+    mu_assert_double_eq(-5, min);
+
+    // the chunks are rebuilt, so their bounds are exact
+    CompressedChunk *newChunk = Compressed_SplitChunk(chunk);
+    mu_check(Compressed_GetValueRange(chunk, &min, &max));
+    mu_assert_double_eq(-5, min);
+    mu_assert_double_eq(49, max);
+    mu_check(Compressed_GetValueRange(newChunk, &min, &max));
+    mu_assert_double_eq(51, min);
+    mu_assert_double_eq(100, max);
+    Compressed_FreeChunk(newChunk);
+    Compressed_FreeChunk(chunk);
+}
+
 MU_TEST_SUITE(compressed_chunk_test_suite) {
     MU_RUN_TEST(test_compressed_upsert);
     MU_RUN_TEST(test_compressed_fail_appendInteger);
     MU_RUN_TEST(test_Compressed_SplitChunk_empty);
     MU_RUN_TEST(test_Compressed_SplitChunk_odd);
     MU_RUN_TEST(test_Compressed_SplitChunk_force_realloc);
+    MU_RUN_TEST(test_Compressed_GetChunkDataSize);
+    MU_RUN_TEST(test_Compressed_DelRange);
+    MU_RUN_TEST(test_Compressed_RetainChunk);
+    MU_RUN_TEST(test_Compressed_ResizeChunk);
+    MU_RUN_TEST(test_Compressed_InitChunkIterator);
+    MU_RUN_TEST(test_Compressed_GetValueRange);
 }
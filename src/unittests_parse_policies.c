@@ -67,6 +67,23 @@ MU_TEST(test_invalid_policy) {
     free(parsedRules);
 }
 
+MU_TEST(test_compaction_level) {
+    int aggType;
+    uint64_t timeBucket;
+    mu_check(ParseCompactionLevel("avg:1h", &aggType, &timeBucket) == TRUE);
+    mu_check(aggType == TS_AGG_AVG);
+    mu_check(timeBucket == 60 * 60 * 1000);
+    mu_check(ParseCompactionLevel("max:10s", &aggType, &timeBucket) == TRUE);
+    mu_check(aggType == TS_AGG_MAX);
+    mu_check(timeBucket == 10 * 1000);
+
+    mu_check(ParseCompactionLevel("avg", &aggType, &timeBucket) == FALSE);
+    mu_check(ParseCompactionLevel(":1h", &aggType, &timeBucket) == FALSE);
+    mu_check(ParseCompactionLevel("mean:1h", &aggType, &timeBucket) == FALSE);
+    mu_check(ParseCompactionLevel("avg:1h:1d", &aggType, &timeBucket) == FALSE);
+    mu_check(ParseCompactionLevel("avg:0s", &aggType, &timeBucket) == FALSE);
+}
+
 MU_TEST(test_StringLenAggTypeToEnum) {
     mu_check(StringAggTypeToEnum("min") == TS_AGG_MIN);
     mu_check(StringAggTypeToEnum("max") == TS_AGG_MAX);
@@ -76,10 +93,19 @@ MU_TEST(test_StringLenAggTypeToEnum) {
     mu_check(StringAggTypeToEnum("first") == TS_AGG_FIRST);
     mu_check(StringAggTypeToEnum("last") == TS_AGG_LAST);
     mu_check(StringAggTypeToEnum("range") == TS_AGG_RANGE);
+    mu_check(StringAggTypeToEnum("p50") == TS_AGG_P50);
+    mu_check(StringAggTypeToEnum("P99") == TS_AGG_P99);
+    mu_check(StringAggTypeToEnum("p999") == TS_AGG_P999);
+    mu_check(StringAggTypeToEnum("p42") == TS_AGG_INVALID);
+    mu_check(StringAggTypeToEnum("rate") == TS_AGG_RATE);
+    mu_check(StringAggTypeToEnum("IRATE") == TS_AGG_IRATE);
+    mu_check(StringAggTypeToEnum("increase") == TS_AGG_INCREASE);
+    mu_check(StringAggTypeToEnum("TWA") == TS_AGG_TWA);
 }
 
 MU_TEST_SUITE(parse_policies_test_suite) {
     MU_RUN_TEST(test_valid_policy);
     MU_RUN_TEST(test_invalid_policy);
+    MU_RUN_TEST(test_compaction_level);
     MU_RUN_TEST(test_StringLenAggTypeToEnum);
 }
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2018-2021 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "minunit.h"
+#include "quantile_sketch.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include "rmutil/alloc.h"
+
+static int withinAccuracy(double estimate, double exact) {
+    return fabs(estimate - exact) <= fabs(exact) * QUANTILE_SKETCH_ACCURACY;
+}
+
+MU_TEST(test_QuantileSketch_Quantile) {
+    QuantileSketch *sketch = QuantileSketch_Create();
+    double value;
+    mu_check(QuantileSketch_Quantile(sketch, 0.5, &value) == TSDB_ERROR);
+
+    for (int i = 1; i <= 10000; i++) {
+        QuantileSketch_Add(sketch, i);
+    }
+    QuantileSketch_Add(sketch, NAN);
+    mu_assert_int_eq(10000, QuantileSketch_Count(sketch));
+    mu_check(QuantileSketch_Quantile(sketch, 0.5, &value) == TSDB_OK);
+    mu_check(withinAccuracy(value, 5000));
+    mu_check(QuantileSketch_Quantile(sketch, 0.99, &value) == TSDB_OK);
+    mu_check(withinAccuracy(value, 9900));
+    // the extremes are exact
+    mu_check(QuantileSketch_Quantile(sketch, 0, &value) == TSDB_OK);
+    mu_check(value == 1);
+    mu_check(QuantileSketch_Quantile(sketch, 1, &value) == TSDB_OK);
+    mu_check(value == 10000);
+
+    QuantileSketch_Reset(sketch);
+    mu_check(QuantileSketch_Quantile(sketch, 0.5, &value) == TSDB_ERROR);
+    free(sketch);
+}
+
+MU_TEST(test_QuantileSketch_NegativeAndZero) {
+    QuantileSketch *sketch = QuantileSketch_Create();
+    double value;
+    for (int i = -100; i <= 100; i++) {
+        QuantileSketch_Add(sketch, i);
+    }
+    mu_check(QuantileSketch_Quantile(sketch, 0.5, &value) == TSDB_OK);
+    mu_check(value == 0);
+    mu_check(QuantileSketch_Quantile(sketch, 0.1, &value) == TSDB_OK);
+    mu_check(withinAccuracy(value, -80));
+    mu_check(QuantileSketch_Quantile(sketch, 0.9, &value) == TSDB_OK);
+    mu_check(withinAccuracy(value, 80));
+    free(sketch);
+}
+
+MU_TEST(test_QuantileSketch_Merge) {
+    QuantileSketch *all = QuantileSketch_Create();
+    QuantileSketch *low = QuantileSketch_Create();
+    QuantileSketch *high = QuantileSketch_Create();
+    for (int i = 1; i <= 1000; i++) {
+        QuantileSketch_Add(all, i);
+        QuantileSketch_Add(i <= 500 ? low : high, i);
+    }
+    QuantileSketch_Merge(low, high);
+    mu_assert_int_eq(1000, QuantileSketch_Count(low));
+    double qs[] = { 0, 0.25, 0.5, 0.95, 1 };
+    for (size_t i = 0; i < sizeof(qs) / sizeof(qs[0]); i++) {
+        double merged, exact;
+        QuantileSketch_Quantile(low, qs[i], &merged);
+        QuantileSketch_Quantile(all, qs[i], &exact);
+        mu_check(merged == exact);
+    }
+    free(all);
+    free(low);
+    free(high);
+}
+
+MU_TEST(test_QuantileSketch_Collapse) {
+    QuantileSketch *sketch = QuantileSketch_Create();
+    double value;
+    // far wider than the bins can hold, the high quantiles keep their accuracy
+    for (int e = -30; e <= 30; e++) {
+        QuantileSketch_Add(sketch, pow(10, e));
+    }
+    mu_check(sketch->positive.maxKey - sketch->positive.minKey < QUANTILE_SKETCH_BINS);
+    mu_check(QuantileSketch_Quantile(sketch, 0.9, &value) == TSDB_OK);
+    mu_check(withinAccuracy(value, 1e24));
+    mu_check(QuantileSketch_Quantile(sketch, 0, &value) == TSDB_OK);
+    mu_check(value == 1e-30);
+    free(sketch);
+}
+
+MU_TEST_SUITE(quantile_sketch_test_suite) {
+    MU_RUN_TEST(test_QuantileSketch_Quantile);
+    MU_RUN_TEST(test_QuantileSketch_NegativeAndZero);
+    MU_RUN_TEST(test_QuantileSketch_Merge);
+    MU_RUN_TEST(test_QuantileSketch_Collapse);
+}
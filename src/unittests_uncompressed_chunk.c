@@ -140,9 +140,79 @@ MU_TEST(test_Uncompressed_Uncompressed_UpsertSample_DuplicatePolicy) {
     Uncompressed_FreeChunk(chunk);
 }
 
+MU_TEST(test_Uncompressed_DelRange) {
+    Chunk *chunk = Uncompressed_NewChunk(100 * SAMPLE_SIZE);
+    for (timestamp_t ts = 1; ts <= 100; ts++) {
+        Sample sample = { .timestamp = ts, .value = ts };
+        Uncompressed_AddSample(chunk, &sample);
+    }
+    mu_assert_int_eq(0, Uncompressed_DelRange(chunk, 200, 300));
+    mu_assert_int_eq(10, Uncompressed_DelRange(chunk, 0, 10));
+    mu_assert_int_eq(21, Uncompressed_DelRange(chunk, 40, 60));
+    mu_assert_int_eq(69, chunk->num_samples);
+    mu_assert_int_eq(11, chunk->base_timestamp);
+    mu_assert_int_eq(39, chunk->samples[28].timestamp);
+    mu_assert_int_eq(61, chunk->samples[29].timestamp);
+    mu_assert_int_eq(100, Uncompressed_GetLastTimestamp(chunk));
+    Uncompressed_FreeChunk(chunk);
+}
+
+MU_TEST(test_Uncompressed_RetainChunk) {
+    Chunk *chunk = Uncompressed_NewChunk(10 * SAMPLE_SIZE);
+    Sample sample = { .timestamp = 1, .value = 1 };
+    Uncompressed_AddSample(chunk, &sample);
+    mu_check(!Uncompressed_IsChunkShared(chunk));
+    mu_check(Uncompressed_RetainChunk(chunk) == chunk);
+    mu_check(Uncompressed_IsChunkShared(chunk));
+
+    Chunk *copy = Uncompressed_CloneChunk(chunk);
+    mu_check(!Uncompressed_IsChunkShared(copy));
+    mu_check(copy->samples != chunk->samples);
+    sample.timestamp = 2;
+    Uncompressed_AddSample(copy, &sample);
+    mu_assert_int_eq(1, chunk->num_samples);
+    mu_assert_int_eq(2, copy->num_samples);
+    Uncompressed_FreeChunk(copy);
+
+    // the owner lets go first, the reader still sees the chunk
+    Uncompressed_FreeChunk(chunk);
+    mu_check(!Uncompressed_IsChunkShared(chunk));
+    mu_assert_int_eq(1, Uncompressed_GetLastTimestamp(chunk));
+    Uncompressed_FreeChunk(chunk);
+}
+
+MU_TEST(test_Uncompressed_GetValueRange) {
+    Chunk *chunk = Uncompressed_NewChunk(100 * SAMPLE_SIZE);
+    double min, max;
+    mu_check(!Uncompressed_GetValueRange(chunk, &min, &max));
+    for (timestamp_t ts = 1; ts <= 100; ts++) {
+        Sample sample = { .timestamp = ts, .value = ts == 50 ? NAN : ts };
+        Uncompressed_AddSample(chunk, &sample);
+    }
+    mu_check(Uncompressed_GetValueRange(chunk, &min, &max));
+    mu_assert_double_eq(1, min);
+    mu_assert_double_eq(100, max);
+
+    int size;
+    UpsertCtx uCtx = { .inChunk = chunk, .sample = { .timestamp = 30, .value = 500 } };
+    Uncompressed_UpsertSample(&uCtx, &size, DP_LAST);
+    mu_check(Uncompressed_GetValueRange(chunk, &min, &max));
+    mu_assert_double_eq(500, max);
+
+    // a delete leaves the bounds wider than the values, never narrower
+    Uncompressed_DelRange(chunk, 30, 30);
+    mu_check(Uncompressed_GetValueRange(chunk, &min, &max));
+    mu_assert_double_eq(1, min);
+    mu_assert_double_eq(500, max);
+    Uncompressed_FreeChunk(chunk);
+}
+
 MU_TEST_SUITE(uncompressed_chunk_test_suite) {
     MU_RUN_TEST(test_Uncompressed_NewChunk);
     MU_RUN_TEST(test_Uncompressed_Uncompressed_AddSample);
     MU_RUN_TEST(test_Uncompressed_Uncompressed_UpsertSample);
     MU_RUN_TEST(test_Uncompressed_Uncompressed_UpsertSample_DuplicatePolicy);
+    MU_RUN_TEST(test_Uncompressed_DelRange);
+    MU_RUN_TEST(test_Uncompressed_RetainChunk);
+    MU_RUN_TEST(test_Uncompressed_GetValueRange);
 }
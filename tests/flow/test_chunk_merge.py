@@ -0,0 +1,52 @@
+import time
+
+from RLTest import Env
+from test_helper_classes import _get_ts_info
+
+
+def _wait_for_merge(r, key, chunks):
+    for _ in range(50):
+        if _get_ts_info(r, key).chunk_count < chunks:
+            return
+        time.sleep(0.1)
+
+
+def test_merge_undersized_chunks():
+    with Env().getClusterConnectionIfNeeded() as r:
+        for key, options in (('compressed', []), ('uncompressed', ['UNCOMPRESSED'])):
+            r.execute_command('TS.CREATE', key, 'CHUNK_SIZE', 1024, *options)
+            for ts in range(1, 6401):
+                r.execute_command('TS.ADD', key, ts, ts)
+            # leave a small part of every chunk behind
+            for start in range(0, 6400, 64):
+                r.execute_command('TS.DEL', key, start + 1, start + 50)
+            expected = r.execute_command('TS.RANGE', key, '-', '+')
+            chunks = _get_ts_info(r, key).chunk_count
+
+            _wait_for_merge(r, key, chunks / 2)
+            info = _get_ts_info(r, key)
+            assert info.chunk_count < chunks / 2
+            assert info.total_samples == len(expected)
+            assert r.execute_command('TS.RANGE', key, '-', '+') == expected
+            assert r.execute_command('TS.GET', key) == [6400, b'6400']
+
+            debug = r.execute_command('TS.INFO', key, 'DEBUG')
+            debug = dict(zip(debug[::2], debug[1::2]))
+            assert len(debug[b'Chunks']) == info.chunk_count
+
+            # the merged chunks still accept writes
+            r.execute_command('TS.ADD', key, 10, 1, 'ON_DUPLICATE', 'LAST')
+            assert r.execute_command('TS.RANGE', key, 10, 10) == [[10, b'1']]
+
+
+def test_merge_disabled():
+    env = Env(moduleArgs='CHUNK_MERGE_INTERVAL 0')
+    with env.getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', 'series', 'CHUNK_SIZE', 1024, 'UNCOMPRESSED')
+        for ts in range(1, 6401):
+            r.execute_command('TS.ADD', 'series', ts, ts)
+        for start in range(0, 6400, 64):
+            r.execute_command('TS.DEL', 'series', start + 1, start + 50)
+        chunks = _get_ts_info(r, 'series').chunk_count
+        time.sleep(0.5)
+        assert _get_ts_info(r, 'series').chunk_count == chunks
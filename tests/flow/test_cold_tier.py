@@ -0,0 +1,42 @@
+from RLTest import Env
+from test_helper_classes import _get_ts_info
+
+
+def _info(r, key):
+    res = r.execute_command('TS.INFO', key)
+    return {res[i]: res[i + 1] for i in range(0, len(res), 2)}
+
+
+def test_cold_tier_residency():
+    env = Env(moduleArgs='COLD_TIER_PATH /tmp COLD_TIER_AGE 1000')
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('TS.CREATE', 'cold', 'CHUNK_SIZE', 128, 'DUPLICATE_POLICY', 'LAST')
+        r.execute_command('TS.CREATE', 'hot', 'UNCOMPRESSED', 'CHUNK_SIZE', 128)
+        for ts in range(1, 5001):
+            r.execute_command('TS.ADD', 'cold', ts, ts)
+            r.execute_command('TS.ADD', 'hot', ts, ts)
+
+        info = _info(r, 'cold')
+        assert info[b'coldChunkCount'] > 0
+        assert info[b'coldChunkCount'] < info[b'chunkCount']
+        assert info[b'coldMemoryUsage'] > 0
+        assert _info(r, 'hot')[b'coldChunkCount'] == 0
+
+        res = r.execute_command('TS.RANGE', 'cold', '-', '+')
+        assert res == [[ts, str(ts).encode()] for ts in range(1, 5001)]
+        res = r.execute_command('TS.REVRANGE', 'cold', 1, 99, 'AGGREGATION', 'sum', 100)
+        assert res == [[0, b'4950']]
+
+        # a write into a cold chunk brings it back
+        cold_chunks = info[b'coldChunkCount']
+        r.execute_command('TS.ADD', 'cold', 10, 1000)
+        assert r.execute_command('TS.RANGE', 'cold', 10, 10) == [[10, b'1000']]
+        assert _info(r, 'cold')[b'coldChunkCount'] == cold_chunks - 1
+
+        data = r.execute_command('DUMP', 'cold')
+        r.execute_command('DEL', 'cold')
+        r.execute_command('RESTORE', 'cold', 0, data)
+        assert _info(r, 'cold')[b'coldChunkCount'] == cold_chunks
+        assert _get_ts_info(r, 'cold').total_samples == 5000
+        assert r.execute_command('TS.RANGE', 'cold', 10, 10) == [[10, b'1000']]
@@ -0,0 +1,65 @@
+import pytest
+import redis
+from RLTest import Env
+
+
+def _info(r, key):
+    res = r.execute_command('TS.INFO', key)
+    return dict(zip(res[::2], res[1::2]))
+
+
+def test_embedded_levels():
+    env = Env(moduleArgs='COMPACTION_POLICY sum:10m:1d\\;max:100m:1d COMPACTION_STORAGE EMBEDDED')
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('FLUSHALL')
+        for ts in range(0, 250):
+            r.execute_command('TS.ADD', 'metric', ts, ts, 'LABELS', 'name', 'metric')
+
+        # no destination keys, labels or postings
+        assert r.execute_command('KEYS', '*') == [b'metric']
+        assert r.execute_command('TS.QUERYINDEX', 'name=metric') == [b'metric']
+
+        sums = r.execute_command('TS.RANGE', 'metric', '-', '+', 'LEVEL', 'sum:10m')
+        assert len(sums) == 24
+        assert sums[0] == [0, b'45']
+        assert sums[-1] == [230, str(sum(range(230, 240))).encode()]
+        assert r.execute_command('TS.REVRANGE', 'metric', '-', '+', 'LEVEL', 'max:100m') == \
+            [[100, b'199'], [0, b'99']]
+        assert r.execute_command('TS.RANGE', 'metric', 0, 99, 'LEVEL', 'sum:10m',
+                                 'AGGREGATION', 'sum', 100) == [[0, b'4950']]
+
+        levels = _info(r, 'metric')[b'levels']
+        assert [level[:3] for level in levels] == [[b'SUM', 10, 86400000], [b'MAX', 100, 86400000]]
+        assert levels[0][3] == 24
+
+        # deletes are applied to the levels as well
+        r.execute_command('TS.DEL', 'metric', 5, 14)
+        assert r.execute_command('TS.RANGE', 'metric', 0, 10, 'LEVEL', 'sum:10m') == \
+            [[0, b'10'], [10, b'85']]
+
+        # levels survive a reload
+        r.execute_command('DEBUG', 'RELOAD')
+        assert r.execute_command('TS.RANGE', 'metric', 0, 10, 'LEVEL', 'sum:10m') == \
+            [[0, b'10'], [10, b'85']]
+        r.execute_command('TS.ADD', 'metric', 260, 1)
+        assert r.execute_command('TS.RANGE', 'metric', 240, 240, 'LEVEL', 'sum:10m') == \
+            [[240, str(sum(range(240, 250))).encode()]]
+
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.RANGE', 'metric', '-', '+', 'LEVEL', 'avg:10m')
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.RANGE', 'metric', '-', '+', 'LEVEL', 'sum')
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.RANGE', 'metric', '-', '+', 'LEVEL')
+
+
+def test_keys_storage_is_default():
+    env = Env(moduleArgs='COMPACTION_POLICY sum:10m:1d')
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('FLUSHALL')
+        r.execute_command('TS.ADD', 'metric', 1, 1)
+        assert sorted(r.execute_command('KEYS', '*')) == [b'metric', b'metric_SUM_10']
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.RANGE', 'metric', '-', '+', 'LEVEL', 'sum:10m')
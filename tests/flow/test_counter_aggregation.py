@@ -0,0 +1,77 @@
+import pytest
+import redis
+from RLTest import Env
+
+# a counter growing by 10 every second, reset to 5 at 5000
+COUNTER = [(0, 0), (1000, 10), (2000, 20), (3000, 30), (4000, 40),
+           (5000, 5), (6000, 15), (7000, 25), (8000, 35), (9000, 45)]
+
+
+def _add_counter(r, key):
+    for ts, value in COUNTER:
+        r.execute_command('TS.ADD', key, ts, value)
+
+
+def _values(res):
+    return [[row[0], float(row[1])] for row in res]
+
+
+def test_counter_range():
+    with Env().getClusterConnectionIfNeeded() as r:
+        _add_counter(r, 'requests')
+
+        # the second bucket starts from the last sample of the first one, through the reset
+        res = r.execute_command('TS.RANGE', 'requests', '-', '+', 'AGGREGATION', 'increase', 5000)
+        assert _values(res) == [[0, 40], [5000, 45]]
+        res = r.execute_command('TS.RANGE', 'requests', '-', '+', 'AGGREGATION', 'rate,irate', 5000)
+        assert [[row[0], float(row[1]), float(row[2])] for row in res] == \
+            [[0, 10, 10], [5000, 9, 10]]
+
+        # the bucket values don't depend on the direction or on where the range starts
+        res = r.execute_command('TS.REVRANGE', 'requests', '-', '+', 'AGGREGATION', 'INCREASE', 5000)
+        assert _values(res) == [[5000, 45], [0, 40]]
+        res = r.execute_command('TS.RANGE', 'requests', 5000, '+', 'AGGREGATION', 'increase', 5000)
+        assert _values(res) == [[5000, 45]]
+        res = r.execute_command('TS.REVRANGE', 'requests', 5000, '+', 'AGGREGATION', 'increase', 5000)
+        assert _values(res) == [[5000, 45]]
+
+        res = r.execute_command('TS.RANGE', 'requests', '-', '+', 'AGGREGATION', 'increase', 1000)
+        assert sum(value for _, value in _values(res)) == 85
+
+
+def test_counter_single_sample():
+    with Env().getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.ADD', 'requests', 100, 7)
+        # no pair of samples, no increase
+        assert r.execute_command('TS.RANGE', 'requests', '-', '+', 'AGGREGATION', 'increase', 10) == []
+        assert r.execute_command('TS.REVRANGE', 'requests', '-', '+', 'AGGREGATION', 'rate', 10) == []
+
+
+def test_counter_rule_survives_reload():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('TS.CREATE', 'requests')
+        r.execute_command('TS.CREATE', 'requests_rate')
+        r.execute_command('TS.CREATERULE', 'requests', 'requests_rate', 'AGGREGATION', 'rate', 5000)
+        for ts, value in COUNTER[:7]:
+            r.execute_command('TS.ADD', 'requests', ts, value)
+
+        # the open bucket keeps the sample carried from the previous one across a reload
+        r.execute_command('DEBUG', 'RELOAD')
+        for ts, value in COUNTER[7:] + [(10000, 55)]:
+            r.execute_command('TS.ADD', 'requests', ts, value)
+
+        res = r.execute_command('TS.RANGE', 'requests_rate', '-', '+')
+        assert _values(res) == [[0, 10], [5000, 9]]
+        info = r.execute_command('TS.INFO', 'requests')
+        info = dict(zip(info[::2], info[1::2]))
+        assert info[b'rules'] == [[b'requests_rate', 5000, b'RATE']]
+
+
+def test_counter_errors():
+    with Env().getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.ADD', 'requests', 1, 1)
+        for agg in ['rates', 'irat', 'increases']:
+            with pytest.raises(redis.ResponseError):
+                r.execute_command('TS.RANGE', 'requests', '-', '+', 'AGGREGATION', agg, 10)
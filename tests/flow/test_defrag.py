@@ -0,0 +1,81 @@
+import time
+
+import redis
+from RLTest import Env
+from test_helper_classes import _get_ts_info
+
+
+def test_active_defrag_keeps_series_intact():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        try:
+            r.execute_command('CONFIG', 'SET', 'activedefrag', 'yes')
+        except redis.ResponseError:
+            # server built without the defrag-capable jemalloc
+            env.skip()
+            return
+        r.execute_command('CONFIG', 'SET', 'active-defrag-ignore-bytes', '1')
+        r.execute_command('CONFIG', 'SET', 'active-defrag-threshold-lower', '0')
+        r.execute_command('CONFIG', 'SET', 'active-defrag-max-scan-fields', '1')
+
+        keys = ['defrag{}'.format(i) for i in range(200)]
+        for key in keys:
+            r.execute_command('TS.CREATE', key, 'CHUNK_SIZE', '128', 'LABELS', 'name', key, 'group', 'defrag')
+            for ts in range(1, 201):
+                r.execute_command('TS.ADD', key, ts, ts)
+        # leave holes behind so there is something to move
+        for key in keys[::2]:
+            r.execute_command('DEL', key)
+
+        time.sleep(2)
+        r.execute_command('CONFIG', 'SET', 'activedefrag', 'no')
+
+        for key in keys[1::2]:
+            res = r.execute_command('TS.RANGE', key, '-', '+')
+            assert len(res) == 200
+            assert res[0] == [1, b'1']
+            assert res[-1] == [200, b'200']
+            assert r.execute_command('TS.GET', key) == [200, b'200']
+        res = r.execute_command('TS.QUERYINDEX', 'group=defrag')
+        assert len(res) == 100
+
+
+def test_late_defrag_walks_metadata_and_every_chunk():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        try:
+            r.execute_command('CONFIG', 'SET', 'activedefrag', 'no')
+        except redis.ResponseError:
+            env.skip()
+            return
+        # a free effort above max-scan-fields makes the server defrag the series late, in calls
+        # that all pass a cursor, the first one 0
+        r.execute_command('CONFIG', 'SET', 'active-defrag-ignore-bytes', '1')
+        r.execute_command('CONFIG', 'SET', 'active-defrag-threshold-lower', '0')
+        r.execute_command('CONFIG', 'SET', 'active-defrag-max-scan-fields', '1')
+
+        r.execute_command('TS.CREATE', 'late', 'CHUNK_SIZE', '128', 'LABELS', 'name', 'late')
+        p = r.pipeline(transaction=False)
+        for ts in range(1, 20001):
+            p.execute_command('TS.ADD', 'late', ts, ts)
+        p.execute()
+        for i in range(2000):
+            r.set('filler{}'.format(i), 'x' * 100)
+        for i in range(0, 2000, 2):
+            r.delete('filler{}'.format(i))
+        chunks = _get_ts_info(r, 'late').chunk_count
+
+        r.execute_command('CONFIG', 'SET', 'activedefrag', 'yes')
+        time.sleep(2)
+        r.execute_command('CONFIG', 'SET', 'activedefrag', 'no')
+
+        info = r.info('timeseries_defrag')
+        # every walk of the series starts with its metadata and reaches the first chunk
+        assert info['timeseries_defrag_series'] > 0
+        assert info['timeseries_defrag_chunks'] == info['timeseries_defrag_series'] * chunks
+
+        res = r.execute_command('TS.RANGE', 'late', '-', '+', 'COUNT', 1)
+        assert res == [[1, b'1']]
+        assert r.execute_command('TS.QUERYINDEX', 'name=late') == [b'late']
@@ -0,0 +1,89 @@
+import pytest
+import redis
+from RLTest import Env
+
+
+def _add_disks(r):
+    r.execute_command('TS.CREATE', 'disk:1', 'LABELS', 'kind', 'disk', 'name', 'd1')
+    r.execute_command('TS.CREATE', 'disk:2', 'UNCOMPRESSED', 'LABELS', 'kind', 'disk', 'name', 'd2')
+    for ts in range(1, 401):
+        r.execute_command('TS.ADD', 'disk:1', ts, ts)
+        # every other timestamp only
+        if ts % 2 == 0:
+            r.execute_command('TS.ADD', 'disk:2', ts, 1000 + ts)
+
+
+def test_expr_mrange():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        _add_disks(r)
+
+        res = r.execute_command('TS.MRANGE', 1, 6, 'EXPR', 'disk:1 + disk:2', 'FILTER', 'kind=disk')
+        assert res == [[b'disk:1 + disk:2', [], [[2, b'1004'], [4, b'1008'], [6, b'1012']]]]
+        res = r.execute_command('TS.MREVRANGE', 1, 6, 'COUNT', 2, 'WITHLABELS',
+                                'EXPR', '(`disk:2` - `disk:1`) / 2', 'FILTER', 'kind=disk')
+        assert res == [[b'(`disk:2` - `disk:1`) / 2', [[b'__source__', b'disk:2,disk:1']],
+                        [[6, b'500'], [4, b'500']]]]
+
+        # every row is evaluated, over several batches
+        res = r.execute_command('TS.MRANGE', '-', '+', 'EXPR', 'd1 * 2 - -d2', 'ALIAS', 'name',
+                                'FILTER', 'kind=disk')
+        assert res[0][2] == [[ts, str(3 * ts + 1000).encode()] for ts in range(2, 401, 2)]
+
+        # the buckets of the aggregation line up, per aggregation type
+        res = r.execute_command('TS.MRANGE', 1, 20, 'AGGREGATION', 'max,count', 10,
+                                'EXPR', 'd2 - d1', 'ALIAS', 'name', 'FILTER', 'kind=disk')
+        assert res[0][2] == [[0, b'999', b'-5'], [10, b'999', b'-5'], [20, b'1000', b'0']]
+
+        # the timestamps of either series
+        res = r.execute_command('TS.MRANGE', 1, 4, 'EXPR', 'd1 + d2', 'JOIN', 'PREVIOUS',
+                                'ALIAS', 'name', 'FILTER', 'kind=disk')
+        assert res[0][2] == [[2, b'1004'], [3, b'1005'], [4, b'1008']]
+        res = r.execute_command('TS.MREVRANGE', 1, 4, 'EXPR', 'd1 + d2', 'JOIN', 'PREVIOUS',
+                                'ALIAS', 'name', 'FILTER', 'kind=disk')
+        assert res[0][2] == [[4, b'1008'], [3, b'1005'], [2, b'1004']]
+        res = r.execute_command('TS.MRANGE', 1, 3, 'EXPR', 'd1 + d2', 'JOIN', 'VALUE', 0.5,
+                                'ALIAS', 'name', 'FILTER', 'kind=disk')
+        assert res[0][2] == [[1, b'1.5'], [2, b'1004'], [3, b'3.5']]
+
+
+def test_expr_range():
+    with Env().getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', 'http', 'FIELDS', 'errors', 'requests')
+        for ts in range(1, 11):
+            r.execute_command('TS.ADD', 'http', ts, ts % 2, 4)
+
+        res = r.execute_command('TS.RANGE', 'http', 1, 3, 'EXPR', 'errors / requests * 100')
+        assert res == [[1, b'25'], [2, b'0'], [3, b'25']]
+        res = r.execute_command('TS.REVRANGE', 'http', '-', '+', 'COUNT', 2,
+                                'AGGREGATION', 'sum', 5, 'EXPR', 'errors / requests * 100')
+        assert res == [[10, b'0'], [5, b'15']]
+
+        r.execute_command('TS.ADD', 'plain', 1, 3)
+        assert r.execute_command('TS.RANGE', 'plain', '-', '+', 'EXPR', '-plain * plain') == [[1, b'-9']]
+
+
+def test_expr_errors():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        _add_disks(r)
+        r.execute_command('TS.CREATE', 'http', 'FIELDS', 'errors', 'requests')
+        for args in [['EXPR', 'FILTER', 'kind=disk'],
+                     ['EXPR', 'disk:1 +', 'FILTER', 'kind=disk'],
+                     ['EXPR', '(disk:1', 'FILTER', 'kind=disk'],
+                     ['EXPR', '1 + 2', 'FILTER', 'kind=disk'],
+                     ['EXPR', 'disk:1 + nope', 'FILTER', 'kind=disk'],
+                     ['EXPR', 'd1', 'ALIAS', 'kind', 'FILTER', 'kind=disk'],
+                     ['EXPR', 'disk:1', 'JOIN', 'LEFT', 'FILTER', 'kind=disk'],
+                     ['JOIN', 'PREVIOUS', 'FILTER', 'kind=disk'],
+                     ['EXPR', 'disk:1', 'TOPK', 1, 'BY', 'max', 'FILTER', 'kind=disk'],
+                     ['EXPR', 'disk:1', 'FILTER', 'kind=disk', 'GROUPBY', 'kind', 'REDUCE', 'max']]:
+            with pytest.raises(redis.ResponseError):
+                r.execute_command('TS.MRANGE', '-', '+', *args)
+        for args in [['EXPR', 'errors + nope'],
+                     ['EXPR', 'errors', 'ALIAS', 'name'],
+                     ['EXPR', 'errors', 'LIMIT', 10, 'CURSOR', 0]]:
+            with pytest.raises(redis.ResponseError):
+                r.execute_command('TS.RANGE', 'http', '-', '+', *args)
@@ -0,0 +1,87 @@
+import pytest
+import redis
+from RLTest import Env
+
+
+def _add_series(r, key, *args):
+    # small chunks, the filters skip most of them
+    r.execute_command('TS.CREATE', key, 'CHUNK_SIZE', 128, *args)
+    for ts in range(0, 1000):
+        r.execute_command('TS.ADD', key, ts * 10, ts % 100)
+
+
+def _rows(res):
+    return [[row[0], float(row[1])] for row in res]
+
+
+def test_filter_by_ts():
+    with Env().getClusterConnectionIfNeeded() as r:
+        _add_series(r, 'tester')
+        res = r.execute_command('TS.RANGE', 'tester', '-', '+', 'FILTER_BY_TS', 9990, 30, 5, 4000, 30)
+        assert _rows(res) == [[30, 3], [4000, 0], [9990, 99]]
+        res = r.execute_command('TS.REVRANGE', 'tester', 40, '+', 'FILTER_BY_TS', 30, 4000, 9990)
+        assert _rows(res) == [[9990, 99], [4000, 0]]
+        res = r.execute_command('TS.RANGE', 'tester', '-', '+', 'FILTER_BY_TS', 30, 4000, 9990, 'COUNT', 2)
+        assert _rows(res) == [[30, 3], [4000, 0]]
+        assert r.execute_command('TS.RANGE', 'tester', '-', '+', 'FILTER_BY_TS', 1, 2) == []
+
+
+def test_filter_by_value():
+    with Env().getClusterConnectionIfNeeded() as r:
+        _add_series(r, 'tester')
+        res = r.execute_command('TS.RANGE', 'tester', '-', '+', 'FILTER_BY_VALUE', 97, 98.5)
+        assert [row[0] for row in res] == [ts * 1000 + offset for ts in range(10) for offset in (970, 980)]
+        rev = r.execute_command('TS.REVRANGE', 'tester', '-', '+', 'FILTER_BY_VALUE', 97, 98.5)
+        assert rev == res[::-1]
+
+        # both filters, before the aggregation
+        res = r.execute_command('TS.RANGE', 'tester', '-', '+', 'FILTER_BY_TS', 10, 20, 980, 5000,
+                                'FILTER_BY_VALUE', 2, 100, 'AGGREGATION', 'count', 1000)
+        assert _rows(res) == [[0, 2]]
+        res = r.execute_command('TS.RANGE', 'tester', '-', '+', 'FILTER_BY_VALUE', 0, 0,
+                                'AGGREGATION', 'count', 1000)
+        assert _rows(res) == [[ts * 1000, 1] for ts in range(10)]
+
+
+def test_filter_by_value_after_reload():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        _add_series(r, 'tester')
+        _add_series(r, 'tester_uncompressed', 'UNCOMPRESSED')
+        expected = r.execute_command('TS.RANGE', 'tester', '-', '+', 'FILTER_BY_VALUE', 50, 51)
+        # the chunk value bounds are rebuilt on load
+        r.execute_command('DEBUG', 'RELOAD')
+        for key in ('tester', 'tester_uncompressed'):
+            assert r.execute_command('TS.RANGE', key, '-', '+', 'FILTER_BY_VALUE', 50, 51) == expected
+
+        # an upsert widens the bounds of its chunk
+        r.execute_command('TS.ADD', 'tester', 15, 1000, 'ON_DUPLICATE', 'LAST')
+        res = r.execute_command('TS.RANGE', 'tester', '-', '+', 'FILTER_BY_VALUE', 1000, 1000)
+        assert _rows(res) == [[15, 1000]]
+
+
+def test_mrange_filter_by():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        _add_series(r, 's1', 'LABELS', 'group', 'g')
+        _add_series(r, 's2', 'LABELS', 'group', 'g')
+        res = r.execute_command('TS.MRANGE', '-', '+', 'FILTER_BY_TS', 30, 40,
+                                'FILTER_BY_VALUE', 4, 10, 'FILTER', 'group=g')
+        assert [[row[0], _rows(row[2])] for row in res] == [[b's1', [[40, 4]]], [b's2', [[40, 4]]]]
+        res = r.execute_command('TS.MRANGE', '-', '+', 'FILTER_BY_VALUE', 99, 99, 'AGGREGATION', 'count', 10000,
+                                'FILTER', 'group=g', 'GROUPBY', 'group', 'REDUCE', 'sum')
+        assert _rows(res[0][2]) == [[0, 20]]
+
+
+def test_filter_by_errors():
+    with Env().getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.ADD', 'tester', 1, 1)
+        for args in [['FILTER_BY_TS'], ['FILTER_BY_TS', 'COUNT', 1], ['FILTER_BY_VALUE', 1],
+                     ['FILTER_BY_VALUE', 'a', 2]]:
+            with pytest.raises(redis.ResponseError):
+                r.execute_command('TS.RANGE', 'tester', '-', '+', *args)
+        r.execute_command('TS.CREATE', 'fields', 'FIELDS', 'a', 'b')
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.RANGE', 'fields', '-', '+', 'FILTER_BY_VALUE', 1, 2)
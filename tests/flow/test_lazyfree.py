@@ -0,0 +1,99 @@
+from RLTest import Env
+
+
+def _create_with_rule(r, src, dst):
+    r.execute_command('TS.CREATE', src, 'CHUNK_SIZE', '128', 'LABELS', 'name', src, 'group', 'lazy')
+    r.execute_command('TS.CREATE', dst)
+    r.execute_command('TS.CREATERULE', src, dst, 'AGGREGATION', 'max', 10)
+    for ts in range(1, 5001):
+        r.execute_command('TS.ADD', src, ts, ts)
+
+
+def test_unlink_large_series():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('CONFIG', 'SET', 'lazyfree-lazy-user-del', 'yes')
+        _create_with_rule(r, 'lazy1', 'lazy1_agg')
+        _create_with_rule(r, 'lazy2', 'lazy2_agg')
+
+        assert r.execute_command('UNLINK', 'lazy1') == 1
+        assert r.execute_command('DEL', 'lazy2') == 1
+        assert r.execute_command('TS.QUERYINDEX', 'group=lazy') == []
+        # the destinations no longer reference the deleted sources
+        for dst in ['lazy1_agg', 'lazy2_agg']:
+            info = r.execute_command('TS.INFO', dst)
+            assert info[info.index(b'sourceKey') + 1] is None
+
+        # a series re-created under the same name starts clean
+        r.execute_command('TS.CREATE', 'lazy1', 'LABELS', 'group', 'lazy')
+        assert r.execute_command('TS.QUERYINDEX', 'group=lazy') == [b'lazy1']
+        memstats = r.execute_command('TS.MEMSTATS')
+        assert memstats[memstats.index(b'seriesCount') + 1] == 3
+
+
+def test_flush_async():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        _create_with_rule(r, 'flush1', 'flush1_agg')
+        r.execute_command('FLUSHALL', 'ASYNC')
+        assert r.execute_command('TS.QUERYINDEX', 'group=lazy') == []
+        memstats = r.execute_command('TS.MEMSTATS')
+        assert memstats[memstats.index(b'seriesCount') + 1] == 0
+
+        _create_with_rule(r, 'flush1', 'flush1_agg')
+        assert r.execute_command('TS.QUERYINDEX', 'group=lazy') == [b'flush1']
+        assert r.execute_command('TS.GET', 'flush1_agg') == [4990, b'4999']
+
+
+def test_rename_and_move_keep_series_attached():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        _create_with_rule(r, 'before', 'before_agg')
+
+        # the server unlinks a renamed or moved value from its old key
+        r.execute_command('RENAME', 'before', 'after')
+        assert r.execute_command('TS.QUERYINDEX', 'group=lazy') == [b'after']
+        res = r.execute_command('TS.MRANGE', 1, 2, 'FILTER', 'group=lazy')
+        assert res == [[b'after', [], [[1, b'1'], [2, b'2']]]]
+        info = r.execute_command('TS.INFO', 'after')
+        assert info[info.index(b'rules') + 1] == [[b'before_agg', 10, b'MAX']]
+        # the rule still compacts into the destination
+        r.execute_command('TS.ADD', 'after', 5011, 1)
+        assert r.execute_command('TS.GET', 'before_agg') == [5000, b'5000']
+        memstats = r.execute_command('TS.MEMSTATS')
+        assert memstats[memstats.index(b'seriesCount') + 1] == 2
+
+        assert r.execute_command('MOVE', 'after', 1) == 1
+        assert r.execute_command('TS.QUERYINDEX', 'group=lazy') == []
+        r.execute_command('SELECT', 1)
+        assert r.execute_command('TS.QUERYINDEX', 'group=lazy') == [b'after']
+        res = r.execute_command('TS.MRANGE', 1, 2, 'FILTER', 'group=lazy')
+        assert res == [[b'after', [], [[1, b'1'], [2, b'2']]]]
+        info = r.execute_command('TS.INFO', 'after')
+        assert info[info.index(b'rules') + 1] == [[b'before_agg', 10, b'MAX']]
+        memstats = r.execute_command('TS.MEMSTATS')
+        assert memstats[memstats.index(b'seriesCount') + 1] == 2
+        r.execute_command('SELECT', 0)
+
+
+def test_unlink_embedded_levels():
+    env = Env(moduleArgs='COMPACTION_POLICY sum:10m:1d\\;max:100m:1d COMPACTION_STORAGE EMBEDDED')
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('FLUSHALL')
+        r.execute_command('CONFIG', 'SET', 'lazyfree-lazy-user-del', 'yes')
+        for key in ['levels1', 'levels2']:
+            for ts in range(0, 5000):
+                r.execute_command('TS.ADD', key, ts, ts, 'CHUNK_SIZE', '128')
+        memstats = r.execute_command('TS.MEMSTATS')
+        assert memstats[memstats.index(b'compactionContexts') + 1] > 0
+
+        # the levels leave the counters when the key is unlinked, before the lazy free
+        assert r.execute_command('UNLINK', 'levels1') == 1
+        assert r.execute_command('DEL', 'levels2') == 1
+        memstats = r.execute_command('TS.MEMSTATS')
+        assert memstats[memstats.index(b'compactionContexts') + 1] == 0
+        assert memstats[memstats.index(b'seriesCount') + 1] == 0
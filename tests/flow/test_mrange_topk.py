@@ -0,0 +1,90 @@
+import pytest
+import redis
+from RLTest import Env
+
+SERIES = 20
+SAMPLES = 500
+
+
+def _add_series(r):
+    expected = {}
+    for i in range(SERIES):
+        key = 'tester{:02d}'.format(i)
+        args = ['UNCOMPRESSED'] if i % 2 else []
+        # small chunks, the value bounds of most of them rule the series out
+        r.execute_command('TS.CREATE', key, 'CHUNK_SIZE', 128, *args, 'LABELS', 'name', 'topk')
+        samples = [((ts * 7 + i * 13) % 50) + i for ts in range(SAMPLES)]
+        p = r.pipeline(transaction=False)
+        for ts, value in enumerate(samples):
+            p.execute_command('TS.ADD', key, ts * 10, value)
+        p.execute()
+        expected[key.encode()] = samples
+    return expected
+
+
+def _ranked(expected, score, ascending=False):
+    scores = {'max': max, 'sum': sum, 'last': lambda s: s[-1],
+              'avg': lambda s: float(sum(s)) / len(s)}
+    keys = sorted(expected)
+    # ties go to the first key
+    return sorted(keys, key=lambda key: (scores[score](expected[key]) * (1 if ascending else -1), key))
+
+
+def test_topk():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        expected = _add_series(r)
+        for score in ('max', 'avg', 'sum', 'last'):
+            for k in (1, 3, SERIES, SERIES + 5):
+                res = r.execute_command('TS.MRANGE', '-', '+', 'TOPK', k, 'BY', score, 'FILTER', 'name=topk')
+                assert [row[0] for row in res] == _ranked(expected, score)[:k]
+                res = r.execute_command('TS.MRANGE', '-', '+', 'TOPK', k, 'BY', score, 'ASC',
+                                        'FILTER', 'name=topk')
+                assert [row[0] for row in res] == _ranked(expected, score, True)[:k]
+
+        # only the winners are queried, with the aggregation of the reply
+        full = r.execute_command('TS.MREVRANGE', '-', '+', 'COUNT', 3, 'AGGREGATION', 'max', 1000,
+                                 'WITHLABELS', 'FILTER', 'name=topk')
+        top = r.execute_command('TS.MREVRANGE', '-', '+', 'COUNT', 3, 'AGGREGATION', 'max', 1000,
+                                'WITHLABELS', 'TOPK', 2, 'BY', 'avg', 'DESC', 'FILTER', 'name=topk')
+        rows = dict((row[0], row) for row in full)
+        assert top == [rows[key] for key in _ranked(expected, 'avg')[:2]]
+
+
+def test_topk_range_and_filters():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('TS.ADD', 'a', 10, 5, 'LABELS', 'name', 'topk')
+        r.execute_command('TS.ADD', 'a', 20, 100)
+        r.execute_command('TS.ADD', 'b', 10, 50, 'LABELS', 'name', 'topk')
+        r.execute_command('TS.ADD', 'b', 20, 60)
+        r.execute_command('TS.ADD', 'c', 30, 1000, 'LABELS', 'name', 'topk')
+
+        res = r.execute_command('TS.MRANGE', '-', '+', 'TOPK', 3, 'BY', 'max', 'FILTER', 'name=topk')
+        assert [row[0] for row in res] == [b'c', b'a', b'b']
+        # scored over the range, the series without samples in it are left out
+        res = r.execute_command('TS.MRANGE', 0, 20, 'TOPK', 3, 'BY', 'max', 'FILTER', 'name=topk')
+        assert [row[0] for row in res] == [b'a', b'b']
+        res = r.execute_command('TS.MRANGE', 0, 20, 'FILTER_BY_VALUE', 0, 70, 'TOPK', 3, 'BY', 'sum',
+                                'FILTER', 'name=topk')
+        assert [row[0] for row in res] == [b'b', b'a']
+        res = r.execute_command('TS.MRANGE', 0, 20, 'FILTER_BY_TS', 10, 'TOPK', 1, 'BY', 'last',
+                                'FILTER', 'name=topk')
+        assert [row[0] for row in res] == [b'b']
+
+
+def test_topk_errors():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('TS.ADD', 'a', 10, 5, 'LABELS', 'name', 'topk')
+        for args in [['TOPK', 'FILTER', 'name=topk'],
+                     ['TOPK', 0, 'BY', 'max', 'FILTER', 'name=topk'],
+                     ['TOPK', -1, 'BY', 'max', 'FILTER', 'name=topk'],
+                     ['TOPK', 2, 'max', 'FILTER', 'name=topk'],
+                     ['TOPK', 2, 'BY', 'min', 'FILTER', 'name=topk'],
+                     ['TOPK', 2, 'BY', 'max', 'FILTER', 'name=topk', 'GROUPBY', 'name', 'REDUCE', 'max']]:
+            with pytest.raises(redis.ResponseError):
+                r.execute_command('TS.MRANGE', '-', '+', *args)
@@ -0,0 +1,70 @@
+import pytest
+import redis
+from RLTest import Env
+
+
+def _columns(r, key, aggregations):
+    return [r.execute_command('TS.RANGE', key, '-', '+', 'AGGREGATION', agg, 10)
+            for agg in aggregations]
+
+
+def test_multiple_aggregations():
+    with Env().getClusterConnectionIfNeeded() as r:
+        for ts in range(0, 100):
+            r.execute_command('TS.ADD', 'tester', ts, ts % 7)
+
+        aggregations = ['min', 'max', 'avg', 'count']
+        expected = _columns(r, 'tester', aggregations)
+        res = r.execute_command('TS.RANGE', 'tester', '-', '+', 'AGGREGATION', 'min,max,avg,count', 10)
+        assert len(res) == 10
+        for i, row in enumerate(res):
+            assert row == [expected[0][i][0]] + [column[i][1] for column in expected]
+
+        rev = r.execute_command('TS.REVRANGE', 'tester', '-', '+', 'AGGREGATION', 'MAX,min', 10)
+        assert rev[0] == [90, b'6', b'0']
+        assert len(rev) == 10
+
+        res = r.execute_command('TS.RANGE', 'tester', '-', '+', 'AGGREGATION', 'sum', 10, 'COUNT', 2)
+        assert r.execute_command('TS.RANGE', 'tester', '-', '+', 'AGGREGATION', 'sum,count', 10,
+                                 'COUNT', 2) == [row + [b'10'] for row in res]
+
+
+def test_multiple_aggregations_fields():
+    with Env().getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', 'tester', 'FIELDS', 'low', 'high')
+        for ts in range(0, 20):
+            r.execute_command('TS.ADD', 'tester', ts, ts, ts * 2)
+        assert r.execute_command('TS.RANGE', 'tester', '-', '+', 'AGGREGATION', 'min,max', 10) == \
+            [[0, b'0', b'9', b'0', b'18'], [10, b'10', b'19', b'20', b'38']]
+
+
+def test_multiple_aggregations_mrange():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('TS.CREATE', 's1', 'LABELS', 'group', 'multi')
+        r.execute_command('TS.CREATE', 's2', 'LABELS', 'group', 'multi')
+        for ts in range(0, 20):
+            r.execute_command('TS.ADD', 's1', ts, ts)
+            r.execute_command('TS.ADD', 's2', ts, ts * 10)
+
+        res = r.execute_command('TS.MRANGE', '-', '+', 'AGGREGATION', 'min,max', 10,
+                                'FILTER', 'group=multi')
+        assert sorted(res) == [[b's1', [], [[0, b'0', b'9'], [10, b'10', b'19']]],
+                               [b's2', [], [[0, b'0', b'90'], [10, b'100', b'190']]]]
+
+        res = r.execute_command('TS.MRANGE', '-', '+', 'AGGREGATION', 'min,max', 10,
+                                'FILTER', 'group=multi', 'GROUPBY', 'group', 'REDUCE', 'max')
+        assert res[0][2] == [[0, b'0', b'90'], [10, b'100', b'190']]
+
+
+def test_multiple_aggregations_errors():
+    with Env().getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.ADD', 'tester', 1, 1)
+        for types in ['min,min', 'min,', ',max', 'min,bad', 'min;max']:
+            with pytest.raises(redis.ResponseError):
+                r.execute_command('TS.RANGE', 'tester', '-', '+', 'AGGREGATION', types, 10)
+        # compaction rules keep a single aggregation
+        r.execute_command('TS.CREATE', 'dest')
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.CREATERULE', 'tester', 'dest', 'AGGREGATION', 'min,max', 10)
@@ -0,0 +1,89 @@
+from RLTest import Env
+
+SERIES = 12
+SAMPLES = 2000
+
+
+def _add_series(r):
+    for i in range(SERIES):
+        key = 'tester{}'.format(i)
+        args = ['UNCOMPRESSED'] if i % 2 else []
+        r.execute_command('TS.CREATE', key, 'CHUNK_SIZE', 128, *args,
+                          'LABELS', 'name', 'mrange', 'group', i % 3, 'index', i)
+        p = r.pipeline(transaction=False)
+        for ts in range(0, SAMPLES):
+            p.execute_command('TS.ADD', key, ts * 10 + i + ts % 7, ((ts + i) * 37) % 101 - 50)
+        p.execute()
+
+
+def _serial(r, *args):
+    # a blocked client is not allowed inside a transaction, the query runs on the main thread
+    p = r.pipeline(transaction=True)
+    p.execute_command(*args)
+    return p.execute()[0]
+
+
+def test_parallel_mrange():
+    env = Env(moduleArgs='QUERY_THREADS 4')
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        _add_series(r)
+        for command in ('TS.MRANGE', 'TS.MREVRANGE'):
+            for args in [['-', '+'],
+                         [1234, 15000],
+                         ['-', '+', 'FILTER_BY_VALUE', -10, 20],
+                         ['-', '+', 'FILTER_BY_TS', 5, 31, 4000, 9990, 15003],
+                         ['-', '+', 'COUNT', 10],
+                         ['-', '+', 'WITHLABELS']]:
+                for aggregation in [[],
+                                    ['AGGREGATION', 'avg', 7],
+                                    ['AGGREGATION', 'avg,first,last,min,max,p50,count', 1000],
+                                    ['AGGREGATION', 'twa,rate', 1000],
+                                    ['AGGREGATION', 'sum', 1000, 'EMPTY']]:
+                    query = [command] + args + aggregation + ['FILTER', 'name=mrange']
+                    assert r.execute_command(*query) == _serial(r, *query)
+                    for reducer in ('sum', 'min', 'max'):
+                        grouped = query + ['GROUPBY', 'group', 'REDUCE', reducer]
+                        assert r.execute_command(*grouped) == _serial(r, *grouped)
+
+
+def test_parallel_mrange_fanout():
+    env = Env(moduleArgs='QUERY_THREADS 4 QUERY_FANOUT 1')
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        _add_series(r)
+        query = ['TS.MRANGE', '-', '+', 'AGGREGATION', 'max', 100, 'FILTER', 'name=mrange']
+        assert r.execute_command(*query) == _serial(r, *query)
+
+
+def test_parallel_mrange_after_writes():
+    env = Env(moduleArgs='QUERY_THREADS 4')
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        _add_series(r)
+        query = ['TS.MRANGE', '-', '+', 'AGGREGATION', 'sum', 1000, 'FILTER', 'name=mrange']
+        expected = r.execute_command(*query)
+        # writes and deletes copy the chunks still pinned by the previous query
+        r.execute_command('TS.ADD', 'tester3', 13, 1000, 'ON_DUPLICATE', 'LAST')
+        r.execute_command('TS.DEL', 'tester5', 5000, 6000)
+        r.execute_command('DEL', 'tester7')
+        res = r.execute_command(*query)
+        assert res != expected
+        assert len(res) == SERIES - 1
+        assert res == _serial(r, *query)
+
+
+def test_sliced_mrange():
+    env = Env(moduleArgs='MAX_EXEC_SLICE_MS 1')
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        _add_series(r)
+        for args in [['-', '+'],
+                     ['-', '+', 'COUNT', 10, 'WITHLABELS'],
+                     ['-', '+', 'AGGREGATION', 'avg,max', 7],
+                     ['-', '+', 'AGGREGATION', 'twa', 100, 'EMPTY']]:
+            query = ['TS.MRANGE'] + args + ['FILTER', 'name=mrange']
+            assert r.execute_command(*query) == _serial(r, *query)
+            grouped = query + ['GROUPBY', 'group', 'REDUCE', 'sum']
+            assert r.execute_command(*grouped) == _serial(r, *grouped)
+
@@ -0,0 +1,71 @@
+from RLTest import Env
+
+SAMPLES = 20000
+
+
+def _add_series(r, key, *args):
+    # small chunks, so the range spans enough of them to be split
+    r.execute_command('TS.CREATE', key, 'CHUNK_SIZE', 128, *args)
+    p = r.pipeline(transaction=False)
+    for ts in range(0, SAMPLES):
+        p.execute_command('TS.ADD', key, ts * 10 + ts % 7, (ts * 37) % 101 - 50)
+    p.execute()
+
+
+def _serial(r, *args):
+    # a COUNT keeps the query on the main thread
+    return r.execute_command(*args, 'COUNT', SAMPLES + 1)
+
+
+def test_parallel_range():
+    env = Env(moduleArgs='QUERY_THREADS 4')
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        _add_series(r, 'compressed')
+        _add_series(r, 'uncompressed', 'UNCOMPRESSED')
+        for key in ('compressed', 'uncompressed'):
+            for command in ('TS.RANGE', 'TS.REVRANGE'):
+                for args in [['-', '+'],
+                             [1234, 150000],
+                             ['-', '+', 'FILTER_BY_VALUE', -10, 20],
+                             ['-', '+', 'FILTER_BY_TS', 5, 31, 4000, 99990, 150003]]:
+                    query = [command, key] + args
+                    res = r.execute_command(*query)
+                    assert res == _serial(r, *query)
+                    # buckets shorter than a chunk, longer than a task and spanning the series
+                    for bucket in (7, 1000, 100000, 10000000):
+                        aggregation = ['AGGREGATION', 'avg,first,last,min,max,range,std.p,p50,count,sum',
+                                       bucket]
+                        res = r.execute_command(*query, *aggregation)
+                        assert res == _serial(r, *query, *aggregation)
+
+
+def test_parallel_range_serial_fallback():
+    env = Env(moduleArgs='QUERY_THREADS 2')
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        _add_series(r, 'tester')
+        # aggregations carrying samples between buckets and EMPTY run on the main thread
+        for aggregation in (['rate', 1000], ['twa', 1000], ['avg', 1000, 'EMPTY']):
+            query = ['TS.RANGE', 'tester', '-', '+', 'AGGREGATION'] + aggregation
+            assert r.execute_command(*query) == _serial(r, *query)
+
+        # a blocked client is not allowed inside a transaction
+        p = r.pipeline(transaction=True)
+        p.execute_command('TS.RANGE', 'tester', '-', '+')
+        assert p.execute()[0] == r.execute_command('TS.RANGE', 'tester', '-', '+')
+
+
+def test_parallel_range_after_writes():
+    env = Env(moduleArgs='QUERY_THREADS 4')
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        _add_series(r, 'tester')
+        expected = r.execute_command('TS.RANGE', 'tester', '-', '+', 'AGGREGATION', 'sum', 1000)
+        # writes and deletes copy the chunks still pinned by the previous query
+        r.execute_command('TS.ADD', 'tester', 15, 1000, 'ON_DUPLICATE', 'LAST')
+        r.execute_command('TS.DEL', 'tester', 50000, 60000)
+        res = r.execute_command('TS.RANGE', 'tester', '-', '+', 'AGGREGATION', 'sum', 1000)
+        assert res != expected
+        assert res == _serial(r, 'TS.RANGE', 'tester', '-', '+', 'AGGREGATION', 'sum', 1000)
+        r.execute_command('DEL', 'tester')
@@ -0,0 +1,97 @@
+import pytest
+import redis
+from RLTest import Env
+
+
+def _value(row):
+    return float(row[1])
+
+
+def test_range_percentiles():
+    with Env().getClusterConnectionIfNeeded() as r:
+        for ts in range(0, 2000):
+            r.execute_command('TS.ADD', 'latency', ts, ts % 1000 + 1)
+
+        res = r.execute_command('TS.RANGE', 'latency', '-', '+', 'AGGREGATION', 'p50', 1000)
+        assert [row[0] for row in res] == [0, 1000]
+        for row in res:
+            assert _value(row) == pytest.approx(500, rel=0.01)
+        res = r.execute_command('TS.RANGE', 'latency', '-', '+', 'AGGREGATION', 'P99', 2000)
+        assert _value(res[0]) == pytest.approx(990, rel=0.01)
+
+        res = r.execute_command('TS.RANGE', 'latency', '-', '+', 'AGGREGATION', 'p90,p999,max', 1000)
+        assert float(res[0][1]) == pytest.approx(900, rel=0.01)
+        assert float(res[0][2]) == pytest.approx(999, rel=0.01)
+        assert res[0][3] == b'1000'
+
+
+def test_percentile_rule_survives_reload():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('TS.CREATE', 'latency')
+        r.execute_command('TS.CREATE', 'latency_p95')
+        r.execute_command('TS.CREATERULE', 'latency', 'latency_p95', 'AGGREGATION', 'p95', 100)
+        for ts in range(0, 150):
+            r.execute_command('TS.ADD', 'latency', ts, ts % 100)
+
+        # the open bucket keeps its sketch across a reload
+        r.execute_command('DEBUG', 'RELOAD')
+        for ts in range(150, 201):
+            r.execute_command('TS.ADD', 'latency', ts, ts % 100)
+
+        res = r.execute_command('TS.RANGE', 'latency_p95', '-', '+')
+        assert [row[0] for row in res] == [0, 100]
+        assert _value(res[0]) == pytest.approx(94, rel=0.01)
+        assert _value(res[1]) == pytest.approx(94, rel=0.01)
+        info = r.execute_command('TS.INFO', 'latency')
+        info = dict(zip(info[::2], info[1::2]))
+        assert info[b'rules'] == [[b'latency_p95', 100, b'P95']]
+
+
+def test_percentile_groupby():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        for key, scale in (('s1', 1), ('s2', 10)):
+            r.execute_command('TS.CREATE', key, 'LABELS', 'group', 'latency')
+            for ts in range(0, 100):
+                r.execute_command('TS.ADD', key, ts, (ts + 1) * scale)
+
+        res = r.execute_command('TS.MRANGE', '-', '+', 'AGGREGATION', 'p50', 100,
+                                'FILTER', 'group=latency', 'GROUPBY', 'group', 'REDUCE', 'max')
+        assert len(res[0][2]) == 1
+        assert _value(res[0][2][0]) == pytest.approx(500, rel=0.01)
+
+
+def test_percentile_reducer_merges_sketches():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        # the union of the samples of both members, in a series of its own
+        r.execute_command('TS.CREATE', 'union')
+        for offset, (key, scale) in enumerate((('m1', 1), ('m2', 7))):
+            r.execute_command('TS.CREATE', key, 'LABELS', 'group', 'merged')
+            for ts in range(0, 300):
+                value = ((ts * 37) % 101 + 1) * scale
+                r.execute_command('TS.ADD', key, ts * 2 + offset, value)
+                r.execute_command('TS.ADD', 'union', ts * 2 + offset, value)
+
+        for reducer in ['p50', 'p90', 'p99']:
+            expected = r.execute_command('TS.RANGE', 'union', '-', '+', 'AGGREGATION', reducer, 100)
+            for reverse, command in ((False, 'TS.MRANGE'), (True, 'TS.MREVRANGE')):
+                # the members aggregate with any percentile, the reducer picks the quantile
+                res = r.execute_command(command, '-', '+', 'WITHLABELS', 'AGGREGATION', 'p75', 100,
+                                        'FILTER', 'group=merged', 'GROUPBY', 'group', 'REDUCE', reducer)
+                assert res[0][1][1] == [b'__reducer__', reducer.encode()]
+                assert res[0][2] == (expected[::-1] if reverse else expected)
+
+        for args in [['GROUPBY', 'group', 'REDUCE', 'p99'],
+                     ['GROUPBY', 'group', 'REDUCE', 'p98']]:
+            with pytest.raises(redis.ResponseError):
+                r.execute_command('TS.MRANGE', '-', '+', 'AGGREGATION', 'max', 100,
+                                  'FILTER', 'group=merged', *args)
+        for aggregation in [[], ['AGGREGATION', 'p50,p99', 100], ['AGGREGATION', 'p50', 100, 'EMPTY']]:
+            with pytest.raises(redis.ResponseError):
+                r.execute_command('TS.MRANGE', '-', '+', *aggregation,
+                                  'FILTER', 'group=merged', 'GROUPBY', 'group', 'REDUCE', 'p50')
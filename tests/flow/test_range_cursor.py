@@ -0,0 +1,61 @@
+import pytest
+import redis
+from RLTest import Env
+
+
+def _read_pages(r, cmd, key, limit, *args):
+    rows = []
+    cursor = b'0'
+    pages = 0
+    while True:
+        page, cursor = r.execute_command(cmd, key, '-', '+', *args, 'LIMIT', limit, 'CURSOR', cursor)
+        assert len(page) <= limit
+        rows += page
+        pages += 1
+        if cursor == b'0':
+            return rows, pages
+
+
+def test_range_pages():
+    with Env().getClusterConnectionIfNeeded() as r:
+        for key, options in (('compressed', []), ('uncompressed', ['UNCOMPRESSED'])):
+            r.execute_command('TS.CREATE', key, 'CHUNK_SIZE', 128, *options)
+            for ts in range(0, 1000, 3):
+                r.execute_command('TS.ADD', key, ts, ts)
+
+            for cmd in ('TS.RANGE', 'TS.REVRANGE'):
+                expected = r.execute_command(cmd, key, '-', '+')
+                rows, pages = _read_pages(r, cmd, key, 7)
+                assert rows == expected
+                assert pages == (len(expected) + 6) // 7
+
+                expected = r.execute_command(cmd, key, '-', '+', 'AGGREGATION', 'sum', 50)
+                rows, _ = _read_pages(r, cmd, key, 4, 'AGGREGATION', 'sum', 50)
+                assert rows == expected
+
+            # a page that ends on the last sample still reports the end of the range
+            page, cursor = r.execute_command('TS.RANGE', key, 990, '+', 'LIMIT', 10, 'CURSOR', 0)
+            assert page == [[990, b'990'], [993, b'993'], [996, b'996'], [999, b'999']]
+            assert cursor == b'0'
+
+
+def test_range_cursor_sees_new_samples():
+    with Env().getClusterConnectionIfNeeded() as r:
+        for ts in range(1, 11):
+            r.execute_command('TS.ADD', 'live', ts, ts)
+        page, cursor = r.execute_command('TS.RANGE', 'live', '-', '+', 'LIMIT', 5, 'CURSOR', 0)
+        assert [row[0] for row in page] == [1, 2, 3, 4, 5]
+        r.execute_command('TS.ADD', 'live', 11, 11)
+        r.execute_command('TS.DEL', 'live', 6, 6)
+        page, cursor = r.execute_command('TS.RANGE', 'live', '-', '+', 'LIMIT', 5, 'CURSOR', cursor)
+        assert [row[0] for row in page] == [7, 8, 9, 10, 11]
+        assert cursor == b'0'
+
+
+def test_range_cursor_errors():
+    with Env().getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.ADD', 'series', 1, 1)
+        for args in (['LIMIT', 10], ['CURSOR', 0], ['LIMIT', 0, 'CURSOR', 0],
+                     ['LIMIT', 10, 'CURSOR', 'abc'], ['COUNT', 5, 'LIMIT', 10, 'CURSOR', 0]):
+            with pytest.raises(redis.ResponseError):
+                r.execute_command('TS.RANGE', 'series', '-', '+', *args)
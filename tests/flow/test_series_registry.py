@@ -0,0 +1,76 @@
+import time
+
+from RLTest import Env
+
+
+def _mget_keys(r, query):
+    return sorted(res[0] for res in r.execute_command('TS.MGET', 'FILTER', query))
+
+
+def _mrange_keys(r, query):
+    return sorted(res[0] for res in r.execute_command('TS.MRANGE', '-', '+', 'FILTER', query))
+
+
+def test_rename_keeps_series_queryable():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('TS.CREATE', 'old', 'LABELS', 'group', 'rename')
+        r.execute_command('TS.ADD', 'old', 1, 1)
+        r.execute_command('TS.CREATE', 'other', 'LABELS', 'group', 'rename')
+        r.execute_command('TS.ADD', 'other', 1, 2)
+
+        r.execute_command('RENAME', 'old', 'new')
+        assert _mget_keys(r, 'group=rename') == [b'new', b'other']
+        assert _mrange_keys(r, 'group=rename') == [b'new', b'other']
+        assert sorted(r.execute_command('TS.QUERYINDEX', 'group=rename')) == [b'new', b'other']
+        res = r.execute_command('TS.MRANGE', '-', '+', 'FILTER', 'group=rename', 'GROUPBY', 'group',
+                                'REDUCE', 'sum')
+        assert res[0][2] == [[1, b'3']]
+
+        # renaming over an existing series drops the overwritten one
+        r.execute_command('RENAME', 'new', 'other')
+        assert _mget_keys(r, 'group=rename') == [b'other']
+        assert r.execute_command('TS.GET', 'other') == [1, b'1']
+
+
+def test_move_and_swapdb():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('TS.CREATE', 'moved', 'LABELS', 'group', 'dbs')
+        r.execute_command('TS.ADD', 'moved', 1, 1)
+        r.execute_command('TS.CREATE', 'stays', 'LABELS', 'group', 'dbs')
+        assert _mget_keys(r, 'group=dbs') == [b'moved', b'stays']
+
+        assert r.execute_command('MOVE', 'moved', 1) == 1
+        assert _mget_keys(r, 'group=dbs') == [b'stays']
+        r.execute_command('SELECT', 1)
+        assert _mget_keys(r, 'group=dbs') == [b'moved']
+
+        r.execute_command('SWAPDB', 0, 1)
+        assert _mget_keys(r, 'group=dbs') == [b'stays']
+        r.execute_command('SELECT', 0)
+        assert _mget_keys(r, 'group=dbs') == [b'moved']
+        assert _mrange_keys(r, 'group=dbs') == [b'moved']
+
+
+def test_expire_and_restore():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('TS.CREATE', 'ttl', 'LABELS', 'group', 'ttl')
+        r.execute_command('TS.ADD', 'ttl', 1, 1)
+        assert _mget_keys(r, 'group=ttl') == [b'ttl']
+        r.execute_command('PEXPIRE', 'ttl', 100)
+        time.sleep(0.2)
+        assert _mget_keys(r, 'group=ttl') == []
+
+        r.execute_command('TS.CREATE', 'dumped', 'LABELS', 'group', 'restore')
+        r.execute_command('TS.ADD', 'dumped', 1, 1)
+        dump = r.execute_command('DUMP', 'dumped')
+        r.execute_command('RESTORE', 'restored', 0, dump)
+        assert _mget_keys(r, 'group=restore') == [b'dumped', b'restored']
+        r.execute_command('DEL', 'dumped')
+        assert _mget_keys(r, 'group=restore') == [b'restored']
+        assert _mrange_keys(r, 'group=restore') == [b'restored']
@@ -77,7 +77,8 @@ def test_uncompressed():
         assert [[1, b'3.5'], [2, b'4.5'], [3, b'5.5']] == \
                r.execute_command('ts.range', 'not_compressed', 0, -1)
         info = _get_ts_info(r, 'not_compressed')
-        assert info.total_samples == 3 and info.memory_usage == 4136
+        # series, chunk dict with one entry, chunk header and a 128 bytes first chunk
+        assert info.total_samples == 3 and info.memory_usage == 448
 
         # rdb load
         data = r.execute_command('dump', 'not_compressed')
@@ -88,7 +89,7 @@ def test_uncompressed():
         assert [[1, b'3.5'], [2, b'4.5'], [3, b'5.5']] == \
                r.execute_command('ts.range', 'not_compressed', 0, -1)
         info = _get_ts_info(r, 'not_compressed')
-        assert info.total_samples == 3 and info.memory_usage == 4136
+        assert info.total_samples == 3 and info.memory_usage == 448
         # test deletion
         assert r.delete('not_compressed')
 
@@ -159,3 +160,23 @@ def test_expire():
         assert r.execute_command('expire', 'test', 1) == 1
         time.sleep(2)
         assert r.execute_command('keys', '*') == []
+
+
+def test_chunks_grow_on_demand():
+    with Env().getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', 'growing', 'CHUNK_SIZE', 4096)
+        r.execute_command('TS.ADD', 'growing', 1, 1)
+        debug = r.execute_command('TS.INFO', 'growing', 'DEBUG')
+        chunk = dict(zip(debug[-1][0][::2], debug[-1][0][1::2]))
+        assert chunk[b'size'] < 4096
+        assert chunk[b'slack'] < chunk[b'size']
+
+        for ts in range(2, 2000):
+            r.execute_command('TS.ADD', 'growing', ts, ts * 1.5)
+        debug = r.execute_command('TS.INFO', 'growing', 'DEBUG')
+        chunks = [dict(zip(c[::2], c[1::2])) for c in debug[-1]]
+        assert len(chunks) > 1
+        # sealed chunks were grown up to the chunk size
+        assert all(c[b'size'] >= 4096 for c in chunks[:-1])
+        assert sum(c[b'samples'] for c in chunks) == 1999
+        assert r.execute_command('TS.RANGE', 'growing', 1999, 1999) == [[1999, b'2998.5']]
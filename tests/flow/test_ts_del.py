@@ -0,0 +1,112 @@
+import pytest
+import redis
+from RLTest import Env
+from test_helper_classes import _get_ts_info
+
+
+def test_del_range():
+    with Env().getClusterConnectionIfNeeded() as r:
+        for key, options in (('compressed', []), ('uncompressed', ['UNCOMPRESSED'])):
+            r.execute_command('TS.CREATE', key, 'CHUNK_SIZE', 128, *options)
+            for ts in range(1, 1001):
+                r.execute_command('TS.ADD', key, ts, ts)
+            chunks = _get_ts_info(r, key).chunk_count
+
+            assert r.execute_command('TS.DEL', key, 100, 899) == 800
+            assert r.execute_command('TS.DEL', key, 100, 899) == 0
+            expected = [[ts, str(ts).encode()] for ts in list(range(1, 100)) + list(range(900, 1001))]
+            assert r.execute_command('TS.RANGE', key, '-', '+') == expected
+            info = _get_ts_info(r, key)
+            assert info.total_samples == 200
+            assert info.chunk_count < chunks
+            assert r.execute_command('TS.GET', key) == [1000, b'1000']
+
+            # writes into the re-encoded boundary chunks still work
+            r.execute_command('TS.ADD', key, 500, 5, 'ON_DUPLICATE', 'LAST')
+            r.execute_command('TS.ADD', key, 50, 0.5, 'ON_DUPLICATE', 'LAST')
+            assert r.execute_command('TS.RANGE', key, 50, 50) == [[50, b'0.5']]
+            assert r.execute_command('TS.RANGE', key, 100, 899) == [[500, b'5']]
+            assert _get_ts_info(r, key).total_samples == 201
+
+
+def test_del_tail_and_all():
+    with Env().getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', 'tail', 'CHUNK_SIZE', 128)
+        for ts in range(1, 1001):
+            r.execute_command('TS.ADD', 'tail', ts, ts)
+
+        assert r.execute_command('TS.DEL', 'tail', 500, '+') == 501
+        assert r.execute_command('TS.GET', 'tail') == [499, b'499']
+        r.execute_command('TS.ADD', 'tail', 600, 600)
+        assert r.execute_command('TS.REVRANGE', 'tail', '-', '+', 'COUNT', 2) == [[600, b'600'], [499, b'499']]
+
+        assert r.execute_command('TS.DEL', 'tail', '-', '+') == 500
+        assert r.execute_command('TS.GET', 'tail') == []
+        assert r.execute_command('TS.RANGE', 'tail', '-', '+') == []
+        info = _get_ts_info(r, 'tail')
+        assert info.total_samples == 0
+        assert info.chunk_count == 1
+        r.execute_command('TS.ADD', 'tail', 10, 1)
+        assert r.execute_command('TS.RANGE', 'tail', '-', '+') == [[10, b'1']]
+
+
+def test_del_compaction():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('TS.CREATE', 'src', 'CHUNK_SIZE', 128)
+        r.execute_command('TS.CREATE', 'dest')
+        r.execute_command('TS.CREATERULE', 'src', 'dest', 'AGGREGATION', 'sum', 10)
+        for ts in range(1, 101):
+            r.execute_command('TS.ADD', 'src', ts, 1)
+        assert len(r.execute_command('TS.RANGE', 'dest', '-', '+')) == 10
+
+        # boundary buckets are recalculated, emptied buckets are removed
+        assert r.execute_command('TS.DEL', 'src', 15, 34) == 20
+        res = r.execute_command('TS.RANGE', 'dest', '-', '+')
+        assert res[:4] == [[0, b'9'], [10, b'5'], [30, b'5'], [40, b'10']]
+        assert len(res) == 9
+
+        # deleting the newest samples reopens the bucket of the new last sample
+        r.execute_command('TS.DEL', 'src', 85, '+')
+        res = r.execute_command('TS.RANGE', 'dest', '-', '+')
+        assert res[-1] == [70, b'10']
+        r.execute_command('TS.ADD', 'src', 200, 1)
+        assert r.execute_command('TS.RANGE', 'dest', 80, 80) == [[80, b'5']]
+
+
+
+def test_del_compaction_in_other_db():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        # a key of the same name in db 0 must not be touched
+        r.execute_command('TS.CREATE', 'db_dest')
+        r.execute_command('SELECT', 1)
+        r.execute_command('TS.CREATE', 'db_src')
+        r.execute_command('TS.CREATE', 'db_dest')
+        r.execute_command('TS.CREATERULE', 'db_src', 'db_dest', 'AGGREGATION', 'sum', 10)
+        for ts in range(1, 51):
+            r.execute_command('TS.ADD', 'db_src', ts, 1)
+
+        assert r.execute_command('TS.DEL', 'db_src', 15, 24) == 10
+        assert r.execute_command('TS.RANGE', 'db_dest', '-', '+') == \
+            [[0, b'9'], [10, b'5'], [20, b'5'], [30, b'10'], [40, b'10']]
+        r.execute_command('SELECT', 0)
+        assert r.execute_command('TS.RANGE', 'db_dest', '-', '+') == []
+
+def test_del_fields_and_errors():
+    with Env().getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', 'cpu', 'FIELDS', 'user', 'idle')
+        for ts in range(1, 11):
+            r.execute_command('TS.ADD', 'cpu', ts, ts, 100 - ts)
+        assert r.execute_command('TS.DEL', 'cpu', 3, 8) == 6
+        assert r.execute_command('TS.RANGE', 'cpu', '-', '+') == \
+            [[1, b'1', b'99'], [2, b'2', b'98'], [9, b'9', b'91'], [10, b'10', b'90']]
+
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.DEL', 'cpu', 1)
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.DEL', 'cpu', 'a', 10)
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.DEL', 'missing', 1, 10)
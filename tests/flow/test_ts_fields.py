@@ -0,0 +1,117 @@
+import pytest
+import redis
+from RLTest import Env
+from test_helper_classes import _get_ts_info
+
+
+def test_fields_add_and_range():
+    with Env().getClusterConnectionIfNeeded() as r:
+        assert r.execute_command('TS.CREATE', 'cpu', 'FIELDS', 'user', 'system', 'idle',
+                                 'LABELS', 'hostname', 'host_1')
+        for ts in range(1, 101):
+            assert r.execute_command('TS.ADD', 'cpu', ts, ts, ts * 2, 100 - ts) == ts
+
+        res = r.execute_command('TS.RANGE', 'cpu', 1, 3)
+        assert res == [[1, b'1', b'2', b'99'], [2, b'2', b'4', b'98'], [3, b'3', b'6', b'97']]
+        res = r.execute_command('TS.RANGE', 'cpu', 1, 2, 'FIELDS', 'idle', 'user')
+        assert res == [[1, b'99', b'1'], [2, b'98', b'2']]
+        res = r.execute_command('TS.REVRANGE', 'cpu', '-', '+', 'COUNT', 1, 'FIELDS', 'system')
+        assert res == [[100, b'200']]
+
+        # aggregations apply per field
+        res = r.execute_command('TS.RANGE', 'cpu', 1, 10, 'AGGREGATION', 'max', 10, 'FIELDS', 'user', 'idle')
+        assert res == [[0, b'9', b'99'], [10, b'10', b'90']]
+
+        assert r.execute_command('TS.GET', 'cpu') == [100, b'100', b'200', b'0']
+        info = _get_ts_info(r, 'cpu')
+        assert info.total_samples == 100
+        assert r.execute_command('TS.QUERYINDEX', 'hostname=host_1') == [b'cpu']
+
+
+def test_fields_upsert():
+    with Env().getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', 'up', 'FIELDS', 'a', 'b', 'DUPLICATE_POLICY', 'LAST')
+        r.execute_command('TS.ADD', 'up', 10, 1, 2)
+        r.execute_command('TS.ADD', 'up', 20, 3, 4)
+        r.execute_command('TS.ADD', 'up', 10, 5, 6)
+        r.execute_command('TS.ADD', 'up', 15, 7, 8)
+        assert r.execute_command('TS.RANGE', 'up', '-', '+') == \
+            [[10, b'5', b'6'], [15, b'7', b'8'], [20, b'3', b'4']]
+
+
+def test_fields_with_filters_and_empty_buckets():
+    with Env().getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', 'mixed', 'FIELDS', 'user', 'idle')
+        for ts in [1, 2, 3, 25]:
+            r.execute_command('TS.ADD', 'mixed', ts, ts, 100 - ts)
+
+        # the FIELDS list ends at the keyword that follows it
+        res = r.execute_command('TS.RANGE', 'mixed', '-', '+', 'FIELDS', 'idle', 'FILTER_BY_TS', 1, 3)
+        assert res == [[1, b'99'], [3, b'97']]
+        res = r.execute_command('TS.RANGE', 'mixed', '-', '+', 'FILTER_BY_TS', 1, 3, 'FIELDS', 'idle')
+        assert res == [[1, b'99'], [3, b'97']]
+        with pytest.raises(redis.ResponseError) as e:
+            r.execute_command('TS.RANGE', 'mixed', '-', '+', 'FIELDS', 'user', 'FILTER_BY_VALUE', 0, 10)
+        assert 'FILTER_BY_VALUE' in str(e.value)
+
+        res = r.execute_command('TS.RANGE', 'mixed', '-', '+', 'FIELDS', 'user', 'idle',
+                                'AGGREGATION', 'count', 10, 'EMPTY')
+        assert res == [[0, b'3', b'3'], [10, b'0', b'0'], [20, b'1', b'1']]
+        res = r.execute_command('TS.RANGE', 'mixed', '-', '+', 'AGGREGATION', 'count', 10, 'EMPTY',
+                                'FIELDS', 'idle')
+        assert res == [[0, b'3'], [10, b'0'], [20, b'1']]
+        res = r.execute_command('TS.RANGE', 'mixed', '-', '+', 'FIELDS', 'user', 'idle',
+                                'AGGREGATION', 'max', 10, 'FILL', 'PREVIOUS')
+        assert res == [[0, b'3', b'99'], [10, b'3', b'99'], [20, b'25', b'75']]
+        res = r.execute_command('TS.REVRANGE', 'mixed', '-', '+', 'AGGREGATION', 'max', 10,
+                                'FILL', 'VALUE', -1, 'FIELDS', 'user')
+        assert res == [[20, b'25'], [10, b'-1'], [0, b'3']]
+
+
+def test_fields_errors():
+    with Env().getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', 'err', 'FIELDS', 'a', 'b')
+        r.execute_command('TS.CREATE', 'plain')
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.CREATE', 'dup', 'FIELDS', 'a', 'a')
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.ADD', 'err', 1, 1)
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.ADD', 'err', 1, 1, 'x')
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.RANGE', 'err', '-', '+', 'FIELDS', 'c')
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.RANGE', 'plain', '-', '+', 'FIELDS', 'a')
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.INCRBY', 'err', 1)
+        r.execute_command('TS.CREATE', 'err_agg')
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.CREATERULE', 'err', 'err_agg', 'AGGREGATION', 'avg', 10)
+
+
+def test_fields_madd():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('TS.CREATE', 'wide', 'FIELDS', 'a', 'b')
+        r.execute_command('TS.CREATE', 'plain')
+        # an error for the key with fields only, the other samples are added
+        res = r.execute_command('TS.MADD', 'wide', 1, 1, 'plain', 1, 5)
+        assert isinstance(res[0], redis.ResponseError)
+        assert res[1] == 1
+        assert r.execute_command('TS.RANGE', 'wide', '-', '+') == []
+        assert r.execute_command('TS.GET', 'plain') == [1, b'5']
+
+
+def test_fields_dump_restore():
+    with Env().getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', 'persist', 'CHUNK_SIZE', 128, 'FIELDS', 'a', 'b')
+        for ts in range(1, 501):
+            r.execute_command('TS.ADD', 'persist', ts, ts, -ts)
+        expected = r.execute_command('TS.RANGE', 'persist', '-', '+')
+        data = r.execute_command('DUMP', 'persist')
+        r.execute_command('DEL', 'persist')
+        r.execute_command('RESTORE', 'persist', 0, data)
+        assert r.execute_command('TS.RANGE', 'persist', '-', '+') == expected
+        assert r.execute_command('TS.GET', 'persist') == [500, b'500', b'-500']
+        assert _get_ts_info(r, 'persist').total_samples == 500
@@ -0,0 +1,71 @@
+from RLTest import Env
+from test_helper_classes import _get_ts_info
+
+
+def _memstats(r):
+    res = r.execute_command('TS.MEMSTATS')
+    return {res[i].decode(): res[i + 1] for i in range(0, len(res), 2)}
+
+
+def test_memstats_tracks_series_lifecycle():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        empty = _memstats(r)
+        assert empty['seriesCount'] == 0
+        assert empty['chunkData'] == 0
+
+        r.execute_command('TS.CREATE', 'mem1', 'CHUNK_SIZE', '128', 'LABELS', 'name', 'mem1', 'team', 'core')
+        r.execute_command('TS.CREATE', 'mem2', 'UNCOMPRESSED', 'CHUNK_SIZE', '128')
+        r.execute_command('TS.CREATE', 'mem1_avg')
+        r.execute_command('TS.CREATERULE', 'mem1', 'mem1_avg', 'AGGREGATION', 'avg', 10)
+        for ts in range(1, 1001):
+            r.execute_command('TS.ADD', 'mem1', ts, ts * 1.5)
+            r.execute_command('TS.ADD', 'mem2', ts, ts)
+
+        stats = _memstats(r)
+        assert stats['seriesCount'] == 3
+        # uncompressed chunks are 16 bytes per sample
+        assert stats['chunkData'] > 1000 * 16
+        assert stats['chunkSlack'] >= 0
+        assert stats['chunkDirectory'] > 0
+        assert stats['labels'] > 0
+        assert stats['invertedIndex'] > 0
+        assert stats['compactionContexts'] > 0
+        assert stats['total'] >= stats['chunkData'] + stats['chunkSlack'] + stats['labels']
+
+        info = _get_ts_info(r, 'mem1')
+        assert info.memory_usage > 0
+        assert r.execute_command('MEMORY', 'USAGE', 'mem1') > 0
+
+        # out of order writes split chunks, the counters must keep up
+        r.execute_command('TS.CREATE', 'mem3', 'CHUNK_SIZE', '128')
+        for ts in range(0, 2000, 2):
+            r.execute_command('TS.ADD', 'mem3', ts, ts)
+        for ts in range(1, 2000, 2):
+            r.execute_command('TS.ADD', 'mem3', ts, ts)
+        for ts in range(0, 2000, 5):
+            r.execute_command('TS.ADD', 'mem3', ts, 0, 'ON_DUPLICATE', 'LAST')
+        assert len(r.execute_command('TS.RANGE', 'mem3', '-', '+')) == 2000
+
+        r.execute_command('DEL', 'mem1', 'mem2', 'mem3', 'mem1_avg')
+        stats = _memstats(r)
+        assert stats['seriesCount'] == 0
+        assert stats['chunkData'] == 0
+        assert stats['chunkSlack'] == 0
+        assert stats['labels'] == 0
+        assert stats['compactionContexts'] == 0
+
+
+def test_memstats_retention_trim():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('TS.CREATE', 'trimmed', 'RETENTION', '100', 'UNCOMPRESSED', 'CHUNK_SIZE', '128')
+        for ts in range(1, 1001):
+            r.execute_command('TS.ADD', 'trimmed', ts, ts)
+        stats = _memstats(r)
+        # only the chunks within retention (plus the open one) are accounted
+        assert stats['chunkData'] < 300 * 16
+        r.execute_command('DEL', 'trimmed')
+        assert _memstats(r)['chunkData'] == 0
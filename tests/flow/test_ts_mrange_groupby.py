@@ -118,3 +118,27 @@ def test_groupby_reduce_multiple_groups():
         env.assertEqual(serie2_labels[1][1], b'max')
         env.assertEqual(serie2_labels[2][0], b'__source__')
         env.assertEqual(serie2_labels[2][1], b's3')
+
+def test_groupby_reduce_many_members():
+    env = Env()
+    with env.getClusterConnectionIfNeeded() as r:
+        members = 50
+        expected = {}
+        for i in range(members):
+            key = 'host{%d}' % i
+            r.execute_command('TS.CREATE', key, 'LABELS', 'metric', 'cpu', 'host', i)
+            # members overlap on some timestamps only
+            for ts in range(i % 5, 200, 1 + i % 3):
+                value = (ts * 7 + i) % 23
+                r.execute_command('TS.ADD', key, ts, value)
+                expected.setdefault(ts, []).append(value)
+
+        reducers = {'sum': sum, 'min': min, 'max': max}
+        for name, reduce in reducers.items():
+            rows = [[ts, str(reduce(values)).encode()] for ts, values in sorted(expected.items())]
+            res = r.execute_command('TS.MRANGE', '-', '+', 'FILTER', 'metric=cpu',
+                                    'GROUPBY', 'metric', 'REDUCE', name)
+            env.assertEqual(res[0][2], rows)
+            res = r.execute_command('TS.MREVRANGE', '-', '+', 'COUNT', 10, 'FILTER', 'metric=cpu',
+                                    'GROUPBY', 'metric', 'REDUCE', name)
+            env.assertEqual(res[0][2], rows[::-1][:10])
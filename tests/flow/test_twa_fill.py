@@ -0,0 +1,91 @@
+import math
+
+import pytest
+import redis
+from RLTest import Env
+
+# a gauge rising to 10, held, then falling back to 0
+GAUGE = [(0, 0), (10, 10), (30, 10), (60, 0)]
+
+
+def _add_gauge(r, key):
+    for ts, value in GAUGE:
+        r.execute_command('TS.ADD', key, ts, value)
+
+
+def _rows(res):
+    return [[row[0]] + [float(value) for value in row[1:]] for row in res]
+
+
+def test_twa():
+    with Env().getClusterConnectionIfNeeded() as r:
+        _add_gauge(r, 'gauge')
+        res = _rows(r.execute_command('TS.RANGE', 'gauge', '-', '+', 'AGGREGATION', 'twa,avg', 20))
+        assert [row[0] for row in res] == [0, 20, 60]
+        assert res[0][1:] == [7.5, 5]
+        # the value held from 10 to 30 weighs more than the samples
+        assert res[1][1] == pytest.approx(9.1667, abs=1e-4)
+        rev = _rows(r.execute_command('TS.REVRANGE', 'gauge', '-', '+', 'AGGREGATION', 'TWA,avg', 20))
+        assert rev == res[::-1]
+
+
+def test_empty_buckets():
+    with Env().getClusterConnectionIfNeeded() as r:
+        _add_gauge(r, 'gauge')
+        res = _rows(r.execute_command('TS.RANGE', 'gauge', '-', '+',
+                                      'AGGREGATION', 'twa,count,avg', 10, 'EMPTY'))
+        assert [row[0] for row in res] == [0, 10, 20, 30, 40, 50, 60]
+        # twa interpolates the empty buckets, the other types have no value for them
+        assert [row[1] for row in res] == pytest.approx([5, 10, 10, 25 / 3., 5, 5 / 3., 0])
+        assert [row[2] for row in res] == [1, 1, 0, 1, 0, 0, 1]
+        assert math.isnan(res[2][3]) and math.isnan(res[4][3])
+        rev = _rows(r.execute_command('TS.REVRANGE', 'gauge', '-', '+',
+                                      'AGGREGATION', 'twa,count', 10, 'EMPTY'))
+        assert [row[:3] for row in rev] == [row[:3] for row in res[::-1]]
+
+        # the range is reported whole while the series goes on past it
+        res = _rows(r.execute_command('TS.RANGE', 'gauge', 35, 55, 'AGGREGATION', 'twa', 10, 'EMPTY'))
+        assert [row[0] for row in res] == [30, 40, 50]
+        # but not past the series ends
+        res = r.execute_command('TS.RANGE', 'gauge', 0, 1000, 'AGGREGATION', 'count', 10, 'EMPTY')
+        assert res[-1][0] == 60
+
+
+def test_fill():
+    with Env().getClusterConnectionIfNeeded() as r:
+        _add_gauge(r, 'gauge')
+        res = _rows(r.execute_command('TS.RANGE', 'gauge', '-', '+',
+                                      'AGGREGATION', 'avg', 10, 'FILL', 'PREVIOUS'))
+        assert res == [[0, 0], [10, 10], [20, 10], [30, 10], [40, 10], [50, 10], [60, 0]]
+        res = _rows(r.execute_command('TS.REVRANGE', 'gauge', '-', '+',
+                                      'AGGREGATION', 'avg', 10, 'FILL', 'linear'))
+        assert [row[1] for row in res] == pytest.approx([0, 10 / 3., 20 / 3., 10, 10, 10, 0])
+        res = _rows(r.execute_command('TS.RANGE', 'gauge', '-', '+',
+                                      'AGGREGATION', 'avg,max', 10, 'EMPTY', 'FILL', 'VALUE', -1))
+        assert res[2] == [20, -1, -1]
+
+
+def test_fill_errors():
+    with Env().getClusterConnectionIfNeeded() as r:
+        _add_gauge(r, 'gauge')
+        for args in [['FILL'], ['FILL', 'next'], ['FILL', 'VALUE'], ['FILL', 'VALUE', 'x']]:
+            with pytest.raises(redis.ResponseError):
+                r.execute_command('TS.RANGE', 'gauge', '-', '+', 'AGGREGATION', 'avg', 10, *args)
+
+
+def test_twa_rule():
+    env = Env()
+    env.skipOnCluster()
+    with env.getConnection() as r:
+        r.execute_command('TS.CREATE', 'gauge')
+        r.execute_command('TS.CREATE', 'gauge_twa')
+        r.execute_command('TS.CREATERULE', 'gauge', 'gauge_twa', 'AGGREGATION', 'twa', 20)
+        r.execute_command('TS.ADD', 'gauge', 0, 0)
+        r.execute_command('TS.ADD', 'gauge', 10, 10)
+        r.execute_command('DEBUG', 'RELOAD')
+        for ts, value in GAUGE[2:]:
+            r.execute_command('TS.ADD', 'gauge', ts, value)
+
+        # the same buckets as the query, the sample closing a bucket ends its interpolation
+        expected = r.execute_command('TS.RANGE', 'gauge', 0, 59, 'AGGREGATION', 'twa', 20)
+        assert r.execute_command('TS.RANGE', 'gauge_twa', '-', '+') == expected